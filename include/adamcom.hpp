@@ -14,6 +14,12 @@
 #include <array>
 #include <cstdint>
 #include <chrono>
+#include <cstdio>
+#include <atomic>
+#include <sys/types.h>
+
+struct pollfd;
+struct can_frame;
 
 namespace adamcom {
 
@@ -24,6 +30,9 @@ namespace adamcom {
 /// Interface type for communication
 enum class InterfaceType { SERIAL, CAN };
 
+/// Event direction (structured output, shm, decoders)
+enum class OutputDir : uint8_t { RX, TX };
+
 /// Configuration map type alias
 using Config = std::map<std::string, std::string>;
 
@@ -70,12 +79,19 @@ bool write_profile(const std::string& path, const Config& cfg);
 // Serial Helpers
 // ============================================================================
 
-/// Parse baud rate string to numeric value
+/// Parse baud rate string to numeric value (throws on non-numeric or 0)
 unsigned int get_baud_numeric(const std::string& s);
 
 /// Get platform speed_t value for baud rate (throws on unsupported baud)
 unsigned int get_baud_speed_t(const std::string& s);
 
+/// Baud rate for a platform speed_t value (0 when it is not in the table)
+unsigned int get_baud_from_speed_t(unsigned int speed);
+
+/// Set any integer baud rate via termios2/BOTHER; applied is the rate the driver
+/// reports back. False when the driver does not support TCSETS2.
+bool serial_set_custom_baud(int fd, unsigned int rate, unsigned int& applied);
+
 // ============================================================================
 // Data Parsing
 // ============================================================================
@@ -87,25 +103,81 @@ bool parse_hex_bytes(const std::string& input, std::vector<uint8_t>& out);
 // Serial I/O
 // ============================================================================
 
-/// Send raw bytes over serial
+/// Send raw bytes over serial; what the port cannot take now is queued (false on error or full queue)
 bool send_serial_bytes(int fd, const std::vector<uint8_t>& data);
+bool send_serial_bytes(int fd, const uint8_t* data, size_t len);
+
+/// Send a user payload (presets, inline repeats, /hex) with the TX checksum appended, if one is set
+bool send_serial_payload(int fd, const uint8_t* data, size_t len);
 
 /// Send text over serial (optionally append CRLF)
 bool send_serial_text(int fd, const std::string& text, bool append_crlf);
 
+/// Account bytes that reached the port (output, shm, load meter)
+void serial_tx_written(const uint8_t* data, size_t len);
+
 // ============================================================================
 // CAN Helpers
 // ============================================================================
 
-/// Configure CAN interface bitrate and bring up (requires sudo)
+/// Link state read over rtnetlink
+struct CanLinkInfo {
+    int ifindex = 0;
+    bool up = false;
+    std::string kind;                  // "can", "vcan", ... (empty for plain devices)
+    uint32_t bitrate = 0;              // 0 when not configured or not a CAN controller
+    std::string state;                 // ERROR-ACTIVE, BUS-OFF, ... (CAN controllers only)
+    uint32_t txqueuelen = 0;           // Driver/qdisc queue length in frames
+};
+
+/// Read link flags, kind, bitrate and controller state (0 or -errno)
+int canlink_query(const std::string& ifname, CanLinkInfo& info);
+
+/// Set the bitrate and bring the interface up, changing only what differs (needs
+/// CAP_NET_ADMIN; falls back to sudo ip without it)
 int configure_can_interface(const std::string& ifname, const std::string& bitrate);
 
-/// Setup CAN socket and bind to interface
+/// Setup non-blocking CAN socket and bind to interface (SO_RXQ_OVFL on, SO_RCVBUF from can_rcvbuf_kb)
 int setup_can(const std::string& ifname, const std::string& filter_str = "");
 
+/// Receive side of the CAN socket: buffer size and the kernel's drop counter
+struct CanRxState {
+    size_t rcvbuf_kb = 0;              // cfg can_rcvbuf_kb; 0 keeps the kernel default
+    int rcvbuf = 0;                    // What the kernel granted (it doubles requests for overhead)
+    bool forced = false;               // Set with SO_RCVBUFFORCE, past net.core.rmem_max
+    bool ovfl = false;                 // SO_RXQ_OVFL accepted: drop counts arrive with frames
+    uint32_t kernel_drops = 0;         // This socket's counter as of the last frame
+    uint64_t dropped = 0;              // Frames the kernel dropped, all sockets since start
+    uint64_t unreported = 0;           // Dropped since the last on-screen warning
+    std::chrono::steady_clock::time_point last_warn;
+};
+
+extern CanRxState g_canrx;
+
+/// Read can_rcvbuf_kb (applied by the next setup_can)
+void can_rx_configure(const Config& cfg);
+
+/// Read one frame with recvmsg(), counting drops reported in the SO_RXQ_OVFL cmsg.
+/// The socket is non-blocking: returns 0 when no frame is queued.
+ssize_t can_read_frame(int fd, struct can_frame& frame);
+
 /// Send CAN frame (data max 8 bytes)
 bool send_can_bytes(int fd, uint32_t can_id, const std::vector<uint8_t>& data);
 
+/// Send CAN frame from a raw buffer (len max 8 bytes); a frame the socket refuses with
+/// ENOBUFS/EAGAIN is parked in the transmit queue and still counts as sent
+bool send_can_bytes(int fd, uint32_t can_id, const uint8_t* data, size_t len);
+
+/// Send CAN frame behind any parked frames but never park it: a refusal is counted in the
+/// transmit queue and returned with errno kept, so the caller paces itself (/stress)
+bool send_can_paced(int fd, uint32_t can_id, const uint8_t* data, size_t len);
+
+/// Account a CAN frame that reached the socket (metrics, output, shm, bus load)
+void can_tx_written(uint32_t can_id, const uint8_t* data, uint8_t dlc);
+
+/// Send a user payload with the TX checksum appended, if one is set (false when it does not fit)
+bool send_can_payload(int fd, uint32_t can_id, const uint8_t* data, size_t len);
+
 // ============================================================================
 // Presets
 // ============================================================================
@@ -114,6 +186,1507 @@ bool send_can_bytes(int fd, uint32_t can_id, const std::vector<uint8_t>& data);
 bool send_preset(int fd, const Config& cfg, InterfaceType itype,
                  int preset_index, bool append_crlf);
 
+// ============================================================================
+// Modbus RTU
+// ============================================================================
+
+/// Per-slave Modbus RTU traffic statistics
+struct ModbusSlaveStats {
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t exceptions = 0;
+    uint64_t timeouts = 0;
+    uint64_t crc_errors = 0;
+    uint64_t rtt_total_us = 0;     // Sum of response times (responses + exceptions)
+    uint32_t rtt_min_us = 0;
+    uint32_t rtt_max_us = 0;
+};
+
+/// Outstanding request awaiting a response from one slave
+struct ModbusPending {
+    bool active = false;
+    uint8_t function = 0;
+    uint16_t start = 0;            // First coil/register (for labelling the response)
+    uint16_t quantity = 0;
+    std::chrono::steady_clock::time_point sent;   // Last byte of the request
+};
+
+/// Frame assembly for one direction of the line
+struct ModbusLine {
+    std::vector<uint8_t> buf;      // Bytes of the frame(s) being assembled
+    std::chrono::steady_clock::time_point first_byte;
+    std::chrono::steady_clock::time_point last_byte;
+};
+
+/// Modbus RTU decoder state (frames are delimited by 3.5 characters of silence)
+struct ModbusState {
+    bool enabled = false;
+    int char_us = 87;              // One character on the wire (start+data+parity+stop)
+    int silence_us = 1750;         // t3.5 inter-frame gap
+    int response_timeout_ms = 1000;
+    ModbusLine rx;                 // Bytes read from the port
+    ModbusLine tx;                 // Bytes we wrote (adamcom as master or emulated slave)
+    std::vector<uint8_t> last_tx;  // Last frame we sent, so an RS-485 echo is not decoded twice
+    std::array<ModbusPending, 256> pending{};
+    std::array<ModbusSlaveStats, 256> slaves{};
+    uint64_t frames = 0;
+    uint64_t crc_errors = 0;
+};
+
+/// Global Modbus decoder state
+extern ModbusState g_modbus;
+
+/// Derive character and t3.5 silence times from the serial settings in cfg
+void modbus_configure(const Config& cfg);
+
+/// Feed a chunk of received (ts: when read() returned) or written (ts: when write()
+/// returned) bytes; requests and responses pair up whichever side sent them
+void modbus_feed(OutputDir dir, const uint8_t* data, size_t len, std::chrono::steady_clock::time_point ts);
+
+/// Close the pending frame once the line has been silent for t3.5, expire stale requests
+void modbus_poll(std::chrono::steady_clock::time_point now);
+
+/// Milliseconds until modbus_poll() must run (-1 if no frame is pending)
+int modbus_timeout_ms(std::chrono::steady_clock::time_point now);
+
+/// Print per-slave request/response counts, CRC error rates and response times
+void modbus_print_stats();
+
+/// Clear all Modbus statistics
+void modbus_reset_stats();
+
+// ============================================================================
+// ISO-TP (ISO 15765-2)
+// ============================================================================
+
+/// Transmit session phase
+enum class IsoTpTxPhase { IDLE, WAIT_FC, SENDING };
+
+/// Outgoing multi-frame transfer
+struct IsoTpTxSession {
+    IsoTpTxPhase phase = IsoTpTxPhase::IDLE;
+    uint32_t can_id = 0;
+    std::vector<uint8_t> data;     // Whole payload being segmented
+    size_t offset = 0;             // Next payload byte to send
+    uint8_t next_sn = 1;           // Sequence number of the next consecutive frame
+    uint8_t block_size = 0;        // BS granted by the receiver (0 = no limit)
+    int block_left = 0;            // Consecutive frames left in the current block
+    int wait_frames = 0;           // FC.WAIT frames received in a row
+    std::chrono::microseconds st_min{0};   // STmin granted by the receiver
+    std::chrono::steady_clock::time_point next_cf;
+    std::chrono::steady_clock::time_point deadline;   // N_Bs timeout
+    std::chrono::steady_clock::time_point started;
+};
+
+/// Incoming multi-frame reassembly
+struct IsoTpRxSession {
+    bool active = false;
+    size_t expected = 0;           // Length announced by the first frame
+    std::vector<uint8_t> data;
+    uint8_t next_sn = 1;
+    int block_count = 0;           // Consecutive frames received in the current block
+    std::chrono::steady_clock::time_point deadline;   // N_Cr timeout
+    std::chrono::steady_clock::time_point started;
+};
+
+/// ISO-TP engine state (one tester-style TX/RX ID pair)
+struct IsoTpState {
+    bool enabled = false;
+    uint32_t tx_id = 0x7E0;        // We send SF/FF/CF and our FC on this ID
+    uint32_t rx_id = 0x7E8;        // We reassemble SF/FF/CF and accept FC from this ID
+    uint8_t block_size = 0;        // BS advertised in our flow control
+    uint8_t st_min = 0;            // STmin advertised in our flow control (raw encoding)
+    bool padding = true;           // Pad frames to 8 bytes (false = minimal DLC)
+    uint8_t pad_byte = 0xCC;
+    size_t max_rx_len = 1 << 20;   // Larger announcements are refused with FC.OVFLW
+    IsoTpTxSession tx;
+    IsoTpRxSession rx;
+    uint64_t tx_messages = 0;
+    uint64_t tx_errors = 0;
+    uint64_t rx_messages = 0;
+    uint64_t rx_errors = 0;
+    double last_tx_rate = 0.0;     // Effective payload bytes/s of the last transfer
+    double last_rx_rate = 0.0;
+};
+
+/// Global ISO-TP state
+extern IsoTpState g_isotp;
+
+/// Load IDs, BS/STmin and padding from the isotp_* config keys
+void isotp_configure(const Config& cfg);
+
+/// Start sending payload (any length up to 4 GiB) to can_id; single frames go out immediately
+bool isotp_send(int fd, uint32_t can_id, const std::vector<uint8_t>& payload);
+
+/// Process a received frame; returns true if it belonged to ISO-TP (rx_id)
+bool isotp_handle_rx(int fd, uint32_t can_id, const uint8_t* data, size_t dlc);
+
+/// Send due consecutive frames and expire N_Bs/N_Cr timeouts
+void isotp_poll(int fd, std::chrono::steady_clock::time_point now);
+
+/// When isotp_poll() must next run (time_point::max() if no transfer is active)
+std::chrono::steady_clock::time_point isotp_next_deadline();
+
+/// Block until the transfer in progress completes or times out (one-shot mode).
+/// Reads the CAN socket for flow control; returns false on abort or timeout.
+bool isotp_wait_tx(int fd);
+
+/// Print configuration, transfers in progress and throughput
+void isotp_print_status();
+
+// ============================================================================
+// J1939
+// ============================================================================
+
+/// Fields of a 29-bit J1939 identifier
+struct J1939Id {
+    uint8_t priority = 0;
+    uint32_t pgn = 0;              // 18-bit parameter group number
+    uint8_t sa = 0;                // Source address
+    uint8_t da = 0xFF;             // Destination address (0xFF for PDU2/broadcast)
+};
+
+/// Per-PGN/SA statistics entry (open-addressing hash table slot)
+struct J1939Stat {
+    uint32_t key = 0;              // (PGN << 8) | SA, 0xFFFFFFFF = empty
+    uint64_t count = 0;
+    uint8_t last_da = 0xFF;
+    uint16_t last_len = 0;
+    std::array<uint8_t, 8> last_data{};
+    std::chrono::steady_clock::time_point first_seen;
+    std::chrono::steady_clock::time_point last_seen;
+};
+
+/// Transport protocol (BAM or RTS/CTS) reassembly session
+struct J1939TpSession {
+    bool active = false;
+    bool bam = false;
+    uint8_t sa = 0;                // Originator of the data
+    uint8_t da = 0xFF;
+    uint8_t priority = 0;
+    uint32_t pgn = 0;              // PGN of the reassembled message
+    size_t size = 0;               // Announced message size
+    uint8_t packets = 0;
+    uint8_t next_seq = 1;
+    std::vector<uint8_t> data;
+    std::chrono::steady_clock::time_point last_rx;
+};
+
+/// Capacity of the PGN/SA statistics table (power of two)
+constexpr size_t J1939_STATS_CAPACITY = 4096;
+
+/// J1939 decoder state
+struct J1939State {
+    bool enabled = false;
+    bool show_frames = true;       // Print every decoded frame (off = stats + TP only)
+    bool show_tp = true;           // Print reassembled TP messages
+    std::vector<J1939Stat> stats;  // Allocated once on first use
+    size_t stats_used = 0;
+    uint64_t stats_dropped = 0;
+    std::array<J1939TpSession, 32> sessions{};
+    uint64_t frames = 0;
+    uint64_t tp_completed = 0;
+    uint64_t tp_aborted = 0;
+};
+
+/// Global J1939 state
+extern J1939State g_j1939;
+
+/// Split a 29-bit identifier into priority, PGN, source and destination address
+J1939Id j1939_decode_id(uint32_t can_id);
+
+/// Decode, index and (optionally) print an extended frame; TP.DT frames are consumed
+bool j1939_handle_rx(uint32_t can_id, const uint8_t* data, size_t dlc,
+                     std::chrono::steady_clock::time_point now);
+
+/// Expire stalled transport protocol sessions
+void j1939_poll(std::chrono::steady_clock::time_point now);
+
+/// Print PGN/SA statistics sorted by frame count (limit 0 = all rows)
+void j1939_print_stats(size_t limit);
+
+/// Clear J1939 statistics
+void j1939_reset_stats();
+
+// ============================================================================
+// DBC Decoding
+// ============================================================================
+
+/// Precomputed extraction descriptor for one signal (hot decode data only)
+struct DbcSignal {
+    uint64_t mask = 0;             // (1 << length) - 1
+    uint64_t sign_bit = 0;         // 1 << (length - 1) for signed signals, else 0
+    double factor = 1.0;
+    double offset = 0.0;
+    uint8_t shift = 0;             // Right shift bringing the LSB to bit 0
+    uint8_t motorola = 0;          // 0 = Intel (LE word), 1 = Motorola (BE word)
+    uint8_t is_signed = 0;
+    uint8_t is_multiplexer = 0;
+    int16_t mux_value = -1;        // Multiplexed signal: present when mux == value
+};
+
+/// Message definition; signals live contiguously in DbcDatabase::signals
+struct DbcMessage {
+    uint32_t id = 0;
+    bool extended = false;
+    uint8_t dlc = 8;
+    uint32_t first_signal = 0;
+    uint32_t signal_count = 0;
+    int32_t mux_signal = -1;       // Index (within the message) of the multiplexer
+};
+
+/// Loaded DBC databases, flattened for lookup by CAN ID
+struct DbcDatabase {
+    bool enabled = true;
+    std::vector<std::string> files;
+    std::vector<DbcMessage> messages;
+    std::vector<std::string> message_names;
+    std::vector<DbcSignal> signals;
+    std::vector<std::string> signal_names;
+    std::vector<std::string> signal_units;
+    std::vector<int32_t> std_index;                      // 11-bit ID -> message, -1 = none
+    std::vector<std::pair<uint32_t, int32_t>> ext_index; // Open-addressing 29-bit ID map
+    std::vector<double> values;    // Decode scratch, sized for the largest message
+    std::vector<uint8_t> present;
+};
+
+/// Global DBC database
+extern DbcDatabase g_dbc;
+
+/// Parse a DBC file and merge it into g_dbc; report receives a summary or the error
+bool dbc_load(const std::string& path, std::string& report);
+
+/// Drop all loaded databases
+void dbc_clear();
+
+/// Look up the message definition for a CAN ID (nullptr if unknown)
+const DbcMessage* dbc_find(uint32_t can_id, bool extended);
+
+/// Decode all signals of a frame into g_dbc.values/present (no allocation)
+size_t dbc_decode(const DbcMessage& msg, const uint8_t* data, size_t dlc);
+
+/// Decode a frame and render "Message: Signal=value unit, ..."
+std::string dbc_format(const DbcMessage& msg, const uint8_t* data, size_t dlc);
+
+// ============================================================================
+// Triggers and Capture
+// ============================================================================
+
+/// Action fired when a trigger matches
+enum class TriggerAction { PRESET, REPEAT_START, REPEAT_STOP, CAPTURE_START, CAPTURE_STOP, DUMP, BELL };
+
+/// One trigger: CAN ID/mask + data mask, or a serial byte pattern
+struct Trigger {
+    std::string spec;              // Original definition, e.g. "can 0x100 01 ?? -> preset 2"
+    bool is_can = false;
+    bool extended = false;
+    uint32_t can_id = 0;
+    uint32_t id_mask = 0x7FF;
+    uint64_t data_want = 0;        // Expected data bytes (little-endian packed)
+    uint64_t data_mask = 0;        // 0xFF per compared byte, 0x00 for "??"
+    uint8_t data_len = 0;          // Minimum DLC for a match
+    std::vector<uint8_t> pattern;  // Serial byte pattern
+    TriggerAction action = TriggerAction::BELL;
+    int arg = 0;                   // Preset number for preset/repeat actions
+    uint64_t fires = 0;
+};
+
+/// Lookup tables over a set of matchers (shared by triggers and the auto-responder)
+struct MatchIndex {
+    size_t can_count = 0;
+    size_t serial_count = 0;
+
+    // CAN lookup: direct table for 11-bit IDs (masks expanded), sorted/masked lists for 29-bit
+    std::vector<std::vector<uint16_t>> sff_index;
+    std::vector<std::pair<uint32_t, uint16_t>> eff_exact;
+    std::vector<uint16_t> eff_masked;
+
+    // Serial patterns: dense Aho-Corasick DFA (256 transitions per state)
+    std::vector<int32_t> ac_next;
+    std::vector<int32_t> ac_fail;
+    std::vector<int32_t> ac_match;   // Matcher ending at this state, -1 = none
+    std::vector<int32_t> ac_dict;    // Nearest suffix state with a match, -1 = none
+    std::vector<int32_t> ac_same;    // Next matcher with an identical pattern
+    int32_t ac_state = 0;            // Carried across reads
+};
+
+/// Called with the index of each matching entry
+using MatchFn = void (*)(size_t index);
+
+/// Raw RX event kept in the pre-trigger history
+constexpr size_t RX_EVENT_BYTES = 64;
+struct RxEvent {
+    std::chrono::system_clock::time_point time;
+    bool is_can = false;
+    bool extended = false;
+    uint32_t id = 0;
+    uint8_t len = 0;
+    std::array<uint8_t, RX_EVENT_BYTES> data{};
+};
+
+/// Limits for persisted triggers and the pre-trigger history ring
+constexpr int MAX_TRIGGERS = 1000;
+constexpr size_t RX_HISTORY_EVENTS = 1024;
+
+/// Trigger engine, capture file and pre-trigger history
+struct TriggerState {
+    bool enabled = true;
+    std::vector<Trigger> triggers;
+    MatchIndex index;
+
+    std::vector<RxEvent> history;
+    size_t history_head = 0;
+    size_t history_count = 0;
+
+    FILE* capture = nullptr;
+    std::string capture_path;
+    uint64_t capture_events = 0;
+    std::string can_iface = "can0";
+
+    // Context for actions (owned by main)
+    const int* fd = nullptr;
+    const Config* cfg = nullptr;
+    const InterfaceType* itype = nullptr;
+    const bool* append_crlf = nullptr;
+};
+
+/// Global trigger state
+extern TriggerState g_trigger;
+
+/// Parse "MATCH -> ACTION" (MATCH: can ID[/MASK] [XX|?? ...], hex XX ..., text STRING)
+bool trigger_parse(const std::string& spec, Trigger& t, std::string& error);
+
+/// Parse only the match part ("can ...", "hex ...", "text ...") into t
+bool trigger_parse_match(std::string match, Trigger& t, std::string& error);
+
+/// Build CAN ID tables and the Aho-Corasick automaton for a matcher list
+void match_index_build(MatchIndex& ix, const std::vector<Trigger>& matchers);
+
+/// Call on_match for every CAN matcher accepting the frame
+void match_can(const MatchIndex& ix, const std::vector<Trigger>& matchers,
+               uint32_t can_id, bool extended, const uint8_t* data, size_t dlc, MatchFn on_match);
+
+/// Feed serial bytes through the automaton, calling on_match per pattern hit
+void match_serial(MatchIndex& ix, const uint8_t* data, size_t len, MatchFn on_match);
+
+/// Load trigger1..N from the config and build lookup tables
+void trigger_configure(const Config& cfg);
+
+/// Store the current triggers as trigger1..N in the config
+void trigger_save(Config& cfg);
+
+/// Point actions at main's fd, config, interface type and CRLF setting
+void trigger_bind(const int* fd, const Config* cfg, const InterfaceType* itype, const bool* append_crlf);
+
+/// Add, remove (0-based) or clear triggers; lookup tables are rebuilt
+bool trigger_add(const std::string& spec, std::string& error);
+bool trigger_remove(size_t index);
+void trigger_clear();
+
+/// Record a received CAN frame and fire matching triggers
+void trigger_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc);
+
+/// Record received serial bytes and fire matching pattern triggers
+void trigger_serial_rx(const uint8_t* data, size_t len);
+
+/// Start/stop appending RX events to a capture file (candump log format)
+bool capture_start(const std::string& path, std::string& error);
+void capture_stop();
+
+/// Write a "# ..." comment line (link gap markers) to the capture file, if one is open
+void capture_note(const std::string& text);
+
+/// Print the pre-trigger history (or append it to the capture file if one is open)
+void trigger_dump_history();
+
+/// Print triggers and fire counts
+void trigger_print_list();
+
+// ============================================================================
+// Auto-Responder
+// ============================================================================
+
+/// Pre-built response (CAN frame or serial bytes) for one responder entry
+struct ResponderEntry {
+    std::string spec;              // e.g. "can 0x7E0 02 10 03 -> can 0x7E8 02 50 03 delay 5"
+    bool is_can = false;
+    uint32_t can_id = 0;
+    uint8_t can_len = 0;
+    std::array<uint8_t, 8> can_data{};
+    std::vector<uint8_t> bytes;    // Serial response
+    uint32_t delay_us = 0;
+    uint64_t hits = 0;
+};
+
+/// Delayed response waiting in the queue
+struct ResponderPending {
+    std::chrono::steady_clock::time_point due;
+    std::chrono::steady_clock::time_point rx;
+    uint16_t entry = 0;
+};
+
+/// Limits for persisted responders and queued delayed responses
+constexpr int MAX_RESPONDERS = 1000;
+constexpr size_t RESPONDER_QUEUE_MAX = 256;
+
+/// Auto-responder table, delay queue and latency statistics
+struct ResponderState {
+    bool enabled = true;
+    bool log = true;               // Print a line per response (after it is sent)
+    std::vector<Trigger> matchers; // Match side, parallel to entries
+    std::vector<ResponderEntry> entries;
+    MatchIndex index;
+    std::vector<ResponderPending> queue;  // Ordered by due time
+    std::chrono::steady_clock::time_point rx_time;  // RX time of the frame being matched
+    const int* fd = nullptr;
+
+    uint64_t sent = 0;
+    uint64_t failed = 0;
+    uint64_t dropped = 0;
+    uint64_t lat_count = 0;
+    uint64_t lat_total_ns = 0;
+    uint64_t lat_min_ns = 0;
+    uint64_t lat_max_ns = 0;
+    std::array<uint64_t, 7> lat_hist{};  // <50, <100, <200, <500, <1000, <5000, >=5000 us
+};
+
+/// Global auto-responder state
+extern ResponderState g_responder;
+
+/// Point responses at main's file descriptor
+void responder_bind(const int* fd);
+
+/// Load respond1..N from the config (presets are resolved once, here)
+void responder_configure(const Config& cfg);
+
+/// Store the current entries as respond1..N in the config
+void responder_save(Config& cfg);
+
+/// Pre-build a payload ("can ID XX ...", "hex XX ...", "text STRING", "preset N") into r
+bool responder_parse_payload(std::string text, const Config& cfg, ResponderEntry& r, std::string& error);
+
+/// Add ("MATCH -> RESPONSE [delay MS]"), remove (0-based) or clear entries
+bool responder_add(const std::string& spec, const Config& cfg, std::string& error);
+bool responder_remove(size_t index);
+void responder_clear();
+
+/// Match a received frame/bytes and send (or queue) the responses
+void responder_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc,
+                      std::chrono::steady_clock::time_point rx_time);
+void responder_serial_rx(const uint8_t* data, size_t len,
+                         std::chrono::steady_clock::time_point rx_time);
+
+/// Send delayed responses that are due
+void responder_poll(std::chrono::steady_clock::time_point now);
+
+/// Due time of the next delayed response (time_point::max() when none is queued)
+std::chrono::steady_clock::time_point responder_next_deadline();
+
+/// Print entries, hit counts and RX->TX latency
+void responder_print_status();
+
+/// Clear counters and latency statistics
+void responder_reset_stats();
+
+// ============================================================================
+// Sequences (/seq)
+// ============================================================================
+
+enum class SeqStepKind : uint8_t { SEND, DELAY, WAIT };
+
+/// One step, pre-built when the sequence is defined
+struct SeqStep {
+    SeqStepKind kind = SeqStepKind::SEND;
+    std::string text;              // As written, e.g. "wait can 0x7E8 timeout 50ms"
+    ResponderEntry payload;        // SEND
+    uint32_t us = 0;               // DELAY length, WAIT timeout
+    Trigger match;                 // WAIT
+    uint64_t count = 0;            // Sends (or matched waits)
+    uint64_t late_total_us = 0;    // SEND: time past the step's deadline
+    uint64_t late_max_us = 0;
+    uint64_t failures = 0;         // SEND errors, WAIT timeouts
+};
+
+/// Named, ordered step list; loops 0 repeats until stopped
+struct Sequence {
+    std::string name;
+    std::vector<SeqStep> steps;
+    uint32_t loops = 1;
+    uint64_t runs = 0;
+    uint64_t completed = 0;
+    uint64_t aborted = 0;
+    uint64_t skipped = 0;          // Delay periods dropped to catch up after a stall
+};
+
+/// A running instance; the deadline is absolute, so delays never accumulate lateness
+struct SeqRun {
+    size_t seq = 0;
+    size_t step = 0;
+    uint32_t loop = 0;
+    bool waiting = false;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline;    // Due time of the current step
+    std::chrono::steady_clock::time_point wait_until;
+    std::vector<uint8_t> tail;     // Serial WAIT: bytes carried over between reads
+    uint64_t late_max_us = 0;
+    uint64_t skipped = 0;
+};
+
+/// Concurrent runs (one per sequence)
+constexpr size_t SEQ_MAX_RUNS = 16;
+
+/// Defined sequences and active runs
+struct SequenceState {
+    std::vector<Sequence> seqs;
+    std::vector<SeqRun> runs;
+    const int* fd = nullptr;
+};
+
+extern SequenceState g_seq;
+
+/// Point sends at main's file descriptor
+void seq_bind(const int* fd);
+
+/// Define a sequence from "step; step; ..." (loop N, can/hex/text/preset, delay T, wait MATCH [timeout T])
+bool seq_define(const std::string& name, const std::string& steps, const Config& cfg, std::string& error);
+
+/// Load seq_NAME keys and the seq_file (if set) from the config
+void seq_configure(const Config& cfg);
+
+/// Load "[NAME]" sections with one step per line; returns the number defined
+int seq_load_file(const std::string& path, const Config& cfg, std::string& error);
+
+/// Start (or restart) a sequence; stop one or all runs
+bool seq_start(const std::string& name, std::string& error);
+bool seq_stop(const std::string& name);
+void seq_stop_all();
+
+/// Run every step that is due
+void seq_poll(std::chrono::steady_clock::time_point now);
+
+/// Earliest step deadline or wait timeout (time_point::max() when idle)
+std::chrono::steady_clock::time_point seq_next_deadline();
+
+/// Complete WAIT steps on matching RX
+void seq_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc,
+                std::chrono::steady_clock::time_point rx_time);
+void seq_serial_rx(const uint8_t* data, size_t len, std::chrono::steady_clock::time_point rx_time);
+
+/// Defined sequences and active runs; one sequence's steps with lateness
+void seq_print_list();
+bool seq_print_steps(const std::string& name);
+
+// ============================================================================
+// Checksums (/crc)
+// ============================================================================
+
+/// Supported checksums; CRC-8 is SAE J1850
+enum class ChecksumKind : uint8_t {
+    CRC8, CRC8_AUTOSAR, CRC16_MODBUS, CRC16_CCITT, CRC32, CRC32C, XOR8, SUM8
+};
+
+constexpr size_t CHECKSUM_KIND_COUNT = 8;
+constexpr size_t CHECKSUM_MAX_RULES = 64;
+
+/// Verify rule for received CAN frames; pos -1 = checksum closes the frame
+struct ChecksumRule {
+    Trigger match;
+    ChecksumKind kind = ChecksumKind::CRC8;
+    int pos = -1;
+    std::string text;              // As written
+    uint64_t checked = 0;
+    uint64_t errors = 0;
+    uint64_t short_frames = 0;     // Matched, but too short to hold the checksum
+};
+
+/// TX append setting and RX verify rules
+struct ChecksumState {
+    bool tx_enabled = false;
+    ChecksumKind tx_kind = ChecksumKind::CRC8;
+    uint64_t tx_appended = 0;
+    uint64_t tx_no_room = 0;       // CAN payloads too long for the checksum
+    std::vector<uint8_t> scratch;  // Serial TX buffer, reused
+    std::vector<ChecksumRule> rules;
+};
+
+extern ChecksumState g_checksum;
+
+/// One-shot checksum (slice-by-8 tables; SSE4.2 for CRC-32C when the CPU has it)
+uint32_t checksum(ChecksumKind kind, const uint8_t* data, size_t len);
+
+/// Incremental form: checksum_final(kind, checksum_update(kind, checksum_init(kind), ...))
+uint32_t checksum_init(ChecksumKind kind);
+uint32_t checksum_update(ChecksumKind kind, uint32_t reg, const uint8_t* data, size_t len);
+uint32_t checksum_final(ChecksumKind kind, uint32_t reg);
+
+/// Reference bit-at-a-time implementation (self-test and --bench)
+uint32_t checksum_bitwise(ChecksumKind kind, const uint8_t* data, size_t len);
+
+/// Bytes on the wire; reflected CRCs are stored little-endian, the others big-endian
+size_t checksum_width(ChecksumKind kind);
+size_t checksum_store(ChecksumKind kind, uint32_t value, uint8_t* out);
+uint32_t checksum_load(ChecksumKind kind, const uint8_t* in);
+
+/// Names: crc8, crc8-autosar, crc16-modbus, crc16-ccitt, crc32, crc32c, xor, sum8
+const char* checksum_name(ChecksumKind kind);
+bool checksum_parse(const std::string& name, ChecksumKind& kind);
+
+/// True when CRC-32C runs on the SSE4.2 crc32 instruction
+bool checksum_hw_crc32c();
+
+/// Compare every algorithm against its "123456789" check value
+bool checksum_selftest(std::string& report);
+
+/// Load tx_checksum and rx_checksum1, rx_checksum2, ...
+void checksum_configure(const Config& cfg);
+
+/// Set the TX checksum (name, or off)
+bool checksum_set_tx(const std::string& name, std::string& error);
+
+/// Add an RX rule: "can ID[/MASK] [XX|?? ...] ALGO [at POS]"
+bool checksum_rule_add(const std::string& spec, std::string& error);
+
+/// Store tx_checksum and the rules as rx_checksum1, rx_checksum2, ...
+void checksum_save(Config& cfg);
+
+/// Remove rule index (0-based); clear counters
+bool checksum_rule_remove(size_t index);
+void checksum_reset_stats();
+
+/// Verify a received frame against the matching rules
+void checksum_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc);
+
+/// TX setting, CRC-32C path and per-rule counters (/crc)
+void checksum_print_status();
+
+// ============================================================================
+// Payload Generators (/gen)
+// ============================================================================
+
+/// Field computed at send time; checksums run after every other field
+enum class GenOpKind : uint8_t { COUNTER, ROLLING, INC16, RANDOM, TIMESTAMP, CHECKSUM };
+
+/// One compiled field of a preset's payload
+struct GenOp {
+    GenOpKind kind = GenOpKind::COUNTER;
+    uint8_t pos = 0;               // Byte written
+    uint8_t from = 0;              // CHECKSUM: covered bytes [from, to]
+    uint8_t to = 0;
+    uint8_t width = 1;             // Bytes written (TIMESTAMP 2 or 4, CHECKSUM 1-4)
+    ChecksumKind algo = ChecksumKind::CRC8;
+    bool high = false;             // ROLLING: upper nibble instead of lower
+    uint16_t step = 1;             // INC16
+    uint32_t value = 0;            // Counter state
+};
+
+/// A preset compiled into a preallocated frame plus an op list applied in place
+struct PayloadGen {
+    bool active = false;
+    bool is_can = false;
+    bool text = false;             // Serial text preset (CRLF appended at send time)
+    uint32_t can_id = 0;
+    std::vector<uint8_t> frame;    // Payload, with room for CRLF
+    size_t len = 0;
+    std::vector<GenOp> ops;
+    uint32_t rng = 0;              // xorshift32 state for RANDOM
+    std::chrono::steady_clock::time_point epoch;   // TIMESTAMP zero
+    uint64_t sends = 0;
+    std::string spec;              // As configured (presetN_gen)
+    std::string label;             // "TX[Preset N (name)]", built once for repeat output
+};
+
+/// Generators for presets 1-10
+struct GeneratorState {
+    std::array<PayloadGen, 10> presets;
+};
+
+extern GeneratorState g_gen;
+
+/// Compile one preset's generator spec ("rolling 6; crc8 7"); an empty spec removes it
+bool gen_compile(int preset, const std::string& spec, const Config& cfg, InterfaceType itype, std::string& error);
+
+/// Recompile every presetN_gen (startup and after preset edits); errors go to stderr
+void gen_configure(const Config& cfg, InterfaceType itype);
+
+/// Active generator of a preset, or nullptr
+PayloadGen* gen_job(int preset);
+
+/// Apply the ops to the frame in place and send it (no allocation)
+bool gen_send(int fd, PayloadGen& job, bool append_crlf);
+
+/// Generators with their fields and current frame
+void gen_print(InterfaceType itype);
+
+// ============================================================================
+// Scrollback
+// ============================================================================
+
+/// Kind of scrollback record
+enum class ScrollKind : uint8_t { TEXT, FRAME, BYTES };
+
+/// Filter bits per block of 256 records
+constexpr size_t SCROLL_ID_BITS = 256;
+constexpr size_t SCROLL_GRAM_BITS = 4096;
+
+/// Bloom filters over one block of records (CAN IDs and byte/character bigrams)
+struct ScrollBlock {
+    uint64_t first_seq = 0;
+    std::array<uint64_t, SCROLL_ID_BITS / 64> id_bloom{};
+    std::array<uint64_t, SCROLL_GRAM_BITS / 64> gram_bloom{};
+};
+
+/// /find query
+struct ScrollQuery {
+    enum Type { ID, BYTES, TEXT } type = TEXT;
+    uint32_t id = 0;
+    std::vector<uint8_t> needle;   // Raw bytes, or lower-cased text
+};
+
+/// Fixed-capacity scrollback: variable-length records in one byte arena
+struct ScrollbackState {
+    size_t cap_bytes = 0;
+    std::vector<uint8_t> arena;
+    std::vector<uint32_t> offsets;         // seq % size -> record offset in the arena
+    std::vector<ScrollBlock> blocks;       // (seq / 256) % size -> filters
+    uint64_t first_seq = 0;                // Oldest live record
+    uint64_t next_seq = 0;
+    size_t head = 0;                       // Next write offset
+    size_t tail = 0;                       // Offset of the oldest record
+    bool wrapped = false;                  // Live region wraps past the arena end
+    uint64_t evicted = 0;
+    uint64_t last_blocks_scanned = 0;
+    uint64_t last_blocks_skipped = 0;
+
+    // Pager
+    bool pager = false;
+    bool pager_follow = true;
+    bool pager_dirty = false;
+    uint64_t pager_bottom = 0;
+    uint64_t pager_new = 0;
+    std::string pager_esc;
+    std::chrono::steady_clock::time_point pager_drawn;
+};
+
+/// Global scrollback
+extern ScrollbackState g_scrollback;
+
+/// Allocate the ring for the configured memory cap (scrollback_mb, 0 = off)
+void scrollback_configure(const Config& cfg);
+
+/// Record a printed line, a received CAN frame or a chunk of received serial bytes
+void scrollback_add_text(const std::string& text);
+void scrollback_add_frame(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc);
+void scrollback_add_bytes(const uint8_t* data, size_t len);
+
+/// Newest-first search (at most limit hits), rendered oldest-first into out
+size_t scrollback_find(const ScrollQuery& q, size_t limit, std::vector<std::string>& out);
+
+/// Full-screen pager; keys return false once the pager has closed
+void scrollback_pager_open();
+bool scrollback_pager_key(char c);
+
+/// Redraw the pager if new lines arrived (rate-limited)
+void scrollback_pager_tick();
+
+/// Print usage of the scrollback ring
+void scrollback_print_status();
+
+// ============================================================================
+// Structured Output
+// ============================================================================
+
+/// Record format of the --output sink
+enum class OutputFormat : uint8_t { NONE, JSONL, CSV };
+
+/// Serializer buffer; records are written out once FLUSH bytes pile up or every 100 ms
+constexpr size_t OUTPUT_BUFFER_BYTES = 1 << 20;
+constexpr size_t OUTPUT_FLUSH_BYTES = 64 * 1024;
+
+/// Machine-readable event sink (one record per frame or serial chunk)
+struct OutputSink {
+    OutputFormat format = OutputFormat::NONE;
+    int fd = -1;
+    std::string path;                      // "-" when writing to the original stdout
+    std::string iface;                     // Interface name, escaped for the format
+    std::vector<char> buf;
+    size_t used = 0;
+    uint64_t events = 0;
+    uint64_t bytes_written = 0;
+    uint64_t dropped = 0;                  // Records lost to a full non-blocking pipe
+    uint64_t write_errors = 0;
+    std::chrono::steady_clock::time_point last_flush;
+};
+
+/// Global output sink
+extern OutputSink g_output;
+
+/// Parse "jsonl" / "csv"
+bool output_parse_format(const std::string& name, OutputFormat& fmt);
+
+/// Start writing records to a file ("-" = stdout) or an already-open descriptor
+bool output_open(OutputFormat fmt, const std::string& path, std::string& error);
+void output_open_fd(OutputFormat fmt, int fd, const std::string& label);
+
+/// Set the interface name stamped on every record (CAN interface or serial device)
+void output_set_iface(const std::string& name);
+
+/// Record a CAN frame (raw can_id including EFF/RTR/ERR flags) or a serial chunk
+void output_can(OutputDir dir, uint32_t can_id, const uint8_t* data, size_t dlc);
+void output_serial(OutputDir dir, const uint8_t* data, size_t len);
+
+/// Record a link gap: dir "gap", state "lost" (with reason) or "restored" (with down_ms)
+void output_gap(bool restored, const std::string& reason, double down_ms);
+
+/// Record frames the kernel dropped before the next RX: dir "drop", count and running total
+void output_drop(uint64_t count, uint64_t total);
+
+/// Write out buffered records; closes the sink on a fatal error
+bool output_flush();
+
+/// Flush once the buffer is large or old enough
+void output_poll(std::chrono::steady_clock::time_point now);
+
+/// Milliseconds until the next time-based flush, or -1 when nothing is buffered
+int output_timeout_ms(std::chrono::steady_clock::time_point now);
+
+/// Flush and close the sink
+void output_close();
+
+/// Print sink statistics
+void output_print_status();
+
+// ============================================================================
+// Shared-Memory Export (ring layout and reader in adamcom_shm.hpp)
+// ============================================================================
+
+struct ShmHeader;
+struct ShmSlot;
+
+/// Default ring size in 64-byte slots (4 MB)
+constexpr uint32_t SHM_DEFAULT_SLOTS = 65536;
+
+/// Writer side of the shared-memory event ring
+struct ShmExportState {
+    std::string name;                      // POSIX shm name; empty when not publishing
+    ShmHeader* hdr = nullptr;
+    ShmSlot* slots = nullptr;
+    size_t map_bytes = 0;
+    uint64_t mask = 0;
+    uint64_t next_seq = 1;
+    uint32_t mode = 0600;                  // Object permissions (cfg "shm_mode"); bus traffic is private by default
+};
+
+/// Global shared-memory export
+extern ShmExportState g_shm;
+
+/// Start publishing per cfg "shm" (off | auto | /NAME) with "shm_slots" slots and "shm_mode" permissions
+void shm_configure(const Config& cfg, const std::string& iface);
+
+/// Create (replacing any stale ring of the same name) and map the ring
+bool shm_start(const std::string& name, uint32_t slots, const std::string& iface, std::string& error);
+
+/// Mark the ring closed for readers and unlink it
+void shm_stop();
+
+/// Ring name derived from the interface (e.g. /adamcom-can0, /adamcom-ttyUSB0)
+std::string shm_default_name(const std::string& iface);
+
+/// Update the interface name shown to readers (after a reconnect)
+void shm_set_iface(const std::string& iface);
+
+/// Publish a CAN frame (raw can_id including EFF/RTR/ERR flags) or a serial chunk
+void shm_can(OutputDir dir, uint32_t can_id, const uint8_t* data, size_t dlc);
+void shm_serial(OutputDir dir, const uint8_t* data, size_t len);
+
+/// Publish a SHM_KIND_GAP event (id 0 lost, 1 restored; data is the text, truncated)
+void shm_gap(bool restored, const std::string& text);
+
+/// Publish an SHM_KIND_DROP event: count frames lost by the kernel, total as text
+void shm_drop(uint64_t count, uint64_t total);
+
+/// Print ring name, size and event count
+void shm_print_status();
+
+// ============================================================================
+// Session Server (--serve / --attach)
+// ============================================================================
+
+/// Attached clients are limited so the poll set stays fixed-size
+constexpr size_t SERVE_MAX_CLIENTS = 16;
+
+/// Unsent output a client may fall behind by before it is dropped
+constexpr size_t SERVE_CLIENT_BUFFER = 256 * 1024;
+
+/// Runs one command line exactly as if it had been typed at the prompt
+using ServeExecFn = void (*)(const std::string& line);
+
+/// One attached client
+struct ServeClient {
+    int fd = -1;
+    bool closing = false;
+    std::string in;                        // Partial command line
+    std::string out;                       // Protocol lines not yet written
+    uint64_t commands = 0;
+};
+
+/// Unix-socket server sharing this session with --attach clients
+struct ServeState {
+    int listen_fd = -1;
+    std::string path;
+    std::vector<ServeClient> clients;
+    ServeExecFn exec = nullptr;
+    int exec_client = -1;                  // Client whose command is running
+    int reply_fd = -1;                     // memfd capturing stdout during a command
+    uint64_t accepted = 0;
+    uint64_t dropped = 0;                  // Slow clients disconnected
+    uint64_t commands = 0;
+};
+
+/// Global session server
+extern ServeState g_serve;
+
+/// $XDG_RUNTIME_DIR/adamcom.sock, or /tmp/adamcom-UID.sock
+std::string serve_default_path();
+
+/// Listen on path (refuses if another server answers there)
+bool serve_start(const std::string& path, ServeExecFn exec, std::string& error);
+void serve_stop();
+
+/// Fill poll entries (listener + clients, at most 1 + SERVE_MAX_CLIENTS); returns the count
+size_t serve_pollfds(struct pollfd* fds);
+
+/// Accept clients, run complete command lines, flush queued output
+void serve_handle(const struct pollfd* fds, size_t n);
+
+/// Send a printed line to every client (except the one whose command produced it)
+void serve_broadcast(const std::string& line);
+
+/// True while a client's command is running (its stdout is being captured)
+bool serve_executing();
+
+/// Print listener path and client counts
+void serve_print_status();
+
+/// --attach client: run cmds one by one, or relay stdin lines when cmds is empty
+int attach_run(const std::string& path, const std::vector<std::string>& cmds);
+
+// ============================================================================
+// Transmit Queue (serial bytes the port could not take yet, CAN frames the socket refused)
+// ============================================================================
+
+/// Stop repeats and keyboard input above this many queued bytes, resume below TXQ_LOW_WATER
+constexpr size_t TXQ_HIGH_WATER = 64 * 1024;
+constexpr size_t TXQ_LOW_WATER = 16 * 1024;
+
+/// Retry delay for parked CAN frames; after ENOBUFS the socket stays writable, so POLLOUT
+/// cannot say when the driver queue has room again
+constexpr auto TXQ_CAN_RETRY = std::chrono::milliseconds(1);
+
+/// A CAN frame waiting for room in the driver queue
+struct CanTxFrame {
+    uint32_t can_id = 0;
+    uint8_t dlc = 0;
+    uint8_t data[8] = {};
+    std::chrono::steady_clock::time_point queued;
+};
+
+struct TxQueueState {
+    std::vector<uint8_t> buf;          // Pending bytes from head onwards
+    size_t head = 0;
+    size_t limit = 1024 * 1024;        // cfg tx_queue_kb; sends beyond this fail
+    bool backpressure = false;         // Between high and low water
+    uint64_t queued_bytes = 0;         // Bytes that had to wait for POLLOUT
+    uint64_t stalls = 0;               // Writes cut short by a full port buffer
+    uint64_t overflows = 0;            // Sends refused because the queue was full
+    uint64_t skipped_repeats = 0;      // Repeat slots skipped under backpressure
+    size_t max_depth = 0;
+
+    // CAN: ring of can_limit frames, oldest at can_head
+    std::vector<CanTxFrame> can;
+    size_t can_head = 0;
+    size_t can_count = 0;
+    size_t can_limit = 1024;           // cfg tx_queue_frames; sends beyond this fail
+    size_t can_max_depth = 0;
+    bool can_nobufs = false;           // Last refusal was ENOBUFS (retry on the timer, not POLLOUT)
+    std::chrono::steady_clock::time_point can_retry_at;
+    uint64_t can_queued = 0;           // Frames that had to wait
+    uint64_t can_sent = 0;             // Waiting frames that went out later
+    uint64_t can_dropped = 0;          // Refused (queue full) or discarded (device lost, /txq clear)
+    uint64_t can_enobufs = 0;          // Refusals by cause
+    uint64_t can_eagain = 0;
+    uint64_t can_wait_sum_us = 0;      // Park-to-write time of can_sent frames
+    uint64_t can_wait_max_us = 0;
+};
+
+extern TxQueueState g_txq;
+
+void txq_configure(const Config& cfg);
+
+inline size_t txq_depth() { return g_txq.buf.size() - g_txq.head; }
+
+/// Queue bytes behind anything already pending (false when the limit would be exceeded)
+bool txq_push(const uint8_t* data, size_t len);
+
+/// Write as much as the port takes (on POLLOUT); false on a hard write error
+bool txq_flush(int fd);
+
+/// Give pending bytes up to timeout_ms to reach the port (exit)
+void txq_drain(int fd, int timeout_ms);
+
+/// Drop everything pending (device closed)
+void txq_reset();
+
+/// Count a refused CAN write (errno ENOBUFS or EAGAIN) and schedule the retry
+void txq_can_refused(int err);
+
+/// Park a CAN frame behind any already waiting (false when the queue is full)
+bool txq_can_push(uint32_t can_id, const uint8_t* data, uint8_t dlc);
+
+/// Write parked CAN frames until the socket refuses again; false on a hard write error
+bool txq_flush_can(int fd);
+
+/// Next retry of parked CAN frames (time_point::max() when none are waiting)
+std::chrono::steady_clock::time_point txq_can_next_retry();
+
+/// Queue depths, refusals and retry latency, with txqueuelen advice for can_iface (/txq)
+void txq_print_status(const std::string& can_iface);
+
+// ============================================================================
+// Automatic Reconnect (auto_reconnect=on)
+// ============================================================================
+
+/// Backoff between reopen attempts: doubles from MIN up to MAX
+constexpr int RECONNECT_BACKOFF_MIN_MS = 100;
+constexpr int RECONNECT_BACKOFF_MAX_MS = 5000;
+
+/// Link-loss state; repeats, triggers and sinks stay configured while the device is away
+struct ReconnectState {
+    bool enabled = true;               // cfg auto_reconnect
+    bool down = false;                 // Device closed, waiting to reopen
+    int pending_errno = 0;             // Fatal write error seen by the send paths
+    std::string device;                // Serial device path or CAN interface
+    bool can = false;
+    std::string reason;                // Why the link was lost
+    std::chrono::steady_clock::time_point lost_at;
+    std::chrono::steady_clock::time_point next_attempt;
+    int backoff_ms = RECONNECT_BACKOFF_MIN_MS;
+    uint32_t attempts = 0;             // Reopen attempts in the current outage
+    int notify_fd = -1;                // inotify on /dev (serial) or rtnetlink link events (CAN)
+    uint64_t notify_events = 0;
+    uint64_t skipped_repeats = 0;      // Repeat slots that fell into an outage
+    uint64_t reconnects = 0;
+    double last_down_ms = 0;
+    double max_down_ms = 0;
+    double total_down_ms = 0;
+};
+
+extern ReconnectState g_reconnect;
+
+void reconnect_configure(const Config& cfg, InterfaceType itype);
+
+/// Errors that mean the device is gone (EIO, ENXIO, ENODEV, ENETDOWN)
+bool reconnect_fatal_errno(int err);
+
+/// Called by the send paths on a failed write; a fatal errno is picked up by the main loop
+void reconnect_note_error(int err);
+
+/// Device closed: start watching for it, record gap markers, schedule the first attempt
+void reconnect_lost(const std::string& reason, size_t dropped_tx);
+
+/// True when the device (node or interface, up or not) is there to be opened
+bool reconnect_device_present();
+
+/// True once the next attempt is due
+bool reconnect_due(std::chrono::steady_clock::time_point now);
+
+/// Milliseconds until the next attempt (-1 while connected)
+int reconnect_timeout_ms(std::chrono::steady_clock::time_point now);
+
+/// Drain hot-plug notifications; an event brings the next attempt forward
+void reconnect_handle_notify(std::chrono::steady_clock::time_point now);
+
+/// An attempt failed (or the device is still absent): back off
+void reconnect_failed(std::chrono::steady_clock::time_point now);
+
+/// Device reopened: measure the outage, record gap markers, stop watching
+void reconnect_restored(std::chrono::steady_clock::time_point now);
+
+/// Print state and outage statistics (/reconnect)
+void reconnect_print_status();
+
+// ============================================================================
+// Serial Latency Profile (latency=low|balanced|throughput)
+// ============================================================================
+
+enum class LatencyProfile { LOW, BALANCED, THROUGHPUT };
+
+/// What the last latency_apply() did to the port (reported by /latency)
+struct LatencyState {
+    LatencyProfile profile = LatencyProfile::BALANCED;
+    size_t read_chunk = 256;           // Bytes read per wakeup
+    std::string low_latency;           // ASYNC_LOW_LATENCY result
+    std::string latency_timer;         // usb-serial latency_timer result
+    std::string timer_path;            // sysfs file used (empty when not a usb-serial port)
+    std::string saved_timer;           // latency_timer before we first wrote it
+    std::string saved_timer_path;      // Where saved_timer belongs (empty = nothing to restore)
+};
+
+extern LatencyState g_latency;
+
+/// Largest serial read chunk any profile uses
+constexpr size_t LATENCY_MAX_READ_CHUNK = 4096;
+
+/// Parse "low", "balanced" or "throughput"
+bool latency_parse_profile(const std::string& s, LatencyProfile& out);
+
+/// Apply cfg "latency" to an open serial port: ASYNC_LOW_LATENCY, the read chunk and the
+/// usb-serial latency_timer under $ADAMCOM_SYSFS_ROOT (default /sys)
+void latency_apply(int fd, const Config& cfg);
+
+/// Write back the latency_timer value found before a profile changed it (on exit)
+void latency_restore();
+
+/// Show the profile and what was applied (/latency)
+void latency_print();
+
+// ============================================================================
+// Link Utilization (/load)
+// ============================================================================
+
+/// 100 ms buckets kept for the longest (10 s) window
+constexpr size_t BUSLOAD_BUCKETS = 100;
+constexpr int BUSLOAD_BUCKET_MS = 100;
+
+/// Bit-time accounting for one direction of the link (CAN counts both directions together)
+struct BusLoadChannel {
+    std::array<uint64_t, BUSLOAD_BUCKETS> bits{};  // On-wire bits per 100 ms bucket
+    uint64_t total_bits = 0;
+    uint64_t units = 0;                // CAN frames or serial bytes
+    double peak[3] = {0, 0, 0};        // Highest 100 ms / 1 s / 10 s utilization (0..1)
+};
+
+struct BusLoadState {
+    bool can = false;
+    uint32_t bitrate = 0;              // can_bitrate or baud
+    uint32_t bits_per_byte = 10;       // Serial: start + databits + parity + stop
+    BusLoadChannel rx;                 // CAN: whole bus
+    BusLoadChannel tx;                 // Serial TX line (unused for CAN)
+    std::chrono::steady_clock::time_point origin;
+    uint64_t bucket = 0;               // Index of the open bucket since origin
+    bool live = false;                 // Print a load line every second
+    std::chrono::steady_clock::time_point next_live;
+};
+
+extern BusLoadState g_busload;
+
+/// Exact on-wire bits of a classic CAN frame: stuff bits, CRC, ACK, EOF and 3-bit IFS
+uint32_t can_frame_bits(uint32_t can_id, const uint8_t* data, uint8_t dlc);
+
+/// Take the bit rate and serial framing from cfg; resets the windows
+void busload_configure(const Config& cfg, InterfaceType itype);
+
+/// Account one CAN frame seen on or sent to the bus (raw can_id with flags)
+void busload_can(uint32_t can_id, const uint8_t* data, uint8_t dlc);
+
+/// Account serial bytes on the RX or TX line
+void busload_serial(bool tx, size_t bytes);
+
+/// Close elapsed buckets and print the live line when due
+void busload_poll(std::chrono::steady_clock::time_point now);
+
+/// Milliseconds until the next live line (-1 when live output is off)
+int busload_timeout_ms(std::chrono::steady_clock::time_point now);
+
+/// Utilization over the last 100 ms / 1 s / 10 s, peaks and totals (/load)
+void busload_print();
+
+/// Clear peaks and windows (/load reset)
+void busload_reset();
+
+// ============================================================================
+// Load Generator (/stress)
+// ============================================================================
+
+enum class LoadGenMode : uint8_t { OFF, LOAD, RATE, BURST };
+
+/// Frames per main-loop pass; the rest waits for the next 1 ms tick
+constexpr size_t LOADGEN_MAX_BATCH = 256;
+
+/// Generated traffic and how much of it the socket took
+struct LoadGenState {
+    LoadGenMode mode = LoadGenMode::OFF;
+    double per_sec = 0;                // LOAD: bits/s, RATE: frames/s
+    uint64_t burst_frames = 0;         // BURST: frames to send
+    std::chrono::steady_clock::time_point stop_at;   // LOAD/RATE with "for T"
+    bool timed = false;
+    // Distributions
+    uint32_t id_lo = 0, id_hi = 0x7FF; // Uniform ID range, unless ids is set
+    std::vector<uint32_t> ids;
+    bool extended = false;
+    uint8_t dlc_lo = 8, dlc_hi = 8;
+    // Schedule
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point last_tick;
+    std::chrono::steady_clock::time_point next_tick;
+    double credit = 0;                 // Bits or frames the schedule allows now
+    double offered = 0;                // Bits or frames demanded since start
+    uint32_t rng = 1;
+    uint32_t next_id = 0;              // Frame waiting to go out (kept when refused)
+    uint8_t next_dlc = 0;
+    uint8_t next_data[8] = {};
+    uint32_t next_bits = 0;
+    bool have_next = false;
+    // Results
+    uint64_t sent = 0;
+    uint64_t sent_bits = 0;
+    uint64_t enobufs = 0;
+    uint64_t eagain = 0;
+    uint64_t errors = 0;               // Other write errors
+    uint64_t stalls = 0;               // Passes cut short by a refused write
+    size_t max_batch = 0;
+    const int* fd = nullptr;
+};
+
+extern LoadGenState g_loadgen;
+
+/// Point sends at main's file descriptor
+void loadgen_bind(const int* fd);
+
+/// Start from "/stress" arguments: load P% | rate N | burst N, then [ids LO-HI|A,B,..] [dlc N|LO-HI] [ext] [for T]
+bool loadgen_start(const std::string& args, uint32_t bitrate, std::string& error);
+
+/// Stop and print the summary
+void loadgen_stop(const char* how);
+
+/// Send what the schedule allows (batched) and finish timed runs and bursts
+void loadgen_poll(std::chrono::steady_clock::time_point now);
+
+/// Next tick (time_point::max() when idle)
+std::chrono::steady_clock::time_point loadgen_next_deadline();
+
+/// Offered vs achieved rate, write errors and stalls (/stress)
+void loadgen_print_status();
+
+// ============================================================================
+// Metrics
+// ============================================================================
+
+/// Monotonic counters
+enum class Metric : uint8_t {
+    RX_FRAMES,                 // CAN frames or serial read() chunks
+    RX_BYTES,
+    TX_FRAMES,
+    TX_BYTES,
+    TX_ERRORS,
+    POLL_WAKEUPS,
+    POLL_TIMEOUTS,
+    REPEAT_FIRES,
+    RX_CHECKSUM_ERRORS,        // Frames failing an RX checksum rule
+    RX_OVERFLOW,               // CAN frames the kernel dropped before they were read
+    COUNT
+};
+
+/// Latency histograms (observed in microseconds)
+enum class MetricHist : uint8_t {
+    REPEAT_LATENESS,           // Repeat fired this long after its due time
+    SEQ_LATENESS,              // Sequence step sent this long after its deadline
+    CAN_TX_WAIT,               // Parked CAN frame written this long after it was refused
+    RENDER,                    // print_message_above() duration
+    COUNT
+};
+
+constexpr size_t METRIC_COUNT = static_cast<size_t>(Metric::COUNT);
+constexpr size_t METRIC_HIST_COUNT = static_cast<size_t>(MetricHist::COUNT);
+
+/// Histogram upper bounds in microseconds (plus an implicit +Inf bucket)
+constexpr std::array<uint32_t, 9> METRIC_BUCKETS_US = {10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000};
+
+/// Per-thread counters; only the owning thread writes, readers sum all blocks
+struct MetricBlock {
+    std::array<std::atomic<uint64_t>, METRIC_COUNT> counters{};
+    std::array<std::array<std::atomic<uint64_t>, METRIC_BUCKETS_US.size() + 1>, METRIC_HIST_COUNT> buckets{};
+    std::array<std::atomic<uint64_t>, METRIC_HIST_COUNT> sum_us{};
+    MetricBlock* next = nullptr;
+};
+
+/// This thread's block (registered on first use)
+extern thread_local MetricBlock* t_metrics;
+MetricBlock& metric_register();
+
+/// Single-writer increment: relaxed load + store, no locked instruction
+inline void metric_bump(std::atomic<uint64_t>& c, uint64_t n)
+{
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void metric_add(Metric m, uint64_t n = 1)
+{
+    MetricBlock& b = t_metrics ? *t_metrics : metric_register();
+    metric_bump(b.counters[static_cast<size_t>(m)], n);
+}
+
+void metric_observe(MetricHist h, uint64_t us);
+
+/// Rewrite cfg "metrics_file" (Prometheus text format) every "metrics_interval" seconds
+void metrics_configure(const Config& cfg, const std::string& iface);
+
+/// Interface label on exported series
+void metrics_set_iface(const std::string& iface);
+
+/// Write the textfile when due
+void metrics_poll(std::chrono::steady_clock::time_point now);
+
+/// Milliseconds until the next textfile write (-1 when no file is configured)
+int metrics_timeout_ms(std::chrono::steady_clock::time_point now);
+
+/// Render all counters, histograms and gauges in Prometheus text format
+std::string metrics_render();
+
+/// Print counters, rates since start, latency percentiles and queue depths (/stats)
+void metrics_print();
+
+// ============================================================================
+// Hot-Path Profiler (make profile; compiled out otherwise)
+// ============================================================================
+
+/// Main-loop stages; each records its own time, excluding nested stages
+enum class PerfStage : uint8_t {
+    SCHEDULE,                  // Poll timeout scan over repeats and module timers
+    POLL_WAIT,                 // Blocked in poll()
+    TIMERS,                    // Responder, output, ISO-TP, Modbus, J1939 housekeeping
+    REPEAT,                    // Firing due repeats (excluding write and render)
+    DEVICE_READ,               // read() from the serial port or CAN socket
+    RX_PROCESS,                // Responder/output/capture hooks, decoders, hex formatting
+    DEVICE_WRITE,              // write() to the serial port or CAN socket
+    RENDER,                    // print_message_above() including readline redraw
+    SERVE,                     // --serve client I/O
+    READLINE,                  // rl_callback_read_char(), command handling, prompt update
+    COUNT
+};
+
+constexpr size_t PERF_STAGE_COUNT = static_cast<size_t>(PerfStage::COUNT);
+
+#ifdef ADAMCOM_PROFILE
+
+/// CLOCK_MONOTONIC_RAW in nanoseconds (vDSO, not slewed by NTP)
+uint64_t perf_now_ns();
+
+/// Record one stage sample of self time (main thread only)
+void perf_record(PerfStage stage, uint64_t self_ns);
+
+/// Nanoseconds spent in stages nested inside the innermost open scope
+extern uint64_t g_perf_nested_ns;
+
+/// Times a block; nested scopes are subtracted so stage totals add up to wall time
+class PerfScope {
+public:
+    explicit PerfScope(PerfStage stage)
+        : stage_(stage), outer_nested_(g_perf_nested_ns), start_(perf_now_ns())
+    {
+        g_perf_nested_ns = 0;
+    }
+    ~PerfScope()
+    {
+        uint64_t total = perf_now_ns() - start_;
+        perf_record(stage_, total - g_perf_nested_ns);
+        g_perf_nested_ns = outer_nested_ + total;
+    }
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfStage stage_;
+    uint64_t outer_nested_;
+    uint64_t start_;
+};
+
+#define ADAMCOM_PERF_CAT2(a, b) a##b
+#define ADAMCOM_PERF_CAT(a, b) ADAMCOM_PERF_CAT2(a, b)
+#define ADAMCOM_PERF(stage) \
+    ::adamcom::PerfScope ADAMCOM_PERF_CAT(perf_scope_, __LINE__)(::adamcom::PerfStage::stage)
+
+#else
+
+#define ADAMCOM_PERF(stage) ((void)0)
+
+#endif
+
+/// Print the per-stage breakdown since the last reset (/perf)
+void perf_print();
+
+/// Start a new measurement window (/perf reset)
+void perf_reset();
+
+// ============================================================================
+// Event Trace (--trace, Chrome trace-event JSON)
+// ============================================================================
+
+/// Traced main-loop activity (one Chrome "complete" event each)
+enum class TraceKind : uint8_t {
+    LOOP,                      // One main-loop iteration
+    POLL,                      // poll() wait; a = timeout ms, b = ready descriptors
+    RX,                        // Device read and its processing; a = bytes
+    TIMER,                     // Repeat fired; a = preset (0 = inline), b = lateness us
+    TX,                        // write() to the device; a = bytes
+    RENDER,                    // print_message_above()
+    COUNT
+};
+
+/// One event as stored in a thread's ring (fixed size, no allocation)
+struct TraceRecord {
+    uint64_t start_ns;         // CLOCK_MONOTONIC
+    uint64_t dur_ns;
+    uint32_t a;
+    uint32_t b;
+    TraceKind kind;
+};
+
+/// Records per thread ring; when a ring is full new events are dropped and counted
+constexpr size_t TRACE_RING_RECORDS = 65536;
+
+/// True while --trace is writing; scopes cost one branch otherwise
+extern std::atomic<bool> g_trace_on;
+
+uint64_t trace_now_ns();
+
+/// Append to this thread's ring (registered on first use; drained by the writer thread)
+void trace_emit(TraceKind kind, uint64_t start_ns, uint64_t dur_ns, uint32_t a = 0, uint32_t b = 0);
+
+/// Times a block as one trace event; a and b may be filled in before it closes
+struct TraceScope {
+    TraceKind kind;
+    uint32_t a;
+    uint32_t b;
+    uint64_t start_ns;
+
+    explicit TraceScope(TraceKind k, uint32_t a0 = 0, uint32_t b0 = 0)
+        : kind(k), a(a0), b(b0), start_ns(g_trace_on.load(std::memory_order_relaxed) ? trace_now_ns() : 0) {}
+    ~TraceScope()
+    {
+        if (start_ns && g_trace_on.load(std::memory_order_relaxed)) {
+            trace_emit(kind, start_ns, trace_now_ns() - start_ns, a, b);
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+/// Start the background writer; events stream to path as they are drained
+bool trace_start(const std::string& path, std::string& error);
+
+/// Drain every ring, close the JSON document and join the writer
+void trace_stop();
+
+/// Path, events written and events dropped (/trace)
+void trace_print_status();
+
+// ============================================================================
+// Benchmarks (--bench)
+// ============================================================================
+
+/// Time internal hot paths (trace scopes, ...) and print ns per operation
+int bench_run();
+
 // ============================================================================
 // Menu UI
 // ============================================================================
@@ -132,8 +1705,9 @@ void show_presets_menu(Config& cfg, InterfaceType itype);
 /// Show comprehensive manual/help
 void show_manual();
 
-/// Open and configure a serial port, returns fd or -1 on error
-int open_serial(const Config& cfg);
+/// Open and configure a serial port, returns fd or -1 on error.
+/// applied_baud receives the rate the driver actually uses.
+int open_serial(const Config& cfg, unsigned int* applied_baud = nullptr);
 
 // ============================================================================
 // Output Helpers
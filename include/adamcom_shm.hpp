@@ -0,0 +1,223 @@
+/**
+ * @file adamcom_shm.hpp
+ * @brief Shared-memory event ring published by adamcom (--shm), plus a header-only reader
+ *
+ * Layout: one ShmHeader followed by slot_count fixed 64-byte ShmSlots. adamcom is the
+ * single writer; any number of processes may map the ring read-only and follow it
+ * without locks or syscalls:
+ *
+ *     adamcom::ShmReader rd;
+ *     if (rd.open("/adamcom-can0")) {
+ *         adamcom::ShmEvent ev;
+ *         for (;;) {
+ *             while (rd.next(ev)) handle(ev);
+ *             if (rd.writer_closed()) break;
+ *             usleep(1000);
+ *         }
+ *     }
+ *
+ * Every event carries a sequence number (1, 2, 3, ...). Each slot is a seqlock: the
+ * writer clears the slot's seq, fills the slot, then publishes the event's seq. A reader
+ * that falls more than slot_count events behind skips ahead and counts the overrun.
+ *
+ * Standalone: depends only on the C++17 standard library and POSIX (link -lrt on old glibc).
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace adamcom {
+
+constexpr uint32_t SHM_MAGIC = 0x4D534441;     // "ADSM"
+constexpr uint32_t SHM_VERSION = 1;
+constexpr size_t SHM_SLOT_BYTES = 64;
+constexpr size_t SHM_SLOT_DATA = 40;
+
+/// Event kind
+enum : uint8_t { SHM_KIND_CAN = 0, SHM_KIND_SERIAL = 1, SHM_KIND_GAP = 2, SHM_KIND_DROP = 3 };
+
+/// SHM_KIND_GAP id: link lost (data: reason) or restored (data: outage length)
+enum : uint32_t { SHM_GAP_LOST = 0, SHM_GAP_RESTORED = 1 };
+
+// SHM_KIND_DROP: received frames the kernel dropped before the next event (id: count,
+// saturated at 0xFFFFFFFF; data: running total as text)
+
+/// Event flags
+enum : uint8_t {
+    SHM_FLAG_EXT = 0x01,       // CAN: 29-bit ID
+    SHM_FLAG_RTR = 0x02,       // CAN: remote request
+    SHM_FLAG_ERR = 0x04,       // CAN: error frame
+    SHM_FLAG_TX = 0x08,        // Transmitted by adamcom (otherwise received)
+    SHM_FLAG_MORE = 0x10       // Serial: chunk continues in the next event
+};
+
+/// Ring header (one cache line of metadata, head on its own line)
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;       // Power of two
+    uint32_t slot_bytes;
+    int32_t writer_pid;
+    std::atomic<uint32_t> closed;             // Set when the writer exits
+    char iface[40];            // CAN interface or serial device (NUL-terminated)
+    alignas(64) std::atomic<uint64_t> head;   // Sequence number of the next event
+};
+
+/// One event; seq is 0 while the writer is filling the slot
+struct alignas(64) ShmSlot {
+    std::atomic<uint64_t> seq;
+    uint64_t time_ns;          // CLOCK_REALTIME
+    uint32_t id;               // CAN ID without flag bits (0 for serial)
+    uint16_t len;
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t data[SHM_SLOT_DATA];
+};
+
+static_assert(sizeof(ShmSlot) == SHM_SLOT_BYTES, "ShmSlot must be one cache line");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "lock-free 64-bit atomics required");
+
+/// Bytes to map for a ring of slot_count slots
+inline size_t shm_map_bytes(uint32_t slot_count)
+{
+    return sizeof(ShmHeader) + static_cast<size_t>(slot_count) * sizeof(ShmSlot);
+}
+
+/// Event copied out of the ring by ShmReader::next()
+struct ShmEvent {
+    uint64_t seq;
+    uint64_t time_ns;
+    uint32_t id;
+    uint16_t len;
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t data[SHM_SLOT_DATA];
+};
+
+/// Lock-free reader for a ring published by adamcom
+class ShmReader {
+public:
+    ShmReader() = default;
+    ShmReader(const ShmReader&) = delete;
+    ShmReader& operator=(const ShmReader&) = delete;
+    ~ShmReader() { close(); }
+
+    /// Map the ring read-only; reading starts at the newest event (see rewind())
+    bool open(const std::string& name, std::string* error = nullptr)
+    {
+        close();
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return fail(error, name + ": " + std::strerror(errno));
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) {
+            ::close(fd);
+            return fail(error, name + ": not an adamcom ring");
+        }
+        void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return fail(error, name + ": " + std::strerror(errno));
+
+        map_ = map;
+        map_bytes_ = static_cast<size_t>(st.st_size);
+        hdr_ = static_cast<const ShmHeader*>(map);
+        if (hdr_->magic != SHM_MAGIC || hdr_->version != SHM_VERSION ||
+            hdr_->slot_bytes != sizeof(ShmSlot) || hdr_->slot_count == 0 ||
+            (hdr_->slot_count & (hdr_->slot_count - 1)) != 0 ||
+            map_bytes_ < shm_map_bytes(hdr_->slot_count)) {
+            close();
+            return fail(error, name + ": unsupported ring layout");
+        }
+        slots_ = reinterpret_cast<const ShmSlot*>(static_cast<const char*>(map) + sizeof(ShmHeader));
+        mask_ = hdr_->slot_count - 1;
+        next_ = hdr_->head.load(std::memory_order_acquire);
+        lost_ = 0;
+        return true;
+    }
+
+    void close()
+    {
+        if (map_) munmap(map_, map_bytes_);
+        map_ = nullptr;
+        hdr_ = nullptr;
+        slots_ = nullptr;
+    }
+
+    /// Start again from the oldest event still in the ring
+    void rewind()
+    {
+        uint64_t head = hdr_->head.load(std::memory_order_acquire);
+        next_ = head > hdr_->slot_count ? head - hdr_->slot_count : 1;
+    }
+
+    /// Copy out the next event; false when the reader has caught up
+    bool next(ShmEvent& ev)
+    {
+        for (;;) {
+            uint64_t head = hdr_->head.load(std::memory_order_acquire);
+            if (next_ >= head) return false;
+            if (head - next_ > hdr_->slot_count) {
+                // Lapped by the writer: skip to the oldest event that is still intact
+                lost_ += head - hdr_->slot_count - next_;
+                next_ = head - hdr_->slot_count;
+            }
+
+            const ShmSlot& s = slots_[next_ & mask_];
+            uint64_t seq = s.seq.load(std::memory_order_acquire);
+            if (seq == next_) {
+                ev.time_ns = s.time_ns;
+                ev.id = s.id;
+                ev.len = s.len;
+                ev.kind = s.kind;
+                ev.flags = s.flags;
+                std::memcpy(ev.data, s.data, sizeof(ev.data));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.seq.load(std::memory_order_relaxed) == next_) {
+                    ev.seq = next_++;
+                    return true;
+                }
+            }
+            // Slot overwritten under us (or being rewritten): count it and move on
+            ++lost_;
+            ++next_;
+        }
+    }
+
+    /// Events skipped because the writer overtook this reader
+    uint64_t lost() const { return lost_; }
+
+    /// Sequence number of the next event this reader will return
+    uint64_t position() const { return next_; }
+
+    /// The writer has exited (no further events will arrive)
+    bool writer_closed() const { return hdr_ && hdr_->closed.load(std::memory_order_acquire) != 0; }
+
+    const ShmHeader* header() const { return hdr_; }
+
+private:
+    static bool fail(std::string* error, const std::string& msg)
+    {
+        if (error) *error = msg;
+        return false;
+    }
+
+    void* map_ = nullptr;
+    size_t map_bytes_ = 0;
+    const ShmHeader* hdr_ = nullptr;
+    const ShmSlot* slots_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t next_ = 1;
+    uint64_t lost_ = 0;
+};
+
+} // namespace adamcom
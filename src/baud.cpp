@@ -0,0 +1,44 @@
+/**
+ * @file baud.cpp
+ * @brief Arbitrary serial baud rates via termios2 / BOTHER
+ *
+ * Kept in its own translation unit: <asm/termbits.h> defines a struct termios
+ * that conflicts with the glibc one from <termios.h> used everywhere else.
+ */
+
+#include "adamcom.hpp"
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+namespace adamcom {
+
+bool serial_set_custom_baud(int fd, unsigned int rate, unsigned int& applied)
+{
+    if (rate == 0) {
+        return false;   // A zero BOTHER rate hangs the line up
+    }
+    struct termios2 tio{};
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return false;
+    }
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ispeed = rate;
+    tio.c_ospeed = rate;
+    // Input speed follows the output speed unless IBSHIFT bits say otherwise
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+    if (ioctl(fd, TCSETS2, &tio) != 0) {
+        return false;
+    }
+
+    // Drivers round to what their divisor can produce; report that
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return false;
+    }
+    applied = tio.c_ospeed;
+    return true;
+}
+
+} // namespace adamcom
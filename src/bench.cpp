@@ -0,0 +1,122 @@
+/**
+ * @file bench.cpp
+ * @brief Micro-benchmarks of internal hot paths (--bench)
+ */
+
+#include "adamcom.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace adamcom {
+
+using Clock = std::chrono::steady_clock;
+
+/// Keep the compiler from folding benchmark loops away
+static inline void clobber()
+{
+    asm volatile("" ::: "memory");
+}
+
+/// Run fn(n) in batches until about 200 ms have been timed; returns ns per operation.
+/// pause runs untimed between batches (e.g. to let the trace writer drain).
+template <typename Fn, typename Pause>
+static double measure(size_t batch, Fn fn, Pause pause)
+{
+    Clock::duration timed{};
+    size_t ops = 0;
+    while (timed < std::chrono::milliseconds(200)) {
+        auto t0 = Clock::now();
+        fn(batch);
+        timed += Clock::now() - t0;
+        ops += batch;
+        pause();
+    }
+    return std::chrono::duration<double, std::nano>(timed).count() / static_cast<double>(ops);
+}
+
+static void row(const char* name, double ns)
+{
+    std::printf("  %-40s %8.2f ns\n", name, ns);
+}
+
+static void bench_trace()
+{
+    constexpr size_t BATCH = TRACE_RING_RECORDS / 4;
+    auto no_pause = [] {};
+    auto drain_pause = [] { std::this_thread::sleep_for(std::chrono::milliseconds(25)); };
+
+    row("empty loop iteration", measure(BATCH, [](size_t n) {
+        for (size_t i = 0; i < n; ++i) clobber();
+    }, no_pause));
+
+    row("clock read (trace_now_ns)", measure(BATCH, [](size_t n) {
+        uint64_t sink = 0;
+        for (size_t i = 0; i < n; ++i) sink += trace_now_ns();
+        asm volatile("" : : "r"(sink));
+    }, no_pause));
+
+    row("trace scope, tracing off", measure(BATCH, [](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            TraceScope scope(TraceKind::LOOP);
+            clobber();
+        }
+    }, no_pause));
+
+    std::string error;
+    if (!trace_start("/dev/null", error)) {
+        std::printf("  trace scope, tracing on: %s\n", error.c_str());
+        return;
+    }
+    row("trace scope, tracing on (to /dev/null)", measure(BATCH, [](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            TraceScope scope(TraceKind::LOOP);
+            clobber();
+        }
+    }, drain_pause));
+    trace_stop();
+}
+
+static void bench_checksums()
+{
+    std::string report;
+    std::printf("  self-test against check values: %s\n", checksum_selftest(report) ? "ok" : "FAILED");
+    if (!report.empty()) std::printf("%s", report.c_str());
+
+    auto no_pause = [] {};
+    for (size_t size : {8, 64, 4096}) {
+        std::vector<uint8_t> buf(size);
+        for (size_t i = 0; i < size; ++i) buf[i] = static_cast<uint8_t>(i * 31 + 7);
+        size_t batch = std::max<size_t>(64, 262144 / size);
+        std::printf("\n  %zu-byte payload (ns per call)    %10s %10s %8s\n", size, "bitwise", "table", "speedup");
+        for (size_t k = 0; k < CHECKSUM_KIND_COUNT; ++k) {
+            auto kind = static_cast<ChecksumKind>(k);
+            double slow = measure(batch, [&](size_t n) {
+                uint32_t sink = 0;
+                for (size_t i = 0; i < n; ++i) sink += checksum_bitwise(kind, buf.data(), buf.size());
+                asm volatile("" : : "r"(sink));
+            }, no_pause);
+            double fast = measure(batch, [&](size_t n) {
+                uint32_t sink = 0;
+                for (size_t i = 0; i < n; ++i) sink += checksum(kind, buf.data(), buf.size());
+                asm volatile("" : : "r"(sink));
+            }, no_pause);
+            std::string name = checksum_name(kind);
+            if (kind == ChecksumKind::CRC32C && checksum_hw_crc32c()) name += " (SSE4.2)";
+            std::printf("  %-32s %10.1f %10.1f %7.1fx\n", name.c_str(), slow, fast, slow / fast);
+        }
+    }
+}
+
+int bench_run()
+{
+    std::printf("adamcom micro-benchmarks (per operation, this machine)\n\n");
+    std::printf("Event trace (--trace):\n");
+    bench_trace();
+    std::printf("\nChecksums (bit-at-a-time reference vs slice-by-8 / SSE4.2):\n");
+    bench_checksums();
+    std::printf("\n");
+    return 0;
+}
+
+} // namespace adamcom
@@ -0,0 +1,267 @@
+/**
+ * @file busload.cpp
+ * @brief CAN bus load and serial line occupancy from exact on-wire bit counts
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/can.h>
+#include <algorithm>
+#include <cctype>
+
+namespace adamcom {
+
+// Define the global link utilization state
+BusLoadState g_busload{};
+
+using Clock = std::chrono::steady_clock;
+
+/// Window lengths in buckets: 100 ms, 1 s, 10 s
+static constexpr size_t WINDOW_BUCKETS[3] = {1, 10, 100};
+static const char* const WINDOW_NAMES[3] = {"100 ms", "1 s", "10 s"};
+
+// ============================================================================
+// CAN frame length
+// ============================================================================
+
+uint32_t can_frame_bits(uint32_t can_id, const uint8_t* data, uint8_t dlc)
+{
+    // Bits from SOF through the CRC are subject to stuffing
+    uint8_t bits[128];
+    size_t n = 0;
+    auto put = [&](uint32_t value, int width) {
+        for (int i = width - 1; i >= 0; --i) bits[n++] = (value >> i) & 1;
+    };
+
+    bool rtr = (can_id & CAN_RTR_FLAG) != 0;
+    put(0, 1);                                         // SOF
+    if (can_id & CAN_EFF_FLAG) {
+        uint32_t id = can_id & CAN_EFF_MASK;
+        put(id >> 18, 11);                             // Base ID
+        put(1, 1);                                     // SRR
+        put(1, 1);                                     // IDE
+        put(id & 0x3FFFF, 18);                         // ID extension
+        put(rtr, 1);
+        put(0, 2);                                     // r1, r0
+    } else {
+        put(can_id & CAN_SFF_MASK, 11);
+        put(rtr, 1);
+        put(0, 2);                                     // IDE, r0
+    }
+    put(dlc & 0x0F, 4);
+    if (!rtr) {
+        for (uint8_t i = 0; i < std::min<uint8_t>(dlc, 8); ++i) put(data[i], 8);
+    }
+
+    // CRC-15 (x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1)
+    uint16_t crc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        bool next = bits[i] ^ ((crc >> 14) & 1);
+        crc = static_cast<uint16_t>((crc << 1) & 0x7FFF);
+        if (next) crc ^= 0x4599;
+    }
+    put(crc, 15);
+
+    // A stuff bit follows every run of five equal bits and starts the next run itself
+    uint32_t stuff = 0;
+    uint8_t last = 2;
+    int run = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (bits[i] == last) {
+            ++run;
+        } else {
+            last = bits[i];
+            run = 1;
+        }
+        if (run == 5) {
+            ++stuff;
+            last = !last;
+            run = 1;
+        }
+    }
+
+    // CRC delimiter, ACK slot, ACK delimiter, EOF, intermission
+    return static_cast<uint32_t>(n) + stuff + 1 + 1 + 1 + 7 + 3;
+}
+
+// ============================================================================
+// Windows
+// ============================================================================
+
+static double window_load(const BusLoadChannel& ch, uint64_t last_bucket, size_t len)
+{
+    const auto& g = g_busload;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < len; ++i) {
+        bits += ch.bits[(last_bucket - i) % BUSLOAD_BUCKETS];
+    }
+    return static_cast<double>(bits) / (static_cast<double>(g.bitrate) * len * BUSLOAD_BUCKET_MS / 1000.0);
+}
+
+/// Fold the just-completed bucket into the peaks of every window it completes
+static void close_bucket(BusLoadChannel& ch, uint64_t bucket)
+{
+    for (size_t w = 0; w < 3; ++w) {
+        if (bucket + 1 >= WINDOW_BUCKETS[w]) {
+            ch.peak[w] = std::max(ch.peak[w], window_load(ch, bucket, WINDOW_BUCKETS[w]));
+        }
+    }
+}
+
+/// Move the open bucket up to now, closing (and zeroing) every bucket in between
+static void advance(Clock::time_point now)
+{
+    auto& g = g_busload;
+    if (g.bitrate == 0 || now < g.origin) return;
+    auto idx = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - g.origin).count() / BUSLOAD_BUCKET_MS);
+    while (g.bucket < idx) {
+        close_bucket(g.rx, g.bucket);
+        close_bucket(g.tx, g.bucket);
+        ++g.bucket;
+        if (idx - g.bucket >= BUSLOAD_BUCKETS) {
+            // Idle for longer than the longest window: every bucket is empty
+            g.rx.bits.fill(0);
+            g.tx.bits.fill(0);
+            g.bucket = idx;
+            break;
+        }
+        g.rx.bits[g.bucket % BUSLOAD_BUCKETS] = 0;
+        g.tx.bits[g.bucket % BUSLOAD_BUCKETS] = 0;
+    }
+}
+
+/// Load over the last len completed buckets (fewer right after a reset)
+static double recent_load(const BusLoadChannel& ch, size_t len)
+{
+    const auto& g = g_busload;
+    if (g.bucket == 0) return 0;
+    len = static_cast<size_t>(std::min<uint64_t>(len, g.bucket));
+    return window_load(ch, g.bucket - 1, len);
+}
+
+static void add_bits(BusLoadChannel& ch, uint64_t bits)
+{
+    advance(Clock::now());
+    ch.bits[g_busload.bucket % BUSLOAD_BUCKETS] += bits;
+    ch.total_bits += bits;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void busload_configure(const Config& cfg, InterfaceType itype)
+{
+    auto& g = g_busload;
+    auto get = [&](const char* key, const char* def) {
+        auto it = cfg.find(key);
+        return it != cfg.end() ? it->second : std::string(def);
+    };
+    g.can = (itype == InterfaceType::CAN);
+    g.bitrate = 0;
+    try {
+        g.bitrate = static_cast<uint32_t>(std::stoul(get(g.can ? "can_bitrate" : "baud", "0")));
+    } catch (...) {}
+
+    int databits = 8;
+    int stop = 1;
+    try { databits = std::stoi(get("databits", "8")); } catch (...) {}
+    try { stop = std::stoi(get("stop", "1")); } catch (...) {}
+    std::string parity = get("parity", "N");
+    bool has_parity = !parity.empty() && std::toupper(static_cast<unsigned char>(parity[0])) != 'N';
+    g.bits_per_byte = static_cast<uint32_t>(1 + databits + (has_parity ? 1 : 0) + stop);
+    busload_reset();
+}
+
+void busload_reset()
+{
+    auto& g = g_busload;
+    g.rx = BusLoadChannel{};
+    g.tx = BusLoadChannel{};
+    g.origin = Clock::now();
+    g.bucket = 0;
+    g.next_live = g.origin + std::chrono::seconds(1);
+}
+
+void busload_can(uint32_t can_id, const uint8_t* data, uint8_t dlc)
+{
+    if (can_id & CAN_ERR_FLAG) return;
+    add_bits(g_busload.rx, can_frame_bits(can_id, data, dlc));
+    ++g_busload.rx.units;
+}
+
+void busload_serial(bool tx, size_t bytes)
+{
+    auto& ch = tx ? g_busload.tx : g_busload.rx;
+    add_bits(ch, static_cast<uint64_t>(bytes) * g_busload.bits_per_byte);
+    ch.units += bytes;
+}
+
+void busload_poll(Clock::time_point now)
+{
+    auto& g = g_busload;
+    advance(now);
+    if (!g.live || now < g.next_live) return;
+    g.next_live = now + std::chrono::seconds(1);
+
+    char line[160];
+    if (g.can) {
+        std::snprintf(line, sizeof(line), "Load: bus %.1f%% (1 s), %.1f%% (10 s), peak %.1f%% (100 ms)",
+                      recent_load(g.rx, 10) * 100, recent_load(g.rx, 100) * 100, g.rx.peak[0] * 100);
+    } else {
+        std::snprintf(line, sizeof(line), "Load: RX %.1f%% TX %.1f%% (1 s), peak RX %.1f%% TX %.1f%% (100 ms)",
+                      recent_load(g.rx, 10) * 100, recent_load(g.tx, 10) * 100,
+                      g.rx.peak[0] * 100, g.tx.peak[0] * 100);
+    }
+    print_message_above(line);
+}
+
+int busload_timeout_ms(Clock::time_point now)
+{
+    const auto& g = g_busload;
+    if (!g.live) return -1;
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(g.next_live - now).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+void busload_print()
+{
+    auto& g = g_busload;
+    advance(Clock::now());
+    if (g.bitrate == 0) {
+        std::printf("\r\nLink utilization: unknown bit rate\n\n");
+        return;
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - g.origin).count();
+    if (g.can) {
+        std::printf("\r\nCAN bus load @ %u bit/s (exact stuffing, 3-bit IFS), %.1f s since reset\n",
+                    g.bitrate, elapsed);
+    } else {
+        std::printf("\r\nSerial line occupancy @ %u baud, %u bits/byte, %.1f s since reset\n",
+                    g.bitrate, g.bits_per_byte, elapsed);
+    }
+    std::printf("  %-8s %8s %8s %8s   peak %7s %8s %8s   average\n", "", WINDOW_NAMES[0], WINDOW_NAMES[1],
+                WINDOW_NAMES[2], WINDOW_NAMES[0], WINDOW_NAMES[1], WINDOW_NAMES[2]);
+
+    auto row = [&](const char* name, const BusLoadChannel& ch) {
+        double avg = elapsed > 0 ? ch.total_bits / (g.bitrate * elapsed) : 0;
+        std::printf("  %-8s %7.1f%% %7.1f%% %7.1f%%   %11.1f%% %7.1f%% %7.1f%%   %6.1f%%\n", name,
+                    recent_load(ch, WINDOW_BUCKETS[0]) * 100, recent_load(ch, WINDOW_BUCKETS[1]) * 100,
+                    recent_load(ch, WINDOW_BUCKETS[2]) * 100, ch.peak[0] * 100, ch.peak[1] * 100,
+                    ch.peak[2] * 100, avg * 100);
+    };
+    if (g.can) {
+        row("bus", g.rx);
+        std::printf("  %llu frames, %.1f bits/frame on the wire\n\n", static_cast<unsigned long long>(g.rx.units),
+                    g.rx.units ? static_cast<double>(g.rx.total_bits) / g.rx.units : 0.0);
+    } else {
+        row("RX line", g.rx);
+        row("TX line", g.tx);
+        std::printf("  RX %llu bytes, TX %llu bytes\n\n", static_cast<unsigned long long>(g.rx.units),
+                    static_cast<unsigned long long>(g.tx.units));
+    }
+}
+
+} // namespace adamcom
@@ -0,0 +1,265 @@
+/**
+ * @file canlink.cpp
+ * @brief CAN interface bitrate and link state over rtnetlink (needs CAP_NET_ADMIN, not sudo)
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/can/netlink.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace adamcom {
+
+// ============================================================================
+// rtnetlink Messages
+// ============================================================================
+
+struct LinkRequest {
+    struct nlmsghdr nh;
+    struct ifinfomsg ifi;
+    char attrs[256];
+};
+
+static LinkRequest make_request(uint16_t type, uint16_t flags, int ifindex)
+{
+    LinkRequest req{};
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nh.nlmsg_type = type;
+    req.nh.nlmsg_flags = static_cast<uint16_t>(NLM_F_REQUEST | flags);
+    req.ifi.ifi_family = AF_UNSPEC;
+    req.ifi.ifi_index = ifindex;
+    return req;
+}
+
+static struct rtattr* add_attr(LinkRequest& req, uint16_t type, const void* data, size_t len)
+{
+    auto* rta = reinterpret_cast<struct rtattr*>(reinterpret_cast<char*>(&req) + NLMSG_ALIGN(req.nh.nlmsg_len));
+    rta->rta_type = type;
+    rta->rta_len = static_cast<uint16_t>(RTA_LENGTH(len));
+    if (len > 0) std::memcpy(RTA_DATA(rta), data, len);
+    req.nh.nlmsg_len = static_cast<uint32_t>(NLMSG_ALIGN(req.nh.nlmsg_len) + RTA_ALIGN(rta->rta_len));
+    return rta;
+}
+
+static void end_nest(LinkRequest& req, struct rtattr* nest)
+{
+    nest->rta_len = static_cast<uint16_t>(reinterpret_cast<char*>(&req) + req.nh.nlmsg_len -
+                                          reinterpret_cast<char*>(nest));
+}
+
+/// Send one request; the first reply is copied to reply (if given). Returns 0 or -errno.
+static int transact(LinkRequest& req, char* reply, size_t reply_size)
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -errno;
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+    req.nh.nlmsg_seq = 1;
+    if (sendto(fd, &req, req.nh.nlmsg_len, 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+
+    alignas(struct nlmsghdr) char buf[8192];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    int err = (n < 0) ? errno : 0;
+    close(fd);
+    if (n < 0) return -err;
+
+    auto* nh = reinterpret_cast<struct nlmsghdr*>(buf);
+    if (!NLMSG_OK(nh, static_cast<uint32_t>(n))) return -EPROTO;
+    if (nh->nlmsg_type == NLMSG_ERROR) {
+        // error 0 is the ACK of a change request
+        return reinterpret_cast<struct nlmsgerr*>(NLMSG_DATA(nh))->error;
+    }
+    if (reply) std::memcpy(reply, buf, std::min(static_cast<size_t>(n), reply_size));
+    return 0;
+}
+
+// ============================================================================
+// Query
+// ============================================================================
+
+static const char* can_state_name(uint32_t state)
+{
+    switch (state) {
+    case CAN_STATE_ERROR_ACTIVE:  return "ERROR-ACTIVE";
+    case CAN_STATE_ERROR_WARNING: return "ERROR-WARNING";
+    case CAN_STATE_ERROR_PASSIVE: return "ERROR-PASSIVE";
+    case CAN_STATE_BUS_OFF:       return "BUS-OFF";
+    case CAN_STATE_STOPPED:       return "STOPPED";
+    case CAN_STATE_SLEEPING:      return "SLEEPING";
+    default:                      return "unknown";
+    }
+}
+
+static void parse_can_data(struct rtattr* data, CanLinkInfo& info)
+{
+    int len = static_cast<int>(RTA_PAYLOAD(data));
+    for (auto* a = static_cast<struct rtattr*>(RTA_DATA(data)); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+        if (a->rta_type == IFLA_CAN_BITTIMING && RTA_PAYLOAD(a) >= sizeof(struct can_bittiming)) {
+            struct can_bittiming bt{};
+            std::memcpy(&bt, RTA_DATA(a), sizeof(bt));
+            info.bitrate = bt.bitrate;
+        } else if (a->rta_type == IFLA_CAN_STATE && RTA_PAYLOAD(a) >= sizeof(uint32_t)) {
+            uint32_t state = 0;
+            std::memcpy(&state, RTA_DATA(a), sizeof(state));
+            info.state = can_state_name(state);
+        }
+    }
+}
+
+int canlink_query(const std::string& ifname, CanLinkInfo& info)
+{
+    info = CanLinkInfo{};
+    int ifindex = static_cast<int>(if_nametoindex(ifname.c_str()));
+    if (ifindex == 0) return -errno;
+
+    LinkRequest req = make_request(RTM_GETLINK, 0, ifindex);
+    alignas(struct nlmsghdr) char reply[8192] = {};
+    int rc = transact(req, reply, sizeof(reply));
+    if (rc < 0) return rc;
+
+    auto* nh = reinterpret_cast<struct nlmsghdr*>(reply);
+    if (nh->nlmsg_type != RTM_NEWLINK) return -EPROTO;
+    auto* ifi = static_cast<struct ifinfomsg*>(NLMSG_DATA(nh));
+    info.ifindex = ifindex;
+    info.up = (ifi->ifi_flags & IFF_UP) != 0;
+
+    int len = static_cast<int>(IFLA_PAYLOAD(nh));
+    for (auto* a = IFLA_RTA(ifi); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+        if (a->rta_type == IFLA_TXQLEN && RTA_PAYLOAD(a) >= sizeof(uint32_t)) {
+            std::memcpy(&info.txqueuelen, RTA_DATA(a), sizeof(uint32_t));
+        }
+        if (a->rta_type != IFLA_LINKINFO) continue;
+        int ilen = static_cast<int>(RTA_PAYLOAD(a));
+        for (auto* i = static_cast<struct rtattr*>(RTA_DATA(a)); RTA_OK(i, ilen); i = RTA_NEXT(i, ilen)) {
+            if (i->rta_type == IFLA_INFO_KIND) {
+                const char* kind = static_cast<const char*>(RTA_DATA(i));
+                info.kind.assign(kind, strnlen(kind, RTA_PAYLOAD(i)));
+            } else if (i->rta_type == IFLA_INFO_DATA) {
+                parse_can_data(i, info);
+            }
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Changes
+// ============================================================================
+
+static int set_up(int ifindex, bool up)
+{
+    LinkRequest req = make_request(RTM_NEWLINK, NLM_F_ACK, ifindex);
+    req.ifi.ifi_flags = up ? IFF_UP : 0;
+    req.ifi.ifi_change = IFF_UP;
+    return transact(req, nullptr, 0);
+}
+
+static int set_bitrate(int ifindex, uint32_t bitrate)
+{
+    LinkRequest req = make_request(RTM_NEWLINK, NLM_F_ACK, ifindex);
+    struct rtattr* linkinfo = add_attr(req, IFLA_LINKINFO, nullptr, 0);
+    add_attr(req, IFLA_INFO_KIND, "can", 3);
+    struct rtattr* data = add_attr(req, IFLA_INFO_DATA, nullptr, 0);
+    // The driver derives the segment timing from the bitrate, as "ip link ... bitrate" does
+    struct can_bittiming bt{};
+    bt.bitrate = bitrate;
+    add_attr(req, IFLA_CAN_BITTIMING, &bt, sizeof(bt));
+    end_nest(req, data);
+    end_nest(req, linkinfo);
+    return transact(req, nullptr, 0);
+}
+
+/// Last resort for users without CAP_NET_ADMIN but with a sudo rule for ip
+static int configure_with_sudo(const std::string& ifname, const std::string& bitrate, bool change_rate)
+{
+    std::string cmd;
+    if (change_rate) {
+        cmd = "sudo ip link set " + ifname + " down 2>/dev/null";
+        [[maybe_unused]] int rc = std::system(cmd.c_str());
+        cmd = "sudo ip link set " + ifname + " type can bitrate " + bitrate;
+        if (std::system(cmd.c_str()) != 0) {
+            std::cerr << "Failed to set CAN bitrate (may need sudo)\n";
+            return -1;
+        }
+    }
+    cmd = "sudo ip link set " + ifname + " up";
+    if (std::system(cmd.c_str()) != 0) {
+        std::cerr << "Failed to bring up CAN interface\n";
+        return -1;
+    }
+    return 0;
+}
+
+int configure_can_interface(const std::string& ifname, const std::string& bitrate)
+{
+    // Validate interface name (it may end up on a sudo command line)
+    for (char c : ifname) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            std::cerr << "Invalid CAN interface name\n";
+            return -1;
+        }
+    }
+
+    // Validate bitrate is numeric
+    uint32_t want = 0;
+    for (char c : bitrate) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) {
+            std::cerr << "Invalid CAN bitrate\n";
+            return -1;
+        }
+    }
+    try { want = static_cast<uint32_t>(std::stoul(bitrate)); } catch (...) {}
+
+    CanLinkInfo info;
+    int rc = canlink_query(ifname, info);
+    if (rc < 0) {
+        std::cerr << ifname << ": " << std::strerror(-rc) << "\n";
+        return -1;
+    }
+
+    // vcan and other virtual interfaces have no bit timing; only the link state applies
+    bool change_rate = (info.kind == "can" && want != 0 && info.bitrate != want);
+    if (!change_rate && info.up) {
+        return 0;
+    }
+
+    if (change_rate && info.up) rc = set_up(info.ifindex, false);
+    if (rc == 0 && change_rate) rc = set_bitrate(info.ifindex, want);
+    if (rc == 0) rc = set_up(info.ifindex, true);
+
+    if (rc == -EPERM || rc == -EACCES) {
+        std::cerr << ifname << ": no CAP_NET_ADMIN, falling back to sudo ip\n";
+        return configure_with_sudo(ifname, bitrate, change_rate);
+    }
+    if (rc < 0) {
+        std::cerr << ifname << ": " << (change_rate ? "setting bitrate " + bitrate : std::string("bringing up"))
+                  << " failed: " << std::strerror(-rc) << "\n";
+        return -1;
+    }
+    if (change_rate) {
+        std::cout << ifname << ": bitrate " << info.bitrate << " -> " << want << " bps, up\n";
+    } else {
+        std::cout << ifname << ": brought up\n";
+    }
+    return 0;
+}
+
+} // namespace adamcom
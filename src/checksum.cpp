@@ -0,0 +1,531 @@
+/**
+ * @file checksum.cpp
+ * @brief CRC-8/16/32, XOR and sum-8: slice-by-8 tables, SSE4.2 CRC-32C, TX append and RX verify rules
+ */
+
+#include "adamcom.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace adamcom {
+
+// Define the global checksum state
+ChecksumState g_checksum{};
+
+// ============================================================================
+// Algorithms
+// ============================================================================
+
+/// Rocksoft-style parameters; reflected CRCs are appended little-endian, the others big-endian
+struct CrcParams {
+    const char* name;
+    uint8_t width;                 // Bits (0 for XOR and sum-8)
+    uint32_t poly;                 // Normal (MSB-first) form
+    uint32_t init;
+    uint32_t xorout;
+    bool reflected;
+    uint32_t check;                // Result over "123456789"
+};
+
+static constexpr CrcParams PARAMS[CHECKSUM_KIND_COUNT] = {
+    {"crc8",         8,  0x1D,       0xFF,       0xFF,       false, 0x4B},
+    {"crc8-autosar", 8,  0x2F,       0xFF,       0xFF,       false, 0xDF},
+    {"crc16-modbus", 16, 0x8005,     0xFFFF,     0x0000,     true,  0x4B37},
+    {"crc16-ccitt",  16, 0x1021,     0xFFFF,     0x0000,     false, 0x29B1},
+    {"crc32",        32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true,  0xCBF43926},
+    {"crc32c",       32, 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true,  0xE3069283},
+    {"xor",          0,  0,          0,          0,          false, 0x31},
+    {"sum8",         0,  0,          0,          0,          false, 0xDD},
+};
+
+static const CrcParams& params(ChecksumKind kind)
+{
+    return PARAMS[static_cast<size_t>(kind)];
+}
+
+static uint32_t reflect(uint32_t v, int bits)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < bits; ++i) {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+static bool is_crc(ChecksumKind kind)
+{
+    return params(kind).width != 0;
+}
+
+// ============================================================================
+// Slice-by-8 Tables
+// ============================================================================
+
+/// T[k][b]: register contribution of byte b followed by k zero bytes.
+/// Reflected CRCs keep the register right-aligned, the others left-aligned in 32 bits.
+struct SliceTables {
+    uint32_t t[8][256];
+};
+
+static SliceTables build_tables(ChecksumKind kind)
+{
+    const CrcParams& p = params(kind);
+    SliceTables s{};
+    if (p.reflected) {
+        uint32_t poly = reflect(p.poly, p.width);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int b = 0; b < 8; ++b) c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+            s.t[0][i] = c;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t prev = s.t[k - 1][i];
+                s.t[k][i] = (prev >> 8) ^ s.t[0][prev & 0xFF];
+            }
+        }
+    } else {
+        uint32_t poly = p.poly << (32 - p.width);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i << 24;
+            for (int b = 0; b < 8; ++b) c = (c & 0x80000000u) ? (c << 1) ^ poly : c << 1;
+            s.t[0][i] = c;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t prev = s.t[k - 1][i];
+                s.t[k][i] = (prev << 8) ^ s.t[0][prev >> 24];
+            }
+        }
+    }
+    return s;
+}
+
+static const SliceTables& tables(ChecksumKind kind)
+{
+    static const auto all = [] {
+        std::array<SliceTables, CHECKSUM_KIND_COUNT> a{};
+        for (size_t k = 0; k < CHECKSUM_KIND_COUNT; ++k) {
+            if (PARAMS[k].width != 0) a[k] = build_tables(static_cast<ChecksumKind>(k));
+        }
+        return a;
+    }();
+    return all[static_cast<size_t>(kind)];
+}
+
+static inline uint32_t load_le32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static uint32_t slice8_reflected(const SliceTables& s, uint32_t crc, const uint8_t* p, size_t len)
+{
+    const auto& t = s.t;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t a = load_le32(p) ^ crc;
+        uint32_t b = load_le32(p + 4);
+        crc = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24] ^
+              t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+    }
+    while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+static uint32_t slice8_forward(const SliceTables& s, uint32_t crc, const uint8_t* p, size_t len)
+{
+    const auto& t = s.t;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t a = load_be32(p) ^ crc;
+        uint32_t b = load_be32(p + 4);
+        crc = t[7][a >> 24] ^ t[6][(a >> 16) & 0xFF] ^ t[5][(a >> 8) & 0xFF] ^ t[4][a & 0xFF] ^
+              t[3][b >> 24] ^ t[2][(b >> 16) & 0xFF] ^ t[1][(b >> 8) & 0xFF] ^ t[0][b & 0xFF];
+    }
+    while (len--) crc = (crc << 8) ^ t[0][(crc >> 24) ^ *p++];
+    return crc;
+}
+
+// ============================================================================
+// SSE4.2 CRC-32C
+// ============================================================================
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* p, size_t len)
+{
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    auto c32 = static_cast<uint32_t>(c);
+    while (len--) c32 = _mm_crc32_u8(c32, *p++);
+    return c32;
+}
+#endif
+
+bool checksum_hw_crc32c()
+{
+#if defined(__x86_64__)
+    static const bool hw = __builtin_cpu_supports("sse4.2");
+    return hw;
+#else
+    return false;
+#endif
+}
+
+// ============================================================================
+// Computation
+// ============================================================================
+
+uint32_t checksum_init(ChecksumKind kind)
+{
+    return params(kind).init;
+}
+
+uint32_t checksum_update(ChecksumKind kind, uint32_t reg, const uint8_t* data, size_t len)
+{
+    const CrcParams& p = params(kind);
+    if (kind == ChecksumKind::XOR8) {
+        for (size_t i = 0; i < len; ++i) reg ^= data[i];
+        return reg & 0xFF;
+    }
+    if (kind == ChecksumKind::SUM8) {
+        for (size_t i = 0; i < len; ++i) reg += data[i];
+        return reg & 0xFF;
+    }
+#if defined(__x86_64__)
+    if (kind == ChecksumKind::CRC32C && checksum_hw_crc32c()) {
+        return crc32c_sse42(reg, data, len);
+    }
+#endif
+    if (p.reflected) {
+        return slice8_reflected(tables(kind), reg, data, len);
+    }
+    // The forward tables work on a left-aligned register
+    int shift = 32 - p.width;
+    return slice8_forward(tables(kind), reg << shift, data, len) >> shift;
+}
+
+uint32_t checksum_final(ChecksumKind kind, uint32_t reg)
+{
+    const CrcParams& p = params(kind);
+    uint32_t mask = p.width == 32 ? 0xFFFFFFFFu : p.width == 0 ? 0xFFu : (1u << p.width) - 1;
+    return (reg ^ p.xorout) & mask;
+}
+
+uint32_t checksum(ChecksumKind kind, const uint8_t* data, size_t len)
+{
+    return checksum_final(kind, checksum_update(kind, checksum_init(kind), data, len));
+}
+
+uint32_t checksum_bitwise(ChecksumKind kind, const uint8_t* data, size_t len)
+{
+    const CrcParams& p = params(kind);
+    if (!is_crc(kind)) return checksum(kind, data, len);
+    uint32_t top = 1u << (p.width - 1);
+    uint32_t mask = p.width == 32 ? 0xFFFFFFFFu : (1u << p.width) - 1;
+    uint32_t poly = p.reflected ? reflect(p.poly, p.width) : p.poly;
+    uint32_t crc = p.init;
+    for (size_t i = 0; i < len; ++i) {
+        if (p.reflected) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; ++b) crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        } else {
+            crc ^= static_cast<uint32_t>(data[i]) << (p.width - 8);
+            for (int b = 0; b < 8; ++b) crc = ((crc & top) ? (crc << 1) ^ poly : crc << 1) & mask;
+        }
+    }
+    return (crc ^ p.xorout) & mask;
+}
+
+size_t checksum_width(ChecksumKind kind)
+{
+    return is_crc(kind) ? params(kind).width / 8 : 1;
+}
+
+const char* checksum_name(ChecksumKind kind)
+{
+    return params(kind).name;
+}
+
+bool checksum_parse(const std::string& name, ChecksumKind& kind)
+{
+    std::string n = name;
+    for (char& c : n) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (n == "crc8-j1850") n = "crc8";
+    if (n == "crc16") n = "crc16-modbus";
+    if (n == "xor8") n = "xor";
+    for (size_t k = 0; k < CHECKSUM_KIND_COUNT; ++k) {
+        if (n == PARAMS[k].name) {
+            kind = static_cast<ChecksumKind>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t checksum_store(ChecksumKind kind, uint32_t value, uint8_t* out)
+{
+    size_t w = checksum_width(kind);
+    for (size_t i = 0; i < w; ++i) {
+        size_t shift = params(kind).reflected ? i : (w - 1 - i);
+        out[i] = static_cast<uint8_t>(value >> (8 * shift));
+    }
+    return w;
+}
+
+uint32_t checksum_load(ChecksumKind kind, const uint8_t* in)
+{
+    size_t w = checksum_width(kind);
+    uint32_t v = 0;
+    for (size_t i = 0; i < w; ++i) {
+        size_t shift = params(kind).reflected ? i : (w - 1 - i);
+        v |= static_cast<uint32_t>(in[i]) << (8 * shift);
+    }
+    return v;
+}
+
+bool checksum_selftest(std::string& report)
+{
+    static const uint8_t CHECK[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    bool ok = true;
+    for (size_t k = 0; k < CHECKSUM_KIND_COUNT; ++k) {
+        auto kind = static_cast<ChecksumKind>(k);
+        uint32_t fast = checksum(kind, CHECK, sizeof(CHECK));
+        uint32_t slow = checksum_bitwise(kind, CHECK, sizeof(CHECK));
+        if (fast != PARAMS[k].check || slow != PARAMS[k].check) {
+            ok = false;
+            char line[96];
+            std::snprintf(line, sizeof(line), "%s: got 0x%X (bitwise 0x%X), want 0x%X\n", PARAMS[k].name, fast,
+                          slow, PARAMS[k].check);
+            report += line;
+        }
+    }
+    return ok;
+}
+
+// ============================================================================
+// TX Append
+// ============================================================================
+
+void checksum_configure(const Config& cfg)
+{
+    auto& g = g_checksum;
+    std::string error;
+    auto it = cfg.find("tx_checksum");
+    if (it != cfg.end() && !checksum_set_tx(it->second, error)) {
+        std::fprintf(stderr, "tx_checksum: %s\n", error.c_str());
+    }
+    g.rules.clear();
+    for (size_t i = 1; i <= CHECKSUM_MAX_RULES; ++i) {
+        auto r = cfg.find("rx_checksum" + std::to_string(i));
+        if (r == cfg.end()) break;
+        if (!checksum_rule_add(r->second, error)) {
+            std::fprintf(stderr, "rx_checksum%zu: %s\n", i, error.c_str());
+        }
+    }
+}
+
+bool checksum_set_tx(const std::string& name, std::string& error)
+{
+    auto& g = g_checksum;
+    if (name.empty() || name == "none" || name == "off") {
+        g.tx_enabled = false;
+        return true;
+    }
+    ChecksumKind kind;
+    if (!checksum_parse(name, kind)) {
+        error = "unknown checksum '" + name + "'";
+        return false;
+    }
+    g.tx_kind = kind;
+    g.tx_enabled = true;
+    return true;
+}
+
+bool send_can_payload(int fd, uint32_t can_id, const uint8_t* data, size_t len)
+{
+    auto& g = g_checksum;
+    if (!g.tx_enabled) return send_can_bytes(fd, can_id, data, len);
+    len = std::min<size_t>(len, 8);
+    if (len + checksum_width(g.tx_kind) > 8) {
+        ++g.tx_no_room;
+        return false;
+    }
+    uint8_t frame[8];
+    std::memcpy(frame, data, len);
+    len += checksum_store(g.tx_kind, checksum(g.tx_kind, frame, len), frame + len);
+    ++g.tx_appended;
+    return send_can_bytes(fd, can_id, frame, len);
+}
+
+bool send_serial_payload(int fd, const uint8_t* data, size_t len)
+{
+    auto& g = g_checksum;
+    if (!g.tx_enabled) return send_serial_bytes(fd, data, len);
+    // Grows once to the largest payload, then reused
+    auto& buf = g.scratch;
+    buf.assign(data, data + len);
+    buf.resize(len + checksum_width(g.tx_kind));
+    checksum_store(g.tx_kind, checksum(g.tx_kind, data, len), buf.data() + len);
+    ++g.tx_appended;
+    return send_serial_bytes(fd, buf.data(), buf.size());
+}
+
+// ============================================================================
+// RX Verify Rules
+// ============================================================================
+
+bool checksum_rule_add(const std::string& spec, std::string& error)
+{
+    // MATCH ALGO [at POS]: the algorithm name splits the match from the options
+    std::istringstream in(spec);
+    std::vector<std::string> tok;
+    for (std::string t; in >> t;) tok.push_back(t);
+
+    ChecksumRule rule;
+    size_t algo = tok.size();
+    for (size_t i = tok.size(); i-- > 0;) {
+        if (checksum_parse(tok[i], rule.kind)) {
+            algo = i;
+            break;
+        }
+    }
+    if (algo == tok.size() || algo == 0) {
+        error = "expected MATCH ALGO [at POS], e.g. can 0x100/0x7F0 crc8 at 7";
+        return false;
+    }
+    std::string match;
+    for (size_t i = 0; i < algo; ++i) match += (i ? " " : "") + tok[i];
+    if (!trigger_parse_match(match, rule.match, error)) return false;
+    if (!rule.match.is_can) {
+        error = "RX checksum rules apply to CAN frames (use /modbus for Modbus RTU)";
+        return false;
+    }
+    if (algo + 1 < tok.size()) {
+        if (tok[algo + 1] != "at" || algo + 3 != tok.size()) {
+            error = "expected 'at POS' after the algorithm";
+            return false;
+        }
+        try { rule.pos = std::stoi(tok[algo + 2]); } catch (...) { rule.pos = 99; }
+        if (rule.pos < 0 || static_cast<size_t>(rule.pos) + checksum_width(rule.kind) > 8) {
+            error = "checksum position must lie within the 8-byte frame";
+            return false;
+        }
+    }
+    if (g_checksum.rules.size() >= CHECKSUM_MAX_RULES) {
+        error = "too many rules";
+        return false;
+    }
+    rule.text = spec;
+    g_checksum.rules.push_back(std::move(rule));
+    return true;
+}
+
+void checksum_save(Config& cfg)
+{
+    const auto& g = g_checksum;
+    cfg["tx_checksum"] = g.tx_enabled ? checksum_name(g.tx_kind) : "none";
+    for (size_t i = 1; i <= CHECKSUM_MAX_RULES; ++i) cfg.erase("rx_checksum" + std::to_string(i));
+    for (size_t i = 0; i < g.rules.size(); ++i) {
+        cfg["rx_checksum" + std::to_string(i + 1)] = g.rules[i].text;
+    }
+}
+
+bool checksum_rule_remove(size_t index)
+{
+    auto& rules = g_checksum.rules;
+    if (index >= rules.size()) return false;
+    rules.erase(rules.begin() + static_cast<std::ptrdiff_t>(index));
+    return true;
+}
+
+void checksum_reset_stats()
+{
+    auto& g = g_checksum;
+    g.tx_appended = 0;
+    g.tx_no_room = 0;
+    for (auto& r : g.rules) {
+        r.checked = 0;
+        r.errors = 0;
+        r.short_frames = 0;
+    }
+}
+
+void checksum_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc)
+{
+    auto& g = g_checksum;
+    dlc = std::min<size_t>(dlc, 8);
+    uint64_t frame = 0;
+    std::memcpy(&frame, data, dlc);
+    for (size_t i = 0; i < g.rules.size(); ++i) {
+        ChecksumRule& r = g.rules[i];
+        const Trigger& t = r.match;
+        if (t.extended != extended || (can_id & t.id_mask) != t.can_id || dlc < t.data_len ||
+            ((frame ^ t.data_want) & t.data_mask) != 0) {
+            continue;
+        }
+        size_t w = checksum_width(r.kind);
+        // Default position: the checksum closes the frame and covers everything before it
+        size_t pos = r.pos < 0 ? (dlc >= w ? dlc - w : dlc) : static_cast<size_t>(r.pos);
+        if (pos + w > dlc) {
+            ++r.short_frames;
+            continue;
+        }
+        uint32_t reg = checksum_init(r.kind);
+        reg = checksum_update(r.kind, reg, data, pos);
+        reg = checksum_update(r.kind, reg, data + pos + w, dlc - pos - w);
+        uint32_t want = checksum_final(r.kind, reg);
+        uint32_t got = checksum_load(r.kind, data + pos);
+        ++r.checked;
+        if (got == want) continue;
+        ++r.errors;
+        metric_add(Metric::RX_CHECKSUM_ERRORS);
+        char line[128];
+        std::snprintf(line, sizeof(line), "CRC ERROR[rule %zu %s] ID 0x%03X: got 0x%0*X, want 0x%0*X", i + 1,
+                      checksum_name(r.kind), can_id, static_cast<int>(w * 2), got, static_cast<int>(w * 2), want);
+        print_message_above(line);
+    }
+}
+
+void checksum_print_status()
+{
+    const auto& g = g_checksum;
+    std::printf("\r\nTX checksum: %s", g.tx_enabled ? checksum_name(g.tx_kind) : "off");
+    if (g.tx_enabled) {
+        std::printf(" (%llu appended, %llu CAN frames without room)",
+                    static_cast<unsigned long long>(g.tx_appended),
+                    static_cast<unsigned long long>(g.tx_no_room));
+    }
+    std::printf("\nCRC-32C: %s\n", checksum_hw_crc32c() ? "SSE4.2" : "slice-by-8");
+    if (g.rules.empty()) {
+        std::printf("No RX checksum rules (/crc rx add can ID[/MASK] ALGO [at POS])\n\n");
+        return;
+    }
+    std::printf("  %-3s %-40s %10s %8s %8s\n", "#", "rule", "checked", "errors", "short");
+    for (size_t i = 0; i < g.rules.size(); ++i) {
+        const ChecksumRule& r = g.rules[i];
+        std::printf("  %-3zu %-40.40s %10llu %8llu %8llu\n", i + 1, r.text.c_str(),
+                    static_cast<unsigned long long>(r.checked), static_cast<unsigned long long>(r.errors),
+                    static_cast<unsigned long long>(r.short_frames));
+    }
+    std::printf("\n");
+}
+
+} // namespace adamcom
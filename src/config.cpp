@@ -55,38 +55,43 @@ bool write_profile(const std::string& path, const Config& cfg)
     return out.good();
 }
 
+static const std::map<unsigned int, speed_t> baud_table = {
+    {300,     B300},
+    {1200,    B1200},
+    {2400,    B2400},
+    {4800,    B4800},
+    {9600,    B9600},
+    {19200,   B19200},
+    {38400,   B38400},
+    {57600,   B57600},
+    {115200,  B115200},
+    {230400,  B230400},
+    {460800,  B460800},
+    {500000,  B500000},
+    {576000,  B576000},
+    {921600,  B921600},
+    {1000000, B1000000},
+    {1152000, B1152000},
+    {1500000, B1500000},
+    {2000000, B2000000},
+    {2500000, B2500000},
+    {3000000, B3000000},
+    {3500000, B3500000},
+    {4000000, B4000000}
+};
+
 unsigned int get_baud_numeric(const std::string& s)
 {
-    return static_cast<unsigned int>(std::stoul(s));
+    unsigned int rate = static_cast<unsigned int>(std::stoul(s));
+    // B0 / a zero BOTHER rate means "hang up", not a line speed
+    if (rate == 0) {
+        throw std::invalid_argument("Invalid baud rate: " + s);
+    }
+    return rate;
 }
 
 unsigned int get_baud_speed_t(const std::string& s)
 {
-    static const std::map<unsigned int, speed_t> baud_table = {
-        {300,     B300},
-        {1200,    B1200},
-        {2400,    B2400},
-        {4800,    B4800},
-        {9600,    B9600},
-        {19200,   B19200},
-        {38400,   B38400},
-        {57600,   B57600},
-        {115200,  B115200},
-        {230400,  B230400},
-        {460800,  B460800},
-        {500000,  B500000},
-        {576000,  B576000},
-        {921600,  B921600},
-        {1000000, B1000000},
-        {1152000, B1152000},
-        {1500000, B1500000},
-        {2000000, B2000000},
-        {2500000, B2500000},
-        {3000000, B3000000},
-        {3500000, B3500000},
-        {4000000, B4000000}
-    };
-
     unsigned int rate = get_baud_numeric(s);
     auto it = baud_table.find(rate);
     if (it == baud_table.end()) {
@@ -95,6 +100,14 @@ unsigned int get_baud_speed_t(const std::string& s)
     return static_cast<unsigned int>(it->second);
 }
 
+unsigned int get_baud_from_speed_t(unsigned int speed)
+{
+    for (const auto& [rate, code] : baud_table) {
+        if (code == speed) return rate;
+    }
+    return 0;
+}
+
 void usage(const char* prog)
 {
     std::cerr <<
@@ -104,23 +117,47 @@ void usage(const char* prog)
         "\n"
         "Serial Options:\n"
         "  -d, --device <path>      Serial device (e.g., /dev/ttyUSB0)\n"
-        "  -b, --baud <rate>        Baud rate (9600, 115200, etc.)\n"
+        "  -b, --baud <rate>        Baud rate (any integer, e.g. 115200, 250000, 1843200)\n"
         "  -i, --databits <5-8>     Data bits\n"
         "  -p, --parity <N|E|O>     Parity (None/Even/Odd)\n"
         "  -s, --stop <1|2>         Stop bits\n"
         "  -f, --flow <mode>        Flow control (none/hardware/software)\n"
+        "  --latency <profile>      low | balanced | throughput (USB latency timer, batching)\n"
+        "\n"
+        "Connection:\n"
+        "  --no-reconnect           Exit when the device goes away instead of reconnecting\n"
         "\n"
         "CAN Options:\n"
         "  -c, --can <iface>        CAN interface (e.g., can0)\n"
         "  --canbitrate <rate>      CAN bitrate (125000/250000/500000/1000000)\n"
         "  --canid <id>             TX CAN ID in hex (default: 0x123)\n"
         "  --filter <id:mask>       CAN RX filter in hex (e.g., 0x100:0x7FF)\n"
+        "  --rcvbuf <KB>            CAN socket receive buffer (SO_RCVBUF; 0 = kernel default)\n"
+        "  --isotp                  Enable ISO-TP (multi-frame) transfers\n"
+        "  --j1939                  Decode extended frames as J1939\n"
+        "  --dbc <file>             Decode signals with a DBC file (repeatable)\n"
+        "\n"
+        "Protocol Decoders:\n"
+        "  --modbus                 Decode serial RX as Modbus RTU frames\n"
         "\n"
         "Mode Options:\n"
         "  --hex                    Start in hex mode\n"
         "  --normal                 Start in normal/text mode\n"
         "  --crlf, --no-crlf        Append CRLF to lines (default: yes)\n"
         "\n"
+        "Structured Output:\n"
+        "  --output jsonl|csv       Write one record per RX/TX frame or serial chunk\n"
+        "  --output-file <path>     Record destination (default: stdout; UI moves to stderr)\n"
+        "  --shm <auto|/name>       Publish RX/TX to a shared-memory ring (off to disable)\n"
+        "  --metrics-file <path>    Rewrite Prometheus metrics to path every metrics_interval s\n"
+        "  --trace <file>           Write a Chrome/Perfetto trace of main-loop activity\n"
+        "  --bench                  Run internal micro-benchmarks and exit\n"
+        "\n"
+        "Session Server:\n"
+        "  --serve [socket]         Share this session with --attach clients\n"
+        "  --attach [socket]        Attach to a serving session (stdin lines are commands)\n"
+        "  -e, --exec <line>        With --attach: run a command, print its reply (repeatable)\n"
+        "\n"
         "Preset/Repeat:\n"
         "  --preset <n>             Send preset 1-10 once and exit\n"
         "  --repeat <n,ms>          Auto-repeat preset n every ms\n"
@@ -135,6 +172,33 @@ void usage(const char* prog)
         "  /r on|off                Toggle repeat mode\n"
         "  /ri MS                   Set repeat interval\n"
         "  /rp N                    Set repeat preset\n"
+        "  /tp XX XX ...            Send ISO-TP payload (any length)\n"
+        "  /isotp on|off|status     ISO-TP settings (tx/rx ID, bs, stmin, pad)\n"
+        "  /j1939 on|off|stats      J1939 decoding and PGN/SA statistics\n"
+        "  /dbc load FILE|on|off    DBC signal decoding\n"
+        "  /trig add MATCH -> ACT   RX triggers (list, del N, clear, on|off)\n"
+        "  /resp add MATCH -> RSP   Auto-responder (list, del N, clear, on|off)\n"
+        "  /seq NAME|stop|show      Timed sequences (def NAME STEPS, load FILE)\n"
+        "  /gen N FIELD; FIELD      Counters, timestamps, CRC-8 in preset N (off, reset)\n"
+        "  /crc tx ALGO|off         Append a checksum to presets, inline repeats, /hex\n"
+        "  /crc rx add MATCH ALGO   Verify CAN RX checksums (del N, clear; /crc for counts)\n"
+        "  /stress load P%|burst N  CAN load generator / max-rate burst (/stress stop)\n"
+        "  /find id|hex|text Q      Search the in-memory scrollback\n"
+        "  /pager                   Scrollback pager (live traffic continues)\n"
+        "  /capture start|stop      Log RX to a candump-format file\n"
+        "  /dump                    Print the pre-trigger RX history\n"
+        "  /output jsonl|csv FILE   Structured RX/TX records (off, or status)\n"
+        "  /shm on [/NAME]|off      Shared-memory ring for local consumers\n"
+        "  /serve                   Attached --serve clients\n"
+        "  /latency [profile]       Serial latency profile and what was applied\n"
+        "  /reconnect [on|off]      Auto-reconnect state, outages and reconnect times\n"
+        "  /txq [clear]             TX queue depth, ENOBUFS/EAGAIN refusals, retry latency\n"
+        "  /load [reset]            CAN bus load / serial line occupancy, peaks\n"
+        "  /load live on|off        Print the load every second\n"
+        "  /stats                   Counters, latency histograms, queue depths\n"
+        "  /perf [reset]            Main-loop time per stage (make profile builds)\n"
+        "  /trace start FILE|stop   Chrome trace-event JSON of main-loop activity\n"
+        "  /modbus on|off|stats     Modbus RTU decoding and statistics\n"
         "  /menu                    Open menu\n"
         "  /help                    Show commands\n"
         "\n"
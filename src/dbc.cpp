@@ -0,0 +1,392 @@
+/**
+ * @file dbc.cpp
+ * @brief DBC database loading and per-ID signal decoding
+ */
+
+#include "adamcom.hpp"
+
+#include <fstream>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global DBC database
+DbcDatabase g_dbc{};
+
+using Clock = std::chrono::steady_clock;
+
+// DBC marks extended identifiers by setting bit 31 of the message ID
+static constexpr uint32_t DBC_EXTENDED_FLAG = 0x80000000u;
+static constexpr uint32_t EXT_EMPTY = 0xFFFFFFFFu;
+
+// ============================================================================
+// Parser
+// ============================================================================
+
+/// Minimal cursor over the file contents (no allocation while scanning)
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    bool at_end() const { return p >= end; }
+
+    void skip_spaces()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    }
+
+    void skip_line()
+    {
+        while (p < end && *p != '\n') ++p;
+        if (p < end) ++p;
+    }
+
+    bool literal(char c)
+    {
+        skip_spaces();
+        if (p < end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    std::string_view word()
+    {
+        skip_spaces();
+        const char* start = p;
+        while (p < end && !std::isspace(static_cast<unsigned char>(*p)) &&
+               *p != ':' && *p != '|' && *p != '@' && *p != '(' && *p != ',' &&
+               *p != ')' && *p != '[' && *p != ']' && *p != '"') {
+            ++p;
+        }
+        return std::string_view(start, static_cast<size_t>(p - start));
+    }
+
+    template <typename T>
+    bool number(T& out)
+    {
+        skip_spaces();
+        auto res = std::from_chars(p, end, out);
+        if (res.ec != std::errc()) return false;
+        p = res.ptr;
+        return true;
+    }
+
+    bool quoted(std::string_view& out)
+    {
+        if (!literal('"')) return false;
+        const char* start = p;
+        while (p < end && *p != '"') ++p;
+        out = std::string_view(start, static_cast<size_t>(p - start));
+        if (p < end) ++p;
+        return true;
+    }
+
+    /// True if the current line starts with kw followed by whitespace
+    bool keyword(std::string_view kw)
+    {
+        skip_spaces();
+        if (static_cast<size_t>(end - p) <= kw.size()) return false;
+        if (std::memcmp(p, kw.data(), kw.size()) != 0) return false;
+        char next = p[kw.size()];
+        if (next != ' ' && next != '\t') return false;
+        p += kw.size();
+        return true;
+    }
+};
+
+/// Compute the shift that brings a signal's LSB to bit 0 of its 64-bit word
+static bool layout_signal(DbcSignal& sig, unsigned start, unsigned length, bool motorola)
+{
+    if (length == 0 || length > 64 || start > 63) return false;
+
+    if (!motorola) {
+        // Intel: start is the LSB in a little-endian word
+        if (start + length > 64) return false;
+        sig.shift = static_cast<uint8_t>(start);
+    } else {
+        // Motorola: start is the MSB in DBC "sawtooth" numbering. Convert it to a
+        // position counted from the MSB of a big-endian word.
+        unsigned msb_from_left = (start / 8) * 8 + (7 - start % 8);
+        unsigned lsb_from_left = msb_from_left + length - 1;
+        if (lsb_from_left > 63) return false;
+        sig.shift = static_cast<uint8_t>(63 - lsb_from_left);
+    }
+
+    sig.motorola = motorola ? 1 : 0;
+    sig.mask = (length == 64) ? ~0ULL : ((1ULL << length) - 1);
+    return true;
+}
+
+static bool parse_message(Cursor& c, DbcMessage& msg, std::string& name)
+{
+    uint32_t raw_id = 0;
+    if (!c.number(raw_id)) return false;
+    std::string_view n = c.word();
+    if (n.empty() || !c.literal(':')) return false;
+    unsigned dlc = 8;
+    c.number(dlc);
+
+    msg.extended = (raw_id & DBC_EXTENDED_FLAG) != 0;
+    msg.id = raw_id & (msg.extended ? 0x1FFFFFFFu : 0x7FFu);
+    msg.dlc = static_cast<uint8_t>(std::min(dlc, 8u));
+    name.assign(n.data(), n.size());
+    return true;
+}
+
+static bool parse_signal(Cursor& c, DbcSignal& sig, std::string& name, std::string& unit)
+{
+    std::string_view n = c.word();
+    if (n.empty()) return false;
+    name.assign(n.data(), n.size());
+
+    // Optional multiplexer indicator: "M" or "mN" (also "mNM" for nested muxes)
+    c.skip_spaces();
+    if (c.p < c.end && *c.p != ':') {
+        std::string_view mux = c.word();
+        if (!mux.empty() && mux[0] == 'M') {
+            sig.is_multiplexer = 1;
+        } else if (mux.size() > 1 && mux[0] == 'm') {
+            int value = -1;
+            std::from_chars(mux.data() + 1, mux.data() + mux.size(), value);
+            sig.mux_value = static_cast<int16_t>(value);
+            if (mux.back() == 'M') sig.is_multiplexer = 1;
+        }
+    }
+    if (!c.literal(':')) return false;
+
+    unsigned start = 0, length = 0;
+    if (!c.number(start) || !c.literal('|') || !c.number(length) || !c.literal('@')) return false;
+    if (c.p + 2 > c.end) return false;
+    bool motorola = (c.p[0] == '0');
+    sig.is_signed = (c.p[1] == '-') ? 1 : 0;
+    c.p += 2;
+
+    if (!c.literal('(') || !c.number(sig.factor) || !c.literal(',') ||
+        !c.number(sig.offset) || !c.literal(')')) {
+        return false;
+    }
+    if (c.literal('[')) {
+        double lo = 0, hi = 0;
+        c.number(lo);
+        c.literal('|');
+        c.number(hi);
+        c.literal(']');
+    }
+    std::string_view u;
+    if (c.quoted(u)) unit.assign(u.data(), u.size());
+
+    if (!layout_signal(sig, start, length, motorola)) return false;
+    sig.sign_bit = sig.is_signed ? (1ULL << (length - 1)) : 0;
+    return true;
+}
+
+/// Skip a statement we do not decode; quoted strings (CM_ comments) may span lines
+static void skip_statement(Cursor& c)
+{
+    bool in_quote = false;
+    while (c.p < c.end) {
+        char ch = *c.p++;
+        if (ch == '"') in_quote = !in_quote;
+        if (ch == '\n' && !in_quote) return;
+    }
+}
+
+// ============================================================================
+// Indexing
+// ============================================================================
+
+static void rebuild_index()
+{
+    g_dbc.std_index.assign(2048, -1);
+
+    size_t ext_count = 0;
+    for (const auto& m : g_dbc.messages) ext_count += m.extended ? 1 : 0;
+    size_t cap = 16;
+    while (cap < ext_count * 2) cap <<= 1;
+    g_dbc.ext_index.assign(cap, {EXT_EMPTY, -1});
+
+    size_t max_signals = 0;
+    for (size_t i = 0; i < g_dbc.messages.size(); ++i) {
+        const DbcMessage& m = g_dbc.messages[i];
+        max_signals = std::max<size_t>(max_signals, m.signal_count);
+        if (!m.extended) {
+            // Later files override earlier definitions of the same ID
+            g_dbc.std_index[m.id] = static_cast<int32_t>(i);
+            continue;
+        }
+        size_t mask = cap - 1;
+        size_t slot = (static_cast<size_t>(m.id) * 0x9E3779B1u) & mask;
+        while (g_dbc.ext_index[slot].first != EXT_EMPTY && g_dbc.ext_index[slot].first != m.id) {
+            slot = (slot + 1) & mask;
+        }
+        g_dbc.ext_index[slot] = {m.id, static_cast<int32_t>(i)};
+    }
+
+    // Decode scratch space sized once for the largest message
+    g_dbc.values.assign(max_signals, 0.0);
+    g_dbc.present.assign(max_signals, 0);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool dbc_load(const std::string& path, std::string& report)
+{
+    auto t0 = Clock::now();
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        report = "cannot open " + path;
+        return false;
+    }
+    std::string text(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(text.data(), static_cast<std::streamsize>(text.size()));
+
+    Cursor c{text.data(), text.data() + text.size()};
+    size_t msgs_before = g_dbc.messages.size();
+    size_t sigs_before = g_dbc.signals.size();
+    DbcMessage* current = nullptr;
+    size_t bad_signals = 0;
+
+    while (!c.at_end()) {
+        const char* line_start = c.p;
+        if (c.keyword("BO_")) {
+            DbcMessage msg{};
+            std::string name;
+            if (parse_message(c, msg, name)) {
+                msg.first_signal = static_cast<uint32_t>(g_dbc.signals.size());
+                g_dbc.messages.push_back(msg);
+                g_dbc.message_names.push_back(std::move(name));
+                current = &g_dbc.messages.back();
+            } else {
+                current = nullptr;
+            }
+            c.skip_line();
+        } else if (c.keyword("SG_")) {
+            DbcSignal sig{};
+            std::string name, unit;
+            if (current && parse_signal(c, sig, name, unit)) {
+                if (sig.is_multiplexer && current->mux_signal < 0) {
+                    current->mux_signal = static_cast<int32_t>(current->signal_count);
+                }
+                g_dbc.signals.push_back(sig);
+                g_dbc.signal_names.push_back(std::move(name));
+                g_dbc.signal_units.push_back(std::move(unit));
+                ++current->signal_count;
+            } else {
+                ++bad_signals;
+            }
+            c.skip_line();
+        } else {
+            // A blank line ends the current message's signal list
+            c.skip_spaces();
+            if (c.p < c.end && *c.p == '\n') current = nullptr;
+            c.p = line_start;
+            skip_statement(c);
+        }
+    }
+
+    rebuild_index();
+
+    auto ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    g_dbc.files.push_back(path);
+    char line[256];
+    std::snprintf(line, sizeof(line), "Loaded %s: %zu messages, %zu signals in %.1f ms%s",
+                  path.c_str(), g_dbc.messages.size() - msgs_before,
+                  g_dbc.signals.size() - sigs_before, ms,
+                  bad_signals ? " (some signals skipped)" : "");
+    report = line;
+    return true;
+}
+
+void dbc_clear()
+{
+    g_dbc = DbcDatabase{};
+}
+
+const DbcMessage* dbc_find(uint32_t can_id, bool extended)
+{
+    if (!extended) {
+        if (can_id >= g_dbc.std_index.size()) return nullptr;
+        int32_t idx = g_dbc.std_index[can_id];
+        return idx < 0 ? nullptr : &g_dbc.messages[static_cast<size_t>(idx)];
+    }
+    if (g_dbc.ext_index.empty()) return nullptr;
+    size_t mask = g_dbc.ext_index.size() - 1;
+    size_t slot = (static_cast<size_t>(can_id) * 0x9E3779B1u) & mask;
+    while (g_dbc.ext_index[slot].first != EXT_EMPTY) {
+        if (g_dbc.ext_index[slot].first == can_id) {
+            return &g_dbc.messages[static_cast<size_t>(g_dbc.ext_index[slot].second)];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+size_t dbc_decode(const DbcMessage& msg, const uint8_t* data, size_t dlc)
+{
+    uint8_t bytes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    std::memcpy(bytes, data, std::min<size_t>(dlc, 8));
+
+    // words[0] = Intel (little-endian), words[1] = Motorola (big-endian)
+    uint64_t words[2] = {0, 0};
+    for (int i = 7; i >= 0; --i) {
+        words[0] = (words[0] << 8) | bytes[i];
+        words[1] = (words[1] << 8) | bytes[7 - i];
+    }
+
+    const DbcSignal* sigs = g_dbc.signals.data() + msg.first_signal;
+    double* values = g_dbc.values.data();
+    uint8_t* present = g_dbc.present.data();
+
+    int64_t mux = -1;
+    if (msg.mux_signal >= 0) {
+        const DbcSignal& m = sigs[msg.mux_signal];
+        mux = static_cast<int64_t>((words[m.motorola] >> m.shift) & m.mask);
+    }
+
+    for (uint32_t i = 0; i < msg.signal_count; ++i) {
+        const DbcSignal& s = sigs[i];
+        uint64_t raw = (words[s.motorola] >> s.shift) & s.mask;
+        // Sign-extend; a no-op for unsigned signals where sign_bit is 0
+        int64_t v = static_cast<int64_t>((raw ^ s.sign_bit) - s.sign_bit);
+        values[i] = static_cast<double>(v) * s.factor + s.offset;
+        present[i] = (s.mux_value < 0) | (s.mux_value == mux);
+    }
+    return msg.signal_count;
+}
+
+std::string dbc_format(const DbcMessage& msg, const uint8_t* data, size_t dlc)
+{
+    size_t n = dbc_decode(msg, data, dlc);
+    size_t msg_idx = static_cast<size_t>(&msg - g_dbc.messages.data());
+
+    std::string out = g_dbc.message_names[msg_idx];
+    out += ':';
+    char val_buf[48];
+    bool first = true;
+    for (size_t i = 0; i < n; ++i) {
+        if (!g_dbc.present[i]) continue;
+        size_t s = msg.first_signal + i;
+        out += first ? " " : ", ";
+        first = false;
+        out += g_dbc.signal_names[s];
+        std::snprintf(val_buf, sizeof(val_buf), "=%.6g", g_dbc.values[i]);
+        out += val_buf;
+        if (!g_dbc.signal_units[s].empty()) {
+            out += ' ';
+            out += g_dbc.signal_units[s];
+        }
+    }
+    return out;
+}
+
+} // namespace adamcom
@@ -0,0 +1,357 @@
+/**
+ * @file generator.cpp
+ * @brief Payload generators: counters, rolling values, timestamps and checksums computed per send
+ */
+
+#include "adamcom.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace adamcom {
+
+// Define the global generator state
+GeneratorState g_gen{};
+
+using Clock = std::chrono::steady_clock;
+
+// ============================================================================
+// Compilation
+// ============================================================================
+
+static const char* op_name(GenOpKind k)
+{
+    switch (k) {
+    case GenOpKind::COUNTER:   return "counter";
+    case GenOpKind::ROLLING:   return "rolling";
+    case GenOpKind::INC16:     return "inc16";
+    case GenOpKind::RANDOM:    return "random";
+    case GenOpKind::TIMESTAMP: return "timestamp";
+    case GenOpKind::CHECKSUM:  return "checksum";
+    }
+    return "?";
+}
+
+static bool parse_byte_index(const std::string& s, unsigned& out)
+{
+    try {
+        size_t used = 0;
+        unsigned long v = std::stoul(s, &used, 0);
+        if (used != s.size() || v > 255) return false;
+        out = static_cast<unsigned>(v);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+/// "counter B", "rolling B [hi]", "inc16 B [STEP]", "random B", "timestamp B [16|32]",
+/// "ALGO B [FROM-TO]" with any checksum name (crc8, crc16-ccitt, xor, ...)
+static bool parse_op(const std::string& text, size_t len, GenOp& op, std::string& error)
+{
+    std::istringstream in(text);
+    std::string kind, pos_str, arg;
+    in >> kind >> pos_str >> arg;
+    for (char& c : kind) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+    unsigned pos = 0;
+    if (!parse_byte_index(pos_str, pos)) {
+        error = "'" + text + "': missing or invalid byte index";
+        return false;
+    }
+    op.pos = static_cast<uint8_t>(pos);
+    size_t span = 1;
+
+    if (kind == "counter") {
+        op.kind = GenOpKind::COUNTER;
+    } else if (kind == "rolling") {
+        op.kind = GenOpKind::ROLLING;
+        op.high = (arg == "hi");
+        if (!arg.empty() && !op.high) {
+            error = "'" + text + "': expected 'hi' or nothing after the byte index";
+            return false;
+        }
+    } else if (kind == "inc16") {
+        op.kind = GenOpKind::INC16;
+        span = 2;
+        unsigned step = 1;
+        if (!arg.empty()) {
+            try { step = static_cast<unsigned>(std::stoul(arg, nullptr, 0)); } catch (...) { step = 0; }
+            if (step == 0 || step > 0xFFFF) {
+                error = "'" + text + "': step must be 1-65535";
+                return false;
+            }
+        }
+        op.step = static_cast<uint16_t>(step);
+    } else if (kind == "random") {
+        op.kind = GenOpKind::RANDOM;
+    } else if (kind == "timestamp" || kind == "ts") {
+        op.kind = GenOpKind::TIMESTAMP;
+        op.width = (arg == "16") ? 2 : 4;
+        if (!arg.empty() && arg != "16" && arg != "32") {
+            error = "'" + text + "': timestamp width is 16 or 32";
+            return false;
+        }
+        span = op.width;
+    } else if (checksum_parse(kind, op.algo)) {
+        op.kind = GenOpKind::CHECKSUM;
+        op.width = static_cast<uint8_t>(checksum_width(op.algo));
+        span = op.width;
+        op.from = 0;
+        op.to = static_cast<uint8_t>(len > 0 ? len - 1 : 0);
+        if (!arg.empty()) {
+            auto dash = arg.find('-');
+            unsigned from = 0, to = 0;
+            if (dash == std::string::npos || !parse_byte_index(arg.substr(0, dash), from) ||
+                !parse_byte_index(arg.substr(dash + 1), to) || from > to || to >= len) {
+                error = "'" + text + "': range must be FROM-TO within the payload";
+                return false;
+            }
+            op.from = static_cast<uint8_t>(from);
+            op.to = static_cast<uint8_t>(to);
+        } else if (op.pos == 0) {
+            op.from = op.width;
+        } else {
+            // Default coverage: every byte before the checksum
+            op.to = static_cast<uint8_t>(op.pos - 1);
+        }
+        if (op.pos <= op.to && op.pos + op.width > op.from) {
+            error = "'" + text + "': the checksum cannot be inside its own range";
+            return false;
+        }
+    } else {
+        error = "unknown field '" + kind + "' (counter, rolling, inc16, random, timestamp, or a checksum: crc8, "
+                "crc8-autosar, crc16-modbus, crc16-ccitt, crc32, crc32c, xor, sum8)";
+        return false;
+    }
+
+    if (op.pos + span > len) {
+        error = "'" + text + "': byte " + std::to_string(op.pos) + " is outside the " +
+                std::to_string(len) + "-byte payload";
+        return false;
+    }
+    return true;
+}
+
+/// Build the preset's frame the way send_preset would
+static bool build_frame(int preset, const Config& cfg, InterfaceType itype, PayloadGen& job, std::string& error)
+{
+    std::string prefix = "preset" + std::to_string(preset) + "_";
+    auto get = [&](const std::string& key) {
+        auto it = cfg.find(key);
+        return it != cfg.end() ? it->second : std::string();
+    };
+    std::string data_str = get(prefix + "data");
+    if (data_str.empty()) {
+        error = "preset " + std::to_string(preset) + " has no data";
+        return false;
+    }
+
+    job.is_can = (itype == InterfaceType::CAN);
+    job.text = !job.is_can && get(prefix + "format") == "text";
+    std::vector<uint8_t> data;
+    if (job.text) {
+        data.assign(data_str.begin(), data_str.end());
+    } else if (!parse_hex_bytes(data_str, data)) {
+        error = "preset " + std::to_string(preset) + " data is not valid hex";
+        return false;
+    }
+
+    if (job.is_can) {
+        if (data.size() > 8) {
+            error = "generators need a single CAN frame (8 data bytes at most)";
+            return false;
+        }
+        std::string id_str = get(prefix + "can_id");
+        if (id_str.empty()) id_str = get("can_id");
+        try {
+            job.can_id = static_cast<uint32_t>(std::stoul(id_str.empty() ? "0x123" : id_str, nullptr, 16));
+        } catch (...) {
+            error = "invalid CAN ID " + id_str;
+            return false;
+        }
+    }
+
+    job.len = data.size();
+    job.frame = std::move(data);
+    job.frame.resize(job.len + 2);    // CRLF for text presets
+    return true;
+}
+
+bool gen_compile(int preset, const std::string& spec, const Config& cfg, InterfaceType itype, std::string& error)
+{
+    if (preset < 1 || preset > 10) {
+        error = "preset must be 1-10";
+        return false;
+    }
+    PayloadGen& slot = g_gen.presets[static_cast<size_t>(preset - 1)];
+    if (spec.empty() || spec == "off" || spec == "none") {
+        slot = PayloadGen{};
+        return true;
+    }
+
+    PayloadGen job;
+    if (!build_frame(preset, cfg, itype, job, error)) return false;
+
+    std::string field;
+    std::istringstream in(spec);
+    while (std::getline(in, field, ';')) {
+        auto b = field.find_first_not_of(" \t");
+        if (b == std::string::npos) continue;
+        field = field.substr(b, field.find_last_not_of(" \t") - b + 1);
+        GenOp op;
+        if (!parse_op(field, job.len, op, error)) return false;
+        job.ops.push_back(op);
+    }
+    if (job.ops.empty()) {
+        error = "no fields";
+        return false;
+    }
+    // Checksums cover the other generated fields, so they go last
+    std::stable_partition(job.ops.begin(), job.ops.end(),
+                          [](const GenOp& op) { return op.kind != GenOpKind::CHECKSUM; });
+
+    // Counters start from the preset's own bytes
+    for (auto& op : job.ops) {
+        const uint8_t* f = job.frame.data();
+        if (op.kind == GenOpKind::COUNTER) {
+            op.value = f[op.pos];
+        } else if (op.kind == GenOpKind::ROLLING) {
+            op.value = op.high ? (f[op.pos] >> 4) : (f[op.pos] & 0x0F);
+        } else if (op.kind == GenOpKind::INC16) {
+            op.value = static_cast<uint32_t>((f[op.pos] << 8) | f[op.pos + 1]);
+        }
+    }
+
+    job.active = true;
+    job.spec = spec;
+    job.epoch = Clock::now();
+    job.rng = static_cast<uint32_t>(job.epoch.time_since_epoch().count()) | 1u;
+    auto it = cfg.find("preset" + std::to_string(preset) + "_name");
+    job.label = "TX[Preset " + std::to_string(preset) + " (" + (it != cfg.end() ? it->second : "") + ")]";
+    slot = std::move(job);
+    return true;
+}
+
+void gen_configure(const Config& cfg, InterfaceType itype)
+{
+    for (int i = 1; i <= 10; ++i) {
+        auto it = cfg.find("preset" + std::to_string(i) + "_gen");
+        std::string spec = (it != cfg.end()) ? it->second : "";
+        std::string error;
+        if (!gen_compile(i, spec, cfg, itype, error)) {
+            g_gen.presets[static_cast<size_t>(i - 1)] = PayloadGen{};
+            std::fprintf(stderr, "Preset %d generator: %s\n", i, error.c_str());
+        }
+    }
+}
+
+// ============================================================================
+// Send Path
+// ============================================================================
+
+PayloadGen* gen_job(int preset)
+{
+    if (preset < 1 || preset > 10) return nullptr;
+    PayloadGen& job = g_gen.presets[static_cast<size_t>(preset - 1)];
+    return job.active ? &job : nullptr;
+}
+
+static void apply_ops(PayloadGen& job)
+{
+    uint8_t* f = job.frame.data();
+    for (auto& op : job.ops) {
+        switch (op.kind) {
+        case GenOpKind::COUNTER:
+            f[op.pos] = static_cast<uint8_t>(op.value++);
+            break;
+        case GenOpKind::ROLLING: {
+            auto v = static_cast<uint8_t>(op.value++ & 0x0F);
+            f[op.pos] = op.high ? static_cast<uint8_t>((f[op.pos] & 0x0F) | (v << 4))
+                                : static_cast<uint8_t>((f[op.pos] & 0xF0) | v);
+            break;
+        }
+        case GenOpKind::INC16:
+            f[op.pos] = static_cast<uint8_t>(op.value >> 8);
+            f[op.pos + 1] = static_cast<uint8_t>(op.value);
+            op.value = (op.value + op.step) & 0xFFFF;
+            break;
+        case GenOpKind::RANDOM:
+            job.rng ^= job.rng << 13;
+            job.rng ^= job.rng >> 17;
+            job.rng ^= job.rng << 5;
+            f[op.pos] = static_cast<uint8_t>(job.rng);
+            break;
+        case GenOpKind::TIMESTAMP: {
+            auto ms = static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - job.epoch).count());
+            for (int i = op.width - 1; i >= 0; --i) {
+                f[op.pos + i] = static_cast<uint8_t>(ms);
+                ms >>= 8;
+            }
+            break;
+        }
+        case GenOpKind::CHECKSUM:
+            checksum_store(op.algo, checksum(op.algo, f + op.from, static_cast<size_t>(op.to - op.from + 1)),
+                           f + op.pos);
+            break;
+        }
+    }
+}
+
+bool gen_send(int fd, PayloadGen& job, bool append_crlf)
+{
+    apply_ops(job);
+    ++job.sends;
+    if (job.is_can) {
+        return send_can_payload(fd, job.can_id, job.frame.data(), job.len);
+    }
+    if (!job.text) {
+        return send_serial_payload(fd, job.frame.data(), job.len);
+    }
+    size_t len = job.len;
+    if (append_crlf) {
+        job.frame[len++] = '\r';
+        job.frame[len++] = '\n';
+    }
+    return send_serial_bytes(fd, job.frame.data(), len);
+}
+
+void gen_print(InterfaceType itype)
+{
+    bool any = false;
+    for (size_t i = 0; i < g_gen.presets.size(); ++i) {
+        const PayloadGen& job = g_gen.presets[i];
+        if (!job.active) continue;
+        if (!any) std::printf("\r\nPayload generators:\n");
+        any = true;
+        std::printf("  Preset %-2zu ", i + 1);
+        if (itype == InterfaceType::CAN) std::printf("ID 0x%03X ", job.can_id);
+        std::printf("%llu sends, last:", static_cast<unsigned long long>(job.sends));
+        for (size_t b = 0; b < job.len && b < 16; ++b) std::printf(" %02X", job.frame[b]);
+        if (job.len > 16) std::printf(" ...");
+        std::printf("\n");
+        for (const auto& op : job.ops) {
+            bool sum = (op.kind == GenOpKind::CHECKSUM);
+            std::printf("    %-12s byte %u", sum ? checksum_name(op.algo) : op_name(op.kind), op.pos);
+            switch (op.kind) {
+            case GenOpKind::ROLLING:   std::printf(" (%s nibble)", op.high ? "high" : "low"); break;
+            case GenOpKind::INC16:     std::printf("-%u, step %u", op.pos + 1, op.step); break;
+            case GenOpKind::TIMESTAMP: std::printf("-%u, ms", op.pos + op.width - 1); break;
+            case GenOpKind::CHECKSUM:
+                if (op.width > 1) std::printf("-%u", op.pos + op.width - 1);
+                std::printf(", over %u-%u", op.from, op.to);
+                break;
+            default: break;
+            }
+            std::printf("\n");
+        }
+    }
+    if (!any) {
+        std::printf("\r\nNo payload generators (/gen N FIELDS, e.g. /gen 1 rolling 6; crc8 7)\n");
+    }
+    std::printf("\n");
+}
+
+} // namespace adamcom
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <cerrno>
 #include <cstring>
 #include <cctype>
 #include <cstdlib>
@@ -58,65 +59,75 @@ bool parse_hex_bytes(const std::string& input, std::vector<uint8_t>& out)
     return true;
 }
 
-bool send_serial_bytes(int fd, const std::vector<uint8_t>& data)
+void serial_tx_written(const uint8_t* data, size_t len)
 {
-    if (data.empty()) return true;
-    ssize_t written = write(fd, data.data(), data.size());
-    return written == static_cast<ssize_t>(data.size());
-}
-
-bool send_serial_text(int fd, const std::string& text, bool append_crlf)
-{
-    std::string msg = text;
-    if (append_crlf) {
-        msg += "\r\n";
+    metric_add(Metric::TX_BYTES, len);
+    output_serial(OutputDir::TX, data, len);
+    shm_serial(OutputDir::TX, data, len);
+    busload_serial(true, len);
+    if (g_modbus.enabled) {
+        modbus_feed(OutputDir::TX, data, len, std::chrono::steady_clock::now());
     }
-    ssize_t written = write(fd, msg.c_str(), msg.size());
-    return written == static_cast<ssize_t>(msg.size());
 }
 
-int configure_can_interface(const std::string& ifname, const std::string& bitrate)
+/// Write now if nothing is queued; whatever the port does not take waits for POLLOUT
+static bool serial_send(int fd, const uint8_t* data, size_t len)
 {
-    // Validate interface name to prevent command injection
-    for (char c : ifname) {
-        if (!std::isalnum(static_cast<unsigned char>(c))) {
-            std::cerr << "Invalid CAN interface name\n";
-            return -1;
+    size_t done = 0;
+    if (txq_depth() == 0) {
+        ssize_t written;
+        {
+            ADAMCOM_PERF(DEVICE_WRITE);
+            TraceScope tx_trace(TraceKind::TX, static_cast<uint32_t>(len));
+            written = write(fd, data, len);
         }
-    }
-
-    // Validate bitrate is numeric
-    for (char c : bitrate) {
-        if (!std::isdigit(static_cast<unsigned char>(c))) {
-            std::cerr << "Invalid CAN bitrate\n";
-            return -1;
+        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            metric_add(Metric::TX_ERRORS);
+            reconnect_note_error(errno);
+            return false;
         }
+        if (written > 0) {
+            done = static_cast<size_t>(written);
+            serial_tx_written(data, done);
+        }
+        if (done < len) {
+            ++g_txq.stalls;
+        }
+    }
+    if (done < len && !txq_push(data + done, len - done)) {
+        metric_add(Metric::TX_ERRORS);
+        return false;
     }
+    metric_add(Metric::TX_FRAMES);
+    return true;
+}
 
-    // Bring interface down (ignore failure - might not be up)
-    std::string cmd = "sudo ip link set " + ifname + " down 2>/dev/null";
-    [[maybe_unused]] int rc = std::system(cmd.c_str());
+bool send_serial_bytes(int fd, const std::vector<uint8_t>& data)
+{
+    if (data.empty()) return true;
+    return serial_send(fd, data.data(), data.size());
+}
 
-    // Set bitrate
-    cmd = "sudo ip link set " + ifname + " type can bitrate " + bitrate;
-    if (std::system(cmd.c_str()) != 0) {
-        std::cerr << "Failed to set CAN bitrate (may need sudo)\n";
-        return -1;
-    }
+bool send_serial_bytes(int fd, const uint8_t* data, size_t len)
+{
+    if (len == 0) return true;
+    return serial_send(fd, data, len);
+}
 
-    // Bring interface up
-    cmd = "sudo ip link set " + ifname + " up";
-    if (std::system(cmd.c_str()) != 0) {
-        std::cerr << "Failed to bring up CAN interface\n";
-        return -1;
+bool send_serial_text(int fd, const std::string& text, bool append_crlf)
+{
+    std::string msg = text;
+    if (append_crlf) {
+        msg += "\r\n";
     }
-
-    return 0;
+    return serial_send(fd, reinterpret_cast<const uint8_t*>(msg.data()), msg.size());
 }
 
 int setup_can(const std::string& ifname, const std::string& filter_str)
 {
-    int sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    // Non-blocking: a full send buffer must return EAGAIN (parked, flushed on POLLOUT)
+    // instead of stalling the event loop, serve clients and timers in write()
+    int sock = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
     if (sock < 0) {
         perror("CAN socket");
         return -1;
@@ -142,6 +153,24 @@ int setup_can(const std::string& ifname, const std::string& filter_str)
         return -1;
     }
 
+    // Kernel drop counter with every frame; a larger receive queue to make drops rarer
+    int on = 1;
+    g_canrx.ovfl = setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) == 0;
+    g_canrx.kernel_drops = 0;
+    g_canrx.forced = false;
+    if (g_canrx.rcvbuf_kb > 0) {
+        int want = static_cast<int>(std::min<size_t>(g_canrx.rcvbuf_kb, 1024 * 1024) * 1024);
+        // FORCE ignores net.core.rmem_max but needs CAP_NET_ADMIN; plain SO_RCVBUF is capped
+        g_canrx.forced = setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &want, sizeof(want)) == 0;
+        if (!g_canrx.forced) {
+            setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &want, sizeof(want));
+        }
+    }
+    socklen_t optlen = sizeof(g_canrx.rcvbuf);
+    if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &g_canrx.rcvbuf, &optlen) < 0) {
+        g_canrx.rcvbuf = 0;
+    }
+
     // Apply filter if specified
     if (!filter_str.empty() && filter_str != "none") {
         auto pos = filter_str.find(':');
@@ -160,15 +189,154 @@ int setup_can(const std::string& ifname, const std::string& filter_str)
     return sock;
 }
 
+// Define the global CAN receive state
+CanRxState g_canrx{};
+
+void can_rx_configure(const Config& cfg)
+{
+    auto it = cfg.find("can_rcvbuf_kb");
+    g_canrx.rcvbuf_kb = 0;
+    if (it != cfg.end()) {
+        try { g_canrx.rcvbuf_kb = std::stoul(it->second); } catch (...) {}
+    }
+}
+
+/// New kernel drops: counted, noted in the capture file, and printed at most once a second
+static void can_rx_dropped(uint32_t n)
+{
+    auto& g = g_canrx;
+    g.dropped += n;
+    g.unreported += n;
+    metric_add(Metric::RX_OVERFLOW, n);
+    output_drop(n, g.dropped);
+    shm_drop(n, g.dropped);
+    capture_note("rx overflow: " + std::to_string(n) + " frames dropped by the kernel (" +
+                 std::to_string(g.dropped) + " total)");
+    auto now = std::chrono::steady_clock::now();
+    if (now - g.last_warn >= std::chrono::seconds(1)) {
+        g.last_warn = now;
+        print_message_above("--- RX OVERFLOW: " + std::to_string(g.unreported) + " frames dropped by the kernel (" +
+                            std::to_string(g.dropped) + " total, rcvbuf " + std::to_string(g.rcvbuf / 1024) +
+                            " KB; raise can_rcvbuf_kb) ---");
+        g.unreported = 0;
+    }
+}
+
+ssize_t can_read_frame(int fd, struct can_frame& frame)
+{
+    struct iovec iov = {&frame, sizeof(frame)};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint32_t))];
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    // Non-blocking socket: nothing queued after all (POLLERR, or another reader took it)
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    if (n <= 0) return n;
+    // The cmsg only appears once the socket has dropped something; it carries the running total
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t total;
+            std::memcpy(&total, CMSG_DATA(c), sizeof(total));
+            if (total != g_canrx.kernel_drops) {
+                can_rx_dropped(total - g_canrx.kernel_drops);
+                g_canrx.kernel_drops = total;
+            }
+        }
+    }
+    return n;
+}
+
 bool send_can_bytes(int fd, uint32_t can_id, const std::vector<uint8_t>& data)
+{
+    return send_can_bytes(fd, can_id, data.data(), data.size());
+}
+
+static struct can_frame make_can_frame(uint32_t can_id, const uint8_t* data, size_t len)
 {
     struct can_frame frame{};
     frame.can_id = can_id;
-    frame.can_dlc = static_cast<uint8_t>(std::min<size_t>(data.size(), 8));
-    std::memcpy(frame.data, data.data(), frame.can_dlc);
+    if ((can_id & CAN_EFF_FLAG) == 0 && (can_id & CAN_EFF_MASK) > CAN_SFF_MASK) {
+        // IDs beyond 11 bits only exist as extended frames
+        frame.can_id |= CAN_EFF_FLAG;
+    }
+    frame.can_dlc = static_cast<uint8_t>(std::min<size_t>(len, 8));
+    if (frame.can_dlc > 0) {
+        std::memcpy(frame.data, data, frame.can_dlc);
+    }
+    return frame;
+}
+
+static bool can_write(int fd, const struct can_frame& frame)
+{
+    ADAMCOM_PERF(DEVICE_WRITE);
+    TraceScope tx_trace(TraceKind::TX, frame.can_dlc);
+    return write(fd, &frame, sizeof(frame)) == sizeof(frame);
+}
+
+void can_tx_written(uint32_t can_id, const uint8_t* data, uint8_t dlc)
+{
+    metric_add(Metric::TX_FRAMES);
+    metric_add(Metric::TX_BYTES, dlc);
+    output_can(OutputDir::TX, can_id, data, dlc);
+    shm_can(OutputDir::TX, can_id, data, dlc);
+    busload_can(can_id, data, dlc);
+}
 
-    ssize_t written = write(fd, &frame, sizeof(frame));
-    return written == sizeof(frame);
+bool send_can_paced(int fd, uint32_t can_id, const uint8_t* data, size_t len)
+{
+    // Frames parked earlier go first so this one cannot overtake them on the bus
+    if (g_txq.can_count > 0 && std::chrono::steady_clock::now() >= g_txq.can_retry_at && !txq_flush_can(fd)) {
+        return false;
+    }
+    if (g_txq.can_count > 0) {
+        errno = g_txq.can_nobufs ? ENOBUFS : EAGAIN;
+        return false;
+    }
+    struct can_frame frame = make_can_frame(can_id, data, len);
+    if (!can_write(fd, frame)) {
+        int err = errno;
+        if (err == ENOBUFS || err == EAGAIN || err == EWOULDBLOCK) {
+            txq_can_refused(err);
+        } else {
+            metric_add(Metric::TX_ERRORS);
+            reconnect_note_error(err);
+        }
+        errno = err;
+        return false;
+    }
+    can_tx_written(frame.can_id, frame.data, frame.can_dlc);
+    return true;
+}
+
+/// Write now if nothing is parked; a full driver queue parks the frame until it drains
+bool send_can_bytes(int fd, uint32_t can_id, const uint8_t* data, size_t len)
+{
+    struct can_frame frame = make_can_frame(can_id, data, len);
+    if (g_txq.can_count == 0) {
+        if (can_write(fd, frame)) {
+            can_tx_written(frame.can_id, frame.data, frame.can_dlc);
+            return true;
+        }
+        if (errno != ENOBUFS && errno != EAGAIN && errno != EWOULDBLOCK) {
+            metric_add(Metric::TX_ERRORS);
+            reconnect_note_error(errno);
+            return false;
+        }
+        txq_can_refused(errno);
+    }
+    if (!txq_can_push(frame.can_id, frame.data, frame.can_dlc)) {
+        metric_add(Metric::TX_ERRORS);
+        errno = ENOBUFS;
+        return false;
+    }
+    return true;
 }
 
 bool send_preset(int fd, const Config& cfg, InterfaceType itype,
@@ -178,6 +346,11 @@ bool send_preset(int fd, const Config& cfg, InterfaceType itype,
         return false;
     }
 
+    // Presets with generated fields are pre-built; only the fields change per send
+    if (PayloadGen* job = gen_job(preset_index)) {
+        return gen_send(fd, *job, append_crlf);
+    }
+
     std::string prefix = "preset" + std::to_string(preset_index) + "_";
 
     auto get_cfg = [&](const std::string& key) -> std::string {
@@ -197,11 +370,9 @@ bool send_preset(int fd, const Config& cfg, InterfaceType itype,
         if (!parse_hex_bytes(data_str, data)) {
             return false;
         }
-        if (data.size() > 8) {
-            data.resize(8);
-        }
 
         std::string can_id_str = get_cfg("can_id");
+        bool own_id = !can_id_str.empty();
         if (can_id_str.empty()) {
             auto it = cfg.find("can_id");
             can_id_str = (it != cfg.end()) ? it->second : "0x123";
@@ -214,7 +385,16 @@ bool send_preset(int fd, const Config& cfg, InterfaceType itype,
             return false;
         }
 
-        return send_can_bytes(fd, can_id, data);
+        // Longer presets are segmented when ISO-TP is on, truncated otherwise
+        if (data.size() > 8) {
+            if (g_isotp.enabled) {
+                // Without an ID of its own the preset goes to the ISO-TP TX ID
+                return isotp_send(fd, own_id ? can_id : g_isotp.tx_id, data);
+            }
+            data.resize(8);
+        }
+
+        return send_can_payload(fd, can_id, data.data(), data.size());
     } else {
         // Serial mode
         if (format == "text") {
@@ -224,12 +404,12 @@ bool send_preset(int fd, const Config& cfg, InterfaceType itype,
             if (!parse_hex_bytes(data_str, data)) {
                 return false;
             }
-            return send_serial_bytes(fd, data);
+            return send_serial_payload(fd, data.data(), data.size());
         }
     }
 }
 
-int open_serial(const Config& cfg)
+int open_serial(const Config& cfg, unsigned int* applied_baud)
 {
     auto get = [&](const std::string& key, const std::string& def) -> std::string {
         auto it = cfg.find(key);
@@ -250,16 +430,23 @@ int open_serial(const Config& cfg)
         return -1;
     }
 
-    // Baud rate
+    // Baud rate: table rates go through termios, any other rate needs termios2 below
+    std::string baud_str = get("baud", "115200");
+    unsigned int baud = 0;
+    bool table_rate = false;
     try {
-        speed_t speed = static_cast<speed_t>(get_baud_speed_t(get("baud", "115200")));
-        cfsetispeed(&tty, speed);
-        cfsetospeed(&tty, speed);
-    } catch (const std::exception& e) {
-        std::cerr << "Invalid baud rate: " << e.what() << "\n";
+        baud = get_baud_numeric(baud_str);
+    } catch (const std::exception&) {
+        std::cerr << "Invalid baud rate: " << baud_str << "\n";
         close(fd);
         return -1;
     }
+    try {
+        speed_t speed = static_cast<speed_t>(get_baud_speed_t(baud_str));
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+        table_rate = true;
+    } catch (const std::exception&) {}
 
     // Data bits
     int databits = 8;
@@ -316,6 +503,29 @@ int open_serial(const Config& cfg)
         return -1;
     }
 
+    unsigned int applied = 0;
+    if (!serial_set_custom_baud(fd, baud, applied)) {
+        if (!table_rate) {
+            std::cerr << "Unsupported baud rate: " << baud_str
+                      << " (driver does not accept custom rates)\n";
+            close(fd);
+            return -1;
+        }
+        // Report what the port is actually set to, not what was asked for
+        struct termios now{};
+        if (tcgetattr(fd, &now) == 0) {
+            applied = get_baud_from_speed_t(static_cast<unsigned int>(cfgetospeed(&now)));
+        }
+        if (applied == 0) {
+            applied = baud;
+        }
+    }
+    if (applied_baud) {
+        *applied_baud = applied;
+    }
+
+    latency_apply(fd, cfg);
+
     fcntl(fd, F_SETFL, FNDELAY);
     return fd;
 }
@@ -0,0 +1,460 @@
+/**
+ * @file isotp.cpp
+ * @brief ISO-TP (ISO 15765-2) segmentation, flow control and reassembly
+ */
+
+#include "adamcom.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <poll.h>
+#include <linux/can.h>
+
+namespace adamcom {
+
+// Define the global ISO-TP state
+IsoTpState g_isotp{};
+
+using Clock = std::chrono::steady_clock;
+
+// Protocol control information (upper nibble of byte 0)
+static constexpr uint8_t PCI_SF = 0x00;
+static constexpr uint8_t PCI_FF = 0x10;
+static constexpr uint8_t PCI_CF = 0x20;
+static constexpr uint8_t PCI_FC = 0x30;
+
+// Flow status
+static constexpr uint8_t FS_CTS = 0;
+static constexpr uint8_t FS_WAIT = 1;
+static constexpr uint8_t FS_OVFLW = 2;
+
+// Timeouts (N_Bs: waiting for flow control, N_Cr: waiting for consecutive frame)
+static constexpr auto N_BS = std::chrono::milliseconds(1000);
+static constexpr auto N_CR = std::chrono::milliseconds(1000);
+static constexpr int MAX_WAIT_FRAMES = 10;
+
+// Largest payload announced by a classic 12-bit first frame
+static constexpr size_t FF_DL_12BIT_MAX = 4095;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+/// Decode an STmin byte into a duration (reserved values map to the 127 ms maximum)
+static std::chrono::microseconds decode_stmin(uint8_t st)
+{
+    if (st <= 0x7F) return std::chrono::milliseconds(st);
+    if (st >= 0xF1 && st <= 0xF9) return std::chrono::microseconds((st - 0xF0) * 100);
+    return std::chrono::milliseconds(0x7F);
+}
+
+static double rate_bps(size_t bytes, Clock::duration elapsed)
+{
+    double secs = std::chrono::duration<double>(elapsed).count();
+    return secs > 0.0 ? static_cast<double>(bytes) / secs : 0.0;
+}
+
+static double elapsed_ms(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+/// Send one ISO-TP frame, padding to 8 bytes when padding is enabled. Paced frames are
+/// never parked: a refusal comes back to the caller so STmin spacing survives a full queue.
+static bool send_frame(int fd, uint32_t can_id, const uint8_t* data, size_t len, bool paced = false)
+{
+    uint8_t frame[8];
+    std::memcpy(frame, data, len);
+    if (g_isotp.padding) {
+        std::memset(frame + len, g_isotp.pad_byte, 8 - len);
+        len = 8;
+    }
+    return paced ? send_can_paced(fd, can_id, frame, len) : send_can_bytes(fd, can_id, frame, len);
+}
+
+static bool send_flow_control(int fd, uint8_t status)
+{
+    uint8_t fc[3] = {static_cast<uint8_t>(PCI_FC | status), g_isotp.block_size, g_isotp.st_min};
+    return send_frame(fd, g_isotp.tx_id, fc, sizeof(fc));
+}
+
+static void tx_finish(const char* reason)
+{
+    IsoTpTxSession& tx = g_isotp.tx;
+    char line[160];
+    if (reason) {
+        ++g_isotp.tx_errors;
+        std::snprintf(line, sizeof(line), "ISO-TP TX[ID:0x%03X] aborted after %zu/%zu bytes: %s",
+                      tx.can_id, tx.offset, tx.data.size(), reason);
+    } else {
+        auto elapsed = Clock::now() - tx.started;
+        ++g_isotp.tx_messages;
+        g_isotp.last_tx_rate = rate_bps(tx.data.size(), elapsed);
+        std::snprintf(line, sizeof(line), "ISO-TP TX[ID:0x%03X %zu bytes] complete in %.2f ms (%.0f B/s)",
+                      tx.can_id, tx.data.size(), elapsed_ms(elapsed), g_isotp.last_tx_rate);
+    }
+    tx.phase = IsoTpTxPhase::IDLE;
+    print_message_above(line);
+}
+
+static void rx_finish()
+{
+    IsoTpRxSession& rx = g_isotp.rx;
+    auto elapsed = Clock::now() - rx.started;
+    ++g_isotp.rx_messages;
+    g_isotp.last_rx_rate = rate_bps(rx.data.size(), elapsed);
+
+    char head[128];
+    std::snprintf(head, sizeof(head), "ISO-TP RX[ID:0x%03X %zu bytes, %.2f ms, %.0f B/s]: ",
+                  g_isotp.rx_id, rx.data.size(), elapsed_ms(elapsed), g_isotp.last_rx_rate);
+    std::string msg = head;
+    char hex_buf[8];
+    for (uint8_t b : rx.data) {
+        std::snprintf(hex_buf, sizeof(hex_buf), "%02X ", b);
+        msg += hex_buf;
+    }
+    rx.active = false;
+    print_message_above(msg);
+}
+
+static void rx_single(const uint8_t* data, size_t dlc)
+{
+    size_t len = data[0] & 0x0F;
+    size_t off = 1;
+    if (len == 0 && dlc > 2) {
+        // CAN FD style escape: length in byte 1
+        len = data[1];
+        off = 2;
+    }
+    if (len == 0 || off + len > dlc) return;
+
+    IsoTpRxSession& rx = g_isotp.rx;
+    if (rx.active) {
+        ++g_isotp.rx_errors;
+        print_message_above("ISO-TP RX: single frame interrupted reception in progress");
+    }
+    rx.data.assign(data + off, data + off + len);
+    rx.started = Clock::now();
+    rx_finish();
+}
+
+static void rx_first(int fd, const uint8_t* data, size_t dlc)
+{
+    if (dlc < 8) return;   // First frames always use the full classic CAN payload
+
+    size_t len = static_cast<size_t>(((data[0] & 0x0F) << 8) | data[1]);
+    size_t off = 2;
+    if (len == 0) {
+        len = (static_cast<size_t>(data[2]) << 24) | (static_cast<size_t>(data[3]) << 16) |
+              (static_cast<size_t>(data[4]) << 8) | data[5];
+        off = 6;
+    }
+    if (len <= 7) return;   // Would have fit a single frame: malformed
+
+    IsoTpRxSession& rx = g_isotp.rx;
+    if (rx.active) {
+        ++g_isotp.rx_errors;
+        print_message_above("ISO-TP RX: first frame interrupted reception in progress");
+    }
+
+    if (len > g_isotp.max_rx_len) {
+        send_flow_control(fd, FS_OVFLW);
+        ++g_isotp.rx_errors;
+        print_message_above("ISO-TP RX: announced length " + std::to_string(len) +
+                            " exceeds limit, sent overflow");
+        rx.active = false;
+        return;
+    }
+
+    rx.active = true;
+    rx.expected = len;
+    rx.data.clear();
+    rx.data.reserve(len);
+    rx.data.insert(rx.data.end(), data + off, data + 8);
+    rx.next_sn = 1;
+    rx.block_count = 0;
+    rx.started = Clock::now();
+    rx.deadline = rx.started + N_CR;
+    send_flow_control(fd, FS_CTS);
+}
+
+static void rx_consecutive(int fd, const uint8_t* data, size_t dlc)
+{
+    IsoTpRxSession& rx = g_isotp.rx;
+    if (!rx.active) return;
+
+    uint8_t sn = data[0] & 0x0F;
+    if (sn != rx.next_sn) {
+        ++g_isotp.rx_errors;
+        print_message_above("ISO-TP RX: sequence error (expected " + std::to_string(rx.next_sn) +
+                            ", got " + std::to_string(sn) + "), message dropped");
+        rx.active = false;
+        return;
+    }
+    rx.next_sn = static_cast<uint8_t>((rx.next_sn + 1) & 0x0F);
+
+    size_t take = std::min(dlc - 1, rx.expected - rx.data.size());
+    rx.data.insert(rx.data.end(), data + 1, data + 1 + take);
+    rx.deadline = Clock::now() + N_CR;
+
+    if (rx.data.size() >= rx.expected) {
+        rx_finish();
+        return;
+    }
+
+    // Grant the next block
+    if (g_isotp.block_size != 0 && ++rx.block_count >= g_isotp.block_size) {
+        rx.block_count = 0;
+        send_flow_control(fd, FS_CTS);
+    }
+}
+
+static void tx_flow_control(const uint8_t* data, size_t dlc)
+{
+    IsoTpTxSession& tx = g_isotp.tx;
+    if (tx.phase != IsoTpTxPhase::WAIT_FC || dlc < 3) return;
+
+    uint8_t status = data[0] & 0x0F;
+    if (status == FS_WAIT) {
+        if (++tx.wait_frames > MAX_WAIT_FRAMES) {
+            tx_finish("too many FC.WAIT frames");
+        } else {
+            tx.deadline = Clock::now() + N_BS;
+        }
+        return;
+    }
+    if (status == FS_OVFLW) {
+        tx_finish("receiver reported overflow");
+        return;
+    }
+    if (status != FS_CTS) {
+        tx_finish("invalid flow status");
+        return;
+    }
+
+    tx.block_size = data[1];
+    tx.block_left = data[1];
+    tx.st_min = decode_stmin(data[2]);
+    tx.wait_frames = 0;
+    tx.phase = IsoTpTxPhase::SENDING;
+    tx.next_cf = Clock::now();
+}
+
+/// Send consecutive frames that are due. Returns false if the socket refused one.
+static bool tx_pump(int fd)
+{
+    IsoTpTxSession& tx = g_isotp.tx;
+    // Bound the work per call so a no-STmin transfer does not starve the UI
+    for (int burst = 0; burst < 64 && tx.phase == IsoTpTxPhase::SENDING; ++burst) {
+        auto now = Clock::now();
+        if (now < tx.next_cf) return true;
+
+        uint8_t frame[8];
+        frame[0] = static_cast<uint8_t>(PCI_CF | tx.next_sn);
+        size_t take = std::min<size_t>(7, tx.data.size() - tx.offset);
+        std::memcpy(frame + 1, tx.data.data() + tx.offset, take);
+
+        if (!send_frame(fd, tx.can_id, frame, take + 1, true)) {
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Driver queue full or frames parked ahead: retry the same frame shortly
+                tx.next_cf = now + std::chrono::milliseconds(1);
+                return false;
+            }
+            tx_finish(std::strerror(errno));
+            return false;
+        }
+
+        tx.offset += take;
+        tx.next_sn = static_cast<uint8_t>((tx.next_sn + 1) & 0x0F);
+        if (tx.offset >= tx.data.size()) {
+            tx_finish(nullptr);
+            return true;
+        }
+
+        if (tx.block_size != 0 && --tx.block_left == 0) {
+            tx.phase = IsoTpTxPhase::WAIT_FC;
+            tx.deadline = now + N_BS;
+            return true;
+        }
+        tx.next_cf = now + tx.st_min;
+    }
+    return true;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void isotp_configure(const Config& cfg)
+{
+    auto get = [&](const std::string& key, const std::string& def) -> std::string {
+        auto it = cfg.find(key);
+        return (it != cfg.end()) ? it->second : def;
+    };
+
+    try { g_isotp.tx_id = static_cast<uint32_t>(std::stoul(get("isotp_tx_id", "0x7E0"), nullptr, 16)); } catch (...) {}
+    try { g_isotp.rx_id = static_cast<uint32_t>(std::stoul(get("isotp_rx_id", "0x7E8"), nullptr, 16)); } catch (...) {}
+    try { g_isotp.block_size = static_cast<uint8_t>(std::stoul(get("isotp_bs", "0"), nullptr, 0)); } catch (...) {}
+    try { g_isotp.st_min = static_cast<uint8_t>(std::stoul(get("isotp_stmin", "0"), nullptr, 0)); } catch (...) {}
+    try { g_isotp.pad_byte = static_cast<uint8_t>(std::stoul(get("isotp_pad_byte", "0xCC"), nullptr, 16)); } catch (...) {}
+    g_isotp.padding = (get("isotp_padding", "on") == "on");
+}
+
+bool isotp_send(int fd, uint32_t can_id, const std::vector<uint8_t>& payload)
+{
+    if (payload.empty()) return false;
+
+    IsoTpTxSession& tx = g_isotp.tx;
+    if (tx.phase != IsoTpTxPhase::IDLE) {
+        print_message_above("ISO-TP TX busy: previous transfer still in progress");
+        return false;
+    }
+
+    tx.can_id = can_id;
+    tx.started = Clock::now();
+
+    if (payload.size() <= 7) {
+        uint8_t frame[8];
+        frame[0] = static_cast<uint8_t>(PCI_SF | payload.size());
+        std::memcpy(frame + 1, payload.data(), payload.size());
+        bool ok = send_frame(fd, can_id, frame, payload.size() + 1);
+        if (ok) ++g_isotp.tx_messages;
+        return ok;
+    }
+
+    tx.data = payload;
+    uint8_t frame[8];
+    size_t header;
+    if (payload.size() <= FF_DL_12BIT_MAX) {
+        frame[0] = static_cast<uint8_t>(PCI_FF | ((payload.size() >> 8) & 0x0F));
+        frame[1] = static_cast<uint8_t>(payload.size() & 0xFF);
+        header = 2;
+    } else {
+        // Escape sequence: FF_DL = 0 followed by a 32-bit length
+        uint32_t len = static_cast<uint32_t>(payload.size());
+        frame[0] = PCI_FF;
+        frame[1] = 0;
+        frame[2] = static_cast<uint8_t>(len >> 24);
+        frame[3] = static_cast<uint8_t>(len >> 16);
+        frame[4] = static_cast<uint8_t>(len >> 8);
+        frame[5] = static_cast<uint8_t>(len);
+        header = 6;
+    }
+    std::memcpy(frame + header, payload.data(), 8 - header);
+
+    if (!send_can_bytes(fd, can_id, frame, 8)) {
+        return false;
+    }
+
+    tx.offset = 8 - header;
+    tx.next_sn = 1;
+    tx.wait_frames = 0;
+    tx.phase = IsoTpTxPhase::WAIT_FC;
+    tx.deadline = Clock::now() + N_BS;
+    return true;
+}
+
+bool isotp_handle_rx(int fd, uint32_t can_id, const uint8_t* data, size_t dlc)
+{
+    if (can_id != g_isotp.rx_id || dlc == 0) {
+        return false;
+    }
+
+    switch (data[0] & 0xF0) {
+        case PCI_SF: rx_single(data, dlc); break;
+        case PCI_FF: rx_first(fd, data, dlc); break;
+        case PCI_CF: rx_consecutive(fd, data, dlc); break;
+        case PCI_FC:
+            tx_flow_control(data, dlc);
+            if (g_isotp.tx.phase == IsoTpTxPhase::SENDING) tx_pump(fd);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+void isotp_poll(int fd, Clock::time_point now)
+{
+    IsoTpTxSession& tx = g_isotp.tx;
+    if (tx.phase == IsoTpTxPhase::WAIT_FC && now > tx.deadline) {
+        tx_finish("timeout waiting for flow control (N_Bs)");
+    } else if (tx.phase == IsoTpTxPhase::SENDING) {
+        tx_pump(fd);
+    }
+
+    IsoTpRxSession& rx = g_isotp.rx;
+    if (rx.active && now > rx.deadline) {
+        ++g_isotp.rx_errors;
+        rx.active = false;
+        print_message_above("ISO-TP RX: timeout waiting for consecutive frame (N_Cr), " +
+                            std::to_string(rx.data.size()) + "/" + std::to_string(rx.expected) +
+                            " bytes received");
+    }
+}
+
+Clock::time_point isotp_next_deadline()
+{
+    // Returned as an absolute deadline so the main loop's timerfd paces sub-millisecond
+    // STmin gaps; a millisecond poll() timeout would round them to zero and spin
+    auto next = Clock::time_point::max();
+    const IsoTpTxSession& tx = g_isotp.tx;
+    if (tx.phase == IsoTpTxPhase::SENDING) next = std::min(next, tx.next_cf);
+    if (tx.phase == IsoTpTxPhase::WAIT_FC) next = std::min(next, tx.deadline);
+    if (g_isotp.rx.active) next = std::min(next, g_isotp.rx.deadline);
+    return next;
+}
+
+bool isotp_wait_tx(int fd)
+{
+    uint64_t errors = g_isotp.tx_errors;
+    while (g_isotp.tx.phase != IsoTpTxPhase::IDLE) {
+        isotp_poll(fd, Clock::now());
+        if (g_isotp.tx.phase == IsoTpTxPhase::IDLE) break;
+
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(isotp_next_deadline() - Clock::now()).count();
+        int timeout_ms = (us <= 0) ? 0 : static_cast<int>((us + 999) / 1000);
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout_ms) <= 0) continue;
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) return false;
+
+        // Only flow control matters here; everything else on the bus is ignored
+        struct can_frame frame{};
+        if (can_read_frame(fd, frame) >= static_cast<ssize_t>(sizeof(frame))) {
+            bool is_ext = (frame.can_id & CAN_EFF_FLAG) != 0;
+            uint32_t id = frame.can_id & (is_ext ? CAN_EFF_MASK : CAN_SFF_MASK);
+            isotp_handle_rx(fd, id, frame.data, frame.can_dlc);
+        }
+    }
+    return g_isotp.tx_errors == errors;
+}
+
+void isotp_print_status()
+{
+    std::printf("\r\nISO-TP: %s\n", g_isotp.enabled ? "on" : "off");
+    std::printf("  TX ID 0x%03X, RX ID 0x%03X\n", g_isotp.tx_id, g_isotp.rx_id);
+    std::printf("  Our flow control: BS %u, STmin 0x%02X\n", g_isotp.block_size, g_isotp.st_min);
+    if (g_isotp.padding) {
+        std::printf("  Padding: on (0x%02X)\n", g_isotp.pad_byte);
+    } else {
+        std::printf("  Padding: off (minimal DLC)\n");
+    }
+
+    const IsoTpTxSession& tx = g_isotp.tx;
+    if (tx.phase != IsoTpTxPhase::IDLE) {
+        std::printf("  TX in progress: %zu/%zu bytes (%s)\n", tx.offset, tx.data.size(),
+                    tx.phase == IsoTpTxPhase::WAIT_FC ? "waiting for FC" : "sending");
+    }
+    if (g_isotp.rx.active) {
+        std::printf("  RX in progress: %zu/%zu bytes\n", g_isotp.rx.data.size(), g_isotp.rx.expected);
+    }
+    std::printf("  Messages: TX %llu (%llu errors, last %.0f B/s), RX %llu (%llu errors, last %.0f B/s)\n\n",
+                static_cast<unsigned long long>(g_isotp.tx_messages),
+                static_cast<unsigned long long>(g_isotp.tx_errors), g_isotp.last_tx_rate,
+                static_cast<unsigned long long>(g_isotp.rx_messages),
+                static_cast<unsigned long long>(g_isotp.rx_errors), g_isotp.last_rx_rate);
+}
+
+} // namespace adamcom
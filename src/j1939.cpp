@@ -0,0 +1,392 @@
+/**
+ * @file j1939.cpp
+ * @brief SAE J1939 ID decoding, transport protocol reassembly and PGN/SA statistics
+ */
+
+#include "adamcom.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global J1939 state
+J1939State g_j1939{};
+
+using Clock = std::chrono::steady_clock;
+
+// Transport protocol PGNs and TP.CM control bytes
+static constexpr uint32_t PGN_TP_CM = 0xEC00;
+static constexpr uint32_t PGN_TP_DT = 0xEB00;
+static constexpr uint8_t TP_CM_RTS = 16;
+static constexpr uint8_t TP_CM_CTS = 17;
+static constexpr uint8_t TP_CM_EOM_ACK = 19;
+static constexpr uint8_t TP_CM_BAM = 32;
+static constexpr uint8_t TP_CM_ABORT = 255;
+
+// Largest TP payload (255 packets x 7 bytes)
+static constexpr size_t TP_MAX_SIZE = 1785;
+
+// T1/T2/T3-style inactivity limit for an unfinished session
+static constexpr auto TP_TIMEOUT = std::chrono::milliseconds(1250);
+
+static constexpr uint32_t STATS_EMPTY = 0xFFFFFFFF;
+
+// ============================================================================
+// ID Decoding
+// ============================================================================
+
+J1939Id j1939_decode_id(uint32_t can_id)
+{
+    J1939Id id{};
+    id.priority = static_cast<uint8_t>((can_id >> 26) & 0x7);
+    id.sa = static_cast<uint8_t>(can_id & 0xFF);
+    uint8_t pf = static_cast<uint8_t>((can_id >> 16) & 0xFF);
+    uint8_t ps = static_cast<uint8_t>((can_id >> 8) & 0xFF);
+    uint32_t dp = (can_id >> 24) & 0x3;     // EDP + DP
+
+    if (pf < 240) {
+        // PDU1: PS is the destination address
+        id.pgn = (dp << 16) | (static_cast<uint32_t>(pf) << 8);
+        id.da = ps;
+    } else {
+        // PDU2: PS is the group extension, always broadcast
+        id.pgn = (dp << 16) | (static_cast<uint32_t>(pf) << 8) | ps;
+        id.da = 0xFF;
+    }
+    return id;
+}
+
+static const char* pgn_name(uint32_t pgn)
+{
+    switch (pgn) {
+        case 0xEA00:  return "Request";
+        case 0xE800:  return "Acknowledgment";
+        case 0xEE00:  return "Address Claimed";
+        case 0xEC00:  return "TP.CM";
+        case 0xEB00:  return "TP.DT";
+        case 0xF003:  return "EEC2";
+        case 0xF004:  return "EEC1";
+        case 0xFECA:  return "DM1";
+        case 0xFECB:  return "DM2";
+        case 0xFEDA:  return "Software ID";
+        case 0xFEE5:  return "Engine Hours";
+        case 0xFEE9:  return "Fuel Consumption";
+        case 0xFEEE:  return "Engine Temperature 1";
+        case 0xFEEF:  return "Engine Fluid Level/Pressure 1";
+        case 0xFEF1:  return "CCVS1";
+        case 0xFEF2:  return "Fuel Economy";
+        case 0xFEF5:  return "Ambient Conditions";
+        case 0xFEF6:  return "Inlet/Exhaust Conditions 1";
+        case 0xFEF7:  return "Vehicle Electrical Power 1";
+        case 0xFEFC:  return "Dash Display";
+        case 0xFEE0:  return "Vehicle Distance";
+        case 0xFEEC:  return "Vehicle Identification";
+        case 0xFDC5:  return "ECU Identification";
+        default:      return nullptr;
+    }
+}
+
+static void append_hex(std::string& out, const uint8_t* p, size_t n)
+{
+    char hex_buf[8];
+    for (size_t i = 0; i < n; ++i) {
+        std::snprintf(hex_buf, sizeof(hex_buf), "0x%02X ", p[i]);
+        out += hex_buf;
+    }
+}
+
+static std::string frame_header(const J1939Id& id, const char* kind, size_t len)
+{
+    char head[128];
+    const char* name = pgn_name(id.pgn);
+    std::snprintf(head, sizeof(head), "RX[J1939%s P:%u PGN:0x%05X%s%s%s SA:0x%02X DA:0x%02X %s:%zu]: ",
+                  kind, id.priority, id.pgn,
+                  name ? " (" : "", name ? name : "", name ? ")" : "",
+                  id.sa, id.da, *kind ? "LEN" : "DLC", len);
+    return head;
+}
+
+// ============================================================================
+// PGN/SA Statistics (open addressing, linear probing)
+// ============================================================================
+
+// Inserts stop at 75% load so every miss ends at an empty slot within a short run
+static constexpr size_t STATS_MAX_USED = J1939_STATS_CAPACITY / 4 * 3;
+// Keys are only ever placed within this many slots of their hash, so lookups stop here too
+static constexpr size_t STATS_MAX_PROBE = 64;
+// log2(J1939_STATS_CAPACITY): the index is the top STATS_BITS bits of the product
+static constexpr unsigned STATS_BITS = 12;
+static_assert((size_t{1} << STATS_BITS) == J1939_STATS_CAPACITY, "STATS_BITS must match the table size");
+
+static J1939Stat* stats_slot(uint32_t pgn, uint8_t sa)
+{
+    auto& table = g_j1939.stats;
+    if (table.empty()) {
+        table.resize(J1939_STATS_CAPACITY);
+        for (auto& e : table) e.key = STATS_EMPTY;
+    }
+
+    uint32_t key = (pgn << 8) | sa;
+    // Fibonacci hashing: multiply by 2^64/phi and keep the high bits, which depend on every
+    // key bit (the low bits of the product only see the low bits of the key)
+    size_t mask = table.size() - 1;
+    size_t idx = static_cast<size_t>((uint64_t{key} * 0x9E3779B97F4A7C15ull) >> (64 - STATS_BITS));
+    for (size_t probe = 0; probe < STATS_MAX_PROBE; ++probe) {
+        J1939Stat& e = table[idx];
+        if (e.key == key) return &e;
+        if (e.key == STATS_EMPTY) {
+            if (g_j1939.stats_used >= STATS_MAX_USED) return nullptr;   // Load limit reached
+            e.key = key;
+            ++g_j1939.stats_used;
+            return &e;
+        }
+        idx = (idx + 1) & mask;
+    }
+    return nullptr;   // Probe run too long: treat as full
+}
+
+static void record_stat(const J1939Id& id, const uint8_t* data, size_t len, Clock::time_point now)
+{
+    J1939Stat* st = stats_slot(id.pgn, id.sa);
+    if (!st) {
+        ++g_j1939.stats_dropped;
+        return;
+    }
+    if (st->count == 0) st->first_seen = now;
+    ++st->count;
+    st->last_seen = now;
+    st->last_da = id.da;
+    st->last_len = static_cast<uint16_t>(len);
+    std::memcpy(st->last_data.data(), data, std::min(len, st->last_data.size()));
+}
+
+// ============================================================================
+// Transport Protocol
+// ============================================================================
+
+static J1939TpSession* find_session(uint8_t sa, uint8_t da, bool create)
+{
+    J1939TpSession* free_slot = nullptr;
+    for (auto& s : g_j1939.sessions) {
+        if (s.active && s.sa == sa && s.da == da) return &s;
+        if (!s.active && !free_slot) free_slot = &s;
+    }
+    if (!create) return nullptr;
+    if (!free_slot) {
+        // Recycle the stalest session (counted as aborted by the caller)
+        free_slot = &*std::min_element(g_j1939.sessions.begin(), g_j1939.sessions.end(),
+            [](const J1939TpSession& a, const J1939TpSession& b) { return a.last_rx < b.last_rx; });
+    }
+    return free_slot;
+}
+
+static uint32_t cm_pgn(const uint8_t* d)
+{
+    return static_cast<uint32_t>(d[5]) | (static_cast<uint32_t>(d[6]) << 8) |
+           (static_cast<uint32_t>(d[7]) << 16);
+}
+
+static void tp_complete(J1939TpSession& s, Clock::time_point now)
+{
+    J1939Id id{};
+    id.priority = s.priority;
+    id.pgn = s.pgn;
+    id.sa = s.sa;
+    id.da = s.da;
+
+    ++g_j1939.tp_completed;
+    record_stat(id, s.data.data(), s.data.size(), now);
+
+    std::string msg = frame_header(id, s.bam ? " BAM" : " RTS/CTS", s.data.size());
+    append_hex(msg, s.data.data(), s.data.size());
+    s.active = false;
+    if (g_j1939.show_frames || g_j1939.show_tp) {
+        print_message_above(msg);
+    }
+}
+
+static void tp_connection_management(const J1939Id& id, const uint8_t* d, size_t dlc,
+                                     Clock::time_point now)
+{
+    if (dlc < 8) return;
+    uint8_t control = d[0];
+
+    if (control == TP_CM_BAM || control == TP_CM_RTS) {
+        size_t size = static_cast<size_t>(d[1]) | (static_cast<size_t>(d[2]) << 8);
+        if (size < 9 || size > TP_MAX_SIZE) return;
+
+        J1939TpSession* s = find_session(id.sa, id.da, true);
+        if (s->active) ++g_j1939.tp_aborted;   // New announcement replaces the old one
+        s->active = true;
+        s->bam = (control == TP_CM_BAM);
+        s->sa = id.sa;
+        s->da = s->bam ? 0xFF : id.da;
+        s->priority = id.priority;
+        s->pgn = cm_pgn(d);
+        s->size = size;
+        s->packets = d[3];
+        s->next_seq = 1;
+        s->data.clear();
+        s->data.reserve(size);
+        s->last_rx = now;
+        return;
+    }
+
+    if (control == TP_CM_ABORT) {
+        // Sent by either side; the session is keyed by the data originator
+        J1939TpSession* s = find_session(id.sa, id.da, false);
+        if (!s) s = find_session(id.da, id.sa, false);
+        if (s) {
+            s->active = false;
+            ++g_j1939.tp_aborted;
+            char line[96];
+            std::snprintf(line, sizeof(line), "J1939 TP abort PGN:0x%05X 0x%02X->0x%02X reason %u",
+                          s->pgn, s->sa, s->da, d[1]);
+            print_message_above(line);
+        }
+        return;
+    }
+
+    // CTS / EndOfMsgAck flow from the receiver back to the originator: nothing to
+    // reassemble, but they prove the session is alive
+    if (control == TP_CM_CTS || control == TP_CM_EOM_ACK) {
+        J1939TpSession* s = find_session(id.da, id.sa, false);
+        if (s) s->last_rx = now;
+    }
+}
+
+static void tp_data_transfer(const J1939Id& id, const uint8_t* d, size_t dlc, Clock::time_point now)
+{
+    if (dlc < 2) return;
+    J1939TpSession* s = find_session(id.sa, id.da, false);
+    if (!s) return;
+
+    uint8_t seq = d[0];
+    if (seq != s->next_seq) {
+        // RTS/CTS senders may retransmit after a CTS re-request; ignore duplicates
+        if (!s->bam && seq < s->next_seq) return;
+        ++g_j1939.tp_aborted;
+        s->active = false;
+        char line[96];
+        std::snprintf(line, sizeof(line), "J1939 TP sequence error PGN:0x%05X 0x%02X->0x%02X (got %u, want %u)",
+                      s->pgn, s->sa, s->da, seq, s->next_seq);
+        print_message_above(line);
+        return;
+    }
+
+    size_t take = std::min<size_t>(dlc - 1, s->size - s->data.size());
+    s->data.insert(s->data.end(), d + 1, d + 1 + take);
+    ++s->next_seq;
+    s->last_rx = now;
+
+    if (s->data.size() >= s->size) {
+        tp_complete(*s, now);
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool j1939_handle_rx(uint32_t can_id, const uint8_t* data, size_t dlc, Clock::time_point now)
+{
+    J1939Id id = j1939_decode_id(can_id);
+    ++g_j1939.frames;
+
+    uint32_t pf_pgn = id.pgn & 0x3FF00;
+    if (pf_pgn == PGN_TP_CM) {
+        tp_connection_management(id, data, dlc, now);
+    } else if (pf_pgn == PGN_TP_DT) {
+        tp_data_transfer(id, data, dlc, now);
+        return true;   // Only the reassembled message is shown
+    }
+
+    record_stat(id, data, dlc, now);
+
+    if (g_j1939.show_frames) {
+        std::string msg = frame_header(id, "", dlc);
+        append_hex(msg, data, dlc);
+        print_message_above(msg);
+    }
+    return true;
+}
+
+void j1939_poll(Clock::time_point now)
+{
+    for (auto& s : g_j1939.sessions) {
+        if (s.active && now - s.last_rx > TP_TIMEOUT) {
+            s.active = false;
+            ++g_j1939.tp_aborted;
+            char line[112];
+            std::snprintf(line, sizeof(line), "J1939 TP timeout PGN:0x%05X 0x%02X->0x%02X (%zu/%zu bytes)",
+                          s.pgn, s.sa, s.da, s.data.size(), s.size);
+            print_message_above(line);
+        }
+    }
+}
+
+void j1939_print_stats(size_t limit)
+{
+    std::vector<const J1939Stat*> rows;
+    rows.reserve(g_j1939.stats_used);
+    for (const auto& e : g_j1939.stats) {
+        if (e.key != STATS_EMPTY) rows.push_back(&e);
+    }
+    std::sort(rows.begin(), rows.end(),
+              [](const J1939Stat* a, const J1939Stat* b) {
+                  return a->count != b->count ? a->count > b->count : a->key < b->key;
+              });
+
+    std::printf("\r\nJ1939: %llu frames, %zu PGN/SA pairs, TP %llu complete / %llu aborted\n",
+                static_cast<unsigned long long>(g_j1939.frames), g_j1939.stats_used,
+                static_cast<unsigned long long>(g_j1939.tp_completed),
+                static_cast<unsigned long long>(g_j1939.tp_aborted));
+    std::printf("  PGN      SA    Count      Rate/s  Name                    Last data\n");
+
+    size_t shown = 0;
+    for (const J1939Stat* e : rows) {
+        if (limit && shown++ >= limit) break;
+        uint32_t pgn = e->key >> 8;
+        double secs = std::chrono::duration<double>(e->last_seen - e->first_seen).count();
+        double rate = (secs > 0.0 && e->count > 1) ? static_cast<double>(e->count - 1) / secs : 0.0;
+        const char* name = pgn_name(pgn);
+
+        std::string data;
+        char hex_buf[4];
+        size_t n = std::min<size_t>(e->last_len, 8);
+        for (size_t i = 0; i < n; ++i) {
+            std::snprintf(hex_buf, sizeof(hex_buf), "%02X", e->last_data[i]);
+            data += hex_buf;
+            if (i + 1 < n) data += ' ';
+        }
+        if (e->last_len > 8) data += " ...";
+
+        std::printf("  0x%05X  0x%02X %8llu %10.1f  %-22.22s  %s\n", pgn, e->key & 0xFF,
+                    static_cast<unsigned long long>(e->count), rate, name ? name : "", data.c_str());
+    }
+    if (rows.empty()) {
+        std::printf("  No J1939 traffic seen.\n");
+    } else if (limit && rows.size() > limit) {
+        std::printf("  ... %zu more (use /j1939 stats all)\n", rows.size() - limit);
+    }
+    if (g_j1939.stats_dropped) {
+        std::printf("  %llu frames not indexed (table full)\n",
+                    static_cast<unsigned long long>(g_j1939.stats_dropped));
+    }
+    std::printf("\n");
+}
+
+void j1939_reset_stats()
+{
+    for (auto& e : g_j1939.stats) e = J1939Stat{};
+    for (auto& e : g_j1939.stats) e.key = STATS_EMPTY;
+    g_j1939.stats_used = 0;
+    g_j1939.stats_dropped = 0;
+    g_j1939.frames = 0;
+    g_j1939.tp_completed = 0;
+    g_j1939.tp_aborted = 0;
+}
+
+} // namespace adamcom
@@ -0,0 +1,185 @@
+/**
+ * @file latency.cpp
+ * @brief Serial latency profiles: ASYNC_LOW_LATENCY, usb-serial latency_timer, read chunk
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace adamcom {
+
+// Define the global latency state
+LatencyState g_latency{};
+
+/// Per-profile settings; timer_ms 0 leaves the driver's latency_timer alone
+struct ProfileSettings {
+    const char* name;
+    int low_latency;                   // 1 set, 0 clear, -1 leave as is
+    int timer_ms;
+    size_t read_chunk;
+};
+
+static const ProfileSettings PROFILES[] = {
+    {"low",        1,  1, 256},
+    {"balanced",  -1,  0, 256},
+    {"throughput", 0, 16, LATENCY_MAX_READ_CHUNK},
+};
+
+static const ProfileSettings& settings(LatencyProfile p)
+{
+    return PROFILES[static_cast<size_t>(p)];
+}
+
+bool latency_parse_profile(const std::string& s, LatencyProfile& out)
+{
+    for (size_t i = 0; i < sizeof(PROFILES) / sizeof(PROFILES[0]); ++i) {
+        if (s == PROFILES[i].name) {
+            out = static_cast<LatencyProfile>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// sysfs latency_timer of a usb-serial port (symlinks like /dev/serial/by-id resolved)
+static std::string timer_path(const std::string& device)
+{
+    char real[PATH_MAX];
+    std::string name = realpath(device.c_str(), real) ? real : device;
+    auto slash = name.find_last_of('/');
+    if (slash != std::string::npos) name = name.substr(slash + 1);
+
+    const char* root = std::getenv("ADAMCOM_SYSFS_ROOT");
+    std::string path = std::string(root && *root ? root : "/sys") +
+                       "/bus/usb-serial/devices/" + name + "/latency_timer";
+    return access(path.c_str(), F_OK) == 0 ? path : "";
+}
+
+static std::string read_timer(const std::string& path)
+{
+    char buf[16] = {};
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return "";
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return "";
+    std::string v(buf, static_cast<size_t>(n));
+    while (!v.empty() && (v.back() == '\n' || v.back() == ' ')) v.pop_back();
+    return v;
+}
+
+static bool write_timer(const std::string& path, const std::string& val)
+{
+    int fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    std::string line = val + "\n";
+    bool ok = write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size());
+    int err = errno;
+    close(fd);
+    errno = err;
+    return ok;
+}
+
+/// Put back the latency_timer value found before we first changed it
+static void restore_timer()
+{
+    auto& g = g_latency;
+    if (g.saved_timer_path.empty()) return;
+    write_timer(g.saved_timer_path, g.saved_timer);
+    g.saved_timer_path.clear();
+    g.saved_timer.clear();
+}
+
+static std::string apply_timer(const std::string& path, int ms)
+{
+    auto& g = g_latency;
+    // The sysfs value outlives the process: profiles that leave it alone get the original back
+    if (!g.saved_timer_path.empty() && (ms <= 0 || g.saved_timer_path != path)) {
+        restore_timer();
+    }
+    if (ms > 0) {
+        if (g.saved_timer_path.empty()) {
+            g.saved_timer = read_timer(path);
+            if (!g.saved_timer.empty()) g.saved_timer_path = path;
+        }
+        if (!write_timer(path, std::to_string(ms))) {
+            int err = errno;
+            std::string cur = read_timer(path);
+            return (cur.empty() ? "unknown" : cur + " ms") + " (set " + std::to_string(ms) + " failed: " +
+                   std::strerror(err) + (err == EACCES ? "; needs root or a udev rule" : "") + ")";
+        }
+    }
+    std::string cur = read_timer(path);
+    return (cur.empty() ? "unknown" : cur + " ms") + (ms > 0 ? "" : " (driver setting)");
+}
+
+static std::string apply_low_latency(int fd, int want)
+{
+    struct serial_struct ss{};
+    if (ioctl(fd, TIOCGSERIAL, &ss) != 0) {
+        return std::string("unsupported (") + std::strerror(errno) + ")";
+    }
+    if (want >= 0) {
+        bool on = (ss.flags & ASYNC_LOW_LATENCY) != 0;
+        if (on != (want == 1)) {
+            ss.flags = want ? (ss.flags | ASYNC_LOW_LATENCY) : (ss.flags & ~ASYNC_LOW_LATENCY);
+            if (ioctl(fd, TIOCSSERIAL, &ss) != 0) {
+                return std::string("set failed (") + std::strerror(errno) + ")";
+            }
+            if (ioctl(fd, TIOCGSERIAL, &ss) != 0) {
+                return "unknown";
+            }
+        }
+    }
+    return std::string((ss.flags & ASYNC_LOW_LATENCY) ? "on" : "off") + (want >= 0 ? "" : " (driver setting)");
+}
+
+void latency_apply(int fd, const Config& cfg)
+{
+    auto& g = g_latency;
+    auto it = cfg.find("latency");
+    g.profile = LatencyProfile::BALANCED;
+    if (it != cfg.end() && !latency_parse_profile(it->second, g.profile)) {
+        std::fprintf(stderr, "Unknown latency profile '%s', using balanced\n", it->second.c_str());
+    }
+    const ProfileSettings& p = settings(g.profile);
+    g.read_chunk = p.read_chunk;
+
+    g.low_latency = apply_low_latency(fd, p.low_latency);
+
+    it = cfg.find("device");
+    g.timer_path = timer_path(it != cfg.end() ? it->second : "");
+    if (g.timer_path.empty()) {
+        restore_timer();
+        g.latency_timer = "n/a (not a usb-serial port)";
+    } else {
+        g.latency_timer = apply_timer(g.timer_path, p.timer_ms);
+    }
+}
+
+void latency_restore()
+{
+    restore_timer();
+}
+
+void latency_print()
+{
+    const auto& g = g_latency;
+    std::printf("\r\nLatency profile: %s\n", settings(g.profile).name);
+    std::printf("  ASYNC_LOW_LATENCY: %s\n", g.low_latency.empty() ? "not applied" : g.low_latency.c_str());
+    std::printf("  USB latency_timer: %s\n", g.latency_timer.empty() ? "not applied" : g.latency_timer.c_str());
+    if (!g.timer_path.empty()) {
+        std::printf("                     %s\n", g.timer_path.c_str());
+    }
+    std::printf("  Read chunk:        %zu bytes\n\n", g.read_chunk);
+}
+
+} // namespace adamcom
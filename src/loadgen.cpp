@@ -0,0 +1,327 @@
+/**
+ * @file loadgen.cpp
+ * @brief CAN load generator: target bus load or frame rate, max-rate bursts, drop accounting
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/can.h>
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+
+namespace adamcom {
+
+// Define the global load generator state
+LoadGenState g_loadgen{};
+
+using Clock = std::chrono::steady_clock;
+
+/// Schedule granularity for LOAD and RATE
+static constexpr auto TICK = std::chrono::milliseconds(1);
+
+/// Retry delay after the socket refused a burst frame
+static constexpr auto BURST_RETRY = std::chrono::microseconds(200);
+
+/// Demand that may pile up while the socket refuses frames (no catch-up flood afterwards)
+static constexpr double MAX_CREDIT_S = 0.05;
+
+// ============================================================================
+// Frame Generation
+// ============================================================================
+
+static uint32_t next_random()
+{
+    auto& g = g_loadgen;
+    g.rng ^= g.rng << 13;
+    g.rng ^= g.rng >> 17;
+    g.rng ^= g.rng << 5;
+    return g.rng;
+}
+
+/// Draw the next frame from the ID and DLC distributions
+static void make_frame()
+{
+    auto& g = g_loadgen;
+    uint32_t id;
+    if (!g.ids.empty()) {
+        id = g.ids[next_random() % g.ids.size()];
+    } else {
+        id = g.id_lo + next_random() % (g.id_hi - g.id_lo + 1);
+    }
+    g.next_id = g.extended ? (id | CAN_EFF_FLAG) : id;
+    g.next_dlc = static_cast<uint8_t>(g.dlc_lo + next_random() % (g.dlc_hi - g.dlc_lo + 1u));
+    for (uint8_t i = 0; i < g.next_dlc; ++i) g.next_data[i] = static_cast<uint8_t>(next_random());
+    g.next_bits = can_frame_bits(g.next_id, g.next_data, g.next_dlc);
+    g.have_next = true;
+}
+
+/// Cost of the pending frame in schedule units
+static double frame_cost()
+{
+    return g_loadgen.mode == LoadGenMode::LOAD ? g_loadgen.next_bits : 1.0;
+}
+
+/// Send the pending frame; false (with the errno classified) when the socket refused it
+static bool send_next()
+{
+    auto& g = g_loadgen;
+    if (!g.have_next) make_frame();
+    errno = 0;
+    if (g.fd && *g.fd >= 0 && send_can_paced(*g.fd, g.next_id, g.next_data, g.next_dlc)) {
+        ++g.sent;
+        g.sent_bits += g.next_bits;
+        g.have_next = false;
+        return true;
+    }
+    if (errno == ENOBUFS) {
+        ++g.enobufs;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        ++g.eagain;
+    } else {
+        ++g.errors;
+    }
+    ++g.stalls;
+    return false;
+}
+
+// ============================================================================
+// Parsing
+// ============================================================================
+
+static bool parse_range(const std::string& text, uint32_t& lo, uint32_t& hi, int base)
+{
+    try {
+        auto dash = text.find('-');
+        lo = static_cast<uint32_t>(std::stoul(text.substr(0, dash), nullptr, base));
+        hi = (dash == std::string::npos) ? lo : static_cast<uint32_t>(std::stoul(text.substr(dash + 1), nullptr, base));
+        return lo <= hi;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool parse_options(std::istringstream& in, LoadGenState& g, std::string& error)
+{
+    std::string opt;
+    while (in >> opt) {
+        std::string val;
+        if (opt == "ext") {
+            g.extended = true;
+            continue;
+        }
+        if (!(in >> val)) {
+            error = "missing value after '" + opt + "'";
+            return false;
+        }
+        if (opt == "ids" && val.find(',') != std::string::npos) {
+            std::istringstream list(val);
+            for (std::string id; std::getline(list, id, ',');) {
+                try {
+                    g.ids.push_back(static_cast<uint32_t>(std::stoul(id, nullptr, 16)));
+                } catch (...) {
+                    error = "invalid ID '" + id + "'";
+                    return false;
+                }
+            }
+        } else if (opt == "ids") {
+            if (!parse_range(val, g.id_lo, g.id_hi, 16)) {
+                error = "ids takes LO-HI or A,B,C (hex)";
+                return false;
+            }
+        } else if (opt == "dlc") {
+            uint32_t lo = 0, hi = 0;
+            if (!parse_range(val, lo, hi, 10) || hi > 8) {
+                error = "dlc takes N or LO-HI within 0-8";
+                return false;
+            }
+            g.dlc_lo = static_cast<uint8_t>(lo);
+            g.dlc_hi = static_cast<uint8_t>(hi);
+        } else if (opt == "for") {
+            double secs = 0;
+            try { secs = std::stod(val); } catch (...) {}
+            if (secs <= 0) {
+                error = "for takes a duration in seconds";
+                return false;
+            }
+            g.timed = true;
+            g.stop_at = Clock::now() + std::chrono::microseconds(static_cast<int64_t>(secs * 1e6));
+        } else {
+            error = "unknown option '" + opt + "'";
+            return false;
+        }
+    }
+    uint32_t id_max = g.extended ? CAN_EFF_MASK : CAN_SFF_MASK;
+    bool ids_ok = g.ids.empty() ? g.id_hi <= id_max
+                                : std::all_of(g.ids.begin(), g.ids.end(), [&](uint32_t id) { return id <= id_max; });
+    if (!ids_ok) {
+        error = g.extended ? "IDs must fit 29 bits" : "IDs above 0x7FF need 'ext'";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void loadgen_bind(const int* fd)
+{
+    g_loadgen.fd = fd;
+}
+
+bool loadgen_start(const std::string& args, uint32_t bitrate, std::string& error)
+{
+    std::istringstream in(args);
+    std::string mode, amount;
+    in >> mode >> amount;
+
+    LoadGenState g;
+    g.fd = g_loadgen.fd;
+    double value = 0;
+    try { value = std::stod(amount); } catch (...) {}
+    if (mode == "load") {
+        if (bitrate == 0) {
+            error = "load needs can_bitrate (virtual interfaces: use rate N)";
+            return false;
+        }
+        if (value <= 0 || value > 100) {
+            error = "load takes a percentage, e.g. load 60%";
+            return false;
+        }
+        g.mode = LoadGenMode::LOAD;
+        g.per_sec = value / 100.0 * bitrate;
+    } else if (mode == "rate" && value > 0) {
+        g.mode = LoadGenMode::RATE;
+        g.per_sec = value;
+    } else if (mode == "burst" && value >= 1) {
+        g.mode = LoadGenMode::BURST;
+        g.burst_frames = static_cast<uint64_t>(value);
+    } else {
+        error = "expected load P% | rate FRAMES/S | burst N";
+        return false;
+    }
+    if (!parse_options(in, g, error)) return false;
+
+    if (g_loadgen.mode != LoadGenMode::OFF) loadgen_stop("replaced");
+    g.started = Clock::now();
+    g.last_tick = g.started;
+    g.next_tick = g.started;
+    g.rng = static_cast<uint32_t>(g.started.time_since_epoch().count()) | 1u;
+    g_loadgen = std::move(g);
+    return true;
+}
+
+static void summary(char* buf, size_t size)
+{
+    const auto& g = g_loadgen;
+    double secs = std::max(1e-6, std::chrono::duration<double>(Clock::now() - g.started).count());
+    double load = g_busload.bitrate ? 100.0 * g.sent_bits / secs / g_busload.bitrate : 0;
+    int n = std::snprintf(buf, size, "%llu frames in %.1f ms (%.0f frames/s", static_cast<unsigned long long>(g.sent),
+                          secs * 1000.0, g.sent / secs);
+    if (g_busload.bitrate) n += std::snprintf(buf + n, size - static_cast<size_t>(n), ", %.1f%% load", load);
+    std::snprintf(buf + n, size - static_cast<size_t>(n), "), ENOBUFS %llu, EAGAIN %llu, errors %llu, stalls %llu",
+                  static_cast<unsigned long long>(g.enobufs), static_cast<unsigned long long>(g.eagain),
+                  static_cast<unsigned long long>(g.errors), static_cast<unsigned long long>(g.stalls));
+}
+
+void loadgen_stop(const char* how)
+{
+    auto& g = g_loadgen;
+    if (g.mode == LoadGenMode::OFF) return;
+    char line[256];
+    summary(line, sizeof(line));
+    g.mode = LoadGenMode::OFF;
+    print_message_above(std::string("STRESS ") + how + ": " + line);
+}
+
+void loadgen_poll(Clock::time_point now)
+{
+    auto& g = g_loadgen;
+    if (g.mode == LoadGenMode::OFF || now < g.next_tick) return;
+
+    if (g.timed && now >= g.stop_at) {
+        loadgen_stop("done");
+        return;
+    }
+
+    size_t batch = 0;
+    if (g.mode == LoadGenMode::BURST) {
+        while (g.sent < g.burst_frames && batch < LOADGEN_MAX_BATCH) {
+            if (!send_next()) break;
+            ++batch;
+        }
+        g.max_batch = std::max(g.max_batch, batch);
+        if (g.sent >= g.burst_frames) {
+            loadgen_stop("burst done");
+            return;
+        }
+        // Refused: give the driver queue a moment; otherwise come straight back
+        g.next_tick = (batch < LOADGEN_MAX_BATCH) ? now + BURST_RETRY : now;
+        return;
+    }
+
+    double demand = std::chrono::duration<double>(now - g.last_tick).count() * g.per_sec;
+    g.last_tick = now;
+    g.offered += demand;
+    if (!g.have_next) make_frame();
+    // At low rates the cap can be below one frame; never let it starve the pending frame
+    g.credit = std::min(g.credit + demand, std::max(g.per_sec * MAX_CREDIT_S, frame_cost()));
+
+    while (g.credit >= frame_cost() && batch < LOADGEN_MAX_BATCH) {
+        double cost = frame_cost();
+        if (!send_next()) break;
+        g.credit -= cost;
+        ++batch;
+        make_frame();
+    }
+    g.max_batch = std::max(g.max_batch, batch);
+    g.next_tick = now + TICK;
+}
+
+Clock::time_point loadgen_next_deadline()
+{
+    return g_loadgen.mode == LoadGenMode::OFF ? Clock::time_point::max() : g_loadgen.next_tick;
+}
+
+void loadgen_print_status()
+{
+    const auto& g = g_loadgen;
+    if (g.mode == LoadGenMode::OFF) {
+        std::printf("\r\nLoad generator idle (/stress load P%% | rate N | burst N [ids ..] [dlc ..] [ext] [for S])\n\n");
+        return;
+    }
+    double secs = std::max(1e-6, std::chrono::duration<double>(Clock::now() - g.started).count());
+    const char* mode = g.mode == LoadGenMode::LOAD ? "load" : g.mode == LoadGenMode::RATE ? "rate" : "burst";
+    std::printf("\r\nLoad generator: %s, running %.1f s, IDs ", mode, secs);
+    if (g.ids.empty()) {
+        std::printf("0x%X-0x%X", g.id_lo, g.id_hi);
+    } else {
+        std::printf("%zu listed", g.ids.size());
+    }
+    std::printf("%s, DLC %u-%u\n", g.extended ? " (29-bit)" : "", g.dlc_lo, g.dlc_hi);
+
+    double fps = g.sent / secs;
+    double avg_bits = g.sent ? static_cast<double>(g.sent_bits) / g.sent : 0;
+    double bitrate = g_busload.bitrate;
+    if (g.mode == LoadGenMode::BURST) {
+        std::printf("  Offered:  %llu frames back-to-back\n", static_cast<unsigned long long>(g.burst_frames));
+    } else {
+        double offered_fps = g.mode == LoadGenMode::RATE ? g.offered / secs
+                                                         : (avg_bits > 0 ? g.offered / secs / avg_bits : 0);
+        std::printf("  Offered:  %10.1f frames/s", offered_fps);
+        if (bitrate > 0) {
+            double offered_bits = g.mode == LoadGenMode::LOAD ? g.offered : g.offered * avg_bits;
+            std::printf("  %5.1f%% of %.0f bps", 100.0 * offered_bits / secs / bitrate, bitrate);
+        }
+        std::printf("\n");
+    }
+    std::printf("  Achieved: %10.1f frames/s", fps);
+    if (bitrate > 0) std::printf("  %5.1f%%", 100.0 * g.sent_bits / secs / bitrate);
+    std::printf("  (%llu sent)\n", static_cast<unsigned long long>(g.sent));
+    std::printf("  Refused:  ENOBUFS %llu, EAGAIN %llu, other errors %llu; %llu stalls, largest batch %zu\n\n",
+                static_cast<unsigned long long>(g.enobufs), static_cast<unsigned long long>(g.eagain),
+                static_cast<unsigned long long>(g.errors), static_cast<unsigned long long>(g.stalls), g.max_batch);
+}
+
+} // namespace adamcom
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <signal.h>
 #include <poll.h>
+#include <sys/timerfd.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -42,6 +43,7 @@ static Config* g_cfg = nullptr;
 static bool* g_append_crlf = nullptr;
 static int* g_fd = nullptr;
 static InterfaceType* g_itype = nullptr;
+static bool g_readline_active = false;
 
 // ============================================================================
 // Signal Handlers
@@ -67,6 +69,14 @@ extern "C" void rl_trampoline(char* line)
     }
 }
 
+/// --serve: run a client's line through the prompt's handler (which frees it)
+static void serve_exec_line(const std::string& line)
+{
+    if (g_line_handler) {
+        g_line_handler(strdup(line.c_str()));
+    }
+}
+
 extern "C" int startup_hook()
 {
     if (g_dynamic_prompt) {
@@ -286,6 +296,8 @@ static std::string extract_hex_bytes_only(const std::string& line, std::string*
 
 static void update_prompt_display(const std::string& prompt)
 {
+    // A client command's output is captured; the local prompt is left alone
+    if (serve_executing()) return;
     std::printf("\r\033[K");
     rl_set_prompt(prompt.c_str());
     rl_replace_line("", 0);
@@ -297,6 +309,25 @@ namespace adamcom {
 /// Print a message above the current readline input without interrupting typing
 void print_message_above(const std::string& msg)
 {
+    ADAMCOM_PERF(RENDER);
+    TraceScope render_trace(TraceKind::RENDER);
+    auto render_start = std::chrono::steady_clock::now();
+    scrollback_add_text(msg);
+    if (!g_serve.clients.empty()) {
+        serve_broadcast(msg);
+    }
+    // The pager owns the screen; it shows the line from the scrollback instead
+    if (g_scrollback.pager) return;
+    // No prompt to preserve when stdin is not read, or inside a client's captured reply
+    if (!g_readline_active || serve_executing()) {
+        std::printf("%s\n", msg.c_str());
+        std::fflush(stdout);
+        metric_observe(MetricHist::RENDER, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - render_start).count()));
+        return;
+    }
+
     // Save current line content and cursor position
     int saved_point = rl_point;
     char* saved_line = rl_copy_text(0, rl_end);
@@ -322,6 +353,9 @@ void print_message_above(const std::string& msg)
     rl_point = saved_point;
     
     std::free(saved_line);
+    metric_observe(MetricHist::RENDER, static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - render_start).count()));
 }
 
 } // namespace adamcom
@@ -330,6 +364,33 @@ void print_message_above(const std::string& msg)
 // Default Configuration
 // ============================================================================
 
+/// "N baud", plus the requested rate when the driver rounded it
+static std::string baud_report(Config& cfg, unsigned int applied)
+{
+    std::string report = std::to_string(applied) + " baud";
+    if (std::to_string(applied) != cfg["baud"]) {
+        report += " (requested " + cfg["baud"] + ")";
+    }
+    return report;
+}
+
+/// Arm the loop timer for an absolute steady_clock deadline (time_point::max() disarms)
+static void arm_loop_timer(int tfd, std::chrono::steady_clock::time_point when)
+{
+    static auto armed = std::chrono::steady_clock::time_point::min();
+    if (when == armed) return;
+    armed = when;
+    struct itimerspec its{};
+    if (when != std::chrono::steady_clock::time_point::max()) {
+        // steady_clock is CLOCK_MONOTONIC, so the deadline converts without an offset
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+        its.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+        its.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
 static Config get_default_config()
 {
     Config cfg = {
@@ -340,6 +401,13 @@ static Config get_default_config()
         {"parity", "N"},
         {"stop", "1"},
         {"flow", "none"},
+        {"latency", "balanced"},
+        {"tx_queue_kb", "1024"},
+        {"tx_queue_frames", "1024"},
+        {"can_rcvbuf_kb", "0"},
+        {"auto_reconnect", "on"},
+        {"seq_file", "none"},
+        {"tx_checksum", "none"},
         {"mode", "normal"},
         {"crlf", "yes"},
         {"can_interface", "can0"},
@@ -348,7 +416,30 @@ static Config get_default_config()
         {"can_filter", "none"},
         {"repeat_enabled", "no"},
         {"repeat_interval", "1000"},
-        {"repeat_preset", "1"}
+        {"repeat_preset", "1"},
+        {"modbus", "off"},
+        {"modbus_timeout", "1000"},
+        {"isotp", "off"},
+        {"isotp_tx_id", "0x7E0"},
+        {"isotp_rx_id", "0x7E8"},
+        {"isotp_bs", "0"},
+        {"isotp_stmin", "0"},
+        {"isotp_padding", "on"},
+        {"isotp_pad_byte", "0xCC"},
+        {"j1939", "off"},
+        {"j1939_frames", "on"},
+        {"dbc", "none"},
+        {"dbc_decode", "on"},
+        {"triggers", "on"},
+        {"capture_file", "adamcom-capture.log"},
+        {"responder", "on"},
+        {"responder_log", "on"},
+        {"scrollback_mb", "16"},
+        {"shm", "off"},
+        {"shm_slots", "65536"},
+        {"shm_mode", "0600"},
+        {"metrics_file", "none"},
+        {"metrics_interval", "10"}
     };
 
     // Initialize 10 presets
@@ -375,6 +466,11 @@ int main(int argc, char* argv[])
     sigemptyset(&sa.sa_mask);
     sa.sa_flags = 0;
     sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    // A closed --output pipe must surface as EPIPE, not kill the process
+    struct sigaction ign{};
+    ign.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ign, nullptr);
 
     // Configuration paths
     const char* home = std::getenv("HOME");
@@ -410,9 +506,16 @@ int main(int argc, char* argv[])
     int start_preset_index = 0;
     int start_repeat_preset = 0;
     int start_repeat_ms = 0;
+    OutputFormat output_format = OutputFormat::NONE;
+    std::string output_path = "-";
+    std::string serve_path;
+    std::string attach_path;
+    std::vector<std::string> attach_cmds;
+    std::string trace_path;
 
     // Parse command line arguments
     bool cli_changed = false;
+    bool cli_dbc = false;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
 
@@ -450,6 +553,14 @@ int main(int argc, char* argv[])
         else if (arg == "-f" || arg == "--flow") {
             if (!require_arg("flow")) return 1;
         }
+        else if (arg == "--latency") {
+            if (!require_arg("latency")) return 1;
+            LatencyProfile profile;
+            if (!latency_parse_profile(cfg["latency"], profile)) {
+                std::cerr << "--latency requires low, balanced or throughput\n";
+                return 1;
+            }
+        }
         else if (arg == "-c" || arg == "--can") {
             if (!require_arg("can_interface")) return 1;
             cfg["type"] = "can";
@@ -464,6 +575,9 @@ int main(int argc, char* argv[])
         else if (arg == "--filter") {
             if (!require_arg("can_filter")) return 1;
         }
+        else if (arg == "--rcvbuf") {
+            if (!require_arg("can_rcvbuf_kb")) return 1;
+        }
         else if (arg == "--hex") {
             cfg["mode"] = "hex";
             cli_changed = true;
@@ -482,6 +596,66 @@ int main(int argc, char* argv[])
             cfg["crlf"] = "no";
             cli_changed = true;
         }
+        else if (arg == "--isotp") {
+            cfg["isotp"] = "on";
+            cli_changed = true;
+        }
+        else if (arg == "--j1939") {
+            cfg["j1939"] = "on";
+            cli_changed = true;
+        }
+        else if (arg == "--dbc") {
+            if (i + 1 >= argc) { usage(argv[0]); return 1; }
+            // Repeatable: the first --dbc replaces the saved list, later ones append
+            std::string path = argv[++i];
+            cfg["dbc"] = cli_dbc ? cfg["dbc"] + "," + path : path;
+            cli_dbc = true;
+            cli_changed = true;
+        }
+        else if (arg == "--modbus") {
+            cfg["modbus"] = "on";
+            cli_changed = true;
+        }
+        else if (arg == "--no-reconnect") {
+            cfg["auto_reconnect"] = "off";
+            cli_changed = true;
+        }
+        else if (arg == "--metrics-file") {
+            if (!require_arg("metrics_file")) return 1;
+        }
+        else if (arg == "--shm") {
+            if (!require_arg("shm")) return 1;
+        }
+        else if (arg == "--serve" || arg == "--attach") {
+            // Socket path is optional
+            std::string path = serve_default_path();
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                path = argv[++i];
+            }
+            (arg == "--serve" ? serve_path : attach_path) = path;
+        }
+        else if (arg == "-e" || arg == "--exec") {
+            if (i + 1 >= argc) { usage(argv[0]); return 1; }
+            attach_cmds.push_back(argv[++i]);
+        }
+        else if (arg == "--output") {
+            if (i + 1 >= argc) { usage(argv[0]); return 1; }
+            if (!output_parse_format(argv[++i], output_format)) {
+                std::cerr << "--output requires jsonl or csv\n";
+                return 1;
+            }
+        }
+        else if (arg == "--output-file") {
+            if (i + 1 >= argc) { usage(argv[0]); return 1; }
+            output_path = argv[++i];
+        }
+        else if (arg == "--trace") {
+            if (i + 1 >= argc) { usage(argv[0]); return 1; }
+            trace_path = argv[++i];
+        }
+        else if (arg == "--bench") {
+            return bench_run();
+        }
         else if (arg == "--preset") {
             if (i + 1 >= argc) { usage(argv[0]); return 1; }
             try {
@@ -514,96 +688,59 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Thin client: the serving session owns the device and settings
+    if (!attach_path.empty()) {
+        return attach_run(attach_path, attach_cmds);
+    }
+    if (!attach_cmds.empty()) {
+        std::cerr << "--exec requires --attach\n";
+        return 1;
+    }
+
     if (cli_changed) {
         write_profile(cfg_path, cfg);
     }
 
+    // Structured output: records to stdout move the human-readable output to stderr
+    if (output_format != OutputFormat::NONE) {
+        if (output_path == "-") {
+            int out_fd = dup(STDOUT_FILENO);
+            if (out_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+                std::perror("dup");
+                return 1;
+            }
+            output_open_fd(output_format, out_fd, "-");
+        } else {
+            std::string error;
+            if (!output_open(output_format, output_path, error)) {
+                std::cerr << "Output: " << error << "\n";
+                return 1;
+            }
+        }
+    }
+    // Without a terminal on stdin an --output or --serve run is driven by signals only
+    bool use_stdin = (g_output.format == OutputFormat::NONE && serve_path.empty()) ||
+                     isatty(STDIN_FILENO);
+
     // Open device
     int fd = -1;
+    unsigned int applied_baud = 0;
 
     if (itype == InterfaceType::SERIAL) {
-        fd = open(cfg["device"].c_str(), O_RDWR | O_NOCTTY);
+        fd = open_serial(cfg, &applied_baud);
         if (fd < 0) {
-            std::perror(cfg["device"].c_str());
             return 1;
         }
-
-        // Configure serial port
-        struct termios tty{};
-        if (tcgetattr(fd, &tty) != 0) {
-            std::perror("tcgetattr");
-            close(fd);
-            return 1;
+        std::cout << "Connected to " << cfg["device"] << " @ " << baud_report(cfg, applied_baud)
+                  << " (Ctrl-T: Menu, Ctrl-C: Quit)\n";
+        output_set_iface(cfg["device"]);
+
+        modbus_configure(cfg);
+        g_modbus.enabled = (cfg["modbus"] == "on");
+        if (g_modbus.enabled) {
+            std::cout << "Modbus RTU decoding on (t3.5 = " << g_modbus.silence_us << " us)\n";
         }
 
-        // Baud rate
-        try {
-            speed_t speed = static_cast<speed_t>(get_baud_speed_t(cfg["baud"]));
-            cfsetispeed(&tty, speed);
-            cfsetospeed(&tty, speed);
-        } catch (const std::exception& e) {
-            std::cerr << "Invalid baud rate: " << e.what() << "\n";
-            close(fd);
-            return 1;
-        }
-
-        // Data bits
-        int databits = 8;
-        try { databits = std::stoi(cfg["databits"]); } catch (...) {}
-        tty.c_cflag &= ~CSIZE;
-        switch (databits) {
-            case 5: tty.c_cflag |= CS5; break;
-            case 6: tty.c_cflag |= CS6; break;
-            case 7: tty.c_cflag |= CS7; break;
-            default: tty.c_cflag |= CS8; break;
-        }
-
-        // Parity
-        char parity = 'N';
-        if (!cfg["parity"].empty()) {
-            parity = static_cast<char>(std::toupper(static_cast<unsigned char>(cfg["parity"][0])));
-        }
-        tty.c_cflag &= ~(PARENB | PARODD);
-        if (parity == 'E') {
-            tty.c_cflag |= PARENB;
-        } else if (parity == 'O') {
-            tty.c_cflag |= PARENB | PARODD;
-        }
-
-        // Stop bits
-        int stopbits = 1;
-        try { stopbits = std::stoi(cfg["stop"]); } catch (...) {}
-        if (stopbits == 2) {
-            tty.c_cflag |= CSTOPB;
-        } else {
-            tty.c_cflag &= ~CSTOPB;
-        }
-
-        // Flow control
-        tty.c_cflag &= ~CRTSCTS;
-        tty.c_iflag &= ~(IXON | IXOFF | IXANY);
-        if (cfg["flow"] == "hardware") {
-            tty.c_cflag |= CRTSCTS;
-        } else if (cfg["flow"] == "software") {
-            tty.c_iflag |= IXON | IXOFF | IXANY;
-        }
-
-        // Raw mode
-        tty.c_cflag |= CREAD | CLOCAL;
-        tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-        tty.c_iflag &= ~(INLCR | ICRNL | IGNCR);
-        tty.c_oflag &= ~OPOST;
-
-        if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-            std::perror("tcsetattr");
-            close(fd);
-            return 1;
-        }
-
-        fcntl(fd, F_SETFL, FNDELAY);
-        std::cout << "Connected to " << cfg["device"] << " @ " << cfg["baud"]
-                  << " baud (Ctrl-T: Menu, Ctrl-C: Quit)\n";
-
     } else {
         // CAN mode
         if (configure_can_interface(cfg["can_interface"], cfg["can_bitrate"]) < 0) {
@@ -615,22 +752,75 @@ int main(int argc, char* argv[])
         }
 
         std::string filter = (cfg["can_filter"] == "none") ? "" : cfg["can_filter"];
+        can_rx_configure(cfg);
         fd = setup_can(cfg["can_interface"], filter);
         if (fd < 0) {
             return 1;
         }
+        if (g_canrx.rcvbuf_kb > 0 && !g_canrx.forced) {
+            std::cerr << "can_rcvbuf_kb: got " << g_canrx.rcvbuf / 1024 << " KB (capped by net.core.rmem_max; "
+                      << "CAP_NET_ADMIN lifts the cap)\n";
+        }
 
         std::cout << "Connected to " << cfg["can_interface"] << " @ "
                   << cfg["can_bitrate"] << " bps (Ctrl-T: Menu, Ctrl-C: Quit)\n";
+        output_set_iface(cfg["can_interface"]);
+
+        isotp_configure(cfg);
+        g_isotp.enabled = (cfg["isotp"] == "on");
+        g_j1939.enabled = (cfg["j1939"] == "on");
+        g_j1939.show_frames = (cfg["j1939_frames"] != "off");
+
+        g_dbc.enabled = (cfg["dbc_decode"] != "off");
+        if (cfg["dbc"] != "none") {
+            std::stringstream ss(cfg["dbc"]);
+            std::string path;
+            while (std::getline(ss, path, ',')) {
+                if (path.empty()) continue;
+                std::string report;
+                if (dbc_load(path, report)) {
+                    std::cout << report << "\n";
+                } else {
+                    std::cerr << "DBC: " << report << "\n";
+                }
+            }
+        }
+    }
+
+    trigger_configure(cfg);
+    responder_configure(cfg);
+    seq_configure(cfg);
+    gen_configure(cfg, itype);
+    checksum_configure(cfg);
+    scrollback_configure(cfg);
+    shm_configure(cfg, itype == InterfaceType::CAN ? cfg["can_interface"] : cfg["device"]);
+    metrics_configure(cfg, itype == InterfaceType::CAN ? cfg["can_interface"] : cfg["device"]);
+    busload_configure(cfg, itype);
+    txq_configure(cfg);
+    reconnect_configure(cfg, itype);
+    if (!trace_path.empty()) {
+        std::string error;
+        if (!trace_start(trace_path, error)) {
+            std::cerr << "Trace: " << error << "\n";
+        }
     }
 
     // Handle one-shot preset
     if (start_preset_index > 0) {
         bool ok = send_preset(fd, cfg, itype, start_preset_index, append_crlf);
+        // A multi-frame ISO-TP preset has only sent its First Frame so far
+        if (ok && g_isotp.tx.phase != IsoTpTxPhase::IDLE) {
+            ok = isotp_wait_tx(fd);
+        }
         if (!ok) {
             std::cerr << "Failed to send preset " << start_preset_index << "\n";
         }
+        txq_drain(fd, 1000);
+        trace_stop();
+        output_close();
+        shm_stop();
         close(fd);
+        latency_restore();
         return ok ? 0 : 1;
     }
 
@@ -655,8 +845,15 @@ int main(int argc, char* argv[])
     g_append_crlf = &append_crlf;
     g_fd = &fd;
     g_itype = &itype;
-
-    rl_callback_handler_install(dynamic_prompt.c_str(), rl_trampoline);
+    trigger_bind(&fd, &cfg, &itype, &append_crlf);
+    responder_bind(&fd);
+    seq_bind(&fd);
+    loadgen_bind(&fd);
+
+    if (use_stdin) {
+        rl_callback_handler_install(dynamic_prompt.c_str(), rl_trampoline);
+        g_readline_active = true;
+    }
     read_history(hist_path.c_str());
     rl_startup_hook = startup_hook;
     rl_pre_input_hook = pre_input_hook;
@@ -674,7 +871,9 @@ int main(int argc, char* argv[])
     rl_bind_keyseq("\0339", alt_9_handler);
     rl_bind_keyseq("\0330", alt_0_handler);
     
-    rl_forced_update_display();
+    if (use_stdin) {
+        rl_forced_update_display();
+    }
 
     // Line handler callback
     g_line_handler = [&](char* buf) {
@@ -688,8 +887,10 @@ int main(int argc, char* argv[])
 
         if (line.empty()) return;
 
-        add_history(line.c_str());
-        write_history(hist_path.c_str());
+        if (!serve_executing()) {
+            add_history(line.c_str());
+            write_history(hist_path.c_str());
+        }
         std::printf("\r\033[K");
 
         // Handle slash commands
@@ -698,6 +899,26 @@ int main(int argc, char* argv[])
             auto [cmd, arg] = split_first(body);
             cmd = to_lower(cmd);
 
+            // These take over the server's own terminal and would stall every attached client
+            if (serve_executing() && (cmd == "menu" || cmd == "clear" || cmd == "pager" || cmd == "less")) {
+                std::printf("\r\nError: /%s needs the server's terminal; not available to attached clients\n",
+                            cmd.c_str());
+                return;
+            }
+            // Clients may connect with less privilege than the server: do not open paths for them
+            if (serve_executing()) {
+                std::string sub = to_lower(split_first(arg).first);
+                bool opens_path = (cmd == "device") ||
+                                  (cmd == "output" && !sub.empty() && sub != "off" && sub != "status") ||
+                                  ((cmd == "capture" || cmd == "trace") && sub == "start") ||
+                                  ((cmd == "seq" || cmd == "dbc") && sub == "load");
+                if (opens_path) {
+                    std::printf("\r\nError: /%s opens files as the server; not available to attached clients\n",
+                                cmd.c_str());
+                    return;
+                }
+            }
+
             if (cmd == "help" || cmd == "h") {
                 std::printf("\r\n"
                     "Commands:\n"
@@ -710,6 +931,46 @@ int main(int argc, char* argv[])
                     "  /ra               Stop all repeats (presets + inline)\n"
                     "  /hex XX XX        Send raw hex bytes\n"
                     "  /can ID XX XX     Send CAN frame (ID + data)\n"
+                    "  /tp XX XX ...     Send ISO-TP payload of any length\n"
+                    "  /isotp on|off     ISO-TP segmentation/reassembly (CAN)\n"
+                    "  /isotp tx|rx ID   Set ISO-TP TX/RX CAN IDs\n"
+                    "  /isotp bs|stmin N Set our flow control block size / STmin\n"
+                    "  /isotp pad on|off Pad frames to 8 bytes (padbyte XX)\n"
+                    "  /j1939 on|off     Decode extended IDs as J1939 (PGN/SA/DA)\n"
+                    "  /j1939 stats      Per-PGN/SA counts and rates\n"
+                    "  /j1939 frames on|off  Print every frame or only TP messages\n"
+                    "  /dbc load FILE    Load a DBC file for signal decoding\n"
+                    "  /dbc on|off|clear Toggle DBC decoding or drop databases\n"
+                    "  /trig add SPEC    Add trigger, e.g. can 0x100 01 ?? -> preset 2\n"
+                    "  /trig list|del N  List or delete triggers (clear, on|off)\n"
+                    "  /capture start|stop [FILE]  Log RX to a candump-format file\n"
+                    "  /dump             Print the pre-trigger RX history\n"
+                    "  /output jsonl|csv FILE  Write RX/TX records to FILE (off, or status)\n"
+                    "  /shm on [/NAME]|off  Publish RX/TX to a shared-memory ring\n"
+                    "  /serve            Show --serve socket and attached clients\n"
+                    "  /latency [P]      Serial latency profile: low|balanced|throughput\n"
+                    "  /reconnect [on|off]  Auto-reconnect state and outage times\n"
+                    "  /txq [clear]      TX queue depth, ENOBUFS/EAGAIN, drops, retry latency\n"
+                    "  /load [reset]     CAN bus load / serial line occupancy, peaks\n"
+                    "  /load live on|off Print the load every second\n"
+                    "  /stats            Counters, latency histograms, queue depths\n"
+                    "  /perf [reset]     Main-loop time per stage (make profile builds)\n"
+                    "  /trace start|stop Chrome trace of loop, poll, RX, TX, render\n"
+                    "  /resp add M -> R  Auto-respond, e.g. can 0x7E0 -> can 0x7E8 01 delay 5\n"
+                    "  /resp list|del N  Responders, hits and RX->TX latency (clear, on|off, log)\n"
+                    "  /seq NAME         Start a sequence (list, show NAME, stop [NAME])\n"
+                    "  /seq def N STEPS  Define a sequence, e.g. hex 01; delay 500us; hex 02\n"
+                    "  /seq load FILE    Load [NAME] sections of steps from FILE\n"
+                    "  /gen N FIELDS     Generated fields, e.g. /gen 1 rolling 6; crc8 7 (off, reset)\n"
+                    "  /crc tx ALGO|off  Append a checksum to presets, inline repeats, /hex, /can\n"
+                    "  /crc rx add M ALGO  Verify CAN RX, e.g. can 0x100/0x7F0 crc8 at 7 (del N, clear)\n"
+                    "  /crc [ALGO XX ..] Checksum rules and error counts, or compute one\n"
+                    "  /stress load 60%% Generate CAN traffic (rate N, burst N; ids, dlc, ext, for S)\n"
+                    "  /stress [stop]    Offered vs achieved rate, ENOBUFS/EAGAIN, stalls\n"
+                    "  /find id|hex|text Q  Search the scrollback (e.g. /find id 0x123)\n"
+                    "  /pager            Scroll back while traffic continues (q to quit)\n"
+                    "  /modbus on|off    Decode serial RX as Modbus RTU\n"
+                    "  /modbus stats     Per-slave response times and CRC errors\n"
                     "  /clear            Clear screen\n"
                     "  /device PATH      Change device path\n"
                     "  /baud RATE        Change baud rate\n"
@@ -738,12 +999,95 @@ int main(int argc, char* argv[])
             else if (cmd == "status") {
                 std::printf("\r\n");
                 if (itype == InterfaceType::SERIAL) {
-                    std::printf("  Device: %s @ %s baud\n", cfg["device"].c_str(), cfg["baud"].c_str());
+                    std::printf("  Device: %s @ %s\n", cfg["device"].c_str(), baud_report(cfg, applied_baud).c_str());
                 } else {
-                    std::printf("  CAN: %s @ %s bps (ID: %s)\n", cfg["can_interface"].c_str(), 
-                                cfg["can_bitrate"].c_str(), cfg["can_id"].c_str());
+                    // Live link state from the kernel, not just the configured bitrate
+                    CanLinkInfo link;
+                    std::string live;
+                    if (canlink_query(cfg["can_interface"], link) == 0) {
+                        live = link.up ? "up" : "DOWN";
+                        if (link.bitrate != 0) live += ", " + std::to_string(link.bitrate) + " bps";
+                        if (!link.state.empty()) live += ", " + link.state;
+                    } else {
+                        live = "not present";
+                    }
+                    std::printf("  CAN: %s @ %s bps (ID: %s) [%s]\n", cfg["can_interface"].c_str(),
+                                cfg["can_bitrate"].c_str(), cfg["can_id"].c_str(), live.c_str());
+                    std::printf("  RX: rcvbuf %d KB%s, %s%llu frames dropped by the kernel\n", g_canrx.rcvbuf / 1024,
+                                g_canrx.forced ? " (forced)" : "", g_canrx.ovfl ? "" : "drop counter unavailable, ",
+                                static_cast<unsigned long long>(g_canrx.dropped));
                 }
                 std::printf("  Mode: %s, CRLF: %s\n", cfg["mode"].c_str(), append_crlf ? "on" : "off");
+                if (g_isotp.enabled) {
+                    std::printf("  ISO-TP: on (TX 0x%03X, RX 0x%03X, BS %u, STmin 0x%02X, padding %s)\n",
+                                g_isotp.tx_id, g_isotp.rx_id, g_isotp.block_size, g_isotp.st_min,
+                                g_isotp.padding ? "on" : "off");
+                }
+                if (g_j1939.enabled) {
+                    std::printf("  J1939: on (%llu frames, %zu PGN/SA pairs)\n",
+                                static_cast<unsigned long long>(g_j1939.frames), g_j1939.stats_used);
+                }
+                if (!g_dbc.files.empty()) {
+                    std::printf("  DBC: %s (%zu files, %zu messages, %zu signals)\n",
+                                g_dbc.enabled ? "on" : "off", g_dbc.files.size(),
+                                g_dbc.messages.size(), g_dbc.signals.size());
+                }
+                if (!g_trigger.triggers.empty()) {
+                    std::printf("  Triggers: %s (%zu defined)\n", g_trigger.enabled ? "on" : "off",
+                                g_trigger.triggers.size());
+                }
+                if (!g_responder.entries.empty()) {
+                    std::printf("  Auto-responder: %s (%zu entries, %llu sent)\n",
+                                g_responder.enabled ? "on" : "off", g_responder.entries.size(),
+                                static_cast<unsigned long long>(g_responder.sent));
+                }
+                if (g_trigger.capture) {
+                    std::printf("  Capture: %s (%llu events)\n", g_trigger.capture_path.c_str(),
+                                static_cast<unsigned long long>(g_trigger.capture_events));
+                }
+                if (g_output.format != OutputFormat::NONE) {
+                    std::printf("  Output: %s to %s (%llu events)\n",
+                                g_output.format == OutputFormat::JSONL ? "jsonl" : "csv",
+                                g_output.path == "-" ? "stdout" : g_output.path.c_str(),
+                                static_cast<unsigned long long>(g_output.events));
+                }
+                if (g_serve.listen_fd >= 0) {
+                    std::printf("  Serving: %s (%zu clients)\n", g_serve.path.c_str(), g_serve.clients.size());
+                }
+                if (cfg["metrics_file"] != "none") {
+                    std::printf("  Metrics: %s\n", cfg["metrics_file"].c_str());
+                }
+                if (g_reconnect.down) {
+                    std::printf("  Link: DOWN (%s), reconnecting, attempt %u\n", g_reconnect.reason.c_str(),
+                                g_reconnect.attempts + 1);
+                } else if (g_reconnect.reconnects > 0) {
+                    std::printf("  Reconnects: %llu (last outage %.0f ms)\n",
+                                static_cast<unsigned long long>(g_reconnect.reconnects), g_reconnect.last_down_ms);
+                }
+                if (g_txq.can_queued > 0 || g_txq.can_dropped > 0) {
+                    std::printf("  TX queue: %zu CAN frames parked (max %zu), ENOBUFS %llu, EAGAIN %llu, "
+                                "%llu dropped (/txq)\n", g_txq.can_count, g_txq.can_max_depth,
+                                static_cast<unsigned long long>(g_txq.can_enobufs),
+                                static_cast<unsigned long long>(g_txq.can_eagain),
+                                static_cast<unsigned long long>(g_txq.can_dropped));
+                }
+                if (g_txq.queued_bytes > 0 || g_txq.overflows > 0) {
+                    std::printf("  TX queue: %zu bytes pending (max %zu), %llu stalls, %llu refused, "
+                                "%llu repeat slots skipped\n", txq_depth(), g_txq.max_depth,
+                                static_cast<unsigned long long>(g_txq.stalls),
+                                static_cast<unsigned long long>(g_txq.overflows),
+                                static_cast<unsigned long long>(g_txq.skipped_repeats));
+                }
+                if (g_shm.hdr) {
+                    std::printf("  Shared memory: %s (%llu events)\n", g_shm.name.c_str(),
+                                static_cast<unsigned long long>(g_shm.next_seq - 1));
+                }
+                if (g_modbus.enabled) {
+                    std::printf("  Modbus RTU: on (t3.5 %d us, %llu frames, %llu CRC errors)\n",
+                                g_modbus.silence_us,
+                                static_cast<unsigned long long>(g_modbus.frames),
+                                static_cast<unsigned long long>(g_modbus.crc_errors));
+                }
                 // Show active repeats
                 bool any_repeat = false;
                 
@@ -908,13 +1252,17 @@ int main(int argc, char* argv[])
                     update_prompt_display(dynamic_prompt);
                     return;
                 }
-                if (itype == InterfaceType::CAN) {
+                if (itype == InterfaceType::CAN && data.size() > 8 && g_isotp.enabled) {
+                    // Segmented payloads go to the ISO-TP TX ID so flow control pairs up
+                    bool ok = isotp_send(fd, g_isotp.tx_id, data);
+                    std::printf("\r\n%s\n", ok ? "Sent" : "Failed");
+                } else if (itype == InterfaceType::CAN) {
                     uint32_t canid = 0x123;
                     try { canid = std::stoul(cfg["can_id"], nullptr, 16); } catch (...) {}
-                    bool ok = send_can_bytes(fd, canid, data);
+                    bool ok = send_can_payload(fd, canid, data.data(), data.size());
                     std::printf("\r\n%s\n", ok ? "Sent" : "Failed");
                 } else {
-                    bool ok = send_serial_bytes(fd, data);
+                    bool ok = send_serial_payload(fd, data.data(), data.size());
                     std::printf("\r\n%s\n", ok ? "Sent" : "Failed");
                 }
             }
@@ -938,7 +1286,17 @@ int main(int argc, char* argv[])
                     return;
                 }
 
-                bool ok = send_can_bytes(fd, canid, data);
+                if (data.size() > 8 && g_isotp.enabled) {
+                    bool ok = isotp_send(fd, canid, data);
+                    std::printf("\r\nISO-TP %s (%zu bytes)\n", ok ? "started" : "failed", data.size());
+                    update_prompt_display(dynamic_prompt);
+                    return;
+                }
+                if (data.size() > 8) {
+                    std::printf("\r\nWarning: CAN data truncated to 8 bytes (/isotp on for longer payloads).\n");
+                }
+
+                bool ok = send_can_payload(fd, canid, data.data(), data.size());
                 std::printf("\r\n%s\n", ok ? "Sent" : "Failed");
             }
             else if (cmd == "device") {
@@ -950,9 +1308,58 @@ int main(int argc, char* argv[])
                     std::printf("\r\nDevice set to %s (reconnect with Ctrl-T menu)\n", arg.c_str());
                 }
             }
+            else if (cmd == "reconnect") {
+                std::string a = to_lower(arg);
+                if (a == "on" || a == "off") {
+                    cfg["auto_reconnect"] = a;
+                    write_profile(cfg_path, cfg);
+                    g_reconnect.enabled = (a == "on");
+                }
+                if (a.empty() || a == "on" || a == "off") {
+                    reconnect_print_status();
+                } else {
+                    std::printf("\r\nUsage: /reconnect [on|off]\n");
+                }
+            }
+            else if (cmd == "txq") {
+                std::string a = to_lower(arg);
+                if (a == "clear") {
+                    size_t n = txq_depth() + g_txq.can_count;
+                    txq_reset();
+                    std::printf("\r\nDropped %zu queued %s\n", n, itype == InterfaceType::CAN ? "frames" : "bytes");
+                } else if (a.empty()) {
+                    txq_print_status(itype == InterfaceType::CAN ? cfg["can_interface"] : "");
+                } else {
+                    std::printf("\r\nUsage: /txq [clear]\n");
+                }
+            }
+            else if (cmd == "latency") {
+                std::string a = to_lower(arg);
+                LatencyProfile profile;
+                if (a.empty()) {
+                    if (itype == InterfaceType::SERIAL) {
+                        latency_print();
+                    } else {
+                        std::printf("\r\nLatency profiles apply to serial ports only.\n");
+                    }
+                } else if (latency_parse_profile(a, profile)) {
+                    cfg["latency"] = a;
+                    write_profile(cfg_path, cfg);
+                    if (itype == InterfaceType::SERIAL) {
+                        latency_apply(fd, cfg);
+                        latency_print();
+                    } else {
+                        std::printf("\r\nLatency set to %s (applies to serial ports)\n", a.c_str());
+                    }
+                } else {
+                    std::printf("\r\nUsage: /latency [low|balanced|throughput]\n");
+                }
+            }
             else if (cmd == "baud") {
-                if (arg.empty()) {
-                    std::printf("\r\nUsage: /baud RATE\n");
+                bool valid = false;
+                try { valid = get_baud_numeric(arg) > 0; } catch (...) {}
+                if (!valid) {
+                    std::printf("\r\nUsage: /baud RATE (any positive integer)\n");
                 } else {
                     cfg["baud"] = arg;
                     write_profile(cfg_path, cfg);
@@ -1043,12 +1450,8 @@ int main(int argc, char* argv[])
                     g_inline_repeat.text_data = text;
                     
                     // Send first message immediately
-                    struct can_frame frame{};
-                    frame.can_id = g_inline_repeat.can_id;
-                    frame.can_dlc = static_cast<uint8_t>(text.size());
-                    std::memcpy(frame.data, text.c_str(), text.size());
-                    ssize_t w = write(fd, &frame, sizeof(frame));
-                    if (w < 0) {
+                    if (!send_can_bytes(fd, g_inline_repeat.can_id,
+                                        reinterpret_cast<const uint8_t*>(text.data()), text.size())) {
                         std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                         g_inline_repeat.enabled = false;
                     } else {
@@ -1058,10 +1461,7 @@ int main(int argc, char* argv[])
                     }
                 } else {
                     // Serial text - send first message immediately
-                    std::string msg = text;
-                    if (append_crlf) msg += "\r\n";
-                    ssize_t w = write(fd, msg.c_str(), msg.size());
-                    if (w < 0) {
+                    if (!send_serial_text(fd, text, append_crlf)) {
                         std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                         g_inline_repeat.enabled = false;
                     } else {
@@ -1071,6 +1471,583 @@ int main(int argc, char* argv[])
                     }
                 }
             }
+            else if (cmd == "tp") {
+                // /tp XX XX ... - send ISO-TP payload to the configured TX ID
+                std::vector<uint8_t> data;
+                if (itype != InterfaceType::CAN) {
+                    std::printf("\r\nISO-TP is only available in CAN mode.\n");
+                } else if (!g_isotp.enabled) {
+                    std::printf("\r\nISO-TP is off. Enable with /isotp on\n");
+                } else if (!parse_hex_bytes(arg, data) || data.empty()) {
+                    std::printf("\r\nUsage: /tp XX XX XX ...\n");
+                } else {
+                    bool ok = isotp_send(fd, g_isotp.tx_id, data);
+                    std::printf("\r\nISO-TP %s (%zu bytes to 0x%03X)\n", ok ? "started" : "failed",
+                                data.size(), g_isotp.tx_id);
+                }
+            }
+            else if (cmd == "isotp") {
+                // /isotp on|off|status | tx ID | rx ID | bs N | stmin N | pad on|off | padbyte XX
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                std::string key;
+                bool valid = true;
+                bool refused = false;
+
+                if (sub.empty() || sub == "status") {
+                    isotp_print_status();
+                } else if (sub == "on" && itype != InterfaceType::CAN) {
+                    std::printf("\r\nISO-TP is only available in CAN mode\n");
+                    refused = true;
+                } else if (sub == "on" || sub == "off") {
+                    cfg["isotp"] = sub;
+                    g_isotp.enabled = (sub == "on");
+                    std::printf("\r\nISO-TP %s\n", g_isotp.enabled ? "on" : "off");
+                } else if (sub == "tx" || sub == "rx" || sub == "padbyte") {
+                    key = (sub == "tx") ? "isotp_tx_id" : (sub == "rx") ? "isotp_rx_id" : "isotp_pad_byte";
+                    valid = is_valid_can_id_token(val) || is_valid_hex_token(val);
+                } else if (sub == "bs" || sub == "stmin") {
+                    key = (sub == "bs") ? "isotp_bs" : "isotp_stmin";
+                    unsigned long v = 256;
+                    try { v = std::stoul(val, nullptr, 0); } catch (...) {}
+                    valid = (v <= 255);
+                } else if (sub == "pad") {
+                    key = "isotp_padding";
+                    val = to_lower(val);
+                    valid = (val == "on" || val == "off");
+                } else {
+                    valid = false;
+                }
+
+                if (refused) {
+                    // Nothing changed
+                } else if (!valid) {
+                    std::printf("\r\nUsage: /isotp on|off|status | tx ID | rx ID | bs N | stmin N |"
+                                " pad on|off | padbyte XX\n");
+                } else if (!key.empty()) {
+                    cfg[key] = val;
+                    isotp_configure(cfg);
+                    std::printf("\r\nISO-TP %s set to %s\n", sub.c_str(), val.c_str());
+                }
+                if (valid && !refused && sub != "status" && !sub.empty()) {
+                    write_profile(cfg_path, cfg);
+                }
+            }
+            else if (cmd == "j1939") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                val = to_lower(val);
+                if (sub == "on" || sub == "off") {
+                    cfg["j1939"] = sub;
+                    write_profile(cfg_path, cfg);
+                    g_j1939.enabled = (sub == "on");
+                    std::printf("\r\nJ1939 decoding %s\n", sub.c_str());
+                } else if (sub == "frames" && (val == "on" || val == "off")) {
+                    cfg["j1939_frames"] = val;
+                    write_profile(cfg_path, cfg);
+                    g_j1939.show_frames = (val == "on");
+                    std::printf("\r\nJ1939 per-frame output %s\n", val.c_str());
+                } else if (sub.empty() || sub == "stats") {
+                    j1939_print_stats(val == "all" ? 0 : 20);
+                } else if (sub == "reset") {
+                    j1939_reset_stats();
+                    std::printf("\r\nJ1939 statistics cleared.\n");
+                } else {
+                    std::printf("\r\nUsage: /j1939 on|off | stats [all] | reset | frames on|off\n");
+                }
+            }
+            else if (cmd == "dbc") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                if (sub == "load" && !val.empty()) {
+                    std::string report;
+                    if (dbc_load(val, report)) {
+                        cfg["dbc"] = (cfg["dbc"] == "none") ? val : cfg["dbc"] + "," + val;
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\n%s\n", report.c_str());
+                    } else {
+                        std::printf("\r\nDBC: %s\n", report.c_str());
+                    }
+                } else if (sub == "on" || sub == "off") {
+                    cfg["dbc_decode"] = sub;
+                    write_profile(cfg_path, cfg);
+                    g_dbc.enabled = (sub == "on");
+                    std::printf("\r\nDBC decoding %s\n", sub.c_str());
+                } else if (sub == "clear") {
+                    dbc_clear();
+                    cfg["dbc"] = "none";
+                    write_profile(cfg_path, cfg);
+                    std::printf("\r\nDBC databases cleared.\n");
+                } else if (sub.empty() || sub == "info") {
+                    std::printf("\r\nDBC decoding %s: %zu messages, %zu signals\n",
+                                g_dbc.enabled ? "on" : "off",
+                                g_dbc.messages.size(), g_dbc.signals.size());
+                    for (const auto& f : g_dbc.files) {
+                        std::printf("  %s\n", f.c_str());
+                    }
+                } else {
+                    std::printf("\r\nUsage: /dbc load FILE | on | off | clear | info\n");
+                }
+            }
+            else if (cmd == "trig" || cmd == "trigger") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                if (sub == "add" && !val.empty()) {
+                    std::string error;
+                    if (trigger_add(val, error)) {
+                        trigger_save(cfg);
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nTrigger %zu added.\n", g_trigger.triggers.size());
+                    } else {
+                        std::printf("\r\nInvalid trigger: %s\n", error.c_str());
+                    }
+                } else if ((sub == "del" || sub == "rm") && is_valid_positive_int(val)) {
+                    if (trigger_remove(static_cast<size_t>(std::stoul(val)) - 1)) {
+                        trigger_save(cfg);
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nTrigger %s deleted.\n", val.c_str());
+                    } else {
+                        std::printf("\r\nNo trigger %s\n", val.c_str());
+                    }
+                } else if (sub == "clear") {
+                    trigger_clear();
+                    trigger_save(cfg);
+                    write_profile(cfg_path, cfg);
+                    std::printf("\r\nAll triggers deleted.\n");
+                } else if (sub == "on" || sub == "off") {
+                    cfg["triggers"] = sub;
+                    write_profile(cfg_path, cfg);
+                    g_trigger.enabled = (sub == "on");
+                    std::printf("\r\nTriggers %s\n", sub.c_str());
+                } else if (sub.empty() || sub == "list") {
+                    trigger_print_list();
+                } else {
+                    std::printf("\r\nUsage: /trig add MATCH -> ACTION | del N | clear | on | off | list\n"
+                                "  MATCH:  can ID[/MASK] [XX|?? ...] | hex XX XX ... | text STRING\n"
+                                "  ACTION: preset N | repeat N start|stop | capture start|stop | dump | bell\n");
+                }
+            }
+            else if (cmd == "resp" || cmd == "respond") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                if (sub == "add" && !val.empty()) {
+                    std::string error;
+                    if (responder_add(val, cfg, error)) {
+                        responder_save(cfg);
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nResponder %zu added.\n", g_responder.entries.size());
+                    } else {
+                        std::printf("\r\nInvalid responder: %s\n", error.c_str());
+                    }
+                } else if ((sub == "del" || sub == "rm") && is_valid_positive_int(val)) {
+                    if (responder_remove(static_cast<size_t>(std::stoul(val)) - 1)) {
+                        responder_save(cfg);
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nResponder %s deleted.\n", val.c_str());
+                    } else {
+                        std::printf("\r\nNo responder %s\n", val.c_str());
+                    }
+                } else if (sub == "clear") {
+                    responder_clear();
+                    responder_save(cfg);
+                    write_profile(cfg_path, cfg);
+                    std::printf("\r\nAll responders deleted.\n");
+                } else if (sub == "on" || sub == "off") {
+                    cfg["responder"] = sub;
+                    write_profile(cfg_path, cfg);
+                    g_responder.enabled = (sub == "on");
+                    std::printf("\r\nAuto-responder %s\n", sub.c_str());
+                } else if (sub == "log" && (val == "on" || val == "off")) {
+                    cfg["responder_log"] = val;
+                    write_profile(cfg_path, cfg);
+                    g_responder.log = (val == "on");
+                    std::printf("\r\nResponse logging %s\n", val.c_str());
+                } else if (sub == "reset") {
+                    responder_reset_stats();
+                    std::printf("\r\nResponder statistics cleared.\n");
+                } else if (sub.empty() || sub == "list" || sub == "stats") {
+                    responder_print_status();
+                } else {
+                    std::printf("\r\nUsage: /resp add MATCH -> RESPONSE [delay MS] | del N | clear | on | off | log on|off | reset | list\n"
+                                "  MATCH:    can ID[/MASK] [XX|?? ...] | hex XX XX ... | text STRING\n"
+                                "  RESPONSE: can ID XX ... | hex XX ... | text STRING | preset N\n");
+                }
+            }
+            else if (cmd == "seq") {
+                auto [sub, val] = split_first(arg);
+                std::string error;
+                if (sub.empty() || to_lower(sub) == "list") {
+                    seq_print_list();
+                } else if (to_lower(sub) == "stop") {
+                    if (val.empty()) {
+                        if (g_seq.runs.empty()) std::printf("\r\nNo sequences running\n");
+                        seq_stop_all();
+                    } else if (!seq_stop(val)) {
+                        std::printf("\r\nSequence %s is not running\n", val.c_str());
+                    }
+                } else if (to_lower(sub) == "show" && !val.empty()) {
+                    if (!seq_print_steps(val)) {
+                        std::printf("\r\nNo sequence '%s'\n", val.c_str());
+                    }
+                } else if (to_lower(sub) == "load" && !val.empty()) {
+                    int n = seq_load_file(val, cfg, error);
+                    if (n < 0) {
+                        std::printf("\r\nSequence file: %s\n", error.c_str());
+                    } else {
+                        std::printf("\r\n%d sequence%s loaded from %s\n", n, n == 1 ? "" : "s", val.c_str());
+                    }
+                } else if (to_lower(sub) == "def" && !val.empty()) {
+                    auto [name, steps] = split_first(val);
+                    if (seq_define(name, steps, cfg, error)) {
+                        cfg["seq_" + name] = steps;
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nSequence %s defined.\n", name.c_str());
+                    } else {
+                        std::printf("\r\nInvalid sequence: %s\n", error.c_str());
+                    }
+                } else if (val.empty() && seq_start(sub, error)) {
+                    print_message_above("SEQ[" + sub + "] started");
+                } else {
+                    if (!error.empty()) std::printf("\r\n%s\n", error.c_str());
+                    std::printf("\r\nUsage: /seq NAME | stop [NAME] | list | show NAME | load FILE | def NAME STEPS\n"
+                                "  STEPS: step; step; ...  loop N | can ID XX .. | hex XX .. | text S | preset N |\n"
+                                "         delay 500us|2ms|1s | wait MATCH [timeout T]\n");
+                }
+            }
+            else if (cmd == "gen") {
+                auto [sub, val] = split_first(arg);
+                int preset = 0;
+                try { preset = std::stoi(sub); } catch (...) {}
+                std::string error;
+                if (sub.empty() || to_lower(sub) == "list") {
+                    gen_print(itype);
+                } else if (preset >= 1 && preset <= 10 && to_lower(val) == "reset") {
+                    if (gen_compile(preset, cfg["preset" + sub + "_gen"], cfg, itype, error)) {
+                        std::printf("\r\nPreset %d generator reset.\n", preset);
+                    } else {
+                        std::printf("\r\nPreset %d generator: %s\n", preset, error.c_str());
+                    }
+                } else if (preset >= 1 && preset <= 10 && !val.empty()) {
+                    std::string spec = (to_lower(val) == "off") ? "" : val;
+                    if (gen_compile(preset, spec, cfg, itype, error)) {
+                        cfg["preset" + sub + "_gen"] = spec;
+                        write_profile(cfg_path, cfg);
+                        if (spec.empty()) {
+                            std::printf("\r\nPreset %d generator removed.\n", preset);
+                        } else {
+                            std::printf("\r\nPreset %d generator: %zu field%s.\n", preset,
+                                        gen_job(preset)->ops.size(), gen_job(preset)->ops.size() == 1 ? "" : "s");
+                        }
+                    } else {
+                        std::printf("\r\nInvalid generator: %s\n", error.c_str());
+                    }
+                } else {
+                    std::printf("\r\nUsage: /gen [list] | N FIELD; FIELD; ... | N off | N reset\n"
+                                "  FIELD: counter B | rolling B [hi] | inc16 B [STEP] | random B |\n"
+                                "         timestamp B [16|32] | ALGO B [FROM-TO]   (B = byte index from 0)\n"
+                                "  ALGO:  crc8, crc8-autosar, crc16-modbus, crc16-ccitt, crc32, crc32c, xor, sum8\n");
+                }
+            }
+            else if (cmd == "crc" || cmd == "checksum") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                std::string error;
+                if (sub.empty() || sub == "list" || sub == "status") {
+                    checksum_print_status();
+                } else if (sub == "tx" && !val.empty()) {
+                    if (checksum_set_tx(to_lower(val), error)) {
+                        checksum_save(cfg);
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nTX checksum: %s\n",
+                                    g_checksum.tx_enabled ? checksum_name(g_checksum.tx_kind) : "off");
+                    } else {
+                        std::printf("\r\n%s\n", error.c_str());
+                    }
+                } else if (sub == "rx") {
+                    auto [op, spec] = split_first(val);
+                    op = to_lower(op);
+                    if (op == "add" && !spec.empty()) {
+                        if (checksum_rule_add(spec, error)) {
+                            checksum_save(cfg);
+                            write_profile(cfg_path, cfg);
+                            std::printf("\r\nRX checksum rule %zu added.\n", g_checksum.rules.size());
+                        } else {
+                            std::printf("\r\nInvalid rule: %s\n", error.c_str());
+                        }
+                    } else if ((op == "del" || op == "rm") && is_valid_positive_int(spec)) {
+                        if (checksum_rule_remove(static_cast<size_t>(std::stoul(spec)) - 1)) {
+                            checksum_save(cfg);
+                            write_profile(cfg_path, cfg);
+                            std::printf("\r\nRX checksum rule %s deleted.\n", spec.c_str());
+                        } else {
+                            std::printf("\r\nNo rule %s\n", spec.c_str());
+                        }
+                    } else if (op == "clear") {
+                        g_checksum.rules.clear();
+                        checksum_save(cfg);
+                        write_profile(cfg_path, cfg);
+                        std::printf("\r\nAll RX checksum rules deleted.\n");
+                    } else {
+                        checksum_print_status();
+                    }
+                } else if (sub == "reset") {
+                    checksum_reset_stats();
+                    std::printf("\r\nChecksum counters cleared.\n");
+                } else if (!sub.empty() && !val.empty()) {
+                    // One-off calculation: /crc ALGO XX XX ...
+                    ChecksumKind kind;
+                    std::vector<uint8_t> data;
+                    if (checksum_parse(sub, kind) && parse_hex_bytes(val, data)) {
+                        uint8_t out[4];
+                        size_t w = checksum_store(kind, checksum(kind, data.data(), data.size()), out);
+                        std::printf("\r\n%s:", checksum_name(kind));
+                        for (size_t i = 0; i < w; ++i) std::printf(" %02X", out[i]);
+                        std::printf("\n");
+                    } else {
+                        std::printf("\r\nUsage: /crc ALGO XX XX ...\n");
+                    }
+                } else {
+                    std::printf("\r\nUsage: /crc [status] | tx ALGO|off | rx add MATCH ALGO [at POS] | rx del N | rx clear |\n"
+                                "       reset | ALGO XX XX ...\n"
+                                "  ALGO: crc8 (SAE J1850), crc8-autosar, crc16-modbus, crc16-ccitt, crc32, crc32c, xor, sum8\n");
+                }
+            }
+            else if (cmd == "stress") {
+                std::string sub = to_lower(split_first(arg).first);
+                std::string error;
+                if (sub.empty() || sub == "status") {
+                    loadgen_print_status();
+                } else if (sub == "stop") {
+                    if (g_loadgen.mode == LoadGenMode::OFF) std::printf("\r\nLoad generator is not running\n");
+                    loadgen_stop("stopped");
+                } else if (itype != InterfaceType::CAN) {
+                    std::printf("\r\nThe load generator needs a CAN interface\n");
+                } else if (loadgen_start(to_lower(arg), g_busload.bitrate, error)) {
+                    std::printf("\r\nLoad generator started (/stress for rates, /stress stop)\n");
+                } else {
+                    std::printf("\r\n%s\n", error.c_str());
+                    std::printf("Usage: /stress load P%% | rate FRAMES/S | burst N [ids LO-HI|A,B,..] [dlc N|LO-HI] [ext] [for S]\n"
+                                "       /stress [status] | stop\n");
+                }
+            }
+            else if (cmd == "find") {
+                auto [sub, val] = split_first(arg);
+                std::string kind = to_lower(sub);
+                ScrollQuery q;
+                bool valid = true;
+                if (kind == "id" && !val.empty()) {
+                    q.type = ScrollQuery::ID;
+                    try {
+                        q.id = static_cast<uint32_t>(std::stoul(val, nullptr, 16));
+                    } catch (...) {
+                        valid = false;
+                    }
+                } else if (kind == "hex" && !val.empty()) {
+                    q.type = ScrollQuery::BYTES;
+                    valid = parse_hex_bytes(val, q.needle) && !q.needle.empty();
+                } else if (!arg.empty()) {
+                    q.type = ScrollQuery::TEXT;
+                    std::string text = (kind == "text" && !val.empty()) ? val : arg;
+                    text = to_lower(text);
+                    q.needle.assign(text.begin(), text.end());
+                } else {
+                    valid = false;
+                }
+
+                if (!valid) {
+                    std::printf("\r\nUsage: /find id 0x123 | hex DE AD | text STRING | STRING\n");
+                } else {
+                    std::vector<std::string> hits;
+                    auto t0 = Clock::now();
+                    size_t n = scrollback_find(q, 50, hits);
+                    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+                    std::printf("\r\n");
+                    for (const auto& h : hits) {
+                        std::printf("%s\n", h.c_str());
+                    }
+                    std::printf("-- %zu match%s%s, %llu blocks scanned, %llu skipped, %.2f ms --\n",
+                                n, n == 1 ? "" : "es", n == 50 ? " (newest 50)" : "",
+                                static_cast<unsigned long long>(g_scrollback.last_blocks_scanned),
+                                static_cast<unsigned long long>(g_scrollback.last_blocks_skipped), ms);
+                }
+            }
+            else if (cmd == "pager" || cmd == "less") {
+                if (g_scrollback.arena.empty()) {
+                    std::printf("\r\nScrollback is disabled (scrollback_mb=0)\n");
+                } else {
+                    scrollback_pager_open();
+                }
+            }
+            else if (cmd == "scrollback") {
+                if (is_valid_positive_int(arg)) {
+                    cfg["scrollback_mb"] = arg;
+                    write_profile(cfg_path, cfg);
+                    scrollback_configure(cfg);
+                    std::printf("\r\nScrollback reset with a %s MB cap\n", arg.c_str());
+                } else {
+                    scrollback_print_status();
+                }
+            }
+            else if (cmd == "capture") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                if (sub == "start") {
+                    if (!val.empty()) {
+                        cfg["capture_file"] = val;
+                        write_profile(cfg_path, cfg);
+                    }
+                    std::string error;
+                    if (capture_start(cfg["capture_file"], error)) {
+                        std::printf("\r\nCapturing RX to %s\n", cfg["capture_file"].c_str());
+                    } else {
+                        std::printf("\r\nCapture failed: %s\n", error.c_str());
+                    }
+                } else if (sub == "stop") {
+                    unsigned long long events = g_trigger.capture_events;
+                    bool was_running = g_trigger.capture != nullptr;
+                    capture_stop();
+                    if (was_running) {
+                        std::printf("\r\nCapture stopped (%llu events).\n", events);
+                    } else {
+                        std::printf("\r\nNo capture running.\n");
+                    }
+                } else {
+                    std::printf("\r\nUsage: /capture start [FILE] | stop\n");
+                }
+            }
+            else if (cmd == "output") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                OutputFormat fmt = OutputFormat::NONE;
+                if (sub == "off") {
+                    bool was_open = g_output.format != OutputFormat::NONE;
+                    unsigned long long events = g_output.events;
+                    output_close();
+                    if (was_open) {
+                        std::printf("\r\nOutput stopped (%llu events).\n", events);
+                    } else {
+                        std::printf("\r\nNo output sink open.\n");
+                    }
+                } else if (output_parse_format(sub, fmt) && !val.empty() && val != "-") {
+                    std::string error;
+                    if (output_open(fmt, val, error)) {
+                        output_set_iface(itype == InterfaceType::CAN ? cfg["can_interface"] : cfg["device"]);
+                        std::printf("\r\nWriting %s records to %s\n", sub.c_str(), val.c_str());
+                    } else {
+                        std::printf("\r\nOutput failed: %s\n", error.c_str());
+                    }
+                } else if (sub.empty()) {
+                    output_print_status();
+                } else {
+                    std::printf("\r\nUsage: /output jsonl|csv FILE | off\n");
+                }
+            }
+            else if (cmd == "stats") {
+                metrics_print();
+            }
+            else if (cmd == "load") {
+                std::string sub = to_lower(arg);
+                if (sub == "reset") {
+                    busload_reset();
+                    std::printf("\r\nLoad windows and peaks reset.\n");
+                } else if (sub == "live on" || sub == "live off") {
+                    g_busload.live = (sub == "live on");
+                    g_busload.next_live = Clock::now() + std::chrono::seconds(1);
+                    std::printf("\r\nLive load line %s.\n", g_busload.live ? "on" : "off");
+                } else if (sub.empty()) {
+                    busload_print();
+                } else {
+                    std::printf("\r\nUsage: /load [reset | live on|off]\n");
+                }
+            }
+            else if (cmd == "trace") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                if (sub == "start" && !val.empty()) {
+                    std::string error;
+                    if (trace_start(val, error)) {
+                        std::printf("\r\nTracing to %s\n", val.c_str());
+                    } else {
+                        std::printf("\r\nTrace failed: %s\n", error.c_str());
+                    }
+                } else if (sub == "stop") {
+                    trace_stop();
+                    std::printf("\r\nTrace stopped.\n");
+                } else if (sub.empty()) {
+                    trace_print_status();
+                } else {
+                    std::printf("\r\nUsage: /trace start FILE | stop\n");
+                }
+            }
+            else if (cmd == "perf") {
+                if (to_lower(arg) == "reset") {
+                    perf_reset();
+                    std::printf("\r\nProfile window reset.\n\n");
+                } else {
+                    perf_print();
+                }
+            }
+            else if (cmd == "serve" || cmd == "clients") {
+                serve_print_status();
+            }
+            else if (cmd == "shm") {
+                auto [sub, val] = split_first(arg);
+                sub = to_lower(sub);
+                std::string iface = (itype == InterfaceType::CAN) ? cfg["can_interface"] : cfg["device"];
+                if (sub == "on") {
+                    cfg["shm"] = val.empty() ? "auto" : val;
+                    write_profile(cfg_path, cfg);
+                    std::string name = val.empty() ? shm_default_name(iface) : val;
+                    uint32_t slots = SHM_DEFAULT_SLOTS;
+                    try { slots = static_cast<uint32_t>(std::stoul(cfg["shm_slots"])); } catch (...) {}
+                    std::string error;
+                    if (shm_start(name, slots, iface, error)) {
+                        shm_print_status();
+                    } else {
+                        std::printf("\r\nShared memory failed: %s\n", error.c_str());
+                    }
+                } else if (sub == "off") {
+                    cfg["shm"] = "off";
+                    write_profile(cfg_path, cfg);
+                    shm_stop();
+                    std::printf("\r\nShared-memory export stopped.\n");
+                } else if (sub.empty()) {
+                    shm_print_status();
+                } else {
+                    std::printf("\r\nUsage: /shm on [/NAME] | off\n");
+                }
+            }
+            else if (cmd == "dump") {
+                std::printf("\r\n");
+                trigger_dump_history();
+            }
+            else if (cmd == "modbus" || cmd == "mb") {
+                std::string a = to_lower(arg);
+                if (a == "on" || a == "off") {
+                    if (a == "on" && itype != InterfaceType::SERIAL) {
+                        std::printf("\r\nModbus RTU decoding is only available in serial mode.\n");
+                        update_prompt_display(dynamic_prompt);
+                        return;
+                    }
+                    cfg["modbus"] = a;
+                    write_profile(cfg_path, cfg);
+                    modbus_configure(cfg);
+                    g_modbus.enabled = (a == "on");
+                    if (g_modbus.enabled) {
+                        std::printf("\r\nModbus RTU decoding on (char %d us, t3.5 %d us)\n",
+                                    g_modbus.char_us, g_modbus.silence_us);
+                    } else {
+                        std::printf("\r\nModbus RTU decoding off\n");
+                    }
+                } else if (a == "stats" || a.empty()) {
+                    modbus_print_stats();
+                } else if (a == "reset") {
+                    modbus_reset_stats();
+                    std::printf("\r\nModbus statistics cleared.\n");
+                } else {
+                    std::printf("\r\nUsage: /modbus on|off|stats|reset\n");
+                }
+            }
             else if (cmd == "r") {
                 std::string a = to_lower(arg);
                 std::printf("\r\nNote: Use /p N -r to start repeat, /p N -nr to stop.\n");
@@ -1096,35 +2073,34 @@ int main(int argc, char* argv[])
         if (cfg["mode"] != "hex") {
             std::string text = line;  // Send exactly what user typed
             
-            if (itype == InterfaceType::CAN) {
+            if (itype == InterfaceType::CAN && text.size() > 8 && g_isotp.enabled) {
+                // Longer text goes out as one ISO-TP message on the ISO-TP TX ID
+                std::vector<uint8_t> payload(text.begin(), text.end());
+                if (!isotp_send(fd, g_isotp.tx_id, payload)) {
+                    std::printf("\r\nISO-TP send failed\n");
+                }
+            } else if (itype == InterfaceType::CAN) {
                 // CAN text mode - max 8 chars
                 if (text.size() > 8) {
                     std::printf("\r\nWarning: CAN data truncated to 8 bytes.\n");
                     text = text.substr(0, 8);
                 }
                 
-                struct can_frame frame{};
+                uint32_t canid = 0x123;
                 try {
-                    frame.can_id = std::stoul(cfg["can_id"], nullptr, 16);
+                    canid = std::stoul(cfg["can_id"], nullptr, 16);
                 } catch (...) {
-                    frame.can_id = 0x123;
+                    canid = 0x123;
                 }
                 
-                frame.can_dlc = static_cast<uint8_t>(text.size());
-                std::memcpy(frame.data, text.c_str(), text.size());
-                
-                ssize_t w = write(fd, &frame, sizeof(frame));
-                if (w < 0) {
+                if (!send_can_bytes(fd, canid, reinterpret_cast<const uint8_t*>(text.data()), text.size())) {
                     std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                 } else {
-                    std::printf("\r\nTX[ID:0x%03X DLC:%d]\n", frame.can_id, frame.can_dlc);
+                    std::printf("\r\nTX[ID:0x%03X DLC:%zu]\n", canid, text.size());
                 }
             } else {
                 // Serial text mode
-                std::string msg = text;
-                if (append_crlf) msg += "\r\n";
-                ssize_t w = write(fd, msg.c_str(), msg.size());
-                if (w < 0) {
+                if (!send_serial_text(fd, text, append_crlf)) {
                     std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                 } else {
                     std::printf("\r\nTX[%zu bytes]\n", text.size());
@@ -1250,20 +2226,29 @@ int main(int argc, char* argv[])
 
         // Send data (HEX mode)
         if (itype == InterfaceType::CAN) {
+            if (data.size() > 8 && g_isotp.enabled && !start_inline_repeat) {
+                uint32_t canid = has_inline_id ? inline_can_id : g_isotp.tx_id;
+                if (!isotp_send(fd, canid, data)) {
+                    std::printf("\r\nISO-TP send failed\n");
+                }
+                update_prompt_display("> ");
+                return;
+            }
             if (data.size() > 8) {
-                std::printf("\r\nError: CAN data max 8 bytes (got %zu)\n", data.size());
+                std::printf("\r\nError: CAN data max 8 bytes (got %zu)%s\n", data.size(),
+                            g_isotp.enabled ? "; ISO-TP cannot be repeated" : "; use /isotp on");
                 update_prompt_display(dynamic_prompt);
                 return;
             }
             
-            struct can_frame frame{};
+            uint32_t canid = 0x123;
             if (has_inline_id) {
-                frame.can_id = inline_can_id;
+                canid = inline_can_id;
             } else {
                 try {
-                    frame.can_id = std::stoul(cfg["can_id"], nullptr, 16);
+                    canid = std::stoul(cfg["can_id"], nullptr, 16);
                 } catch (...) {
-                    frame.can_id = 0x123;
+                    canid = 0x123;
                 }
             }
             
@@ -1272,34 +2257,27 @@ int main(int argc, char* argv[])
                 g_inline_repeat.enabled = true;
                 g_inline_repeat.is_can = true;
                 g_inline_repeat.is_hex = true;
-                g_inline_repeat.can_id = frame.can_id;
+                g_inline_repeat.can_id = canid;
                 g_inline_repeat.data = data;
                 g_inline_repeat.interval_ms = inline_interval_ms;
                 g_inline_repeat.next_fire = Clock::now() + 
                     std::chrono::milliseconds(inline_interval_ms);
                 
                 // Send first message immediately
-                frame.can_dlc = static_cast<uint8_t>(data.size());
-                std::memcpy(frame.data, data.data(), data.size());
-                ssize_t w = write(fd, &frame, sizeof(frame));
-                if (w < 0) {
+                if (!send_can_payload(fd, canid, data.data(), data.size())) {
                     std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                     g_inline_repeat.enabled = false;
                 } else {
                     std::printf("\r\nInline repeat started: ID 0x%03X, %zu bytes, every %dms\n",
-                                frame.can_id, data.size(), inline_interval_ms);
+                                canid, data.size(), inline_interval_ms);
                     std::printf("Use /rs stop to stop, /ra to stop all.\n");
                 }
             } else {
                 // Send once
-                frame.can_dlc = static_cast<uint8_t>(data.size());
-                std::memcpy(frame.data, data.data(), data.size());
-                
-                ssize_t w = write(fd, &frame, sizeof(frame));
-                if (w < 0) {
+                if (!send_can_payload(fd, canid, data.data(), data.size())) {
                     std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                 } else {
-                    std::printf("\r\nTX[ID:0x%03X DLC:%d]\n", frame.can_id, frame.can_dlc);
+                    std::printf("\r\nTX[ID:0x%03X DLC:%zu]\n", canid, data.size());
                 }
             }
         } else {
@@ -1314,8 +2292,7 @@ int main(int argc, char* argv[])
                     std::chrono::milliseconds(inline_interval_ms);
                 
                 // Send first message immediately
-                ssize_t w = write(fd, data.data(), data.size());
-                if (w < 0) {
+                if (!send_serial_payload(fd, data.data(), data.size())) {
                     std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                     g_inline_repeat.enabled = false;
                 } else {
@@ -1324,8 +2301,7 @@ int main(int argc, char* argv[])
                     std::printf("Use /rs stop to stop, /ra to stop all.\n");
                 }
             } else {
-                ssize_t w = write(fd, data.data(), data.size());
-                if (w < 0) {
+                if (!send_serial_payload(fd, data.data(), data.size())) {
                     std::printf("\r\nWrite error: %s\n", std::strerror(errno));
                 } else {
                     std::printf("\r\nTX[%zu bytes]\n", data.size());
@@ -1336,8 +2312,56 @@ int main(int argc, char* argv[])
         update_prompt_display("> ");
     };
 
+    if (!serve_path.empty()) {
+        std::string error;
+        if (!serve_start(serve_path, serve_exec_line, error)) {
+            std::cerr << "Serve: " << error << "\n";
+            trace_stop();
+            close(fd);
+            latency_restore();
+            return 1;
+        }
+        print_message_above("Serving this session on " + serve_path);
+    }
+
+    // Losing the device keeps the session (repeats, triggers, sinks) and reopens it later
+    auto device_lost = [&](const std::string& reason) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+        size_t dropped = txq_depth() + g_txq.can_count;
+        txq_reset();
+        reconnect_lost(reason, dropped);
+    };
+    auto device_reopen = [&]() {
+        if (itype == InterfaceType::CAN) {
+            // No-op when the link is still up at the right bitrate
+            if (configure_can_interface(cfg["can_interface"], cfg["can_bitrate"]) < 0) return false;
+            fd = setup_can(cfg["can_interface"], cfg["can_filter"] == "none" ? "" : cfg["can_filter"]);
+        } else {
+            fd = open_serial(cfg, &applied_baud);
+        }
+        if (fd >= 0) busload_configure(cfg, itype);
+        return fd >= 0;
+    };
+
+    // Microsecond wakeups for repeats and sequences (poll() alone only has milliseconds)
+    int loop_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
     // Main event loop
     while (g_keep_running) {
+        TraceScope loop_trace(TraceKind::LOOP);
+
+        // A signal-driven --output run ends with its sink (e.g. the reader closed the pipe)
+        if (!use_stdin && output_format != OutputFormat::NONE && serve_path.empty() &&
+            g_output.format == OutputFormat::NONE) {
+            break;
+        }
+
+        // The menu needs the local terminal
+        if (g_show_menu && !g_readline_active) {
+            g_show_menu = 0;
+        }
+
         // Handle menu request
         if (g_show_menu) {
             g_show_menu = 0;
@@ -1357,26 +2381,62 @@ int main(int argc, char* argv[])
             tcsetattr(STDIN_FILENO, TCSANOW, &old_term);
             clear_screen();
 
+            // Preset edits change what the generators are built from
+            gen_configure(cfg, itype);
+
             // Handle reconnection if settings changed
             if (need_reconnect) {
-                close(fd);
+                if (fd >= 0) close(fd);
+                fd = -1;
+                txq_reset();
+                reconnect_configure(cfg, itype);
                 std::printf("Reconnecting...\n");
                 
                 if (itype == InterfaceType::CAN) {
+                    // Cheap when nothing changed: only a differing bitrate or a down link is touched
+                    configure_can_interface(cfg["can_interface"], cfg["can_bitrate"]);
+                    can_rx_configure(cfg);
                     fd = setup_can(cfg["can_interface"], cfg["can_filter"]);
-                    if (fd < 0) {
+                    if (fd < 0 && !g_reconnect.enabled) {
                         std::fprintf(stderr, "Failed to reconnect to CAN interface.\n");
                         break;
                     }
-                    std::printf("Connected to %s\n", cfg["can_interface"].c_str());
-                } else {
-                    fd = open_serial(cfg);
                     if (fd < 0) {
+                        std::fprintf(stderr, "Failed to reconnect to CAN interface, will keep trying.\n");
+                    } else {
+                        std::printf("Connected to %s\n", cfg["can_interface"].c_str());
+                    }
+                    g_trigger.can_iface = cfg["can_interface"];
+                    output_set_iface(cfg["can_interface"]);
+                    shm_set_iface(cfg["can_interface"]);
+                    metrics_set_iface(cfg["can_interface"]);
+                    busload_configure(cfg, itype);
+                    isotp_configure(cfg);
+                    g_isotp.enabled = (cfg["isotp"] == "on");
+                    g_j1939.enabled = (cfg["j1939"] == "on");
+                } else {
+                    fd = open_serial(cfg, &applied_baud);
+                    if (fd < 0 && !g_reconnect.enabled) {
                         std::fprintf(stderr, "Failed to reconnect to serial port.\n");
                         break;
                     }
-                    std::printf("Connected to %s @ %s baud\n", 
-                                cfg["device"].c_str(), cfg["baud"].c_str());
+                    if (fd < 0) {
+                        std::fprintf(stderr, "Failed to reconnect to serial port, will keep trying.\n");
+                    } else {
+                        std::printf("Connected to %s @ %s\n",
+                                    cfg["device"].c_str(), baud_report(cfg, applied_baud).c_str());
+                    }
+                    output_set_iface(cfg["device"]);
+                    shm_set_iface(cfg["device"]);
+                    metrics_set_iface(cfg["device"]);
+                    busload_configure(cfg, itype);
+                }
+                modbus_configure(cfg);
+                g_modbus.enabled = (itype == InterfaceType::SERIAL && cfg["modbus"] == "on");
+                if (fd < 0) {
+                    device_lost("reopen after settings change failed");
+                } else if (g_reconnect.down) {
+                    reconnect_restored(Clock::now());
                 }
                 std::this_thread::sleep_for(std::chrono::seconds(1));
             }
@@ -1390,55 +2450,186 @@ int main(int argc, char* argv[])
         // Calculate poll timeout based on soonest repeat
         int timeout_ms = 100;
         auto now = Clock::now();
-        
-        // Check inline repeat timeout
-        if (g_inline_repeat.enabled) {
-            auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(
-                g_inline_repeat.next_fire - now).count();
-            if (diff <= 0) {
+        {
+            ADAMCOM_PERF(SCHEDULE);
+
+            // Repeats, sequence steps, delayed auto-responses, ISO-TP frames and CAN TX retries
+            // wake the loop through the timerfd at their exact deadline; poll()'s millisecond
+            // timeout would round them early and spin
+            Clock::time_point next_fire = std::min({seq_next_deadline(), loadgen_next_deadline(),
+                                                    responder_next_deadline(), txq_can_next_retry()});
+            if (g_isotp.enabled && itype == InterfaceType::CAN) {
+                next_fire = std::min(next_fire, isotp_next_deadline());
+            }
+            if (g_inline_repeat.enabled) {
+                next_fire = std::min(next_fire, g_inline_repeat.next_fire);
+            }
+            for (const auto& r : g_preset_repeats) {
+                if (r.enabled) {
+                    next_fire = std::min(next_fire, r.next_fire);
+                }
+            }
+            if (next_fire <= now) {
                 timeout_ms = 0;
-            } else {
-                timeout_ms = static_cast<int>(std::min<long long>(timeout_ms, diff));
+            } else if (loop_timer >= 0) {
+                arm_loop_timer(loop_timer, next_fire);
+            } else if (next_fire != Clock::time_point::max()) {
+                auto diff_us = std::chrono::duration_cast<std::chrono::microseconds>(next_fire - now).count();
+                timeout_ms = static_cast<int>(std::min<long long>(timeout_ms, (diff_us + 999) / 1000));
             }
-        }
-        
-        // Check preset repeat timeouts
-        for (size_t i = 0; i < 10; ++i) {
-            if (g_preset_repeats[i].enabled) {
-                auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    g_preset_repeats[i].next_fire - now).count();
-                if (diff <= 0) {
-                    timeout_ms = 0;
-                    break;
-                } else {
-                    timeout_ms = static_cast<int>(std::min<long long>(timeout_ms, diff));
+
+            // Close a Modbus frame as soon as its t3.5 silence has elapsed
+            if (g_modbus.enabled) {
+                int mb_ms = modbus_timeout_ms(now);
+                if (mb_ms >= 0) {
+                    timeout_ms = std::min(timeout_ms, mb_ms);
+                }
+            }
+
+            // Flush buffered --output records at least every 100 ms
+            if (g_output.used > 0) {
+                int out_ms = output_timeout_ms(now);
+                if (out_ms >= 0) {
+                    timeout_ms = std::min(timeout_ms, out_ms);
                 }
             }
+
+            // Print the live /load line once a second
+            int load_ms = busload_timeout_ms(now);
+            if (load_ms >= 0) {
+                timeout_ms = std::min(timeout_ms, load_ms);
+            }
+
+            // Rewrite the metrics textfile on schedule
+            int metrics_ms = metrics_timeout_ms(now);
+            if (metrics_ms >= 0) {
+                timeout_ms = std::min(timeout_ms, metrics_ms);
+            }
+
+            // Next reopen attempt while the device is away
+            int reconnect_ms = reconnect_timeout_ms(now);
+            if (reconnect_ms >= 0) {
+                timeout_ms = std::min(timeout_ms, reconnect_ms);
+            }
         }
 
-        // Poll for events
-        struct pollfd fds[2] = {
-            {fd, POLLIN, 0},
-            {STDIN_FILENO, POLLIN, 0}
+        // Poll for events (device, keyboard, --serve listener and clients, hot-plug watch,
+        // loop timer). Device: POLLOUT only while bytes are queued or CAN frames wait after
+        // EAGAIN (after ENOBUFS the retry timer decides). Keyboard: paused under TX backpressure
+        bool want_pollout = txq_depth() > 0 || (g_txq.can_count > 0 && !g_txq.can_nobufs);
+        struct pollfd fds[2 + 1 + SERVE_MAX_CLIENTS + 2] = {
+            {fd, static_cast<short>(POLLIN | (want_pollout ? POLLOUT : 0)), 0},
+            {use_stdin && !g_txq.backpressure ? STDIN_FILENO : -1, POLLIN, 0}
         };
+        size_t nserve = serve_pollfds(fds + 2);
+        struct pollfd& notify_pfd = fds[2 + nserve];
+        notify_pfd = {g_reconnect.notify_fd, POLLIN, 0};
+        struct pollfd& timer_pfd = fds[2 + nserve + 1];
+        timer_pfd = {loop_timer, POLLIN, 0};
 
-        int rv = poll(fds, 2, timeout_ms);
+        int rv;
+        {
+            ADAMCOM_PERF(POLL_WAIT);
+            TraceScope poll_trace(TraceKind::POLL, static_cast<uint32_t>(timeout_ms));
+            rv = poll(fds, static_cast<nfds_t>(2 + nserve + 2), timeout_ms);
+            poll_trace.b = rv > 0 ? static_cast<uint32_t>(rv) : 0;
+        }
         if (rv < 0) {
             if (errno == EINTR) continue;
             std::perror("poll");
             break;
         }
 
-        // Handle inline repeat transmission
+        metric_add(Metric::POLL_WAKEUPS);
+        if (rv == 0) {
+            metric_add(Metric::POLL_TIMEOUTS);
+        }
+
+        if (timer_pfd.revents & POLLIN) {
+            uint64_t expirations;
+            [[maybe_unused]] ssize_t r = read(loop_timer, &expirations, sizeof(expirations));
+        }
+
         now = Clock::now();
+        {
+            ADAMCOM_PERF(TIMERS);
+            scrollback_pager_tick();
+            if (!g_responder.queue.empty()) {
+                responder_poll(now);
+            }
+            if (g_output.used > 0) {
+                output_poll(now);
+            }
+            metrics_poll(now);
+            busload_poll(now);
+            if (g_modbus.enabled) {
+                modbus_poll(now);
+            }
+            if (g_isotp.enabled && itype == InterfaceType::CAN) {
+                isotp_poll(fd, now);
+            }
+            if (g_j1939.enabled) {
+                j1939_poll(now);
+            }
+        }
+
+        // Reopen the device once it is back (hot-plug event or backoff expiry)
+        if (g_reconnect.down) {
+            if (notify_pfd.revents & POLLIN) {
+                reconnect_handle_notify(now);
+            }
+            if (reconnect_due(now)) {
+                if (reconnect_device_present() && device_reopen()) {
+                    reconnect_restored(Clock::now());
+                } else {
+                    reconnect_failed(now);
+                }
+            }
+        }
+
+        // Queued serial bytes go out as the port drains
+        if ((fds[0].revents & POLLOUT) && !txq_flush(fd)) {
+            print_message_above("TX error: " + std::string(std::strerror(errno)) + " (queue dropped)");
+        }
+
+        // Parked CAN frames go out once the socket takes them again
+        if (g_txq.can_count > 0 && fd >= 0 && ((fds[0].revents & POLLOUT) || now >= g_txq.can_retry_at) &&
+            !txq_flush_can(fd)) {
+            print_message_above("TX error: " + std::string(std::strerror(errno)) + " (queue dropped)");
+        }
+
+        // Under TX backpressure or while the device is away due repeat slots are skipped,
+        // not piled onto the queue; the repeats themselves stay configured
+        if (g_txq.backpressure || g_reconnect.down) {
+            uint64_t& skipped = g_reconnect.down ? g_reconnect.skipped_repeats : g_txq.skipped_repeats;
+            if (g_inline_repeat.enabled && now >= g_inline_repeat.next_fire) {
+                ++skipped;
+                g_inline_repeat.next_fire = now + std::chrono::milliseconds(g_inline_repeat.interval_ms);
+            }
+            for (auto& r : g_preset_repeats) {
+                if (r.enabled && now >= r.next_fire) {
+                    ++skipped;
+                    r.next_fire = now + std::chrono::milliseconds(r.interval_ms);
+                }
+            }
+        }
+
+        // Handle inline repeat transmission
         if (g_inline_repeat.enabled && now >= g_inline_repeat.next_fire) {
+            ADAMCOM_PERF(REPEAT);
+            auto late_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - g_inline_repeat.next_fire).count());
+            TraceScope repeat_trace(TraceKind::TIMER, 0, static_cast<uint32_t>(late_us));
+            metric_add(Metric::REPEAT_FIRES);
+            metric_observe(MetricHist::REPEAT_LATENESS, late_us);
             bool ok = false;
             std::string msg;
             
             if (g_inline_repeat.is_can) {
                 // CAN mode
                 if (g_inline_repeat.is_hex) {
-                    ok = send_can_bytes(fd, g_inline_repeat.can_id, g_inline_repeat.data);
+                    ok = send_can_payload(fd, g_inline_repeat.can_id, g_inline_repeat.data.data(),
+                                          g_inline_repeat.data.size());
                     char buf[64];
                     std::snprintf(buf, sizeof(buf), "TX[Inline ID:0x%03X DLC:%zu]%s",
                                   g_inline_repeat.can_id, g_inline_repeat.data.size(),
@@ -1446,12 +2637,9 @@ int main(int argc, char* argv[])
                     msg = buf;
                 } else {
                     // CAN text mode
-                    struct can_frame frame{};
-                    frame.can_id = g_inline_repeat.can_id;
-                    frame.can_dlc = static_cast<uint8_t>(std::min(g_inline_repeat.text_data.size(), size_t(8)));
-                    std::memcpy(frame.data, g_inline_repeat.text_data.c_str(), frame.can_dlc);
-                    ssize_t w = write(fd, &frame, sizeof(frame));
-                    ok = (w == sizeof(frame));
+                    ok = send_can_bytes(fd, g_inline_repeat.can_id,
+                                        reinterpret_cast<const uint8_t*>(g_inline_repeat.text_data.data()),
+                                        std::min(g_inline_repeat.text_data.size(), size_t(8)));
                     char buf[64];
                     std::snprintf(buf, sizeof(buf), "TX[Inline ID:0x%03X \"%s\"]%s",
                                   g_inline_repeat.can_id, g_inline_repeat.text_data.c_str(),
@@ -1461,18 +2649,14 @@ int main(int argc, char* argv[])
             } else {
                 // Serial mode
                 if (g_inline_repeat.is_hex) {
-                    ssize_t w = write(fd, g_inline_repeat.data.data(), g_inline_repeat.data.size());
-                    ok = (w == static_cast<ssize_t>(g_inline_repeat.data.size()));
+                    ok = send_serial_payload(fd, g_inline_repeat.data.data(), g_inline_repeat.data.size());
                     char buf[64];
                     std::snprintf(buf, sizeof(buf), "TX[Inline %zu bytes]%s",
                                   g_inline_repeat.data.size(), ok ? "" : " FAILED");
                     msg = buf;
                 } else {
                     // Serial text mode
-                    std::string send_data = g_inline_repeat.text_data;
-                    if (g_inline_repeat.append_crlf) send_data += "\r\n";
-                    ssize_t w = write(fd, send_data.c_str(), send_data.size());
-                    ok = (w == static_cast<ssize_t>(send_data.size()));
+                    ok = send_serial_text(fd, g_inline_repeat.text_data, g_inline_repeat.append_crlf);
                     char buf[128];
                     std::snprintf(buf, sizeof(buf), "TX[Inline \"%s\"]%s",
                                   g_inline_repeat.text_data.c_str(), ok ? "" : " FAILED");
@@ -1488,7 +2672,25 @@ int main(int argc, char* argv[])
         // Handle multi-preset repeat transmissions
         for (size_t i = 0; i < 10; ++i) {
             if (g_preset_repeats[i].enabled && now >= g_preset_repeats[i].next_fire) {
+                ADAMCOM_PERF(REPEAT);
+                auto late_us = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(now - g_preset_repeats[i].next_fire).count());
+                TraceScope repeat_trace(TraceKind::TIMER, static_cast<uint32_t>(i + 1), static_cast<uint32_t>(late_us));
+                metric_add(Metric::REPEAT_FIRES);
+                metric_observe(MetricHist::REPEAT_LATENESS, late_us);
                 int preset_num = static_cast<int>(i + 1);
+                // Generated presets carry a pre-built label, keeping fast repeats allocation-free
+                if (PayloadGen* job = gen_job(preset_num)) {
+                    // A ternary would copy the label into a temporary on every fire
+                    if (gen_send(fd, *job, append_crlf)) {
+                        print_message_above(job->label);
+                    } else {
+                        print_message_above("TX FAILED[Preset " + std::to_string(preset_num) + "]");
+                    }
+                    g_preset_repeats[i].next_fire = now +
+                        std::chrono::milliseconds(g_preset_repeats[i].interval_ms);
+                    continue;
+                }
                 bool ok = send_preset(fd, cfg, itype, preset_num, append_crlf);
                 std::string pname = cfg["preset" + std::to_string(preset_num) + "_name"];
                 std::string msg = ok ? 
@@ -1500,14 +2702,66 @@ int main(int argc, char* argv[])
             }
         }
 
-        // Handle incoming data
-        if (fds[0].revents & POLLIN) {
+        // Sequence steps that are due (several sequences run side by side)
+        if (!g_seq.runs.empty()) {
+            ADAMCOM_PERF(REPEAT);
+            seq_poll(now);
+        }
+
+        // Load generator / burst (paused while the interface is away)
+        if (g_loadgen.mode != LoadGenMode::OFF && !g_reconnect.down) {
+            ADAMCOM_PERF(REPEAT);
+            loadgen_poll(now);
+        }
+
+        // Handle incoming data (an unplugged device reports POLLHUP/POLLERR)
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ADAMCOM_PERF(RX_PROCESS);
+            TraceScope rx_trace(TraceKind::RX);
             if (itype == InterfaceType::CAN) {
                 struct can_frame frame{};
-                ssize_t n = read(fd, &frame, sizeof(frame));
+                ssize_t n;
+                {
+                    ADAMCOM_PERF(DEVICE_READ);
+                    n = can_read_frame(fd, frame);
+                }
+                if (n < 0 && reconnect_fatal_errno(errno)) {
+                    g_reconnect.pending_errno = errno;
+                }
+                rx_trace.a = n >= static_cast<ssize_t>(sizeof(frame)) ? frame.can_dlc : 0;
+                auto rx_time = Clock::now();
+                bool is_ext = (frame.can_id & CAN_EFF_FLAG) != 0;
+                uint32_t rx_id = frame.can_id & (is_ext ? CAN_EFF_MASK : CAN_SFF_MASK);
+                // Auto-responses go out before any decoding or rendering
                 if (n >= static_cast<ssize_t>(sizeof(frame))) {
-                    std::string msg = "RX[ID:0x" + std::to_string(frame.can_id) + " DLC:" + 
-                                      std::to_string(frame.can_dlc) + "]: ";
+                    metric_add(Metric::RX_FRAMES);
+                    metric_add(Metric::RX_BYTES, frame.can_dlc);
+                    responder_can_rx(rx_id, is_ext, frame.data, frame.can_dlc, rx_time);
+                    seq_can_rx(rx_id, is_ext, frame.data, frame.can_dlc, rx_time);
+                    output_can(OutputDir::RX, frame.can_id, frame.data, frame.can_dlc);
+                    shm_can(OutputDir::RX, frame.can_id, frame.data, frame.can_dlc);
+                    busload_can(frame.can_id, frame.data, frame.can_dlc);
+                    scrollback_add_frame(rx_id, is_ext, frame.data, frame.can_dlc);
+                    if (!g_checksum.rules.empty()) {
+                        checksum_can_rx(rx_id, is_ext, frame.data, frame.can_dlc);
+                    }
+                }
+                const DbcMessage* dbc_msg = nullptr;
+                if (n >= static_cast<ssize_t>(sizeof(frame)) && g_isotp.enabled &&
+                    isotp_handle_rx(fd, rx_id, frame.data, frame.can_dlc)) {
+                    // Consumed by ISO-TP; whole messages are printed on completion
+                } else if (n >= static_cast<ssize_t>(sizeof(frame)) && g_dbc.enabled &&
+                           (dbc_msg = dbc_find(rx_id, is_ext)) != nullptr) {
+                    char head[32];
+                    std::snprintf(head, sizeof(head), is_ext ? "RX[ID:0x%08X] " : "RX[ID:0x%03X] ", rx_id);
+                    print_message_above(head + dbc_format(*dbc_msg, frame.data, frame.can_dlc));
+                } else if (n >= static_cast<ssize_t>(sizeof(frame)) && g_j1939.enabled && is_ext) {
+                    j1939_handle_rx(rx_id, frame.data, frame.can_dlc, Clock::now());
+                } else if (n >= static_cast<ssize_t>(sizeof(frame))) {
+                    char head[48];
+                    std::snprintf(head, sizeof(head), is_ext ? "RX[ID:0x%08X DLC:%d]: " : "RX[ID:0x%03X DLC:%d]: ",
+                                  rx_id, frame.can_dlc);
+                    std::string msg = head;
                     char hex_buf[8];
                     for (int i = 0; i < frame.can_dlc; ++i) {
                         std::snprintf(hex_buf, sizeof(hex_buf), "0x%02X ", frame.data[i]);
@@ -1515,10 +2769,36 @@ int main(int argc, char* argv[])
                     }
                     print_message_above(msg);
                 }
+                if (n >= static_cast<ssize_t>(sizeof(frame))) {
+                    trigger_can_rx(rx_id, is_ext, frame.data, frame.can_dlc);
+                }
             } else {
-                char buf[256];
-                ssize_t n = read(fd, buf, sizeof(buf));
+                char buf[LATENCY_MAX_READ_CHUNK];
+                ssize_t n;
+                {
+                    ADAMCOM_PERF(DEVICE_READ);
+                    n = read(fd, buf, g_latency.read_chunk);
+                }
+                if (n == 0 || (n < 0 && reconnect_fatal_errno(errno))) {
+                    g_reconnect.pending_errno = (n == 0) ? ENODEV : errno;
+                }
+                rx_trace.a = n > 0 ? static_cast<uint32_t>(n) : 0;
                 if (n > 0) {
+                    metric_add(Metric::RX_FRAMES);
+                    metric_add(Metric::RX_BYTES, static_cast<uint64_t>(n));
+                    auto rx_time = Clock::now();
+                    responder_serial_rx(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n), rx_time);
+                    seq_serial_rx(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n), rx_time);
+                    output_serial(OutputDir::RX, reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n));
+                    shm_serial(OutputDir::RX, reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n));
+                    busload_serial(false, static_cast<size_t>(n));
+                    scrollback_add_bytes(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n));
+                    trigger_serial_rx(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n));
+                }
+                if (n > 0 && g_modbus.enabled) {
+                    modbus_feed(OutputDir::RX, reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(n),
+                                Clock::now());
+                } else if (n > 0) {
                     std::string msg = "RX[" + std::to_string(n) + " bytes]: ";
                     char hex_buf[8];
                     for (ssize_t i = 0; i < n; ++i) {
@@ -1531,12 +2811,36 @@ int main(int argc, char* argv[])
             }
         }
 
+        // A read or write hit a dead device: close it and start reconnecting
+        if (g_reconnect.pending_errno != 0 && fd >= 0) {
+            std::string reason = std::strerror(g_reconnect.pending_errno);
+            if (!g_reconnect.enabled) {
+                print_message_above("Device lost: " + reason + " (auto_reconnect is off)");
+                break;
+            }
+            device_lost(reason);
+        }
+
+        // Commands from attached clients run through the same line handler
+        if (nserve > 0) {
+            ADAMCOM_PERF(SERVE);
+            serve_handle(fds + 2, nserve);
+        }
+
         // Handle keyboard input
-        if (fds[1].revents & POLLIN) {
+        if ((fds[1].revents & POLLIN) && g_scrollback.pager) {
+            // Pager keys bypass readline; the input line is redrawn on exit
+            ADAMCOM_PERF(READLINE);
+            char c = 0;
+            if (read(STDIN_FILENO, &c, 1) == 1 && !scrollback_pager_key(c)) {
+                rl_forced_update_display();
+            }
+        } else if (fds[1].revents & POLLIN) {
+            ADAMCOM_PERF(READLINE);
             rl_callback_read_char();
 
             // Update dynamic prompt
-            if (g_dynamic_prompt && g_cfg && g_append_crlf) {
+            if (g_dynamic_prompt && g_cfg && g_append_crlf && !g_scrollback.pager) {
                 const char* line = rl_line_buffer;
                 std::string new_prompt;
 
@@ -1568,8 +2872,17 @@ int main(int argc, char* argv[])
     }
 
     // Cleanup
+    if (loop_timer >= 0) close(loop_timer);
     rl_callback_handler_remove();
+    capture_stop();
+    serve_stop();
+    metrics_poll(Clock::time_point::max());
+    trace_stop();
+    txq_drain(fd, 1000);
+    output_close();
+    shm_stop();
     close(fd);
+    latency_restore();
     write_history(hist_path.c_str());
     std::cout << "Disconnected.\n";
 
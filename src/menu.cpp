@@ -67,6 +67,37 @@ void show_manual()
     std::printf("║ /hex XX XX ...      Send raw hex bytes                                      ║\n");
     std::printf("║ /can ID XX XX       Send CAN frame (ID in hex, up to 8 data bytes)          ║\n");
     std::printf("║ /rpt MS text        Repeat text every MS milliseconds (use for text mode)   ║\n");
+    std::printf("║ /tp XX XX ...       Send ISO-TP payload of any length (CAN)                 ║\n");
+    std::printf("║ /isotp on|off       ISO-TP segmentation and reassembly (tx/rx/bs/stmin/pad) ║\n");
+    std::printf("║ /j1939 on|off       Decode extended IDs as J1939 PGN/SA/DA, reassemble TP   ║\n");
+    std::printf("║ /j1939 stats        Per-PGN/SA frame counts and rates                       ║\n");
+    std::printf("║ /dbc load FILE      Load a DBC file and decode matching CAN IDs to signals  ║\n");
+    std::printf("║ /dbc on|off|clear   Toggle DBC decoding or drop loaded databases            ║\n");
+    std::printf("║ /trig add M -> A    Trigger on CAN ID/data or serial bytes (see /trig)      ║\n");
+    std::printf("║ /trig list|del N    List triggers with fire counts, delete trigger N        ║\n");
+    std::printf("║ /resp add M -> R    Auto-respond to CAN/serial requests (delay MS optional) ║\n");
+    std::printf("║ /resp list|del N    Responders, hit counts and RX->TX latency histogram     ║\n");
+    std::printf("║ /seq NAME|stop      Run timed sequences of frames, delays and RX waits      ║\n");
+    std::printf("║ /gen N FIELDS       Alive counters, timestamps and CRC-8 computed per send  ║\n");
+    std::printf("║ /crc tx|rx ...      Append checksums on TX, verify CAN RX with error counts ║\n");
+    std::printf("║ /stress load|burst  Generate CAN load or bursts, offered vs achieved rate   ║\n");
+    std::printf("║ /find id|hex|text Q Search the scrollback ring (newest 50 matches)          ║\n");
+    std::printf("║ /pager              Page back through RX/TX while live traffic continues    ║\n");
+    std::printf("║ /scrollback [MB]    Show scrollback usage or set its memory cap             ║\n");
+    std::printf("║ /capture start|stop Append RX to a candump-format log file                  ║\n");
+    std::printf("║ /dump               Print the pre-trigger RX history                        ║\n");
+    std::printf("║ /output jsonl|csv F Write RX/TX records as JSON Lines or CSV (/output off)  ║\n");
+    std::printf("║ /shm on|off         Publish RX/TX to a lock-free shared-memory ring (/NAME) ║\n");
+    std::printf("║ /serve              Show the --serve socket and attached clients            ║\n");
+    std::printf("║ /latency [P]        Serial latency profile: low, balanced or throughput     ║\n");
+    std::printf("║ /reconnect [on|off] Auto-reconnect after unplug, outage and reconnect times ║\n");
+    std::printf("║ /txq [clear]        TX queue depth, ENOBUFS/EAGAIN, drops and retry latency ║\n");
+    std::printf("║ /load [reset]       Bus load / line occupancy over 100 ms, 1 s, 10 s        ║\n");
+    std::printf("║ /stats              Counters, latency histograms and queue depths           ║\n");
+    std::printf("║ /perf [reset]       Main-loop time per stage (built with make profile)      ║\n");
+    std::printf("║ /trace start F|stop Chrome/Perfetto trace of loop, poll, RX, TX and render  ║\n");
+    std::printf("║ /modbus on|off      Decode serial RX as Modbus RTU frames                   ║\n");
+    std::printf("║ /modbus stats       Per-slave response times and CRC error rates            ║\n");
     std::printf("║ /clear              Clear screen                                            ║\n");
     std::printf("║ /device PATH        Switch serial device (e.g., /device /dev/ttyUSB1)       ║\n");
     std::printf("║ /baud RATE          Change baud rate (e.g., /baud 115200)                   ║\n");
@@ -379,7 +410,7 @@ bool show_settings_menu(Config& cfg, InterfaceType& itype,
 
             case 'B':
                 if (itype == InterfaceType::SERIAL) {
-                    std::printf("Enter baud rate (e.g. 9600, 115200): ");
+                    std::printf("Enter baud rate (e.g. 9600, 115200, 250000): ");
                 } else {
                     std::printf("Enter CAN bitrate (125000/250000/500000/1000000): ");
                 }
@@ -0,0 +1,320 @@
+/**
+ * @file metrics.cpp
+ * @brief Per-thread counters and latency histograms, /stats and a Prometheus textfile
+ */
+
+#include "adamcom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace adamcom {
+
+thread_local MetricBlock* t_metrics = nullptr;
+
+using Clock = std::chrono::steady_clock;
+
+/// Registered blocks (never freed; one per thread that ever counted something)
+static std::mutex s_blocks_mutex;
+static MetricBlock* s_blocks = nullptr;
+
+struct MetricsExport {
+    std::string path;                      // Empty when no textfile is written
+    std::string iface;
+    int interval_ms = 10000;
+    Clock::time_point started = Clock::now();
+    Clock::time_point next_write;
+};
+
+static MetricsExport s_export;
+
+static const char* const COUNTER_NAMES[METRIC_COUNT] = {
+    "rx_frames", "rx_bytes", "tx_frames", "tx_bytes", "tx_errors",
+    "poll_wakeups", "poll_timeouts", "repeat_fires", "rx_checksum_errors",
+    "rx_overflow"
+};
+
+static const char* const COUNTER_HELP[METRIC_COUNT] = {
+    "CAN frames or serial read chunks received",
+    "Payload bytes received",
+    "CAN frames or serial writes sent",
+    "Payload bytes sent",
+    "Failed or short writes to the device",
+    "Returns from poll() in the main loop",
+    "poll() returns with no ready descriptor",
+    "Repeat transmissions fired",
+    "Received frames failing an RX checksum rule",
+    "CAN frames dropped by the kernel (full socket receive queue)"
+};
+
+static const char* const HIST_NAMES[METRIC_HIST_COUNT] = {
+    "repeat_lateness", "seq_lateness", "can_tx_wait", "render"
+};
+
+static const char* const HIST_HELP[METRIC_HIST_COUNT] = {
+    "Delay between a repeat's due time and its transmission",
+    "Delay between a sequence step's deadline and its transmission",
+    "Time a refused CAN frame waited in the TX queue",
+    "Time spent printing one line above the prompt"
+};
+
+/// Counters summed over all threads
+struct MetricTotals {
+    std::array<uint64_t, METRIC_COUNT> counters{};
+    std::array<std::array<uint64_t, METRIC_BUCKETS_US.size() + 1>, METRIC_HIST_COUNT> buckets{};
+    std::array<uint64_t, METRIC_HIST_COUNT> sum_us{};
+};
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+MetricBlock& metric_register()
+{
+    auto* b = new MetricBlock();
+    std::lock_guard<std::mutex> lock(s_blocks_mutex);
+    b->next = s_blocks;
+    s_blocks = b;
+    t_metrics = b;
+    return *b;
+}
+
+void metric_observe(MetricHist h, uint64_t us)
+{
+    MetricBlock& b = t_metrics ? *t_metrics : metric_register();
+    size_t hi = static_cast<size_t>(h);
+    size_t i = 0;
+    while (i < METRIC_BUCKETS_US.size() && us > METRIC_BUCKETS_US[i]) ++i;
+    metric_bump(b.buckets[hi][i], 1);
+    metric_bump(b.sum_us[hi], us);
+}
+
+static void collect(MetricTotals& t)
+{
+    std::lock_guard<std::mutex> lock(s_blocks_mutex);
+    for (const MetricBlock* b = s_blocks; b; b = b->next) {
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            t.counters[i] += b->counters[i].load(std::memory_order_relaxed);
+        }
+        for (size_t h = 0; h < METRIC_HIST_COUNT; ++h) {
+            for (size_t i = 0; i < t.buckets[h].size(); ++i) {
+                t.buckets[h][i] += b->buckets[h][i].load(std::memory_order_relaxed);
+            }
+            t.sum_us[h] += b->sum_us[h].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// ============================================================================
+// Gauges (sampled from module state when rendering)
+// ============================================================================
+
+/// A value read from module state; running totals are exported as counters
+struct Gauge {
+    const char* name;
+    const char* help;
+    double value;
+    bool counter = false;          // Only ever grows: exported as NAME_total, TYPE counter
+};
+
+static std::vector<Gauge> sample_gauges()
+{
+    size_t serve_queued = 0;
+    for (const auto& c : g_serve.clients) {
+        serve_queued = std::max(serve_queued, c.out.size());
+    }
+    return {
+        {"responder_queue_depth", "Delayed auto-responses waiting", static_cast<double>(g_responder.queue.size())},
+        {"tx_queue_bytes", "Serial bytes waiting for the port to drain", static_cast<double>(txq_depth())},
+        {"tx_stalls", "Serial writes cut short by a full port buffer", static_cast<double>(g_txq.stalls), true},
+        {"tx_queue_refused", "Sends refused because the TX queue was full", static_cast<double>(g_txq.overflows), true},
+        {"tx_repeats_skipped", "Repeat slots skipped under TX backpressure", static_cast<double>(g_txq.skipped_repeats), true},
+        {"can_tx_queue_frames", "CAN frames waiting for room in the driver queue", static_cast<double>(g_txq.can_count)},
+        {"can_tx_enobufs", "CAN writes refused with ENOBUFS", static_cast<double>(g_txq.can_enobufs), true},
+        {"can_tx_eagain", "CAN writes refused with EAGAIN", static_cast<double>(g_txq.can_eagain), true},
+        {"can_tx_dropped", "CAN frames dropped (TX queue full or device lost)", static_cast<double>(g_txq.can_dropped), true},
+        {"link_up", "1 while the device is open, 0 while reconnecting", g_reconnect.down ? 0.0 : 1.0},
+        {"reconnects", "Times the device was reopened after being lost", static_cast<double>(g_reconnect.reconnects), true},
+        {"reconnect_last_ms", "Length of the last outage", g_reconnect.last_down_ms},
+        {"output_buffered_bytes", "Structured output bytes not yet written", static_cast<double>(g_output.used)},
+        {"output_dropped_records", "Structured output records dropped (full pipe)", static_cast<double>(g_output.dropped), true},
+        {"serve_clients", "Attached --serve clients", static_cast<double>(g_serve.clients.size())},
+        {"serve_client_queue_max_bytes", "Largest per-client output backlog", static_cast<double>(serve_queued)},
+        {"serve_dropped_clients", "Clients disconnected for falling behind", static_cast<double>(g_serve.dropped), true},
+        {"scrollback_evicted_records", "Scrollback records evicted by the memory cap", static_cast<double>(g_scrollback.evicted), true},
+        {"shm_published_events", "Events published to the shared-memory ring",
+         static_cast<double>(g_shm.hdr ? g_shm.next_seq - 1 : 0), true},
+    };
+}
+
+/// Approximate percentile from bucket counts (upper bound of the bucket it falls in)
+static double percentile_us(const std::array<uint64_t, METRIC_BUCKETS_US.size() + 1>& b, double p)
+{
+    uint64_t total = 0;
+    for (uint64_t n : b) total += n;
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < b.size(); ++i) {
+        seen += b[i];
+        if (seen > rank) {
+            return i < METRIC_BUCKETS_US.size() ? METRIC_BUCKETS_US[i] : INFINITY;
+        }
+    }
+    return INFINITY;
+}
+
+// ============================================================================
+// Export
+// ============================================================================
+
+std::string metrics_render()
+{
+    MetricTotals t;
+    collect(t);
+
+    std::string out;
+    out.reserve(4096);
+    // The iface label has no length limit, so lines are appended piecewise rather than
+    // formatted into a fixed buffer; only numbers go through snprintf
+    const std::string label = "{iface=\"" + s_export.iface + "\"";
+    char num[64];
+    auto header = [&](const char* name, const char* suffix, const char* help, const char* type) {
+        out.append("# HELP adamcom_").append(name).append(suffix).append(" ").append(help).append("\n");
+        out.append("# TYPE adamcom_").append(name).append(suffix).append(" ").append(type).append("\n");
+    };
+    auto sample = [&](const char* name, const char* suffix, const char* extra, const char* value) {
+        out.append("adamcom_").append(name).append(suffix).append(label).append(extra).append("} ");
+        out.append(value).append("\n");
+    };
+
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        header(COUNTER_NAMES[i], "_total", COUNTER_HELP[i], "counter");
+        std::snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(t.counters[i]));
+        sample(COUNTER_NAMES[i], "_total", "", num);
+    }
+
+    for (size_t h = 0; h < METRIC_HIST_COUNT; ++h) {
+        header(HIST_NAMES[h], "_seconds", HIST_HELP[h], "histogram");
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < t.buckets[h].size(); ++i) {
+            cumulative += t.buckets[h][i];
+            char le[48];
+            if (i < METRIC_BUCKETS_US.size()) {
+                std::snprintf(le, sizeof(le), ",le=\"%g\"", METRIC_BUCKETS_US[i] / 1e6);
+            } else {
+                std::snprintf(le, sizeof(le), ",le=\"+Inf\"");
+            }
+            std::snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(cumulative));
+            sample(HIST_NAMES[h], "_seconds_bucket", le, num);
+        }
+        std::snprintf(num, sizeof(num), "%.6f", t.sum_us[h] / 1e6);
+        sample(HIST_NAMES[h], "_seconds_sum", "", num);
+        std::snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(cumulative));
+        sample(HIST_NAMES[h], "_seconds_count", "", num);
+    }
+
+    for (const auto& g : sample_gauges()) {
+        const char* suffix = g.counter ? "_total" : "";
+        header(g.name, suffix, g.help, g.counter ? "counter" : "gauge");
+        std::snprintf(num, sizeof(num), "%.0f", g.value);
+        sample(g.name, suffix, "", num);
+    }
+    return out;
+}
+
+/// Write to a temporary file and rename, so scrapers never see a partial file
+static void write_textfile()
+{
+    const auto& e = s_export;
+    std::string tmp = e.path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "w");
+    if (!f) return;
+    std::string text = metrics_render();
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (ok) {
+        std::rename(tmp.c_str(), e.path.c_str());
+    } else {
+        std::remove(tmp.c_str());
+    }
+}
+
+void metrics_configure(const Config& cfg, const std::string& iface)
+{
+    auto& e = s_export;
+    metrics_set_iface(iface);
+    auto it = cfg.find("metrics_file");
+    e.path = (it == cfg.end() || it->second == "none") ? "" : it->second;
+    it = cfg.find("metrics_interval");
+    int seconds = 10;
+    if (it != cfg.end()) {
+        try { seconds = std::stoi(it->second); } catch (...) {}
+    }
+    e.interval_ms = std::max(1, seconds) * 1000;
+    e.next_write = Clock::now();
+}
+
+void metrics_set_iface(const std::string& iface)
+{
+    // Label values escape backslash, quote and newline
+    auto& e = s_export;
+    e.iface.clear();
+    for (char c : iface) {
+        if (c == '\\' || c == '"') e.iface.push_back('\\');
+        if (c == '\n') {
+            e.iface += "\\n";
+            continue;
+        }
+        e.iface.push_back(c);
+    }
+}
+
+void metrics_poll(Clock::time_point now)
+{
+    auto& e = s_export;
+    if (e.path.empty() || now < e.next_write) return;
+    write_textfile();
+    e.next_write = now + std::chrono::milliseconds(e.interval_ms);
+}
+
+int metrics_timeout_ms(Clock::time_point now)
+{
+    const auto& e = s_export;
+    if (e.path.empty()) return -1;
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(e.next_write - now).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+void metrics_print()
+{
+    MetricTotals t;
+    collect(t);
+    double secs = std::chrono::duration<double>(Clock::now() - s_export.started).count();
+    if (secs <= 0) secs = 1;
+
+    std::printf("\r\nMetrics (%.0f s since start)\n", secs);
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        std::printf("  %-16s %14llu  %10.1f/s\n", COUNTER_NAMES[i],
+                    static_cast<unsigned long long>(t.counters[i]), t.counters[i] / secs);
+    }
+    std::printf("  Latency            count      avg      p50      p99  (us)\n");
+    for (size_t h = 0; h < METRIC_HIST_COUNT; ++h) {
+        uint64_t n = 0;
+        for (uint64_t c : t.buckets[h]) n += c;
+        std::printf("  %-16s %8llu %8.1f %8.0f %8.0f\n", HIST_NAMES[h],
+                    static_cast<unsigned long long>(n), n ? static_cast<double>(t.sum_us[h]) / n : 0.0,
+                    percentile_us(t.buckets[h], 0.50), percentile_us(t.buckets[h], 0.99));
+    }
+    std::printf("  Queues and drops\n");
+    for (const auto& g : sample_gauges()) {
+        std::printf("  %-30s %10.0f\n", g.name, g.value);
+    }
+    if (!s_export.path.empty()) {
+        std::printf("  Textfile: %s (every %d s)\n", s_export.path.c_str(), s_export.interval_ms / 1000);
+    }
+    std::printf("\n");
+}
+
+} // namespace adamcom
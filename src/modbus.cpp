@@ -0,0 +1,568 @@
+/**
+ * @file modbus.cpp
+ * @brief Modbus RTU decoder (silence-based framing, CRC-16, request/response pairing)
+ */
+
+#include "adamcom.hpp"
+
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global Modbus decoder state
+ModbusState g_modbus{};
+
+using Clock = std::chrono::steady_clock;
+
+// Largest RTU ADU (address + PDU + CRC)
+static constexpr size_t MODBUS_MAX_ADU = 256;
+// Smallest valid RTU frame (address + function + CRC)
+static constexpr size_t MODBUS_MIN_ADU = 4;
+
+// ============================================================================
+// CRC-16 (Modbus: reflected poly 0xA001, init 0xFFFF)
+// ============================================================================
+
+static bool crc_ok(const uint8_t* p, size_t n)
+{
+    if (n < MODBUS_MIN_ADU) return false;
+    return checksum(ChecksumKind::CRC16_MODBUS, p, n - 2) == checksum_load(ChecksumKind::CRC16_MODBUS, p + n - 2);
+}
+
+// ============================================================================
+// Frame Layout Helpers
+// ============================================================================
+
+static inline uint16_t be16(const uint8_t* p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+static const char* function_name(uint8_t fc)
+{
+    switch (fc & 0x7F) {
+        case 0x01: return "Read Coils";
+        case 0x02: return "Read Discrete Inputs";
+        case 0x03: return "Read Holding Registers";
+        case 0x04: return "Read Input Registers";
+        case 0x05: return "Write Single Coil";
+        case 0x06: return "Write Single Register";
+        case 0x07: return "Read Exception Status";
+        case 0x08: return "Diagnostics";
+        case 0x0F: return "Write Multiple Coils";
+        case 0x10: return "Write Multiple Registers";
+        case 0x11: return "Report Server ID";
+        case 0x17: return "Read/Write Multiple Registers";
+        default:   return "Function";
+    }
+}
+
+static const char* exception_name(uint8_t code)
+{
+    switch (code) {
+        case 0x01: return "Illegal Function";
+        case 0x02: return "Illegal Data Address";
+        case 0x03: return "Illegal Data Value";
+        case 0x04: return "Server Device Failure";
+        case 0x05: return "Acknowledge";
+        case 0x06: return "Server Device Busy";
+        case 0x08: return "Memory Parity Error";
+        case 0x0A: return "Gateway Path Unavailable";
+        case 0x0B: return "Gateway Target Failed to Respond";
+        default:   return "Unknown Exception";
+    }
+}
+
+/// Expected request length from the bytes seen so far (0 = unknown/need more)
+static size_t request_length(const uint8_t* p, size_t avail)
+{
+    switch (p[1]) {
+        case 0x01: case 0x02: case 0x03: case 0x04:
+        case 0x05: case 0x06: case 0x08:
+            return 8;
+        case 0x07: case 0x11:
+            return 4;
+        case 0x0F: case 0x10:
+            return (avail > 6) ? 9 + p[6] : 0;
+        case 0x17:
+            return (avail > 10) ? 13 + p[10] : 0;
+        default:
+            return 0;
+    }
+}
+
+/// Expected response length from the bytes seen so far (0 = unknown/need more)
+static size_t response_length(const uint8_t* p, size_t avail)
+{
+    if (p[1] & 0x80) return 5;
+    switch (p[1]) {
+        case 0x01: case 0x02: case 0x03: case 0x04:
+        case 0x11: case 0x17:
+            return (avail > 2) ? 5 + p[2] : 0;
+        case 0x05: case 0x06: case 0x08: case 0x0F: case 0x10:
+            return 8;
+        case 0x07:
+            return 5;
+        default:
+            return 0;
+    }
+}
+
+// ============================================================================
+// Decoding
+// ============================================================================
+
+static void append_hex(std::string& out, const uint8_t* p, size_t n)
+{
+    char hex_buf[8];
+    for (size_t i = 0; i < n; ++i) {
+        std::snprintf(hex_buf, sizeof(hex_buf), "%s%02X", i ? " " : "", p[i]);
+        out += hex_buf;
+    }
+}
+
+static void append_bits(std::string& out, const uint8_t* p, size_t nbytes, size_t nbits)
+{
+    nbits = std::min(nbits, nbytes * 8);
+    for (size_t i = 0; i < nbits; ++i) {
+        out.push_back((p[i / 8] >> (i % 8)) & 1 ? '1' : '0');
+    }
+}
+
+static void append_registers(std::string& out, const uint8_t* p, size_t nbytes)
+{
+    char reg_buf[8];
+    for (size_t i = 0; i + 1 < nbytes; i += 2) {
+        std::snprintf(reg_buf, sizeof(reg_buf), "%s%04X", i ? " " : "", be16(p + i));
+        out += reg_buf;
+    }
+}
+
+static uint32_t elapsed_us(Clock::time_point from, Clock::time_point to)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+    return us > 0 ? static_cast<uint32_t>(us) : 0;
+}
+
+/// Frames we wrote are tagged "MB TX", frames read from the line plain "MB"
+static const char* tag(OutputDir dir)
+{
+    return dir == OutputDir::TX ? "MB TX" : "MB";
+}
+
+static void decode_request(OutputDir dir, const uint8_t* p, size_t n, Clock::time_point end)
+{
+    uint8_t slave = p[0];
+    uint8_t fc = p[1];
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s REQ [%02X] %s (0x%02X)", tag(dir), slave, function_name(fc), fc);
+    std::string msg = line;
+
+    ModbusPending& pend = g_modbus.pending[slave];
+    if (pend.active) {
+        // Previous request never got an answer
+        ++g_modbus.slaves[slave].timeouts;
+    }
+    pend = ModbusPending{};
+    pend.function = fc;
+    pend.sent = end;
+
+    // A frame that does not match its function-code layout (including the byte
+    // count at p[6]) is dumped raw instead of being decoded field by field
+    bool layout_ok = request_length(p, n) == n;
+
+    switch (layout_ok ? fc : 0x00) {
+        case 0x01: case 0x02: case 0x03: case 0x04:
+            pend.start = be16(p + 2);
+            pend.quantity = be16(p + 4);
+            std::snprintf(line, sizeof(line), " start=0x%04X qty=%u", pend.start, pend.quantity);
+            msg += line;
+            break;
+        case 0x05:
+            std::snprintf(line, sizeof(line), " coil=0x%04X %s", be16(p + 2),
+                          be16(p + 4) == 0xFF00 ? "ON" : "OFF");
+            msg += line;
+            break;
+        case 0x06:
+            std::snprintf(line, sizeof(line), " reg=0x%04X value=0x%04X", be16(p + 2), be16(p + 4));
+            msg += line;
+            break;
+        case 0x0F:
+            pend.start = be16(p + 2);
+            pend.quantity = be16(p + 4);
+            std::snprintf(line, sizeof(line), " start=0x%04X qty=%u: ", pend.start, pend.quantity);
+            msg += line;
+            append_bits(msg, p + 7, p[6], pend.quantity);
+            break;
+        case 0x10:
+            pend.start = be16(p + 2);
+            pend.quantity = be16(p + 4);
+            std::snprintf(line, sizeof(line), " start=0x%04X qty=%u: ", pend.start, pend.quantity);
+            msg += line;
+            append_registers(msg, p + 7, p[6]);
+            break;
+        default:
+            if (n > 4) {
+                msg += ": ";
+                append_hex(msg, p + 2, n - 4);
+            }
+            break;
+    }
+
+    // Broadcast requests are never answered
+    pend.active = (slave != 0);
+    ++g_modbus.slaves[slave].requests;
+    print_message_above(msg);
+}
+
+static void decode_response(OutputDir dir, const uint8_t* p, size_t n, Clock::time_point start)
+{
+    uint8_t slave = p[0];
+    uint8_t fc = p[1];
+    ModbusPending& pend = g_modbus.pending[slave];
+    ModbusSlaveStats& st = g_modbus.slaves[slave];
+
+    uint32_t rtt = elapsed_us(pend.sent, start);
+    st.rtt_total_us += rtt;
+    if (st.responses + st.exceptions == 0 || rtt < st.rtt_min_us) st.rtt_min_us = rtt;
+    if (rtt > st.rtt_max_us) st.rtt_max_us = rtt;
+
+    char line[160];
+    std::string msg;
+
+    if (fc & 0x80) {
+        ++st.exceptions;
+        std::snprintf(line, sizeof(line), "%s EXC [%02X] %s (0x%02X): %s (0x%02X)",
+                      tag(dir), slave, function_name(fc), fc & 0x7F, exception_name(p[2]), p[2]);
+        msg = line;
+    } else {
+        ++st.responses;
+        std::snprintf(line, sizeof(line), "%s RSP [%02X] %s (0x%02X)", tag(dir), slave, function_name(fc), fc);
+        msg = line;
+
+        // Byte count at p[2] must agree with the frame length before p+3 is read
+        bool layout_ok = response_length(p, n) == n;
+
+        switch (layout_ok ? fc : 0x00) {
+            case 0x01: case 0x02:
+                std::snprintf(line, sizeof(line), " start=0x%04X: ", pend.start);
+                msg += line;
+                append_bits(msg, p + 3, p[2], pend.quantity ? pend.quantity : p[2] * 8u);
+                break;
+            case 0x03: case 0x04: case 0x17:
+                std::snprintf(line, sizeof(line), " start=0x%04X: ", pend.start);
+                msg += line;
+                append_registers(msg, p + 3, p[2]);
+                break;
+            case 0x05:
+            case 0x06:
+                std::snprintf(line, sizeof(line), " addr=0x%04X value=0x%04X", be16(p + 2), be16(p + 4));
+                msg += line;
+                break;
+            case 0x0F: case 0x10:
+                std::snprintf(line, sizeof(line), " start=0x%04X qty=%u", be16(p + 2), be16(p + 4));
+                msg += line;
+                break;
+            default:
+                if (n > 4) {
+                    msg += ": ";
+                    append_hex(msg, p + 2, n - 4);
+                }
+                break;
+        }
+    }
+
+    std::snprintf(line, sizeof(line), " (+%.3f ms)", rtt / 1000.0);
+    msg += line;
+    pend.active = false;
+    print_message_above(msg);
+}
+
+/// True if this frame answers the outstanding request for its slave
+static bool is_response(const uint8_t* p)
+{
+    const ModbusPending& pend = g_modbus.pending[p[0]];
+    return pend.active && (p[1] & 0x7F) == pend.function;
+}
+
+/// Classify a CRC-valid frame: responses must match both the pending request and
+/// the response layout, so a master re-polling an unanswered slave stays a request
+static bool classify_response(const uint8_t* p, size_t n)
+{
+    bool pending = is_response(p);
+    if (pending && response_length(p, n) == n) return true;
+    if (request_length(p, n) == n) return false;
+    return pending;
+}
+
+static void decode_frame(OutputDir dir, const uint8_t* p, size_t n, Clock::time_point start, Clock::time_point end)
+{
+    auto& last_tx = g_modbus.last_tx;
+    if (dir == OutputDir::TX) {
+        last_tx.assign(p, p + n);
+    } else if (last_tx.size() == n && std::equal(p, p + n, last_tx.begin())) {
+        // Half-duplex adapters read back what we sent; it was decoded on the way out
+        last_tx.clear();
+        return;
+    }
+
+    ++g_modbus.frames;
+    if (classify_response(p, n)) {
+        decode_response(dir, p, n, start);
+    } else {
+        decode_request(dir, p, n, end);
+    }
+}
+
+static void report_crc_error(const uint8_t* p, size_t n)
+{
+    ++g_modbus.frames;
+    ++g_modbus.crc_errors;
+    ++g_modbus.slaves[p[0]].crc_errors;
+    std::string msg = "MB CRC ERROR [" + std::to_string(n) + " bytes]: ";
+    append_hex(msg, p, std::min<size_t>(n, 32));
+    if (n > 32) msg += " ...";
+    print_message_above(msg);
+}
+
+/// Length of the frame at p if the layout predicted for it passes CRC (0 otherwise)
+static size_t predicted_frame(const uint8_t* p, size_t avail)
+{
+    if (avail < MODBUS_MIN_ADU) return 0;
+    size_t first = is_response(p) ? response_length(p, avail) : request_length(p, avail);
+    size_t second = is_response(p) ? request_length(p, avail) : response_length(p, avail);
+    for (size_t len : {first, second}) {
+        if (len >= MODBUS_MIN_ADU && len <= avail && crc_ok(p, len)) return len;
+    }
+    return 0;
+}
+
+/// Length of the shortest CRC-valid prefix at p (0 if none)
+static size_t shortest_valid_prefix(const uint8_t* p, size_t avail)
+{
+    constexpr auto kind = ChecksumKind::CRC16_MODBUS;
+    uint32_t crc = checksum_update(kind, checksum_init(kind), p, 2);
+    for (size_t len = MODBUS_MIN_ADU; len <= std::min(avail, MODBUS_MAX_ADU); ++len) {
+        if (crc == checksum_load(kind, p + len - 2)) return len;
+        crc = checksum_update(kind, crc, p + len - 2, 1);
+    }
+    return 0;
+}
+
+/// Consume complete frames from the assembly buffer.
+/// Bytes of back-to-back frames that reached us in one read() (USB adapters batch
+/// them, hiding the silence) are split by predicted length + CRC. At silence the
+/// remainder is a frame on its own: decoded if it validates, else a CRC error.
+static void drain(OutputDir dir, bool at_silence)
+{
+    ModbusLine& ln = (dir == OutputDir::TX) ? g_modbus.tx : g_modbus.rx;
+    auto& buf = ln.buf;
+    size_t pos = 0;
+    Clock::time_point start = ln.first_byte;
+    auto char_time = std::chrono::microseconds(g_modbus.char_us);
+
+    while (buf.size() - pos >= MODBUS_MIN_ADU) {
+        const uint8_t* p = buf.data() + pos;
+        size_t avail = buf.size() - pos;
+        size_t len = predicted_frame(p, avail);
+
+        if (len == 0 && at_silence) {
+            len = crc_ok(p, avail) ? avail : shortest_valid_prefix(p, avail);
+            if (len == 0) {
+                report_crc_error(p, avail);
+                pos = buf.size();
+                break;
+            }
+        }
+        if (len == 0) {
+            if (avail < MODBUS_MAX_ADU) break;
+            // No silence seen for a full ADU and nothing validates: resync
+            report_crc_error(p, MODBUS_MAX_ADU);
+            pos += MODBUS_MAX_ADU;
+            start += char_time * static_cast<int>(MODBUS_MAX_ADU);
+            continue;
+        }
+
+        Clock::time_point end = start + char_time * static_cast<int>(len - 1);
+        decode_frame(dir, p, len, start, end);
+        pos += len;
+        start = end + char_time;
+    }
+
+    if (at_silence && pos < buf.size()) {
+        // Too short to be a frame
+        report_crc_error(buf.data() + pos, buf.size() - pos);
+        pos = buf.size();
+    }
+
+    buf.erase(buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(pos));
+    ln.first_byte = start;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void modbus_configure(const Config& cfg)
+{
+    auto get = [&](const std::string& key, const std::string& def) -> std::string {
+        auto it = cfg.find(key);
+        return (it != cfg.end()) ? it->second : def;
+    };
+
+    unsigned int baud = 115200;
+    int databits = 8;
+    int stopbits = 1;
+    try { baud = get_baud_numeric(get("baud", "115200")); } catch (...) {}
+    try { databits = std::stoi(get("databits", "8")); } catch (...) {}
+    try { stopbits = std::stoi(get("stop", "1")); } catch (...) {}
+    try { g_modbus.response_timeout_ms = std::stoi(get("modbus_timeout", "1000")); } catch (...) {}
+    std::string parity = get("parity", "N");
+    int parity_bits = (!parity.empty() && std::toupper(static_cast<unsigned char>(parity[0])) != 'N') ? 1 : 0;
+    if (baud == 0) baud = 115200;
+
+    // start + data + parity + stop
+    int char_bits = 1 + databits + parity_bits + stopbits;
+    g_modbus.char_us = std::max(1, static_cast<int>((char_bits * 1000000ULL + baud - 1) / baud));
+
+    // The spec fixes t3.5 at 1750 us above 19200 baud
+    if (baud > 19200) {
+        g_modbus.silence_us = 1750;
+    } else {
+        g_modbus.silence_us = static_cast<int>((char_bits * 3500000ULL + baud - 1) / baud);
+    }
+
+    for (ModbusLine* ln : {&g_modbus.rx, &g_modbus.tx}) {
+        ln->buf.clear();
+        ln->buf.reserve(MODBUS_MAX_ADU * 4);
+    }
+    g_modbus.last_tx.clear();
+    for (auto& p : g_modbus.pending) p.active = false;
+}
+
+void modbus_feed(OutputDir dir, const uint8_t* data, size_t len, Clock::time_point ts)
+{
+    if (len == 0) return;
+
+    auto char_time = std::chrono::microseconds(g_modbus.char_us);
+    ModbusLine& ln = (dir == OutputDir::TX) ? g_modbus.tx : g_modbus.rx;
+    Clock::time_point first;
+    if (dir == OutputDir::TX) {
+        // write() returns once the bytes are queued; they leave one character time apart
+        first = std::max(ts, ln.last_byte + char_time);
+        ts = first + char_time * static_cast<int>(len - 1);
+    } else {
+        // read() returns once the last byte is in; back-date the first one
+        first = ts - char_time * static_cast<int>(len - 1);
+    }
+
+    if (!ln.buf.empty()) {
+        if (first - ln.last_byte >= std::chrono::microseconds(g_modbus.silence_us)) {
+            drain(dir, true);
+        }
+    }
+    if (ln.buf.empty()) {
+        ln.first_byte = std::max(first, ln.last_byte);
+    }
+
+    ln.buf.insert(ln.buf.end(), data, data + len);
+    ln.last_byte = ts;
+    drain(dir, false);
+}
+
+void modbus_poll(Clock::time_point now)
+{
+    for (OutputDir dir : {OutputDir::TX, OutputDir::RX}) {
+        const ModbusLine& ln = (dir == OutputDir::TX) ? g_modbus.tx : g_modbus.rx;
+        if (!ln.buf.empty() && now - ln.last_byte >= std::chrono::microseconds(g_modbus.silence_us)) {
+            drain(dir, true);
+        }
+    }
+
+    auto timeout = std::chrono::milliseconds(g_modbus.response_timeout_ms);
+    for (size_t i = 1; i < g_modbus.pending.size(); ++i) {
+        ModbusPending& pend = g_modbus.pending[i];
+        if (pend.active && now - pend.sent > timeout) {
+            pend.active = false;
+            ++g_modbus.slaves[i].timeouts;
+            char line[96];
+            std::snprintf(line, sizeof(line), "MB T/O [%02zX] %s: no response in %d ms",
+                          i, function_name(pend.function), g_modbus.response_timeout_ms);
+            print_message_above(line);
+        }
+    }
+}
+
+int modbus_timeout_ms(Clock::time_point now)
+{
+    const ModbusLine* ln = nullptr;
+    for (const ModbusLine* l : {&g_modbus.rx, &g_modbus.tx}) {
+        if (!l->buf.empty() && (!ln || l->last_byte < ln->last_byte)) ln = l;
+    }
+    if (!ln) return -1;
+    auto deadline = ln->last_byte + std::chrono::microseconds(g_modbus.silence_us);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+    if (us <= 0) return 0;
+    return static_cast<int>((us + 999) / 1000);
+}
+
+void modbus_print_stats()
+{
+    std::printf("\r\nModbus RTU (char %d us, t3.5 %d us, timeout %d ms):\n",
+                g_modbus.char_us, g_modbus.silence_us, g_modbus.response_timeout_ms);
+    std::printf("  Slave   Req    Rsp    Exc    T/O    CRC   CRC%%   RTT min/avg/max (ms)\n");
+
+    bool any = false;
+    for (size_t i = 0; i < g_modbus.slaves.size(); ++i) {
+        const ModbusSlaveStats& st = g_modbus.slaves[i];
+        uint64_t frames = st.requests + st.responses + st.exceptions + st.crc_errors;
+        if (frames == 0) continue;
+        any = true;
+
+        uint64_t answered = st.responses + st.exceptions;
+        double crc_pct = 100.0 * static_cast<double>(st.crc_errors) / static_cast<double>(frames);
+        if (answered > 0) {
+            std::printf("  0x%02zX %6llu %6llu %6llu %6llu %6llu %6.2f   %.3f / %.3f / %.3f\n",
+                        i,
+                        static_cast<unsigned long long>(st.requests),
+                        static_cast<unsigned long long>(st.responses),
+                        static_cast<unsigned long long>(st.exceptions),
+                        static_cast<unsigned long long>(st.timeouts),
+                        static_cast<unsigned long long>(st.crc_errors),
+                        crc_pct,
+                        st.rtt_min_us / 1000.0,
+                        static_cast<double>(st.rtt_total_us) / static_cast<double>(answered) / 1000.0,
+                        st.rtt_max_us / 1000.0);
+        } else {
+            std::printf("  0x%02zX %6llu %6llu %6llu %6llu %6llu %6.2f   -\n",
+                        i,
+                        static_cast<unsigned long long>(st.requests),
+                        static_cast<unsigned long long>(st.responses),
+                        static_cast<unsigned long long>(st.exceptions),
+                        static_cast<unsigned long long>(st.timeouts),
+                        static_cast<unsigned long long>(st.crc_errors),
+                        crc_pct);
+        }
+    }
+    if (!any) {
+        std::printf("  No Modbus traffic seen.\n");
+    }
+
+    double total_pct = g_modbus.frames
+        ? 100.0 * static_cast<double>(g_modbus.crc_errors) / static_cast<double>(g_modbus.frames)
+        : 0.0;
+    std::printf("  Frames: %llu, CRC errors: %llu (%.2f%%)\n\n",
+                static_cast<unsigned long long>(g_modbus.frames),
+                static_cast<unsigned long long>(g_modbus.crc_errors), total_pct);
+}
+
+void modbus_reset_stats()
+{
+    g_modbus.slaves.fill(ModbusSlaveStats{});
+    g_modbus.frames = 0;
+    g_modbus.crc_errors = 0;
+}
+
+} // namespace adamcom
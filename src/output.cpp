@@ -0,0 +1,415 @@
+/**
+ * @file output.cpp
+ * @brief Structured JSON Lines / CSV event sink (allocation-free serializer)
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/can.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global output sink
+OutputSink g_output{};
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int FLUSH_INTERVAL_MS = 100;
+
+/// Worst-case record size excluding the payload hex
+static constexpr size_t RECORD_OVERHEAD = 128;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+/// Interface name as given; re-escaped whenever the format changes
+static std::string s_iface_name;
+
+// ============================================================================
+// Serializer
+// ============================================================================
+
+static inline char* put(char* p, const char* s, size_t n)
+{
+    std::memcpy(p, s, n);
+    return p + n;
+}
+
+template <size_t N>
+static inline char* put(char* p, const char (&s)[N])
+{
+    return put(p, s, N - 1);
+}
+
+static inline char* put_u64(char* p, uint64_t v)
+{
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+/// Wall-clock seconds with microsecond fraction
+static inline char* put_timestamp(char* p)
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    p = put_u64(p, static_cast<uint64_t>(ts.tv_sec));
+    *p++ = '.';
+    uint32_t us = static_cast<uint32_t>(ts.tv_nsec / 1000);
+    for (int i = 5; i >= 0; --i) {
+        p[i] = static_cast<char>('0' + us % 10);
+        us /= 10;
+    }
+    return p + 6;
+}
+
+static inline char* put_hex(char* p, const uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        *p++ = HEX_DIGITS[data[i] >> 4];
+        *p++ = HEX_DIGITS[data[i] & 0x0F];
+    }
+    return p;
+}
+
+static char* put_flags(char* p, uint32_t can_id)
+{
+    if (can_id & CAN_EFF_FLAG) *p++ = 'x';
+    if (can_id & CAN_RTR_FLAG) *p++ = 'r';
+    if (can_id & CAN_ERR_FLAG) *p++ = 'e';
+    return p;
+}
+
+/// Serialize one record; the caller guarantees RECORD_OVERHEAD + iface + 2*len bytes
+static char* put_record(char* p, OutputDir dir, bool is_can, uint32_t can_id,
+                        const uint8_t* data, size_t len)
+{
+    const auto& g = g_output;
+    const char* dir_str = (dir == OutputDir::RX) ? "rx" : "tx";
+    uint32_t id = can_id & ((can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+
+    if (g.format == OutputFormat::JSONL) {
+        p = put(p, "{\"ts\":");
+        p = put_timestamp(p);
+        p = put(p, ",\"if\":\"");
+        p = put(p, g.iface.data(), g.iface.size());
+        p = put(p, "\",\"dir\":\"");
+        p = put(p, dir_str, 2);
+        p = put(p, "\",\"id\":");
+        if (is_can) {
+            p = put_u64(p, id);
+        } else {
+            p = put(p, "null");
+        }
+        p = put(p, ",\"flags\":\"");
+        if (is_can) p = put_flags(p, can_id);
+        p = put(p, "\",\"len\":");
+        p = put_u64(p, len);
+        p = put(p, ",\"data\":\"");
+        p = put_hex(p, data, len);
+        p = put(p, "\"}\n");
+    } else {
+        p = put_timestamp(p);
+        *p++ = ',';
+        p = put(p, g.iface.data(), g.iface.size());
+        *p++ = ',';
+        p = put(p, dir_str, 2);
+        *p++ = ',';
+        if (is_can) p = put_u64(p, id);
+        *p++ = ',';
+        if (is_can) p = put_flags(p, can_id);
+        *p++ = ',';
+        p = put_u64(p, len);
+        *p++ = ',';
+        p = put_hex(p, data, len);
+        *p++ = '\n';
+    }
+    return p;
+}
+
+static void emit(OutputDir dir, bool is_can, uint32_t can_id, const uint8_t* data, size_t len)
+{
+    auto& g = g_output;
+    size_t overhead = RECORD_OVERHEAD + g.iface.size();
+
+    // Oversized serial writes are split so every record fits the buffer
+    size_t max_chunk = (g.buf.size() - overhead) / 2;
+    while (len > max_chunk) {
+        emit(dir, is_can, can_id, data, max_chunk);
+        if (g.format == OutputFormat::NONE) return;
+        data += max_chunk;
+        len -= max_chunk;
+    }
+
+    if (g.buf.size() - g.used < overhead + 2 * len) {
+        // A full non-blocking pipe may leave too little room: drop rather than block
+        if (!output_flush() || g.buf.size() - g.used < overhead + 2 * len) {
+            ++g.dropped;
+            return;
+        }
+    }
+    char* start = g.buf.data() + g.used;
+    g.used += static_cast<size_t>(put_record(start, dir, is_can, can_id, data, len) - start);
+    ++g.events;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool output_parse_format(const std::string& name, OutputFormat& fmt)
+{
+    if (name == "jsonl" || name == "json") {
+        fmt = OutputFormat::JSONL;
+    } else if (name == "csv") {
+        fmt = OutputFormat::CSV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void output_open_fd(OutputFormat fmt, int fd, const std::string& label)
+{
+    output_close();
+    auto& g = g_output;
+    g.format = fmt;
+    g.fd = fd;
+    g.path = label;
+    if (g.buf.size() != OUTPUT_BUFFER_BYTES) g.buf.assign(OUTPUT_BUFFER_BYTES, 0);
+    g.used = 0;
+    g.events = 0;
+    g.bytes_written = 0;
+    g.dropped = 0;
+    g.write_errors = 0;
+    g.last_flush = Clock::now();
+    output_set_iface(s_iface_name);
+
+    if (fmt == OutputFormat::CSV) {
+        static const char header[] = "ts,if,dir,id,flags,len,data\n";
+        std::memcpy(g.buf.data(), header, sizeof(header) - 1);
+        g.used = sizeof(header) - 1;
+    }
+}
+
+bool output_open(OutputFormat fmt, const std::string& path, std::string& error)
+{
+    if (path.empty() || path == "-") {
+        output_open_fd(fmt, STDOUT_FILENO, "-");
+        return true;
+    }
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    output_open_fd(fmt, fd, path);
+    return true;
+}
+
+void output_set_iface(const std::string& name)
+{
+    // Escaped once here so the per-record path is a plain copy
+    auto& g = g_output;
+    s_iface_name = name;
+    g.iface.clear();
+    bool quote = false;
+    for (unsigned char c : name) {
+        if (c < 0x20) continue;
+        if (g.format == OutputFormat::CSV) {
+            if (c == '"') g.iface.push_back('"');
+        } else if (c == '"' || c == '\\') {
+            g.iface.push_back('\\');
+        }
+        if (c == ',' || c == '"') quote = true;
+        g.iface.push_back(static_cast<char>(c));
+    }
+    if (g.format == OutputFormat::CSV && quote) {
+        g.iface = "\"" + g.iface + "\"";
+    }
+}
+
+void output_can(OutputDir dir, uint32_t can_id, const uint8_t* data, size_t dlc)
+{
+    if (g_output.format == OutputFormat::NONE) return;
+    emit(dir, true, can_id, data, std::min<size_t>(dlc, 8));
+}
+
+void output_serial(OutputDir dir, const uint8_t* data, size_t len)
+{
+    if (g_output.format == OutputFormat::NONE || len == 0) return;
+    emit(dir, false, 0, data, len);
+}
+
+void output_gap(bool restored, const std::string& reason, double down_ms)
+{
+    auto& g = g_output;
+    if (g.format == OutputFormat::NONE) return;
+    size_t need = RECORD_OVERHEAD + g.iface.size() + 2 * reason.size();
+    if (g.buf.size() - g.used < need && (!output_flush() || g.buf.size() - g.used < need)) {
+        ++g.dropped;
+        return;
+    }
+    char* start = g.buf.data() + g.used;
+    char* p = start;
+    const char* state = restored ? "restored" : "lost";
+    if (g.format == OutputFormat::JSONL) {
+        p = put(p, "{\"ts\":");
+        p = put_timestamp(p);
+        p = put(p, ",\"if\":\"");
+        p = put(p, g.iface.data(), g.iface.size());
+        p = put(p, "\",\"dir\":\"gap\",\"state\":\"");
+        p = put(p, state, std::strlen(state));
+        if (restored) {
+            p = put(p, "\",\"down_ms\":");
+            p = put_u64(p, static_cast<uint64_t>(down_ms + 0.5));
+        } else {
+            p = put(p, "\",\"reason\":\"");
+            for (unsigned char c : reason) {
+                if (c < 0x20) continue;
+                if (c == '"' || c == '\\') *p++ = '\\';
+                *p++ = static_cast<char>(c);
+            }
+            *p++ = '"';
+        }
+        p = put(p, "}\n");
+    } else {
+        // Same columns as data records: the state goes in the flags column
+        p = put_timestamp(p);
+        *p++ = ',';
+        p = put(p, g.iface.data(), g.iface.size());
+        p = put(p, ",gap,,");
+        p = put(p, state, std::strlen(state));
+        p = put(p, ",0,\n");
+    }
+    g.used += static_cast<size_t>(p - start);
+    ++g.events;
+    // Markers are rare and readers may be waiting on them
+    output_flush();
+}
+
+void output_drop(uint64_t count, uint64_t total)
+{
+    auto& g = g_output;
+    if (g.format == OutputFormat::NONE) return;
+    size_t need = RECORD_OVERHEAD + g.iface.size();
+    if (g.buf.size() - g.used < need && (!output_flush() || g.buf.size() - g.used < need)) {
+        ++g.dropped;
+        return;
+    }
+    char* start = g.buf.data() + g.used;
+    char* p = start;
+    if (g.format == OutputFormat::JSONL) {
+        p = put(p, "{\"ts\":");
+        p = put_timestamp(p);
+        p = put(p, ",\"if\":\"");
+        p = put(p, g.iface.data(), g.iface.size());
+        p = put(p, "\",\"dir\":\"drop\",\"count\":");
+        p = put_u64(p, count);
+        p = put(p, ",\"total\":");
+        p = put_u64(p, total);
+        p = put(p, "}\n");
+    } else {
+        // Same columns as data records: the frame count goes in the len column
+        p = put_timestamp(p);
+        *p++ = ',';
+        p = put(p, g.iface.data(), g.iface.size());
+        p = put(p, ",drop,,,");
+        p = put_u64(p, count);
+        p = put(p, ",\n");
+    }
+    g.used += static_cast<size_t>(p - start);
+    ++g.events;
+}
+
+bool output_flush()
+{
+    auto& g = g_output;
+    if (g.format == OutputFormat::NONE) return false;
+    g.last_flush = Clock::now();
+
+    size_t off = 0;
+    while (off < g.used) {
+        ssize_t n = write(g.fd, g.buf.data() + off, g.used - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                // Non-blocking pipe is full: keep the rest for the next flush
+                break;
+            }
+            ++g.write_errors;
+            int err = errno;
+            std::string target = g.path;
+            g.used = 0;
+            output_close();
+            print_message_above("Output to " + target + " stopped: " + std::strerror(err));
+            return false;
+        }
+        off += static_cast<size_t>(n);
+        g.bytes_written += static_cast<uint64_t>(n);
+    }
+    if (off < g.used) {
+        std::memmove(g.buf.data(), g.buf.data() + off, g.used - off);
+    }
+    g.used -= off;
+    return true;
+}
+
+void output_poll(Clock::time_point now)
+{
+    auto& g = g_output;
+    if (g.used == 0) return;
+    if (g.used >= OUTPUT_FLUSH_BYTES || now - g.last_flush >= std::chrono::milliseconds(FLUSH_INTERVAL_MS)) {
+        output_flush();
+    }
+}
+
+int output_timeout_ms(Clock::time_point now)
+{
+    const auto& g = g_output;
+    if (g.format == OutputFormat::NONE || g.used == 0) return -1;
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        g.last_flush + std::chrono::milliseconds(FLUSH_INTERVAL_MS) - now).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+void output_close()
+{
+    auto& g = g_output;
+    if (g.format == OutputFormat::NONE) return;
+    if (g.used > 0) output_flush();
+    if (g.format == OutputFormat::NONE) return;
+    if (g.fd > STDERR_FILENO) {
+        close(g.fd);
+    }
+    g.fd = -1;
+    g.format = OutputFormat::NONE;
+}
+
+void output_print_status()
+{
+    const auto& g = g_output;
+    if (g.format == OutputFormat::NONE) {
+        std::printf("\r\nOutput: off\n\n");
+        return;
+    }
+    std::printf("\r\nOutput: %s to %s, %llu events, %llu bytes written, %zu buffered, %llu dropped, %llu write errors\n\n",
+                g.format == OutputFormat::JSONL ? "jsonl" : "csv",
+                g.path == "-" ? "stdout" : g.path.c_str(),
+                static_cast<unsigned long long>(g.events),
+                static_cast<unsigned long long>(g.bytes_written), g.used,
+                static_cast<unsigned long long>(g.dropped),
+                static_cast<unsigned long long>(g.write_errors));
+}
+
+} // namespace adamcom
@@ -0,0 +1,107 @@
+/**
+ * @file perf.cpp
+ * @brief Per-stage main-loop timing (built with make profile)
+ */
+
+#include "adamcom.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+namespace adamcom {
+
+#ifdef ADAMCOM_PROFILE
+
+static const char* const STAGE_NAMES[PERF_STAGE_COUNT] = {
+    "schedule", "poll_wait", "timers", "repeat", "device_read",
+    "rx_process", "device_write", "render", "serve", "readline"
+};
+
+/// Histogram buckets are powers of two in nanoseconds: bucket b holds [2^(b-1), 2^b)
+constexpr size_t PERF_BUCKETS = 40;
+
+struct PerfStats {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    std::array<uint64_t, PERF_BUCKETS> buckets{};
+};
+
+uint64_t g_perf_nested_ns = 0;
+
+static std::array<PerfStats, PERF_STAGE_COUNT> s_stages;
+static uint64_t s_window_start = perf_now_ns();
+
+uint64_t perf_now_ns()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void perf_record(PerfStage stage, uint64_t self_ns)
+{
+    PerfStats& s = s_stages[static_cast<size_t>(stage)];
+    ++s.calls;
+    s.total_ns += self_ns;
+    if (self_ns > s.max_ns) s.max_ns = self_ns;
+    size_t b = self_ns ? static_cast<size_t>(64 - __builtin_clzll(self_ns)) : 0;
+    ++s.buckets[b < PERF_BUCKETS ? b : PERF_BUCKETS - 1];
+}
+
+/// Upper bound (ns) of the bucket holding the p-th sample
+static double percentile_ns(const PerfStats& s, double p)
+{
+    if (s.calls == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(s.calls));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < PERF_BUCKETS; ++b) {
+        seen += s.buckets[b];
+        if (seen > rank) return static_cast<double>(std::min<uint64_t>(1ULL << b, s.max_ns));
+    }
+    return static_cast<double>(s.max_ns);
+}
+
+void perf_print()
+{
+    double wall_s = (perf_now_ns() - s_window_start) / 1e9;
+    if (wall_s <= 0) wall_s = 1e-9;
+
+    std::printf("\r\nMain-loop profile over %.1f s (self time; /perf reset starts a new window)\n", wall_s);
+    std::printf("  %-13s %10s %9s %8s %6s %9s %9s %9s %9s\n",
+                "Stage", "calls", "calls/s", "ms/s", "wall%", "avg us", "p50 us", "p99 us", "max us");
+    uint64_t accounted = 0;
+    for (size_t i = 0; i < PERF_STAGE_COUNT; ++i) {
+        const PerfStats& s = s_stages[i];
+        accounted += s.total_ns;
+        double ms_per_s = s.total_ns / 1e6 / wall_s;
+        std::printf("  %-13s %10llu %9.1f %8.2f %5.1f%% %9.2f %9.2f %9.2f %9.2f\n",
+                    STAGE_NAMES[i], static_cast<unsigned long long>(s.calls), s.calls / wall_s,
+                    ms_per_s, ms_per_s / 10.0,
+                    s.calls ? s.total_ns / 1e3 / static_cast<double>(s.calls) : 0.0,
+                    percentile_ns(s, 0.50) / 1e3, percentile_ns(s, 0.99) / 1e3, s.max_ns / 1e3);
+    }
+    double other_ms = (wall_s * 1e9 - static_cast<double>(accounted)) / 1e6 / wall_s;
+    std::printf("  %-13s %10s %9s %8.2f %5.1f%%\n\n", "(untimed)", "", "", other_ms, other_ms / 10.0);
+}
+
+void perf_reset()
+{
+    s_stages = {};
+    s_window_start = perf_now_ns();
+}
+
+#else
+
+void perf_print()
+{
+    std::printf("\r\nProfiler not built in; rebuild with 'make profile' to enable /perf.\n\n");
+}
+
+void perf_reset()
+{
+}
+
+#endif
+
+} // namespace adamcom
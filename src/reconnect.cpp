@@ -0,0 +1,227 @@
+/**
+ * @file reconnect.cpp
+ * @brief Automatic reconnect: hot-plug watch (inotify / rtnetlink), backoff, gap markers
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace adamcom {
+
+// Define the global reconnect state
+ReconnectState g_reconnect{};
+
+using Clock = std::chrono::steady_clock;
+
+/// Settle time after a hot-plug event (udev still setting permissions, links)
+static constexpr int NOTIFY_SETTLE_MS = 20;
+
+// ============================================================================
+// Hot-plug Watch
+// ============================================================================
+
+/// inotify on /dev and, for paths like /dev/serial/by-id/..., the device's own directory
+static int watch_dev(const std::string& device)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+    const uint32_t mask = IN_CREATE | IN_ATTRIB | IN_MOVED_TO;
+    inotify_add_watch(fd, "/dev", mask);
+    auto slash = device.find_last_of('/');
+    if (slash != std::string::npos && slash > 0) {
+        std::string dir = device.substr(0, slash);
+        if (dir != "/dev") inotify_add_watch(fd, dir.c_str(), mask);
+    }
+    return fd;
+}
+
+/// rtnetlink link notifications (interface added, up/down)
+static int watch_links()
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+    struct sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK;
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_watch()
+{
+    auto& g = g_reconnect;
+    if (g.notify_fd >= 0) {
+        close(g.notify_fd);
+        g.notify_fd = -1;
+    }
+}
+
+// ============================================================================
+// Gap Markers
+// ============================================================================
+
+static void mark_gap(bool restored, const std::string& text, double down_ms)
+{
+    output_gap(restored, g_reconnect.reason, down_ms);
+    shm_gap(restored, text);
+    capture_note((restored ? "link restored: " : "link lost: ") + text);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void reconnect_configure(const Config& cfg, InterfaceType itype)
+{
+    auto& g = g_reconnect;
+    auto get = [&](const char* key) {
+        auto it = cfg.find(key);
+        return it != cfg.end() ? it->second : std::string();
+    };
+    g.enabled = (get("auto_reconnect") != "off");
+    g.can = (itype == InterfaceType::CAN);
+    g.device = get(g.can ? "can_interface" : "device");
+}
+
+bool reconnect_fatal_errno(int err)
+{
+    switch (err) {
+    case EIO:
+    case ENXIO:
+    case ENODEV:
+    case ENETDOWN:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void reconnect_note_error(int err)
+{
+    auto& g = g_reconnect;
+    if (!g.down && g.pending_errno == 0 && reconnect_fatal_errno(err)) {
+        g.pending_errno = err;
+    }
+}
+
+void reconnect_lost(const std::string& reason, size_t dropped_tx)
+{
+    auto& g = g_reconnect;
+    auto now = Clock::now();
+    g.down = true;
+    g.pending_errno = 0;
+    g.reason = reason;
+    g.lost_at = now;
+    g.attempts = 0;
+    g.backoff_ms = RECONNECT_BACKOFF_MIN_MS;
+    g.next_attempt = now + std::chrono::milliseconds(g.backoff_ms);
+
+    close_watch();
+    g.notify_fd = g.can ? watch_links() : watch_dev(g.device);
+
+    mark_gap(false, reason, 0);
+    std::string msg = "--- " + g.device + " lost (" + reason + ")";
+    if (dropped_tx > 0) msg += ", " + std::to_string(dropped_tx) + " queued TX bytes dropped";
+    msg += g.notify_fd >= 0 ? "; waiting for it to return ---" : "; retrying with backoff ---";
+    print_message_above(msg);
+}
+
+bool reconnect_device_present()
+{
+    const auto& g = g_reconnect;
+    if (!g.can) {
+        return access(g.device.c_str(), F_OK) == 0;
+    }
+    // A replugged USB adapter returns down and without a bitrate; reopening configures it
+    return if_nametoindex(g.device.c_str()) != 0;
+}
+
+bool reconnect_due(Clock::time_point now)
+{
+    return g_reconnect.down && now >= g_reconnect.next_attempt;
+}
+
+int reconnect_timeout_ms(Clock::time_point now)
+{
+    const auto& g = g_reconnect;
+    if (!g.down) return -1;
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(g.next_attempt - now).count();
+    return left > 0 ? static_cast<int>(left) + 1 : 0;
+}
+
+void reconnect_handle_notify(Clock::time_point now)
+{
+    auto& g = g_reconnect;
+    if (g.notify_fd < 0) return;
+    char buf[4096];
+    while (read(g.notify_fd, buf, sizeof(buf)) > 0) {
+        ++g.notify_events;
+    }
+    auto soon = now + std::chrono::milliseconds(NOTIFY_SETTLE_MS);
+    if (g.next_attempt > soon) g.next_attempt = soon;
+}
+
+void reconnect_failed(Clock::time_point now)
+{
+    auto& g = g_reconnect;
+    ++g.attempts;
+    g.backoff_ms = std::min(g.backoff_ms * 2, RECONNECT_BACKOFF_MAX_MS);
+    g.next_attempt = now + std::chrono::milliseconds(g.backoff_ms);
+}
+
+void reconnect_restored(Clock::time_point now)
+{
+    auto& g = g_reconnect;
+    ++g.attempts;
+    double down_ms = std::chrono::duration<double, std::milli>(now - g.lost_at).count();
+    g.down = false;
+    g.pending_errno = 0;
+    ++g.reconnects;
+    g.last_down_ms = down_ms;
+    g.max_down_ms = std::max(g.max_down_ms, down_ms);
+    g.total_down_ms += down_ms;
+    close_watch();
+
+    char text[96];
+    std::snprintf(text, sizeof(text), "down %.0f ms, %u attempt%s", down_ms, g.attempts,
+                  g.attempts == 1 ? "" : "s");
+    mark_gap(true, text, down_ms);
+    print_message_above("--- " + g.device + " reconnected (" + text + ") ---");
+}
+
+void reconnect_print_status()
+{
+    const auto& g = g_reconnect;
+    std::printf("\r\nAuto-reconnect: %s", g.enabled ? "on" : "off");
+    if (g.down) {
+        double down_s = std::chrono::duration<double>(Clock::now() - g.lost_at).count();
+        std::printf(", %s DOWN for %.1f s (%s), %u attempts, next in %d ms, watching %s\n",
+                    g.device.c_str(), down_s, g.reason.c_str(), g.attempts,
+                    std::max(0, reconnect_timeout_ms(Clock::now())),
+                    g.notify_fd < 0 ? "nothing (polling)" : g.can ? "rtnetlink" : "inotify /dev");
+    } else {
+        std::printf(", %s connected\n", g.device.c_str());
+    }
+    std::printf("  Reconnects: %llu", static_cast<unsigned long long>(g.reconnects));
+    if (g.reconnects > 0) {
+        std::printf(" (last %.0f ms, max %.0f ms, total %.1f s down)", g.last_down_ms, g.max_down_ms,
+                    g.total_down_ms / 1000.0);
+    }
+    std::printf("\n  Hot-plug events: %llu, repeat slots skipped while down: %llu\n\n",
+                static_cast<unsigned long long>(g.notify_events),
+                static_cast<unsigned long long>(g.skipped_repeats));
+}
+
+} // namespace adamcom
@@ -0,0 +1,415 @@
+/**
+ * @file responder.cpp
+ * @brief Auto-responder table for ECU/device emulation (pre-built responses, latency stats)
+ */
+
+#include "adamcom.hpp"
+
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global auto-responder state
+ResponderState g_responder{};
+
+using Clock = std::chrono::steady_clock;
+
+// Latency histogram bucket upper bounds in microseconds (last bucket is open-ended)
+static constexpr std::array<uint32_t, 6> LATENCY_BOUNDS_US = {50, 100, 200, 500, 1000, 5000};
+
+// ============================================================================
+// Spec Parsing
+// ============================================================================
+
+static std::string lower(std::string s)
+{
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+static std::string trimmed(const std::string& s)
+{
+    size_t b = s.find_first_not_of(" \t");
+    size_t e = s.find_last_not_of(" \t");
+    return (b == std::string::npos) ? "" : s.substr(b, e - b + 1);
+}
+
+/// Pre-build a preset as a response so nothing is parsed per hit
+static bool build_preset(const Config& cfg, int n, ResponderEntry& r, std::string& error)
+{
+    std::string prefix = "preset" + std::to_string(n) + "_";
+    auto get = [&](const std::string& key) -> std::string {
+        auto it = cfg.find(key);
+        return (it != cfg.end()) ? it->second : "";
+    };
+
+    std::string data = get(prefix + "data");
+    if (data.empty()) {
+        error = "preset " + std::to_string(n) + " is empty";
+        return false;
+    }
+
+    if (get("type") == "can") {
+        std::vector<uint8_t> bytes;
+        if (!parse_hex_bytes(data, bytes)) {
+            error = "preset " + std::to_string(n) + " has invalid hex data";
+            return false;
+        }
+        std::string id = get(prefix + "can_id");
+        if (id.empty()) id = get("can_id");
+        try {
+            r.can_id = static_cast<uint32_t>(std::stoul(id.empty() ? "0x123" : id, nullptr, 16));
+        } catch (...) {
+            error = "preset " + std::to_string(n) + " has an invalid CAN ID";
+            return false;
+        }
+        r.is_can = true;
+        r.can_len = static_cast<uint8_t>(std::min<size_t>(bytes.size(), 8));
+        std::copy(bytes.begin(), bytes.begin() + r.can_len, r.can_data.begin());
+        return true;
+    }
+
+    if (get(prefix + "format") == "text") {
+        r.bytes.assign(data.begin(), data.end());
+        if (get("crlf") == "yes") {
+            r.bytes.push_back('\r');
+            r.bytes.push_back('\n');
+        }
+        return true;
+    }
+    if (!parse_hex_bytes(data, r.bytes)) {
+        error = "preset " + std::to_string(n) + " has invalid hex data";
+        return false;
+    }
+    return true;
+}
+
+bool responder_parse_payload(std::string text, const Config& cfg, ResponderEntry& r, std::string& error)
+{
+    text = trimmed(text);
+    auto sp = text.find(' ');
+    std::string kind = lower(text.substr(0, sp));
+    std::string rest = (sp == std::string::npos) ? "" : trimmed(text.substr(sp + 1));
+
+    if (kind == "preset") {
+        int n = 0;
+        try { n = std::stoi(rest); } catch (...) {}
+        if (n < 1 || n > 10) {
+            error = "preset number must be 1-10";
+            return false;
+        }
+        return build_preset(cfg, n, r, error);
+    }
+
+    if (kind == "can") {
+        auto id_end = rest.find(' ');
+        std::string id = rest.substr(0, id_end);
+        std::vector<uint8_t> bytes;
+        try {
+            r.can_id = static_cast<uint32_t>(std::stoul(id, nullptr, 16));
+        } catch (...) {
+            error = "invalid CAN ID: " + id;
+            return false;
+        }
+        if (id_end != std::string::npos && !parse_hex_bytes(rest.substr(id_end + 1), bytes)) {
+            error = "invalid CAN data";
+            return false;
+        }
+        if (bytes.size() > 8 || r.can_id > 0x1FFFFFFF) {
+            error = "CAN response must be an ID plus at most 8 bytes";
+            return false;
+        }
+        r.is_can = true;
+        r.can_len = static_cast<uint8_t>(bytes.size());
+        std::copy(bytes.begin(), bytes.end(), r.can_data.begin());
+        return true;
+    }
+
+    if (kind == "hex") {
+        if (!parse_hex_bytes(rest, r.bytes) || r.bytes.empty()) {
+            error = "invalid hex response";
+            return false;
+        }
+        return true;
+    }
+
+    if (kind == "text") {
+        // Reuse the trigger escapes (\r \n \t \xHH) via the match parser
+        Trigger tmp;
+        if (!trigger_parse_match("text " + rest, tmp, error)) return false;
+        r.bytes = std::move(tmp.pattern);
+        return true;
+    }
+
+    error = "response must be can, hex, text or preset";
+    return false;
+}
+
+static bool parse_response(std::string text, const Config& cfg, ResponderEntry& r, std::string& error)
+{
+    // Optional trailing "delay MS"
+    auto pos = lower(text).rfind(" delay ");
+    if (pos != std::string::npos) {
+        std::string ms = trimmed(text.substr(pos + 7));
+        try {
+            size_t used = 0;
+            double v = std::stod(ms, &used);
+            if (used == ms.size() && v >= 0 && v <= 60000) {
+                r.delay_us = static_cast<uint32_t>(v * 1000.0);
+                text = text.substr(0, pos);
+            }
+        } catch (...) {}
+    }
+    return responder_parse_payload(text, cfg, r, error);
+}
+
+static bool parse_entry(const std::string& spec, const Config& cfg, Trigger& match,
+                        ResponderEntry& r, std::string& error)
+{
+    auto arrow = spec.find("->");
+    if (arrow == std::string::npos) {
+        error = "missing '-> RESPONSE'";
+        return false;
+    }
+    if (!trigger_parse_match(spec.substr(0, arrow), match, error)) return false;
+    if (!parse_response(spec.substr(arrow + 2), cfg, r, error)) return false;
+    match.spec = spec;
+    r.spec = spec;
+    return true;
+}
+
+// ============================================================================
+// Sending and Latency
+// ============================================================================
+
+static void record_latency(Clock::time_point rx, Clock::time_point due)
+{
+    auto& g = g_responder;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - rx).count();
+    // Delayed responses are measured against their due time
+    ns -= std::chrono::duration_cast<std::chrono::nanoseconds>(due - rx).count();
+    uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+
+    if (g.lat_count == 0 || v < g.lat_min_ns) g.lat_min_ns = v;
+    if (v > g.lat_max_ns) g.lat_max_ns = v;
+    g.lat_total_ns += v;
+    ++g.lat_count;
+
+    size_t bucket = 0;
+    while (bucket < LATENCY_BOUNDS_US.size() && v >= LATENCY_BOUNDS_US[bucket] * 1000ULL) ++bucket;
+    ++g.lat_hist[bucket];
+}
+
+static void send_entry(size_t index, Clock::time_point rx, Clock::time_point due)
+{
+    auto& g = g_responder;
+    ResponderEntry& r = g.entries[index];
+    if (!g.fd) return;
+
+    bool ok = r.is_can ? send_can_bytes(*g.fd, r.can_id, r.can_data.data(), r.can_len)
+                       : send_serial_bytes(*g.fd, r.bytes);
+    if (ok) {
+        record_latency(rx, due);
+        ++g.sent;
+        ++r.hits;
+    } else {
+        ++g.failed;
+    }
+
+    // Rendering happens only after the response is on the wire
+    if (g.log) {
+        char line[64];
+        std::snprintf(line, sizeof(line), "%s[%zu] ", ok ? "RESP" : "RESP FAILED", index + 1);
+        print_message_above(line + r.spec);
+    }
+}
+
+static void on_match(size_t index)
+{
+    auto& g = g_responder;
+    const ResponderEntry& r = g.entries[index];
+    if (r.delay_us == 0) {
+        send_entry(index, g.rx_time, g.rx_time);
+        return;
+    }
+    if (g.queue.size() >= RESPONDER_QUEUE_MAX) {
+        ++g.dropped;
+        return;
+    }
+    ResponderPending p;
+    p.due = g.rx_time + std::chrono::microseconds(r.delay_us);
+    p.rx = g.rx_time;
+    p.entry = static_cast<uint16_t>(index);
+    // Keep the queue ordered by due time (it is short; insertion is cheap)
+    auto it = std::upper_bound(g.queue.begin(), g.queue.end(), p,
+                               [](const auto& a, const auto& b) { return a.due < b.due; });
+    g.queue.insert(it, p);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void responder_bind(const int* fd)
+{
+    g_responder.fd = fd;
+}
+
+void responder_configure(const Config& cfg)
+{
+    auto& g = g_responder;
+    g.matchers.clear();
+    g.entries.clear();
+    g.queue.clear();
+    g.queue.reserve(RESPONDER_QUEUE_MAX);
+
+    auto it = cfg.find("responder");
+    g.enabled = (it == cfg.end() || it->second != "off");
+    it = cfg.find("responder_log");
+    g.log = (it == cfg.end() || it->second != "off");
+
+    for (int i = 1; i <= MAX_RESPONDERS; ++i) {
+        it = cfg.find("respond" + std::to_string(i));
+        if (it == cfg.end()) break;
+        Trigger match;
+        ResponderEntry r;
+        std::string error;
+        if (parse_entry(it->second, cfg, match, r, error)) {
+            g.matchers.push_back(std::move(match));
+            g.entries.push_back(std::move(r));
+        } else {
+            print_message_above("Ignoring respond" + std::to_string(i) + ": " + error);
+        }
+    }
+    match_index_build(g.index, g.matchers);
+}
+
+void responder_save(Config& cfg)
+{
+    for (int i = 1; i <= MAX_RESPONDERS; ++i) cfg.erase("respond" + std::to_string(i));
+    for (size_t i = 0; i < g_responder.entries.size(); ++i) {
+        cfg["respond" + std::to_string(i + 1)] = g_responder.entries[i].spec;
+    }
+}
+
+bool responder_add(const std::string& spec, const Config& cfg, std::string& error)
+{
+    auto& g = g_responder;
+    if (g.entries.size() >= static_cast<size_t>(MAX_RESPONDERS)) {
+        error = "too many responders";
+        return false;
+    }
+    Trigger match;
+    ResponderEntry r;
+    if (!parse_entry(spec, cfg, match, r, error)) return false;
+    g.matchers.push_back(std::move(match));
+    g.entries.push_back(std::move(r));
+    match_index_build(g.index, g.matchers);
+    return true;
+}
+
+bool responder_remove(size_t index)
+{
+    auto& g = g_responder;
+    if (index >= g.entries.size()) return false;
+    g.matchers.erase(g.matchers.begin() + static_cast<std::ptrdiff_t>(index));
+    g.entries.erase(g.entries.begin() + static_cast<std::ptrdiff_t>(index));
+    g.queue.clear();
+    match_index_build(g.index, g.matchers);
+    return true;
+}
+
+void responder_clear()
+{
+    g_responder.matchers.clear();
+    g_responder.entries.clear();
+    g_responder.queue.clear();
+    match_index_build(g_responder.index, g_responder.matchers);
+}
+
+void responder_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc,
+                      Clock::time_point rx_time)
+{
+    auto& g = g_responder;
+    if (!g.enabled || g.index.can_count == 0) return;
+    g.rx_time = rx_time;
+    match_can(g.index, g.matchers, can_id, extended, data, dlc, on_match);
+}
+
+void responder_serial_rx(const uint8_t* data, size_t len, Clock::time_point rx_time)
+{
+    auto& g = g_responder;
+    if (!g.enabled || g.index.serial_count == 0) return;
+    g.rx_time = rx_time;
+    match_serial(g.index, data, len, on_match);
+}
+
+void responder_poll(Clock::time_point now)
+{
+    auto& g = g_responder;
+    size_t done = 0;
+    while (done < g.queue.size() && g.queue[done].due <= now) {
+        const ResponderPending& p = g.queue[done];
+        send_entry(p.entry, p.rx, p.due);
+        ++done;
+    }
+    if (done > 0) {
+        g.queue.erase(g.queue.begin(), g.queue.begin() + static_cast<std::ptrdiff_t>(done));
+    }
+}
+
+Clock::time_point responder_next_deadline()
+{
+    if (g_responder.queue.empty()) return Clock::time_point::max();
+    return g_responder.queue.front().due;
+}
+
+void responder_print_status()
+{
+    const auto& g = g_responder;
+    std::printf("\r\nAuto-responder %s (%zu entries, log %s):\n",
+                g.enabled ? "on" : "off", g.entries.size(), g.log ? "on" : "off");
+    if (g.entries.empty()) {
+        std::printf("  None. Example: /resp add can 0x7E0 02 10 03 -> can 0x7E8 02 50 03\n");
+    }
+    for (size_t i = 0; i < g.entries.size(); ++i) {
+        std::printf("  %2zu. %-56s hits %llu\n", i + 1, g.entries[i].spec.c_str(),
+                    static_cast<unsigned long long>(g.entries[i].hits));
+    }
+
+    std::printf("  Sent %llu, failed %llu, queue drops %llu, pending %zu\n",
+                static_cast<unsigned long long>(g.sent),
+                static_cast<unsigned long long>(g.failed),
+                static_cast<unsigned long long>(g.dropped), g.queue.size());
+    if (g.lat_count > 0) {
+        std::printf("  Latency RX->TX (us): min %.1f / avg %.1f / max %.1f\n",
+                    g.lat_min_ns / 1000.0,
+                    static_cast<double>(g.lat_total_ns) / static_cast<double>(g.lat_count) / 1000.0,
+                    g.lat_max_ns / 1000.0);
+        std::printf("  ");
+        for (size_t i = 0; i < g.lat_hist.size(); ++i) {
+            if (i < LATENCY_BOUNDS_US.size()) {
+                std::printf("<%uus:%llu  ", LATENCY_BOUNDS_US[i],
+                            static_cast<unsigned long long>(g.lat_hist[i]));
+            } else {
+                std::printf(">=%uus:%llu", LATENCY_BOUNDS_US.back(),
+                            static_cast<unsigned long long>(g.lat_hist[i]));
+            }
+        }
+        std::printf("\n");
+    }
+    std::printf("\n");
+}
+
+void responder_reset_stats()
+{
+    auto& g = g_responder;
+    g.sent = g.failed = g.dropped = 0;
+    g.lat_count = g.lat_total_ns = g.lat_min_ns = g.lat_max_ns = 0;
+    g.lat_hist.fill(0);
+    for (auto& r : g.entries) r.hits = 0;
+}
+
+} // namespace adamcom
@@ -0,0 +1,526 @@
+/**
+ * @file scrollback.cpp
+ * @brief Bounded in-memory scrollback (byte-arena ring, block filters for /find, pager)
+ */
+
+#include "adamcom.hpp"
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <ctime>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global scrollback state
+ScrollbackState g_scrollback{};
+
+using Clock = std::chrono::steady_clock;
+
+/// Record header stored in the arena, followed by the payload padded to 8 bytes
+struct RecordHeader {
+    int64_t time_us;
+    uint32_t id;
+    uint16_t len;
+    uint8_t kind;
+    uint8_t extended;
+};
+
+static constexpr size_t MIN_RECORD = sizeof(RecordHeader) + 8;
+static constexpr size_t BLOCK_EVENTS = 256;
+static constexpr size_t MAX_PAYLOAD = 4096;
+
+// ============================================================================
+// Block Filters
+// ============================================================================
+
+static inline void set_bit(uint64_t* bits, size_t n)
+{
+    bits[n >> 6] |= 1ULL << (n & 63);
+}
+
+static inline bool test_bit(const uint64_t* bits, size_t n)
+{
+    return (bits[n >> 6] >> (n & 63)) & 1;
+}
+
+static inline void id_bits(uint32_t id, size_t& a, size_t& b)
+{
+    uint32_t h = id * 0x9E3779B1u;
+    a = (h >> 24) & (SCROLL_ID_BITS - 1);
+    b = (h >> 8) & (SCROLL_ID_BITS - 1);
+}
+
+static inline size_t gram_bit(uint8_t x, uint8_t y)
+{
+    uint32_t key = (static_cast<uint32_t>(x) << 8) | y;
+    return ((key * 0x9E3779B1u) >> 16) & (SCROLL_GRAM_BITS - 1);
+}
+
+static inline uint8_t fold(uint8_t c)
+{
+    return static_cast<uint8_t>(std::tolower(c));
+}
+
+static ScrollBlock& block_for(uint64_t seq)
+{
+    auto& g = g_scrollback;
+    return g.blocks[(seq / BLOCK_EVENTS) % g.blocks.size()];
+}
+
+static void index_record(uint64_t seq, const RecordHeader& h, const uint8_t* p)
+{
+    ScrollBlock& blk = block_for(seq);
+    if (seq % BLOCK_EVENTS == 0 || blk.first_seq != seq - seq % BLOCK_EVENTS) {
+        blk = ScrollBlock{};
+        blk.first_seq = seq - seq % BLOCK_EVENTS;
+    }
+    if (h.kind == static_cast<uint8_t>(ScrollKind::FRAME)) {
+        size_t a = 0, b = 0;
+        id_bits(h.id, a, b);
+        set_bit(blk.id_bloom.data(), a);
+        set_bit(blk.id_bloom.data(), b);
+    }
+    bool text = h.kind == static_cast<uint8_t>(ScrollKind::TEXT);
+    for (size_t i = 1; i < h.len; ++i) {
+        uint8_t x = text ? fold(p[i - 1]) : p[i - 1];
+        uint8_t y = text ? fold(p[i]) : p[i];
+        set_bit(blk.gram_bloom.data(), gram_bit(x, y));
+    }
+}
+
+// ============================================================================
+// Arena Ring
+// ============================================================================
+
+static inline size_t record_size(size_t len)
+{
+    return sizeof(RecordHeader) + ((len + 7) & ~static_cast<size_t>(7));
+}
+
+static const RecordHeader* record_at(uint64_t seq)
+{
+    auto& g = g_scrollback;
+    size_t off = g.offsets[seq % g.offsets.size()];
+    return reinterpret_cast<const RecordHeader*>(g.arena.data() + off);
+}
+
+static void evict_oldest()
+{
+    auto& g = g_scrollback;
+    ++g.first_seq;
+    ++g.evicted;
+    if (g.first_seq == g.next_seq) return;
+    size_t next = g.offsets[g.first_seq % g.offsets.size()];
+    // The tail moving back to the start means the live region no longer wraps
+    if (next < g.tail) g.wrapped = false;
+    g.tail = next;
+}
+
+/// Reserve space for a record, evicting the oldest ones as needed
+static uint8_t* reserve(size_t size)
+{
+    auto& g = g_scrollback;
+    while (g.next_seq - g.first_seq >= g.offsets.size()) evict_oldest();
+
+    for (;;) {
+        if (g.first_seq == g.next_seq) {
+            g.head = g.tail = 0;
+            g.wrapped = false;
+            break;
+        }
+        if (!g.wrapped) {
+            // Live region is [tail, head): use the end, else wrap to the start
+            if (g.arena.size() - g.head >= size) break;
+            g.head = 0;
+            g.wrapped = true;
+            continue;
+        }
+        // Live region wraps: the free gap is [head, tail)
+        if (g.tail - g.head >= size) break;
+        evict_oldest();
+    }
+
+    uint8_t* p = g.arena.data() + g.head;
+    g.offsets[g.next_seq % g.offsets.size()] = static_cast<uint32_t>(g.head);
+    g.head += size;
+    return p;
+}
+
+static void append(ScrollKind kind, uint32_t id, bool extended, const uint8_t* data, size_t len)
+{
+    auto& g = g_scrollback;
+    if (g.arena.empty()) return;
+    len = std::min(len, MAX_PAYLOAD);
+
+    RecordHeader h{};
+    h.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    h.id = id;
+    h.len = static_cast<uint16_t>(len);
+    h.kind = static_cast<uint8_t>(kind);
+    h.extended = extended ? 1 : 0;
+
+    uint8_t* p = reserve(record_size(len));
+    std::memcpy(p, &h, sizeof(h));
+    std::memcpy(p + sizeof(h), data, len);
+    index_record(g.next_seq, h, data);
+    ++g.next_seq;
+
+    if (g.pager && kind == ScrollKind::TEXT) {
+        ++g.pager_new;
+        g.pager_dirty = true;
+    }
+}
+
+// ============================================================================
+// Rendering
+// ============================================================================
+
+static std::string render(const RecordHeader* h)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(h + 1);
+    char stamp[32];
+    std::time_t secs = static_cast<std::time_t>(h->time_us / 1000000);
+    struct tm tm_buf{};
+    localtime_r(&secs, &tm_buf);
+    std::snprintf(stamp, sizeof(stamp), "%02d:%02d:%02d.%03d ",
+                  tm_buf.tm_hour, tm_buf.tm_min, tm_buf.tm_sec,
+                  static_cast<int>((h->time_us / 1000) % 1000));
+    std::string out = stamp;
+
+    auto kind = static_cast<ScrollKind>(h->kind);
+    if (kind == ScrollKind::TEXT) {
+        out.append(reinterpret_cast<const char*>(p), h->len);
+        return out;
+    }
+
+    char head[48];
+    if (kind == ScrollKind::FRAME) {
+        std::snprintf(head, sizeof(head), h->extended ? "RX[ID:0x%08X DLC:%u]: " : "RX[ID:0x%03X DLC:%u]: ",
+                      h->id, static_cast<unsigned>(h->len));
+    } else {
+        std::snprintf(head, sizeof(head), "RX[%u bytes]: ", static_cast<unsigned>(h->len));
+    }
+    out += head;
+    char hex_buf[8];
+    for (size_t i = 0; i < h->len; ++i) {
+        std::snprintf(hex_buf, sizeof(hex_buf), "0x%02X ", p[i]);
+        out += hex_buf;
+    }
+    return out;
+}
+
+// ============================================================================
+// Search
+// ============================================================================
+
+static bool contains(const uint8_t* hay, size_t n, const std::vector<uint8_t>& needle, bool fold_case)
+{
+    if (needle.size() > n) return false;
+    for (size_t i = 0; i + needle.size() <= n; ++i) {
+        size_t j = 0;
+        while (j < needle.size() &&
+               (fold_case ? fold(hay[i + j]) : hay[i + j]) == needle[j]) {
+            ++j;
+        }
+        if (j == needle.size()) return true;
+    }
+    return false;
+}
+
+static bool block_may_match(const ScrollBlock& blk, const ScrollQuery& q)
+{
+    if (q.type == ScrollQuery::ID) {
+        size_t a = 0, b = 0;
+        id_bits(q.id, a, b);
+        return test_bit(blk.id_bloom.data(), a) && test_bit(blk.id_bloom.data(), b);
+    }
+    for (size_t i = 1; i < q.needle.size(); ++i) {
+        if (!test_bit(blk.gram_bloom.data(), gram_bit(q.needle[i - 1], q.needle[i]))) return false;
+    }
+    return true;
+}
+
+static bool record_matches(const RecordHeader* h, const ScrollQuery& q)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(h + 1);
+    auto kind = static_cast<ScrollKind>(h->kind);
+    switch (q.type) {
+        case ScrollQuery::ID:
+            return kind == ScrollKind::FRAME && h->id == q.id;
+        case ScrollQuery::BYTES:
+            return kind != ScrollKind::TEXT && contains(p, h->len, q.needle, false);
+        case ScrollQuery::TEXT:
+            return kind == ScrollKind::TEXT && contains(p, h->len, q.needle, true);
+    }
+    return false;
+}
+
+size_t scrollback_find(const ScrollQuery& q, size_t limit, std::vector<std::string>& out)
+{
+    auto& g = g_scrollback;
+    out.clear();
+    std::vector<uint64_t> hits;
+    g.last_blocks_scanned = 0;
+    g.last_blocks_skipped = 0;
+
+    uint64_t seq = g.next_seq;
+    while (seq > g.first_seq && hits.size() < limit) {
+        // Walk back one block at a time, skipping blocks the filters rule out
+        uint64_t block_start = std::max<uint64_t>((seq - 1) - (seq - 1) % BLOCK_EVENTS, g.first_seq);
+        const ScrollBlock& blk = block_for(seq - 1);
+        if (!block_may_match(blk, q)) {
+            ++g.last_blocks_skipped;
+            seq = block_start;
+            continue;
+        }
+        ++g.last_blocks_scanned;
+        while (seq > block_start && hits.size() < limit) {
+            --seq;
+            if (record_matches(record_at(seq), q)) hits.push_back(seq);
+        }
+        seq = block_start;
+    }
+
+    for (auto it = hits.rbegin(); it != hits.rend(); ++it) {
+        out.push_back(render(record_at(*it)));
+    }
+    return hits.size();
+}
+
+// ============================================================================
+// Pager
+// ============================================================================
+
+static void term_size(int& rows, int& cols)
+{
+    struct winsize ws{};
+    rows = 24;
+    cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 2 && ws.ws_col > 10) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+}
+
+static bool is_text(uint64_t seq)
+{
+    return record_at(seq)->kind == static_cast<uint8_t>(ScrollKind::TEXT);
+}
+
+static bool prev_text(uint64_t& seq)
+{
+    for (uint64_t s = seq; s > g_scrollback.first_seq;) {
+        if (is_text(--s)) {
+            seq = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool next_text(uint64_t& seq)
+{
+    for (uint64_t s = seq + 1; s < g_scrollback.next_seq; ++s) {
+        if (is_text(s)) {
+            seq = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Text record the pager view ends at (the anchor may have been evicted)
+static bool anchor(uint64_t& seq)
+{
+    auto& g = g_scrollback;
+    if (g.first_seq == g.next_seq) return false;
+    seq = std::clamp(g.pager_bottom, g.first_seq, g.next_seq - 1);
+    return is_text(seq) || prev_text(seq) || next_text(seq);
+}
+
+static void move_lines(long delta)
+{
+    auto& g = g_scrollback;
+    uint64_t s = 0;
+    g.pager_follow = false;
+    if (!anchor(s)) return;
+    while (delta < 0 && prev_text(s)) ++delta;
+    while (delta > 0) {
+        if (!next_text(s)) {
+            g.pager_follow = true;
+            break;
+        }
+        --delta;
+    }
+    g.pager_bottom = s;
+}
+
+static void draw_pager()
+{
+    auto& g = g_scrollback;
+    int rows = 0, cols = 0;
+    term_size(rows, cols);
+    size_t page = static_cast<size_t>(rows - 1);
+
+    if (g.pager_follow && g.next_seq > g.first_seq) {
+        g.pager_bottom = g.next_seq - 1;
+        g.pager_new = 0;
+    }
+
+    // Collect up to one page of text records ending at the anchor
+    std::vector<uint64_t> lines;
+    uint64_t s = 0;
+    if (anchor(s)) {
+        lines.push_back(s);
+        while (lines.size() < page && prev_text(s)) lines.push_back(s);
+    }
+
+    std::string frame = "\033[H\033[2J";
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+        std::string line = render(record_at(*it));
+        if (line.size() > static_cast<size_t>(cols)) line.resize(static_cast<size_t>(cols));
+        frame += line;
+        frame += "\r\n";
+    }
+    for (size_t i = lines.size(); i < page; ++i) frame += "~\r\n";
+
+    char status[160];
+    std::snprintf(status, sizeof(status),
+                  "\033[7m scrollback %s | %llu new | j/k PgUp/PgDn g/G: move  q: quit \033[0m",
+                  g.pager_follow ? "LIVE" : "paused",
+                  static_cast<unsigned long long>(g.pager_new));
+    frame += status;
+    std::fwrite(frame.data(), 1, frame.size(), stdout);
+    std::fflush(stdout);
+    g.pager_dirty = false;
+    g.pager_drawn = Clock::now();
+}
+
+void scrollback_pager_open()
+{
+    auto& g = g_scrollback;
+    g.pager = true;
+    g.pager_follow = true;
+    g.pager_new = 0;
+    g.pager_esc.clear();
+    std::printf("\033[?1049h");
+    draw_pager();
+}
+
+static void pager_close()
+{
+    g_scrollback.pager = false;
+    std::printf("\033[?1049l");
+    std::fflush(stdout);
+}
+
+bool scrollback_pager_key(char c)
+{
+    auto& g = g_scrollback;
+    int rows = 0, cols = 0;
+    term_size(rows, cols);
+    long page = rows - 2;
+
+    // A lone ESC followed by a plain key: drop the ESC and handle the key
+    if (g.pager_esc.size() == 1 && c != '[' && c != 'O') g.pager_esc.clear();
+
+    // Collect escape sequences (arrows, PgUp/PgDn, Home/End)
+    if (!g.pager_esc.empty() || c == '\033') {
+        g.pager_esc.push_back(c);
+        const std::string& e = g.pager_esc;
+        bool done = e.size() >= 3 && (std::isalpha(static_cast<unsigned char>(e.back())) || e.back() == '~');
+        if (!done && e.size() < 6) return true;
+        if (e == "\033[A") move_lines(-1);
+        else if (e == "\033[B") move_lines(1);
+        else if (e == "\033[5~") move_lines(-page);
+        else if (e == "\033[6~") move_lines(page);
+        else if (e == "\033[H" || e == "\033[1~") move_lines(-static_cast<long>(g.next_seq));
+        else if (e == "\033[F" || e == "\033[4~") g.pager_follow = true;
+        g.pager_esc.clear();
+        draw_pager();
+        return true;
+    }
+
+    switch (c) {
+        case 'q': case 'Q':
+            pager_close();
+            return false;
+        case 'k': move_lines(-1); break;
+        case 'j': case '\r': case '\n': move_lines(1); break;
+        case 'b': case 'u': move_lines(-page); break;
+        case ' ': case 'f': case 'd': move_lines(page); break;
+        case 'g': move_lines(-static_cast<long>(g.next_seq)); break;
+        case 'G': g.pager_follow = true; break;
+        default: return true;
+    }
+    draw_pager();
+    return true;
+}
+
+void scrollback_pager_tick()
+{
+    auto& g = g_scrollback;
+    // Redraw at most 10 times per second while traffic keeps arriving
+    if (g.pager && g.pager_dirty && Clock::now() - g.pager_drawn >= std::chrono::milliseconds(100)) {
+        draw_pager();
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void scrollback_configure(const Config& cfg)
+{
+    auto& g = g_scrollback;
+    size_t mb = 16;
+    auto it = cfg.find("scrollback_mb");
+    if (it != cfg.end()) {
+        try { mb = std::stoul(it->second); } catch (...) {}
+    }
+    mb = std::min<size_t>(mb, 1024);
+
+    g = ScrollbackState{};
+    g.cap_bytes = mb << 20;
+    if (g.cap_bytes == 0) return;
+
+    // ~80% arena; the offset table and block filters take the rest
+    size_t arena = g.cap_bytes / 5 * 4;
+    size_t max_events = arena / MIN_RECORD + 1;
+    g.arena.assign(arena, 0);
+    g.offsets.assign(max_events, 0);
+    g.blocks.assign(max_events / BLOCK_EVENTS + 2, ScrollBlock{});
+}
+
+void scrollback_add_text(const std::string& text)
+{
+    append(ScrollKind::TEXT, 0, false, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+void scrollback_add_frame(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc)
+{
+    append(ScrollKind::FRAME, can_id, extended, data, std::min<size_t>(dlc, 8));
+}
+
+void scrollback_add_bytes(const uint8_t* data, size_t len)
+{
+    append(ScrollKind::BYTES, 0, false, data, len);
+}
+
+void scrollback_print_status()
+{
+    const auto& g = g_scrollback;
+    size_t used = (g.first_seq == g.next_seq) ? 0
+                : (g.head > g.tail ? g.head - g.tail : g.arena.size() - g.tail + g.head);
+    std::printf("\r\nScrollback: %llu events held, %llu evicted, %.1f / %.1f MB arena (cap %zu MB)\n\n",
+                static_cast<unsigned long long>(g.next_seq - g.first_seq),
+                static_cast<unsigned long long>(g.evicted),
+                used / 1048576.0, g.arena.size() / 1048576.0, g.cap_bytes >> 20);
+}
+
+} // namespace adamcom
@@ -0,0 +1,507 @@
+/**
+ * @file sequence.cpp
+ * @brief Timed sequences: pre-built steps on absolute deadlines, RX waits, per-step lateness
+ */
+
+#include "adamcom.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+namespace adamcom {
+
+// Define the global sequence state
+SequenceState g_seq{};
+
+using Clock = std::chrono::steady_clock;
+
+/// WAIT timeout when none is given
+static constexpr uint32_t DEFAULT_WAIT_US = 1000000;
+
+// ============================================================================
+// Parsing
+// ============================================================================
+
+static std::string lower(std::string s)
+{
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+static std::string trimmed(const std::string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r");
+    size_t e = s.find_last_not_of(" \t\r");
+    return (b == std::string::npos) ? "" : s.substr(b, e - b + 1);
+}
+
+/// "250us", "1.5ms", "2s"; a bare number is milliseconds
+static bool parse_duration_us(const std::string& text, uint32_t& us)
+{
+    std::string t = lower(trimmed(text));
+    double scale = 1000.0;
+    if (t.size() > 2 && t.compare(t.size() - 2, 2, "us") == 0) {
+        scale = 1.0;
+        t.resize(t.size() - 2);
+    } else if (t.size() > 2 && t.compare(t.size() - 2, 2, "ms") == 0) {
+        t.resize(t.size() - 2);
+    } else if (t.size() > 1 && t.back() == 's') {
+        scale = 1000000.0;
+        t.pop_back();
+    }
+    try {
+        size_t used = 0;
+        double v = std::stod(t, &used) * scale;
+        if (used != t.size() || v < 0 || v > 3600e6) return false;
+        us = static_cast<uint32_t>(v + 0.5);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool parse_step(const std::string& text, const Config& cfg, SeqStep& step, std::string& error)
+{
+    step.text = text;
+    auto sp = text.find(' ');
+    std::string kind = lower(text.substr(0, sp));
+    std::string rest = (sp == std::string::npos) ? "" : trimmed(text.substr(sp + 1));
+
+    if (kind == "delay") {
+        step.kind = SeqStepKind::DELAY;
+        if (!parse_duration_us(rest, step.us)) {
+            error = "invalid delay: " + rest;
+            return false;
+        }
+        return true;
+    }
+    if (kind == "wait") {
+        step.kind = SeqStepKind::WAIT;
+        step.us = DEFAULT_WAIT_US;
+        auto pos = lower(rest).rfind(" timeout ");
+        if (pos != std::string::npos) {
+            if (!parse_duration_us(rest.substr(pos + 9), step.us)) {
+                error = "invalid timeout: " + rest.substr(pos + 9);
+                return false;
+            }
+            rest = rest.substr(0, pos);
+        }
+        return trigger_parse_match(rest, step.match, error);
+    }
+    step.kind = SeqStepKind::SEND;
+    return responder_parse_payload(text, cfg, step.payload, error);
+}
+
+static bool parse_sequence(const std::string& name, const std::vector<std::string>& lines, const Config& cfg,
+                           Sequence& seq, std::string& error)
+{
+    seq.name = name;
+    uint64_t cycle_us = 0;
+    bool has_wait = false;
+    for (const auto& raw : lines) {
+        std::string line = trimmed(raw);
+        if (line.empty() || line[0] == '#') continue;
+        if (lower(line.substr(0, 5)) == "loop ") {
+            try {
+                seq.loops = static_cast<uint32_t>(std::stoul(line.substr(5)));
+            } catch (...) {
+                error = "invalid loop count: " + line.substr(5);
+                return false;
+            }
+            continue;
+        }
+        SeqStep step;
+        if (!parse_step(line, cfg, step, error)) {
+            error = "'" + line + "': " + error;
+            return false;
+        }
+        if (step.kind == SeqStepKind::DELAY) cycle_us += step.us;
+        if (step.kind == SeqStepKind::WAIT) has_wait = true;
+        seq.steps.push_back(std::move(step));
+    }
+    if (seq.steps.empty()) {
+        error = "no steps";
+        return false;
+    }
+    // An endless loop that never waits would keep the main loop busy forever
+    if (seq.loops == 0 && cycle_us == 0 && !has_wait) {
+        error = "loop 0 (forever) needs a delay or wait step";
+        return false;
+    }
+    return true;
+}
+
+static bool valid_name(const std::string& name)
+{
+    if (name.empty()) return false;
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-') return false;
+    }
+    return true;
+}
+
+static Sequence* find(const std::string& name)
+{
+    for (auto& s : g_seq.seqs) {
+        if (s.name == name) return &s;
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Execution
+// ============================================================================
+
+static void finish(size_t run_index, const char* how)
+{
+    auto& g = g_seq;
+    SeqRun& run = g.runs[run_index];
+    Sequence& seq = g.seqs[run.seq];
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - run.started).count();
+    char line[192];
+    std::snprintf(line, sizeof(line), "SEQ[%s] %s after %.1f ms (%u loop%s, max lateness %llu us, %llu skipped)",
+                  seq.name.c_str(), how, ms, run.loop, run.loop == 1 ? "" : "s",
+                  static_cast<unsigned long long>(run.late_max_us),
+                  static_cast<unsigned long long>(run.skipped));
+    g.runs.erase(g.runs.begin() + static_cast<std::ptrdiff_t>(run_index));
+    print_message_above(line);
+}
+
+/// Step past the current step; false when the run has ended
+static bool advance(SeqRun& run, const Sequence& seq)
+{
+    if (++run.step < seq.steps.size()) return true;
+    run.step = 0;
+    ++run.loop;
+    return seq.loops == 0 || run.loop < seq.loops;
+}
+
+/// Run steps until one lies in the future or waits for RX; false when the run has ended
+static bool run_due(SeqRun& run, Clock::time_point now)
+{
+    auto& g = g_seq;
+    Sequence& seq = g.seqs[run.seq];
+    for (;;) {
+        SeqStep& step = seq.steps[run.step];
+        if (step.kind == SeqStepKind::DELAY) {
+            auto period = std::chrono::microseconds(step.us);
+            run.deadline += period;
+            // More than a period behind after a stall (menu, reconnect, SIGSTOP): resume from
+            // now rather than firing every missed iteration back-to-back
+            if (step.us > 0 && now - run.deadline > period) {
+                auto missed = static_cast<uint64_t>((now - run.deadline) / period);
+                run.deadline = now;
+                run.skipped += missed;
+                seq.skipped += missed;
+            }
+        } else if (step.kind == SeqStepKind::WAIT) {
+            if (!run.waiting) {
+                run.waiting = true;
+                run.tail.clear();
+                run.wait_until = run.deadline + std::chrono::microseconds(step.us);
+            }
+            if (now < run.wait_until) return true;
+            ++step.failures;
+            ++seq.aborted;
+            return false;
+        } else {
+            if (now < run.deadline) return true;
+            auto late_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - run.deadline).count());
+            const ResponderEntry& p = step.payload;
+            bool ok = g.fd && (p.is_can ? send_can_bytes(*g.fd, p.can_id, p.can_data.data(), p.can_len)
+                                        : send_serial_bytes(*g.fd, p.bytes));
+            ++step.count;
+            step.late_total_us += late_us;
+            step.late_max_us = std::max(step.late_max_us, late_us);
+            run.late_max_us = std::max(run.late_max_us, late_us);
+            metric_observe(MetricHist::SEQ_LATENESS, late_us);
+            if (!ok) ++step.failures;
+        }
+        if (!advance(run, seq)) {
+            ++seq.completed;
+            return false;
+        }
+    }
+}
+
+static void wait_matched(size_t run_index, Clock::time_point rx_time)
+{
+    auto& g = g_seq;
+    SeqRun& run = g.runs[run_index];
+    Sequence& seq = g.seqs[run.seq];
+    ++seq.steps[run.step].count;
+    run.waiting = false;
+    // Steps after a wait are timed from the frame that satisfied it
+    run.deadline = rx_time;
+    if (!advance(run, seq)) {
+        ++seq.completed;
+        finish(run_index, "done");
+    } else if (!run_due(run, Clock::now())) {
+        finish(run_index, run.waiting ? "timed out" : "done");
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void seq_bind(const int* fd)
+{
+    g_seq.fd = fd;
+}
+
+bool seq_define(const std::string& name, const std::string& steps, const Config& cfg, std::string& error)
+{
+    if (!valid_name(name)) {
+        error = "invalid sequence name '" + name + "' (letters, digits, _ and -)";
+        return false;
+    }
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start <= steps.size()) {
+        size_t end = steps.find(';', start);
+        if (end == std::string::npos) end = steps.size();
+        lines.push_back(steps.substr(start, end - start));
+        start = end + 1;
+    }
+    Sequence seq;
+    if (!parse_sequence(name, lines, cfg, seq, error)) return false;
+
+    seq_stop(name);
+    if (Sequence* old = find(name)) {
+        *old = std::move(seq);
+    } else {
+        g_seq.seqs.push_back(std::move(seq));
+    }
+    return true;
+}
+
+void seq_configure(const Config& cfg)
+{
+    std::string error;
+    for (const auto& [key, value] : cfg) {
+        if (key.compare(0, 4, "seq_") != 0 || key == "seq_file") continue;
+        if (!seq_define(key.substr(4), value, cfg, error)) {
+            std::fprintf(stderr, "Sequence %s: %s\n", key.substr(4).c_str(), error.c_str());
+        }
+    }
+    auto it = cfg.find("seq_file");
+    if (it != cfg.end() && it->second != "none" && seq_load_file(it->second, cfg, error) < 0) {
+        std::fprintf(stderr, "Sequence file: %s\n", error.c_str());
+    }
+}
+
+int seq_load_file(const std::string& path, const Config& cfg, std::string& error)
+{
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return -1;
+    }
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> sections;
+    std::string line;
+    int lineno = 0;
+    while (std::getline(in, line)) {
+        ++lineno;
+        std::string t = trimmed(line);
+        if (t.size() >= 2 && t.front() == '[' && t.back() == ']') {
+            sections.push_back({trimmed(t.substr(1, t.size() - 2)), {}});
+        } else if (!t.empty() && t[0] != '#') {
+            if (sections.empty()) {
+                error = path + ":" + std::to_string(lineno) + ": step before the first [NAME]";
+                return -1;
+            }
+            sections.back().second.push_back(t);
+        }
+    }
+
+    // Parse everything first so a bad file leaves the existing sequences alone
+    std::vector<Sequence> parsed;
+    for (const auto& [name, lines] : sections) {
+        Sequence seq;
+        if (!valid_name(name)) {
+            error = path + ": invalid sequence name '" + name + "'";
+            return -1;
+        }
+        if (!parse_sequence(name, lines, cfg, seq, error)) {
+            error = path + ": [" + name + "] " + error;
+            return -1;
+        }
+        parsed.push_back(std::move(seq));
+    }
+    for (auto& seq : parsed) {
+        seq_stop(seq.name);
+        if (Sequence* old = find(seq.name)) {
+            *old = std::move(seq);
+        } else {
+            g_seq.seqs.push_back(std::move(seq));
+        }
+    }
+    return static_cast<int>(parsed.size());
+}
+
+bool seq_start(const std::string& name, std::string& error)
+{
+    auto& g = g_seq;
+    Sequence* seq = find(name);
+    if (!seq) {
+        error = "no sequence '" + name + "'";
+        return false;
+    }
+    seq_stop(name);
+    if (g.runs.size() >= SEQ_MAX_RUNS) {
+        error = "already " + std::to_string(SEQ_MAX_RUNS) + " sequences running";
+        return false;
+    }
+    SeqRun run;
+    run.seq = static_cast<size_t>(seq - g.seqs.data());
+    run.started = Clock::now();
+    run.deadline = run.started;
+    ++seq->runs;
+    g.runs.push_back(std::move(run));
+    // Leading sends go out now rather than on the next loop pass
+    if (!run_due(g.runs.back(), g.runs.back().started)) {
+        finish(g.runs.size() - 1, g.runs.back().waiting ? "timed out" : "done");
+    }
+    return true;
+}
+
+bool seq_stop(const std::string& name)
+{
+    auto& g = g_seq;
+    for (size_t i = 0; i < g.runs.size(); ++i) {
+        if (g.seqs[g.runs[i].seq].name == name) {
+            ++g.seqs[g.runs[i].seq].aborted;
+            finish(i, "stopped");
+            return true;
+        }
+    }
+    return false;
+}
+
+void seq_stop_all()
+{
+    while (!g_seq.runs.empty()) {
+        ++g_seq.seqs[g_seq.runs.back().seq].aborted;
+        finish(g_seq.runs.size() - 1, "stopped");
+    }
+}
+
+void seq_poll(Clock::time_point now)
+{
+    auto& g = g_seq;
+    for (size_t i = 0; i < g.runs.size();) {
+        if (run_due(g.runs[i], now)) {
+            ++i;
+            continue;
+        }
+        finish(i, g.runs[i].waiting ? "timed out" : "done");
+    }
+}
+
+Clock::time_point seq_next_deadline()
+{
+    auto next = Clock::time_point::max();
+    for (const auto& run : g_seq.runs) {
+        next = std::min(next, run.waiting ? run.wait_until : run.deadline);
+    }
+    return next;
+}
+
+void seq_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc, Clock::time_point rx_time)
+{
+    auto& g = g_seq;
+    dlc = std::min<size_t>(dlc, 8);
+    uint64_t frame = 0;
+    std::memcpy(&frame, data, dlc);
+    for (size_t i = g.runs.size(); i-- > 0;) {
+        const SeqRun& run = g.runs[i];
+        if (!run.waiting) continue;
+        const Trigger& t = g.seqs[run.seq].steps[run.step].match;
+        if (t.is_can && t.extended == extended && (can_id & t.id_mask) == t.can_id && dlc >= t.data_len &&
+            ((frame ^ t.data_want) & t.data_mask) == 0) {
+            wait_matched(i, rx_time);
+        }
+    }
+}
+
+void seq_serial_rx(const uint8_t* data, size_t len, Clock::time_point rx_time)
+{
+    auto& g = g_seq;
+    for (size_t i = g.runs.size(); i-- > 0;) {
+        SeqRun& run = g.runs[i];
+        if (!run.waiting) continue;
+        const auto& pattern = g.seqs[run.seq].steps[run.step].match.pattern;
+        if (pattern.empty()) continue;
+        // Search the carried-over tail plus this read so patterns split across reads match
+        run.tail.insert(run.tail.end(), data, data + len);
+        if (std::search(run.tail.begin(), run.tail.end(), pattern.begin(), pattern.end()) != run.tail.end()) {
+            wait_matched(i, rx_time);
+            continue;
+        }
+        if (run.tail.size() >= pattern.size()) {
+            run.tail.erase(run.tail.begin(), run.tail.end() - static_cast<std::ptrdiff_t>(pattern.size() - 1));
+        }
+    }
+}
+
+void seq_print_list()
+{
+    const auto& g = g_seq;
+    if (g.seqs.empty()) {
+        std::printf("\r\nNo sequences (define seq_NAME=\"step; step\" in the config or /seq load FILE)\n\n");
+        return;
+    }
+    std::printf("\r\nSequences:\n");
+    auto now = Clock::now();
+    for (size_t i = 0; i < g.seqs.size(); ++i) {
+        const Sequence& s = g.seqs[i];
+        std::printf("  %-16s %3zu steps, %s, %llu runs (%llu done, %llu stopped/timed out)", s.name.c_str(),
+                    s.steps.size(), s.loops == 0 ? "loops forever" : (std::to_string(s.loops) + "x").c_str(),
+                    static_cast<unsigned long long>(s.runs), static_cast<unsigned long long>(s.completed),
+                    static_cast<unsigned long long>(s.aborted));
+        if (s.skipped > 0) {
+            std::printf(", %llu delays skipped", static_cast<unsigned long long>(s.skipped));
+        }
+        for (const auto& run : g.runs) {
+            if (run.seq != i) continue;
+            std::printf("  RUNNING step %zu loop %u, %.1f s", run.step + 1, run.loop + 1,
+                        std::chrono::duration<double>(now - run.started).count());
+            if (run.waiting) std::printf(" (waiting)");
+        }
+        std::printf("\n");
+    }
+    std::printf("\n");
+}
+
+bool seq_print_steps(const std::string& name)
+{
+    const Sequence* s = find(name);
+    if (!s) return false;
+    std::printf("\r\nSequence %s (%s, %llu delays skipped after stalls):\n", s->name.c_str(),
+                s->loops == 0 ? "loops forever" : ("loop " + std::to_string(s->loops)).c_str(),
+                static_cast<unsigned long long>(s->skipped));
+    std::printf("  %-4s %-40s %8s %10s %10s %8s\n", "#", "step", "count", "late avg", "late max", "failed");
+    for (size_t i = 0; i < s->steps.size(); ++i) {
+        const SeqStep& st = s->steps[i];
+        if (st.kind == SeqStepKind::SEND && st.count > 0) {
+            std::printf("  %-4zu %-40.40s %8llu %8.1fus %8lluus %8llu\n", i + 1, st.text.c_str(),
+                        static_cast<unsigned long long>(st.count),
+                        static_cast<double>(st.late_total_us) / static_cast<double>(st.count),
+                        static_cast<unsigned long long>(st.late_max_us),
+                        static_cast<unsigned long long>(st.failures));
+        } else {
+            std::printf("  %-4zu %-40.40s %8llu %10s %10s %8llu\n", i + 1, st.text.c_str(),
+                        static_cast<unsigned long long>(st.count), "", "",
+                        static_cast<unsigned long long>(st.failures));
+        }
+    }
+    std::printf("\n");
+    return true;
+}
+
+} // namespace adamcom
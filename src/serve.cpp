@@ -0,0 +1,475 @@
+/**
+ * @file serve.cpp
+ * @brief Session server on a Unix socket (--serve) and the thin --attach client
+ *
+ * Protocol (newline-delimited, both directions):
+ *   client -> server   one command line, exactly as typed at the prompt
+ *   server -> client   "E <line>"  printed event (RX/TX, decoders, triggers, ...)
+ *                      "R <line>"  output of this client's command
+ *                      "D"         end of the reply to one command
+ */
+
+#include "adamcom.hpp"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <iostream>
+
+namespace adamcom {
+
+// Define the global session server
+ServeState g_serve{};
+
+static constexpr size_t MAX_COMMAND = 4096;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static bool make_address(const std::string& path, sockaddr_un& addr, std::string& error)
+{
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        error = "socket path must be 1-" + std::to_string(sizeof(addr.sun_path) - 1) + " characters";
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static int connect_socket(const std::string& path, std::string& error)
+{
+    sockaddr_un addr{};
+    if (!make_address(path, addr, error)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        error = path + ": " + std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// Write as much queued output as the socket takes without blocking
+static void flush_client(ServeClient& c)
+{
+    while (!c.out.empty() && !c.closing) {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            c.out.erase(0, static_cast<size_t>(n));
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            c.closing = true;
+        }
+    }
+}
+
+/// Queue protocol text; a client too far behind is dropped instead of stalling the session
+static void queue(ServeClient& c, const char* data, size_t len)
+{
+    if (c.closing) return;
+    if (c.out.size() + len > SERVE_CLIENT_BUFFER) {
+        c.closing = true;
+        ++g_serve.dropped;
+        return;
+    }
+    bool idle = c.out.empty();
+    c.out.append(data, len);
+    if (idle) flush_client(c);
+}
+
+static void queue_line(ServeClient& c, char tag, const std::string& text)
+{
+    std::string line;
+    line.reserve(text.size() + 3);
+    line.push_back(tag);
+    line.push_back(' ');
+    line += text;
+    line.push_back('\n');
+    queue(c, line.data(), line.size());
+}
+
+/// Turn captured terminal output into reply lines (drops CRs, ANSI escapes, outer blank lines)
+static void queue_reply(ServeClient& c, const std::string& raw)
+{
+    std::vector<std::string> lines(1);
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char ch = raw[i];
+        if (ch == '\033') {
+            if (i + 1 < raw.size() && raw[i + 1] == '[') {
+                i += 2;
+                while (i < raw.size() && !std::isalpha(static_cast<unsigned char>(raw[i]))) ++i;
+            }
+        } else if (ch == '\n') {
+            lines.emplace_back();
+        } else if (ch != '\r' && ch != '\a') {
+            lines.back().push_back(ch);
+        }
+    }
+    size_t first = 0, last = lines.size();
+    while (first < last && lines[first].empty()) ++first;
+    while (last > first && lines[last - 1].empty()) --last;
+    for (size_t i = first; i < last; ++i) {
+        queue_line(c, 'R', lines[i]);
+    }
+    queue(c, "D\n", 2);
+}
+
+static void run_command(size_t index, const std::string& line)
+{
+    auto& g = g_serve;
+    ++g.commands;
+    ++g.clients[index].commands;
+
+    // Capture everything the command prints to stdout as its reply
+    std::fflush(stdout);
+    std::cout.flush();
+    int saved = dup(STDOUT_FILENO);
+    bool captured = saved >= 0 && g.reply_fd >= 0 && ftruncate(g.reply_fd, 0) == 0 &&
+                    lseek(g.reply_fd, 0, SEEK_SET) == 0 && dup2(g.reply_fd, STDOUT_FILENO) >= 0;
+
+    g.exec_client = static_cast<int>(index);
+    g.exec(line);
+    g.exec_client = -1;
+
+    std::fflush(stdout);
+    std::cout.flush();
+    std::string reply;
+    if (captured) {
+        dup2(saved, STDOUT_FILENO);
+        off_t size = lseek(g.reply_fd, 0, SEEK_CUR);
+        if (size > 0) {
+            reply.resize(static_cast<size_t>(size));
+            ssize_t n = pread(g.reply_fd, &reply[0], reply.size(), 0);
+            reply.resize(n > 0 ? static_cast<size_t>(n) : 0);
+        }
+    }
+    if (saved >= 0) close(saved);
+    queue_reply(g.clients[index], reply);
+}
+
+static void read_client(size_t index)
+{
+    auto& g = g_serve;
+    char buf[4096];
+    ssize_t n = recv(g.clients[index].fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        g.clients[index].closing = true;
+        return;
+    }
+    if (n < 0) return;
+
+    g.clients[index].in.append(buf, static_cast<size_t>(n));
+    size_t start = 0;
+    for (;;) {
+        // Re-index each time: a command may queue output to (and drop) other clients
+        auto& c = g.clients[index];
+        size_t nl = c.in.find('\n', start);
+        if (nl == std::string::npos) break;
+        std::string line = c.in.substr(start, nl - start);
+        start = nl + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        run_command(index, line);
+        if (g.clients[index].closing) return;
+    }
+    auto& c = g.clients[index];
+    c.in.erase(0, start);
+    if (c.in.size() > MAX_COMMAND) c.closing = true;
+}
+
+static void accept_clients()
+{
+    auto& g = g_serve;
+    for (;;) {
+        int fd = accept4(g.listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (g.clients.size() >= SERVE_MAX_CLIENTS) {
+            static const char full[] = "E server full\n";
+            send(fd, full, sizeof(full) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+        ServeClient c;
+        c.fd = fd;
+        g.clients.push_back(std::move(c));
+        ++g.accepted;
+    }
+}
+
+static void reap_clients()
+{
+    auto& g = g_serve;
+    for (size_t i = 0; i < g.clients.size();) {
+        if (g.clients[i].closing) {
+            close(g.clients[i].fd);
+            g.clients.erase(g.clients.begin() + static_cast<std::ptrdiff_t>(i));
+        } else {
+            ++i;
+        }
+    }
+}
+
+// ============================================================================
+// Server API
+// ============================================================================
+
+std::string serve_default_path()
+{
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return std::string(runtime) + "/adamcom.sock";
+    }
+    return "/tmp/adamcom-" + std::to_string(getuid()) + ".sock";
+}
+
+bool serve_start(const std::string& path, ServeExecFn exec, std::string& error)
+{
+    serve_stop();
+    sockaddr_un addr{};
+    if (!make_address(path, addr, error)) return false;
+
+    // Only replace the socket file if nobody is answering on it
+    std::string probe_error;
+    int probe = connect_socket(path, probe_error);
+    if (probe >= 0) {
+        close(probe);
+        error = path + ": another adamcom is already serving here";
+        return false;
+    }
+    unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(fd, static_cast<int>(SERVE_MAX_CLIENTS)) != 0) {
+        error = path + ": " + std::strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    chmod(path.c_str(), 0600);   // Commands run with our privileges: owner only
+
+    auto& g = g_serve;
+    g.listen_fd = fd;
+    g.path = path;
+    g.exec = exec;
+    if (g.reply_fd < 0) {
+        g.reply_fd = memfd_create("adamcom-reply", MFD_CLOEXEC);
+    }
+    return true;
+}
+
+void serve_stop()
+{
+    auto& g = g_serve;
+    for (auto& c : g.clients) {
+        close(c.fd);
+    }
+    g.clients.clear();
+    if (g.listen_fd >= 0) {
+        close(g.listen_fd);
+        unlink(g.path.c_str());
+    }
+    g.listen_fd = -1;
+}
+
+size_t serve_pollfds(pollfd* fds)
+{
+    auto& g = g_serve;
+    if (g.listen_fd < 0) return 0;
+    reap_clients();
+    size_t n = 0;
+    fds[n++] = {g.listen_fd, POLLIN, 0};
+    for (const auto& c : g.clients) {
+        fds[n++] = {c.fd, static_cast<short>(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0};
+    }
+    return n;
+}
+
+void serve_handle(const pollfd* fds, size_t n)
+{
+    auto& g = g_serve;
+    if (n == 0) return;
+
+    // Entries 1..n-1 line up with clients[] as they were when the poll set was built
+    size_t polled = n - 1;
+    for (size_t i = 0; i < polled && i < g.clients.size(); ++i) {
+        short ev = fds[i + 1].revents;
+        if (ev & (POLLERR | POLLNVAL)) {
+            g.clients[i].closing = true;
+            continue;
+        }
+        if (ev & POLLOUT) flush_client(g.clients[i]);
+        if (ev & (POLLIN | POLLHUP)) read_client(i);
+    }
+    if (fds[0].revents & POLLIN) accept_clients();
+    reap_clients();
+}
+
+void serve_broadcast(const std::string& line)
+{
+    auto& g = g_serve;
+    for (size_t i = 0; i < g.clients.size(); ++i) {
+        if (static_cast<int>(i) != g.exec_client) {
+            queue_line(g.clients[i], 'E', line);
+        }
+    }
+}
+
+bool serve_executing()
+{
+    return g_serve.exec_client >= 0;
+}
+
+void serve_print_status()
+{
+    const auto& g = g_serve;
+    if (g.listen_fd < 0) {
+        std::printf("\r\nServer: off (start with --serve [PATH])\n\n");
+        return;
+    }
+    std::printf("\r\nServer: %s, %zu client%s attached (%llu accepted, %llu dropped as slow), %llu commands\n",
+                g.path.c_str(), g.clients.size(), g.clients.size() == 1 ? "" : "s",
+                static_cast<unsigned long long>(g.accepted),
+                static_cast<unsigned long long>(g.dropped),
+                static_cast<unsigned long long>(g.commands));
+    for (const auto& c : g.clients) {
+        std::printf("  fd %d: %llu commands, %zu bytes queued\n", c.fd,
+                    static_cast<unsigned long long>(c.commands), c.out.size());
+    }
+    std::printf("\n");
+}
+
+// ============================================================================
+// Attach Client
+// ============================================================================
+
+/// Print one protocol line; returns true for the end-of-reply marker
+static bool relay_line(const std::string& line)
+{
+    if (line == "D") return true;
+    if (line.size() >= 2 && (line[0] == 'R' || line[0] == 'E') && line[1] == ' ') {
+        std::printf("%s\n", line.c_str() + 2);
+    } else {
+        std::printf("%s\n", line.c_str());
+    }
+    std::fflush(stdout);
+    return false;
+}
+
+int attach_run(const std::string& path, const std::vector<std::string>& cmds)
+{
+    std::string error;
+    int fd = connect_socket(path, error);
+    if (fd < 0) {
+        std::cerr << "Attach failed: " << error << "\n";
+        return 1;
+    }
+
+    // Scripted: one reply per command, events in between are not shown
+    bool interactive = cmds.empty();
+    size_t next_cmd = 0;
+    size_t pending = 0;
+    bool stdin_open = interactive;
+    std::string in_buf;
+    std::string sock_buf;
+    bool failed = false;           // Refused (server full) or closed by the server
+
+    auto send_line = [&](const std::string& line) {
+        std::string msg = line + "\n";
+        size_t off = 0;
+        while (off < msg.size()) {
+            ssize_t n = send(fd, msg.data() + off, msg.size() - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            off += static_cast<size_t>(n);
+        }
+        ++pending;
+        return true;
+    };
+
+    if (!interactive && !send_line(cmds[next_cmd++])) {
+        close(fd);
+        return 1;
+    }
+
+    char buf[4096];
+    for (;;) {
+        if (!interactive && pending == 0) {
+            if (next_cmd == cmds.size()) break;
+            if (!send_line(cmds[next_cmd++])) {
+                failed = true;
+                break;
+            }
+        }
+        if (interactive && !stdin_open && pending == 0) break;
+
+        pollfd fds[2] = {
+            {fd, POLLIN, 0},
+            {stdin_open ? STDIN_FILENO : -1, POLLIN, 0}
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                std::cerr << "Server closed the connection\n";
+                failed = true;
+                break;
+            }
+            sock_buf.append(buf, static_cast<size_t>(n));
+            size_t start = 0, nl;
+            while ((nl = sock_buf.find('\n', start)) != std::string::npos) {
+                std::string line = sock_buf.substr(start, nl - start);
+                start = nl + 1;
+                if (line == "E server full") {
+                    std::cerr << "Attach failed: server full\n";
+                    failed = true;
+                    continue;
+                }
+                if (!interactive && line.rfind("E ", 0) == 0) continue;
+                if (relay_line(line) && pending > 0) --pending;
+            }
+            sock_buf.erase(0, start);
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n <= 0) {
+                stdin_open = false;
+                continue;
+            }
+            in_buf.append(buf, static_cast<size_t>(n));
+            size_t start = 0, nl;
+            while ((nl = in_buf.find('\n', start)) != std::string::npos) {
+                std::string line = in_buf.substr(start, nl - start);
+                start = nl + 1;
+                if (!line.empty() && !send_line(line)) stdin_open = false;
+            }
+            in_buf.erase(0, start);
+        }
+    }
+
+    close(fd);
+    return failed ? 1 : 0;
+}
+
+} // namespace adamcom
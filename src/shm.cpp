@@ -0,0 +1,251 @@
+/**
+ * @file shm.cpp
+ * @brief Shared-memory event ring writer (single writer, lock-free readers)
+ */
+
+#include "adamcom.hpp"
+#include "adamcom_shm.hpp"
+
+#include <linux/can.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global shared-memory export
+ShmExportState g_shm{};
+
+static inline uint64_t realtime_ns()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/// Fill the next slot; readers see it once its seq and the header head are published
+static inline void publish(uint8_t kind, uint8_t flags, uint32_t id,
+                           const uint8_t* data, size_t len, uint64_t time_ns)
+{
+    auto& g = g_shm;
+    uint64_t seq = g.next_seq++;
+    ShmSlot& s = g.slots[seq & g.mask];
+
+    s.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.time_ns = time_ns;
+    s.id = id;
+    s.len = static_cast<uint16_t>(len);
+    s.kind = kind;
+    s.flags = flags;
+    std::memcpy(s.data, data, len);
+    s.seq.store(seq, std::memory_order_release);
+    g.hdr->head.store(seq + 1, std::memory_order_release);
+}
+
+/// PID of a live writer still publishing to an existing object called name (0 if none/stale)
+static pid_t live_writer(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return 0;
+    struct stat st{};
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ShmHeader)) {
+        map = mmap(nullptr, sizeof(ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    const auto* hdr = static_cast<const ShmHeader*>(map);
+    pid_t pid = 0;
+    if (hdr->magic == SHM_MAGIC && hdr->closed.load(std::memory_order_acquire) == 0 && hdr->writer_pid > 0) {
+        pid = hdr->writer_pid;
+        // EPERM still means the process exists (another user's instance)
+        if (kill(pid, 0) != 0 && errno != EPERM) pid = 0;
+    }
+    munmap(map, sizeof(ShmHeader));
+    return pid;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+std::string shm_default_name(const std::string& iface)
+{
+    auto slash = iface.find_last_of('/');
+    return "/adamcom-" + (slash == std::string::npos ? iface : iface.substr(slash + 1));
+}
+
+bool shm_start(const std::string& name, uint32_t slots, const std::string& iface, std::string& error)
+{
+    shm_stop();
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos) {
+        error = "name must look like /NAME";
+        return false;
+    }
+    // Round up to a power of two so slot lookup is a mask
+    uint32_t count = 64;
+    while (count < slots && count < (1u << 24)) count <<= 1;
+
+    // A fresh object each time: readers of a stale ring keep their own mapping. An object
+    // left by a crashed writer is replaced, one another instance still publishes to is not.
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, static_cast<mode_t>(g_shm.mode));
+    if (fd < 0 && errno == EEXIST) {
+        pid_t pid = live_writer(name);
+        if (pid != 0) {
+            error = name + ": in use by adamcom pid " + std::to_string(pid);
+            return false;
+        }
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, static_cast<mode_t>(g_shm.mode));
+    }
+    if (fd < 0) {
+        error = name + ": " + std::strerror(errno);
+        return false;
+    }
+    size_t bytes = shm_map_bytes(count);
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        error = name + ": " + std::strerror(errno);
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error = name + ": " + std::strerror(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    auto& g = g_shm;
+    g.name = name;
+    g.map_bytes = bytes;
+    g.hdr = static_cast<ShmHeader*>(map);
+    g.slots = reinterpret_cast<ShmSlot*>(static_cast<char*>(map) + sizeof(ShmHeader));
+    g.mask = count - 1;
+    g.next_seq = 1;
+
+    // ftruncate zero-fills, so every slot starts with seq 0 (empty)
+    g.hdr->slot_count = count;
+    g.hdr->slot_bytes = sizeof(ShmSlot);
+    g.hdr->writer_pid = static_cast<int32_t>(getpid());
+    shm_set_iface(iface);
+    g.hdr->head.store(1, std::memory_order_relaxed);
+    g.hdr->version = SHM_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    g.hdr->magic = SHM_MAGIC;
+    return true;
+}
+
+void shm_stop()
+{
+    auto& g = g_shm;
+    if (!g.hdr) return;
+    g.hdr->closed.store(1, std::memory_order_release);
+    munmap(g.hdr, g.map_bytes);
+    shm_unlink(g.name.c_str());
+    g.hdr = nullptr;
+    g.slots = nullptr;
+    g.name.clear();
+}
+
+void shm_configure(const Config& cfg, const std::string& iface)
+{
+    auto it = cfg.find("shm_mode");
+    if (it != cfg.end()) {
+        try { g_shm.mode = static_cast<uint32_t>(std::stoul(it->second, nullptr, 8)) & 0666; } catch (...) {}
+    }
+
+    it = cfg.find("shm");
+    std::string name = (it != cfg.end()) ? it->second : "off";
+    if (name == "off" || name.empty()) {
+        shm_stop();
+        return;
+    }
+    if (name == "auto") name = shm_default_name(iface);
+
+    uint32_t slots = SHM_DEFAULT_SLOTS;
+    it = cfg.find("shm_slots");
+    if (it != cfg.end()) {
+        try { slots = static_cast<uint32_t>(std::stoul(it->second)); } catch (...) {}
+    }
+
+    std::string error;
+    if (shm_start(name, slots, iface, error)) {
+        std::printf("Publishing RX/TX to shared memory %s (%u slots)\n", name.c_str(),
+                    static_cast<unsigned>(g_shm.mask + 1));
+    } else {
+        std::fprintf(stderr, "Shared memory: %s\n", error.c_str());
+    }
+}
+
+void shm_set_iface(const std::string& iface)
+{
+    auto& g = g_shm;
+    if (!g.hdr) return;
+    size_t n = std::min(iface.size(), sizeof(g.hdr->iface) - 1);
+    std::memcpy(g.hdr->iface, iface.data(), n);
+    g.hdr->iface[n] = '\0';
+}
+
+void shm_can(OutputDir dir, uint32_t can_id, const uint8_t* data, size_t dlc)
+{
+    if (!g_shm.hdr) return;
+    uint8_t flags = (dir == OutputDir::TX) ? SHM_FLAG_TX : 0;
+    if (can_id & CAN_EFF_FLAG) flags |= SHM_FLAG_EXT;
+    if (can_id & CAN_RTR_FLAG) flags |= SHM_FLAG_RTR;
+    if (can_id & CAN_ERR_FLAG) flags |= SHM_FLAG_ERR;
+    uint32_t id = can_id & ((can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+    publish(SHM_KIND_CAN, flags, id, data, std::min<size_t>(dlc, 8), realtime_ns());
+}
+
+void shm_serial(OutputDir dir, const uint8_t* data, size_t len)
+{
+    if (!g_shm.hdr) return;
+    uint8_t flags = (dir == OutputDir::TX) ? SHM_FLAG_TX : 0;
+    uint64_t t = realtime_ns();
+    // Chunks longer than a slot span consecutive events flagged MORE
+    while (len > SHM_SLOT_DATA) {
+        publish(SHM_KIND_SERIAL, flags | SHM_FLAG_MORE, 0, data, SHM_SLOT_DATA, t);
+        data += SHM_SLOT_DATA;
+        len -= SHM_SLOT_DATA;
+    }
+    if (len > 0) publish(SHM_KIND_SERIAL, flags, 0, data, len, t);
+}
+
+void shm_gap(bool restored, const std::string& text)
+{
+    if (!g_shm.hdr) return;
+    publish(SHM_KIND_GAP, 0, restored ? SHM_GAP_RESTORED : SHM_GAP_LOST,
+            reinterpret_cast<const uint8_t*>(text.data()), std::min(text.size(), SHM_SLOT_DATA), realtime_ns());
+}
+
+void shm_drop(uint64_t count, uint64_t total)
+{
+    if (!g_shm.hdr) return;
+    std::string text = std::to_string(total) + " total";
+    publish(SHM_KIND_DROP, 0, static_cast<uint32_t>(std::min<uint64_t>(count, UINT32_MAX)),
+            reinterpret_cast<const uint8_t*>(text.data()), text.size(), realtime_ns());
+}
+
+void shm_print_status()
+{
+    const auto& g = g_shm;
+    if (!g.hdr) {
+        std::printf("\r\nShared memory: off\n\n");
+        return;
+    }
+    std::printf("\r\nShared memory: %s, %llu slots (%.1f MB), %llu events published\n\n",
+                g.name.c_str(), static_cast<unsigned long long>(g.mask + 1),
+                g.map_bytes / 1048576.0, static_cast<unsigned long long>(g.next_seq - 1));
+}
+
+} // namespace adamcom
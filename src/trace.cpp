@@ -0,0 +1,223 @@
+/**
+ * @file trace.cpp
+ * @brief Chrome trace-event export of main-loop activity (--trace)
+ */
+
+#include "adamcom.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+namespace adamcom {
+
+std::atomic<bool> g_trace_on{false};
+
+/// Single-producer ring owned by one thread; the writer thread is the only consumer
+struct TraceRing {
+    std::array<TraceRecord, TRACE_RING_RECORDS> records;
+    std::atomic<uint64_t> head{0};         // Next record the owner writes
+    std::atomic<uint64_t> tail{0};         // Next record the writer drains
+    std::atomic<uint64_t> dropped{0};
+    uint32_t tid = 0;
+    TraceRing* next = nullptr;
+};
+
+static thread_local TraceRing* t_ring = nullptr;
+
+/// Registered rings (never freed; one per thread that ever traced something)
+static std::mutex s_rings_mutex;
+static TraceRing* s_rings = nullptr;
+
+struct TraceWriter {
+    std::string path;
+    FILE* file = nullptr;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    uint64_t origin_ns = 0;                // Timestamps are relative to --trace start
+    std::atomic<uint64_t> written{0};
+    int pid = 0;
+
+    // Any return from main() after --trace finalizes the file; a joinable
+    // std::thread left behind would std::terminate() instead
+    ~TraceWriter() { trace_stop(); }
+};
+
+static TraceWriter s_writer;
+
+static const char* const KIND_NAMES[static_cast<size_t>(TraceKind::COUNT)] = {
+    "loop", "poll", "rx", "repeat", "tx", "render"
+};
+
+uint64_t trace_now_ns()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+static TraceRing& register_ring()
+{
+    auto* r = new TraceRing();
+    r->tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    std::lock_guard<std::mutex> lock(s_rings_mutex);
+    r->next = s_rings;
+    s_rings = r;
+    t_ring = r;
+    return *r;
+}
+
+void trace_emit(TraceKind kind, uint64_t start_ns, uint64_t dur_ns, uint32_t a, uint32_t b)
+{
+    TraceRing& r = t_ring ? *t_ring : register_ring();
+    uint64_t head = r.head.load(std::memory_order_relaxed);
+    if (head - r.tail.load(std::memory_order_acquire) >= TRACE_RING_RECORDS) {
+        r.dropped.store(r.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    TraceRecord& rec = r.records[head & (TRACE_RING_RECORDS - 1)];
+    rec.start_ns = start_ns;
+    rec.dur_ns = dur_ns;
+    rec.a = a;
+    rec.b = b;
+    rec.kind = kind;
+    r.head.store(head + 1, std::memory_order_release);
+}
+
+// ============================================================================
+// Writer thread
+// ============================================================================
+
+static void write_record(const TraceRecord& rec, uint32_t tid)
+{
+    auto& w = s_writer;
+    double ts = rec.start_ns > w.origin_ns ? (rec.start_ns - w.origin_ns) / 1e3 : 0.0;
+    char args[64] = "";
+    switch (rec.kind) {
+    case TraceKind::POLL:
+        std::snprintf(args, sizeof(args), ",\"args\":{\"timeout_ms\":%u,\"ready\":%u}", rec.a, rec.b);
+        break;
+    case TraceKind::RX:
+    case TraceKind::TX:
+        std::snprintf(args, sizeof(args), ",\"args\":{\"bytes\":%u}", rec.a);
+        break;
+    case TraceKind::TIMER:
+        std::snprintf(args, sizeof(args), ",\"args\":{\"preset\":%u,\"late_us\":%u}", rec.a, rec.b);
+        break;
+    default:
+        break;
+    }
+    std::fprintf(w.file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u%s}",
+                 KIND_NAMES[static_cast<size_t>(rec.kind)], ts, rec.dur_ns / 1e3, w.pid, tid, args);
+    metric_bump(w.written, 1);
+}
+
+/// Copy out everything published so far; returns the number of records written
+static size_t drain_rings()
+{
+    size_t n = 0;
+    std::lock_guard<std::mutex> lock(s_rings_mutex);
+    for (TraceRing* r = s_rings; r; r = r->next) {
+        uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail, ++n) {
+            write_record(r->records[tail & (TRACE_RING_RECORDS - 1)], r->tid);
+        }
+        r->tail.store(tail, std::memory_order_release);
+    }
+    return n;
+}
+
+static void writer_main()
+{
+    auto& w = s_writer;
+    while (!w.stop.load(std::memory_order_acquire)) {
+        if (drain_rings() > 0) {
+            std::fflush(w.file);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool trace_start(const std::string& path, std::string& error)
+{
+    trace_stop();
+    auto& w = s_writer;
+    w.file = std::fopen(path.c_str(), "w");
+    if (!w.file) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    w.path = path;
+    w.pid = static_cast<int>(getpid());
+    w.written.store(0, std::memory_order_relaxed);
+    w.origin_ns = trace_now_ns();
+    std::fprintf(w.file, "{\"traceEvents\":[\n"
+                 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"adamcom\"}}",
+                 w.pid);
+
+    // Discard anything left from an earlier trace
+    {
+        std::lock_guard<std::mutex> lock(s_rings_mutex);
+        for (TraceRing* r = s_rings; r; r = r->next) {
+            r->tail.store(r->head.load(std::memory_order_acquire), std::memory_order_release);
+            r->dropped.store(0, std::memory_order_relaxed);
+        }
+    }
+    w.stop.store(false, std::memory_order_release);
+    w.thread = std::thread(writer_main);
+    g_trace_on.store(true, std::memory_order_release);
+    return true;
+}
+
+void trace_stop()
+{
+    auto& w = s_writer;
+    if (!w.file) return;
+    g_trace_on.store(false, std::memory_order_release);
+    w.stop.store(true, std::memory_order_release);
+    w.thread.join();
+    drain_rings();
+
+    unsigned long long dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_rings_mutex);
+        for (TraceRing* r = s_rings; r; r = r->next) {
+            dropped += r->dropped.load(std::memory_order_relaxed);
+            std::fprintf(w.file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                         "\"args\":{\"name\":\"%s\"}}",
+                         w.pid, r->tid, static_cast<int>(r->tid) == w.pid ? "main loop" : "worker");
+        }
+    }
+    std::fprintf(w.file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%llu}}\n", dropped);
+    std::fclose(w.file);
+    w.file = nullptr;
+}
+
+void trace_print_status()
+{
+    const auto& w = s_writer;
+    if (!w.file) {
+        std::printf("\r\nTrace: off\n\n");
+        return;
+    }
+    unsigned long long dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_rings_mutex);
+        for (TraceRing* r = s_rings; r; r = r->next) {
+            dropped += r->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    std::printf("\r\nTrace: %s (%llu events written, %llu dropped)\n\n", w.path.c_str(),
+                static_cast<unsigned long long>(w.written.load(std::memory_order_relaxed)), dropped);
+}
+
+} // namespace adamcom
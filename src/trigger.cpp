@@ -0,0 +1,637 @@
+/**
+ * @file trigger.cpp
+ * @brief RX pattern triggers (CAN ID table, Aho-Corasick for serial), capture and pre-trigger history
+ */
+
+#include "adamcom.hpp"
+
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+namespace adamcom {
+
+// Define the global trigger state
+TriggerState g_trigger{};
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t SFF_IDS = 2048;
+
+// ============================================================================
+// Spec Parsing
+// ============================================================================
+
+static std::string lower(std::string s)
+{
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+static bool parse_u32(const std::string& s, uint32_t& out)
+{
+    try {
+        size_t used = 0;
+        unsigned long v = std::stoul(s, &used, 16);
+        if (used != s.size() || v > 0x1FFFFFFFUL) return false;
+        out = static_cast<uint32_t>(v);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+/// Unescape a text pattern (\r \n \t \\ \xHH)
+static bool unescape(const std::string& s, std::vector<uint8_t>& out)
+{
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '\\' || i + 1 >= s.size()) {
+            out.push_back(static_cast<uint8_t>(s[i]));
+            continue;
+        }
+        char e = s[++i];
+        switch (e) {
+            case 'r':  out.push_back('\r'); break;
+            case 'n':  out.push_back('\n'); break;
+            case 't':  out.push_back('\t'); break;
+            case '\\': out.push_back('\\'); break;
+            case 'x': {
+                if (i + 2 >= s.size()) return false;
+                uint32_t v = 0;
+                if (!parse_u32(s.substr(i + 1, 2), v)) return false;
+                out.push_back(static_cast<uint8_t>(v));
+                i += 2;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_action(const std::string& text, Trigger& t, std::string& error)
+{
+    std::istringstream iss(text);
+    std::string verb, a1, a2;
+    iss >> verb >> a1 >> a2;
+    verb = lower(verb);
+    a1 = lower(a1);
+    a2 = lower(a2);
+
+    auto on_word = [](const std::string& w) { return w == "start" || w == "on"; };
+    auto off_word = [](const std::string& w) { return w == "stop" || w == "off"; };
+
+    if (verb == "preset" || verb == "repeat") {
+        int n = 0;
+        try { n = std::stoi(a1); } catch (...) {}
+        if (n < 1 || n > 10) {
+            error = "preset number must be 1-10";
+            return false;
+        }
+        t.arg = n;
+        if (verb == "preset") {
+            t.action = TriggerAction::PRESET;
+        } else if (on_word(a2)) {
+            t.action = TriggerAction::REPEAT_START;
+        } else if (off_word(a2)) {
+            t.action = TriggerAction::REPEAT_STOP;
+        } else {
+            error = "use: repeat N start|stop";
+            return false;
+        }
+    } else if (verb == "capture" && on_word(a1)) {
+        t.action = TriggerAction::CAPTURE_START;
+    } else if (verb == "capture" && off_word(a1)) {
+        t.action = TriggerAction::CAPTURE_STOP;
+    } else if (verb == "dump") {
+        t.action = TriggerAction::DUMP;
+    } else if (verb == "bell") {
+        t.action = TriggerAction::BELL;
+    } else {
+        error = "unknown action (preset N, repeat N start|stop, capture start|stop, dump, bell)";
+        return false;
+    }
+    return true;
+}
+
+bool trigger_parse_match(std::string match, Trigger& t, std::string& error)
+{
+    while (!match.empty() && std::isspace(static_cast<unsigned char>(match.back()))) match.pop_back();
+    size_t start = match.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        error = "empty match";
+        return false;
+    }
+    match = match.substr(start);
+
+    auto sp = match.find(' ');
+    std::string kind = lower(match.substr(0, sp));
+    std::string rest = (sp == std::string::npos) ? "" : match.substr(sp + 1);
+
+    if (kind == "can") {
+        std::istringstream iss(rest);
+        std::string id_tok;
+        iss >> id_tok;
+        auto slash = id_tok.find('/');
+        if (!parse_u32(id_tok.substr(0, slash), t.can_id)) {
+            error = "invalid CAN ID: " + id_tok;
+            return false;
+        }
+        t.extended = t.can_id > 0x7FF;
+        uint32_t full = t.extended ? 0x1FFFFFFFu : 0x7FFu;
+        t.id_mask = full;
+        if (slash != std::string::npos && !parse_u32(id_tok.substr(slash + 1), t.id_mask)) {
+            error = "invalid CAN ID mask: " + id_tok;
+            return false;
+        }
+        t.id_mask &= full;
+        t.can_id &= t.id_mask;
+
+        std::string byte_tok;
+        while (iss >> byte_tok) {
+            if (t.data_len >= 8) {
+                error = "at most 8 data bytes";
+                return false;
+            }
+            // Bytes are packed little-endian to match a memcpy of the frame data
+            uint32_t v = 0;
+            unsigned shift = 8u * t.data_len;
+            if (byte_tok == "??" || byte_tok == "XX" || byte_tok == "xx") {
+                // Wildcard: length check only
+            } else if (byte_tok.size() <= 2 && parse_u32(byte_tok, v)) {
+                t.data_want |= static_cast<uint64_t>(v) << shift;
+                t.data_mask |= 0xFFULL << shift;
+            } else {
+                error = "invalid data byte: " + byte_tok;
+                return false;
+            }
+            ++t.data_len;
+        }
+        t.is_can = true;
+        return true;
+    }
+
+    if (kind == "hex") {
+        if (!parse_hex_bytes(rest, t.pattern) || t.pattern.empty()) {
+            error = "invalid hex pattern";
+            return false;
+        }
+        return true;
+    }
+
+    if (kind == "text") {
+        if (rest.size() >= 2 && rest.front() == '"' && rest.back() == '"') {
+            rest = rest.substr(1, rest.size() - 2);
+        }
+        if (!unescape(rest, t.pattern) || t.pattern.empty()) {
+            error = "invalid text pattern";
+            return false;
+        }
+        return true;
+    }
+
+    error = "match must start with can, hex or text";
+    return false;
+}
+
+bool trigger_parse(const std::string& spec, Trigger& t, std::string& error)
+{
+    auto arrow = spec.find("->");
+    if (arrow == std::string::npos) {
+        error = "missing '-> ACTION'";
+        return false;
+    }
+    if (!parse_action(spec.substr(arrow + 2), t, error)) return false;
+    t.spec = spec;
+    return trigger_parse_match(spec.substr(0, arrow), t, error);
+}
+
+// ============================================================================
+// Match Index
+// ============================================================================
+
+static void build_can_index(MatchIndex& ix, const std::vector<Trigger>& matchers)
+{
+    ix.sff_index.assign(SFF_IDS, {});
+    ix.eff_exact.clear();
+    ix.eff_masked.clear();
+    ix.can_count = 0;
+
+    for (size_t i = 0; i < matchers.size(); ++i) {
+        const Trigger& t = matchers[i];
+        if (!t.is_can) continue;
+        ++ix.can_count;
+        auto idx = static_cast<uint16_t>(i);
+        if (!t.extended) {
+            // Expand masked 11-bit matches so lookup stays a single table index
+            for (uint32_t id = 0; id < SFF_IDS; ++id) {
+                if ((id & t.id_mask) == t.can_id) ix.sff_index[id].push_back(idx);
+            }
+        } else if (t.id_mask == 0x1FFFFFFFu) {
+            ix.eff_exact.emplace_back(t.can_id, idx);
+        } else {
+            ix.eff_masked.push_back(idx);
+        }
+    }
+    std::sort(ix.eff_exact.begin(), ix.eff_exact.end());
+}
+
+/// Build a dense Aho-Corasick DFA over all serial patterns
+static void build_automaton(MatchIndex& ix, const std::vector<Trigger>& matchers)
+{
+    ix.ac_next.assign(256, 0);
+    ix.ac_match.assign(1, -1);
+    ix.ac_dict.assign(1, -1);
+    ix.ac_fail.assign(1, 0);
+    ix.ac_same.assign(matchers.size(), -1);
+    ix.ac_state = 0;
+
+    // Trie (0 = root, transitions to 0 mean "none" until the BFS pass fills them)
+    for (size_t i = 0; i < matchers.size(); ++i) {
+        const Trigger& t = matchers[i];
+        if (t.is_can) continue;
+        int32_t s = 0;
+        for (uint8_t b : t.pattern) {
+            int32_t& nx = ix.ac_next[static_cast<size_t>(s) * 256 + b];
+            if (nx == 0) {
+                nx = static_cast<int32_t>(ix.ac_match.size());
+                ix.ac_next.resize(ix.ac_next.size() + 256, 0);
+                ix.ac_match.push_back(-1);
+                ix.ac_dict.push_back(-1);
+                ix.ac_fail.push_back(0);
+            }
+            s = ix.ac_next[static_cast<size_t>(s) * 256 + b];
+        }
+        // Identical patterns share a state; chain them
+        ix.ac_same[i] = ix.ac_match[static_cast<size_t>(s)];
+        ix.ac_match[static_cast<size_t>(s)] = static_cast<int32_t>(i);
+    }
+
+    // BFS: compute failure links and complete the transition table
+    std::vector<int32_t> queue;
+    queue.reserve(ix.ac_match.size());
+    for (int b = 0; b < 256; ++b) {
+        int32_t nx = ix.ac_next[static_cast<size_t>(b)];
+        if (nx != 0) queue.push_back(nx);
+    }
+    for (size_t qi = 0; qi < queue.size(); ++qi) {
+        int32_t s = queue[qi];
+        auto su = static_cast<size_t>(s);
+        int32_t f = ix.ac_fail[su];
+        auto fu = static_cast<size_t>(f);
+        ix.ac_dict[su] = (ix.ac_match[fu] >= 0) ? f : ix.ac_dict[fu];
+        for (int b = 0; b < 256; ++b) {
+            int32_t& nx = ix.ac_next[su * 256 + static_cast<size_t>(b)];
+            int32_t via_fail = ix.ac_next[fu * 256 + static_cast<size_t>(b)];
+            if (nx != 0) {
+                ix.ac_fail[static_cast<size_t>(nx)] = via_fail;
+                queue.push_back(nx);
+            } else {
+                nx = via_fail;
+            }
+        }
+    }
+    ix.serial_count = matchers.size() - ix.can_count;
+}
+
+void match_index_build(MatchIndex& ix, const std::vector<Trigger>& matchers)
+{
+    build_can_index(ix, matchers);
+    build_automaton(ix, matchers);
+}
+
+void match_can(const MatchIndex& ix, const std::vector<Trigger>& matchers,
+               uint32_t can_id, bool extended, const uint8_t* data, size_t dlc, MatchFn on_match)
+{
+    if (ix.can_count == 0) return;
+    dlc = std::min<size_t>(dlc, 8);
+    uint64_t frame = 0;
+    std::memcpy(&frame, data, dlc);
+
+    auto check = [&](uint16_t idx) {
+        const Trigger& t = matchers[idx];
+        if (dlc >= t.data_len && ((frame ^ t.data_want) & t.data_mask) == 0) on_match(idx);
+    };
+
+    if (!extended) {
+        for (uint16_t idx : ix.sff_index[can_id & 0x7FF]) check(idx);
+        return;
+    }
+    auto range = std::equal_range(ix.eff_exact.begin(), ix.eff_exact.end(),
+                                  std::make_pair(can_id, uint16_t{0}),
+                                  [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (auto it = range.first; it != range.second; ++it) check(it->second);
+    for (uint16_t idx : ix.eff_masked) {
+        if ((can_id & matchers[idx].id_mask) == matchers[idx].can_id) check(idx);
+    }
+}
+
+void match_serial(MatchIndex& ix, const uint8_t* data, size_t len, MatchFn on_match)
+{
+    if (ix.serial_count == 0) return;
+    const int32_t* next = ix.ac_next.data();
+    int32_t s = ix.ac_state;
+    for (size_t i = 0; i < len; ++i) {
+        s = next[static_cast<size_t>(s) * 256 + data[i]];
+        auto su = static_cast<size_t>(s);
+        if (ix.ac_match[su] < 0 && ix.ac_dict[su] < 0) continue;
+        for (int32_t m = (ix.ac_match[su] >= 0) ? s : ix.ac_dict[su]; m >= 0;
+             m = ix.ac_dict[static_cast<size_t>(m)]) {
+            for (int32_t p = ix.ac_match[static_cast<size_t>(m)]; p >= 0;
+                 p = ix.ac_same[static_cast<size_t>(p)]) {
+                on_match(static_cast<size_t>(p));
+            }
+        }
+    }
+    ix.ac_state = s;
+}
+
+static void rebuild()
+{
+    match_index_build(g_trigger.index, g_trigger.triggers);
+}
+
+// ============================================================================
+// History and Capture
+// ============================================================================
+
+static void format_event(const RxEvent& ev, char* out, size_t size)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        ev.time.time_since_epoch()).count();
+    int n = std::snprintf(out, size, "(%lld.%06lld) %s ",
+                          static_cast<long long>(us / 1000000),
+                          static_cast<long long>(us % 1000000),
+                          ev.is_can ? g_trigger.can_iface.c_str() : "serial");
+    if (n < 0 || static_cast<size_t>(n) >= size) return;
+    size_t pos = static_cast<size_t>(n);
+    if (ev.is_can) {
+        n = std::snprintf(out + pos, size - pos, ev.extended ? "%08X#" : "%03X#", ev.id);
+        if (n > 0) pos += static_cast<size_t>(n);
+    }
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < ev.len && pos + 3 < size; ++i) {
+        out[pos++] = hex[ev.data[i] >> 4];
+        out[pos++] = hex[ev.data[i] & 0x0F];
+    }
+    out[pos] = '\0';
+}
+
+static void record(bool is_can, uint32_t id, bool extended, const uint8_t* data, size_t len)
+{
+    auto& g = g_trigger;
+    auto now = std::chrono::system_clock::now();
+
+    // Serial reads are split into fixed-size events so the ring never allocates
+    do {
+        size_t chunk = std::min(len, RX_EVENT_BYTES);
+        RxEvent& ev = g.history[g.history_head];
+        ev.time = now;
+        ev.is_can = is_can;
+        ev.extended = extended;
+        ev.id = id;
+        ev.len = static_cast<uint8_t>(chunk);
+        std::memcpy(ev.data.data(), data, chunk);
+        g.history_head = (g.history_head + 1) % g.history.size();
+        g.history_count = std::min(g.history_count + 1, g.history.size());
+
+        if (g.capture) {
+            char line[256];
+            format_event(ev, line, sizeof(line));
+            std::fprintf(g.capture, "%s\n", line);
+            ++g.capture_events;
+        }
+        data += chunk;
+        len -= chunk;
+    } while (len > 0);
+}
+
+bool capture_start(const std::string& path, std::string& error)
+{
+    capture_stop();
+    g_trigger.capture = std::fopen(path.c_str(), "a");
+    if (!g_trigger.capture) {
+        error = "cannot open " + path;
+        return false;
+    }
+    g_trigger.capture_path = path;
+    g_trigger.capture_events = 0;
+    return true;
+}
+
+void capture_stop()
+{
+    if (g_trigger.capture) {
+        std::fclose(g_trigger.capture);
+        g_trigger.capture = nullptr;
+    }
+}
+
+void capture_note(const std::string& text)
+{
+    auto& g = g_trigger;
+    if (!g.capture) return;
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::fprintf(g.capture, "# (%lld.%06lld) %s\n", static_cast<long long>(us / 1000000),
+                 static_cast<long long>(us % 1000000), text.c_str());
+    std::fflush(g.capture);
+}
+
+void trigger_dump_history()
+{
+    auto& g = g_trigger;
+    FILE* out = g.capture ? g.capture : nullptr;
+    size_t start = (g.history_head + g.history.size() - g.history_count) % g.history.size();
+
+    print_message_above("--- pre-trigger history (" + std::to_string(g.history_count) + " events) ---");
+    char line[256];
+    for (size_t i = 0; i < g.history_count; ++i) {
+        format_event(g.history[(start + i) % g.history.size()], line, sizeof(line));
+        if (out) {
+            std::fprintf(out, "%s\n", line);
+        } else {
+            print_message_above(line);
+        }
+    }
+    if (out) {
+        std::fflush(out);
+        print_message_above("--- written to " + g.capture_path + " ---");
+    } else {
+        print_message_above("--- end of history ---");
+    }
+}
+
+// ============================================================================
+// Actions
+// ============================================================================
+
+static void fire(size_t index)
+{
+    auto& g = g_trigger;
+    Trigger& t = g.triggers[index];
+    ++t.fires;
+
+    char head[64];
+    std::snprintf(head, sizeof(head), "TRIG[%zu] ", index + 1);
+    std::string msg = head;
+
+    switch (t.action) {
+        case TriggerAction::PRESET: {
+            bool ok = g.fd && g.cfg && g.itype && g.append_crlf &&
+                      send_preset(*g.fd, *g.cfg, *g.itype, t.arg, *g.append_crlf);
+            msg += (ok ? "sent preset " : "FAILED preset ") + std::to_string(t.arg);
+            break;
+        }
+        case TriggerAction::REPEAT_START: {
+            auto& rep = g_preset_repeats[static_cast<size_t>(t.arg - 1)];
+            rep.enabled = true;
+            rep.next_fire = Clock::now();
+            msg += "repeat preset " + std::to_string(t.arg) + " started";
+            break;
+        }
+        case TriggerAction::REPEAT_STOP:
+            g_preset_repeats[static_cast<size_t>(t.arg - 1)].enabled = false;
+            msg += "repeat preset " + std::to_string(t.arg) + " stopped";
+            break;
+        case TriggerAction::CAPTURE_START: {
+            if (g.capture) {
+                msg += "capture already running";
+                break;
+            }
+            std::string error;
+            std::string path = (g.cfg && g.cfg->count("capture_file")) ? g.cfg->at("capture_file")
+                                                                       : "adamcom-capture.log";
+            msg += capture_start(path, error) ? "capture started: " + path : "capture FAILED: " + error;
+            break;
+        }
+        case TriggerAction::CAPTURE_STOP:
+            msg += "capture stopped";
+            capture_stop();
+            break;
+        case TriggerAction::DUMP:
+            print_message_above(msg + "dumping history");
+            trigger_dump_history();
+            return;
+        case TriggerAction::BELL:
+            std::printf("\a");
+            msg += "bell";
+            break;
+    }
+    print_message_above(msg + " (" + t.spec + ")");
+}
+
+// ============================================================================
+// RX Hooks
+// ============================================================================
+
+void trigger_can_rx(uint32_t can_id, bool extended, const uint8_t* data, size_t dlc)
+{
+    record(true, can_id, extended, data, std::min<size_t>(dlc, 8));
+    if (!g_trigger.enabled) return;
+    match_can(g_trigger.index, g_trigger.triggers, can_id, extended, data, dlc, fire);
+}
+
+void trigger_serial_rx(const uint8_t* data, size_t len)
+{
+    if (len == 0) return;
+    record(false, 0, false, data, len);
+    if (!g_trigger.enabled) return;
+    match_serial(g_trigger.index, data, len, fire);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void trigger_bind(const int* fd, const Config* cfg, const InterfaceType* itype, const bool* append_crlf)
+{
+    g_trigger.fd = fd;
+    g_trigger.cfg = cfg;
+    g_trigger.itype = itype;
+    g_trigger.append_crlf = append_crlf;
+}
+
+void trigger_configure(const Config& cfg)
+{
+    auto& g = g_trigger;
+    g.triggers.clear();
+    if (g.history.empty()) g.history.resize(RX_HISTORY_EVENTS);
+
+    auto it = cfg.find("can_interface");
+    g.can_iface = (it != cfg.end()) ? it->second : "can0";
+    it = cfg.find("triggers");
+    g.enabled = (it == cfg.end() || it->second != "off");
+
+    for (int i = 1; i <= MAX_TRIGGERS; ++i) {
+        it = cfg.find("trigger" + std::to_string(i));
+        if (it == cfg.end()) break;
+        Trigger t;
+        std::string error;
+        if (trigger_parse(it->second, t, error)) {
+            g.triggers.push_back(std::move(t));
+        } else {
+            print_message_above("Ignoring trigger" + std::to_string(i) + ": " + error);
+        }
+    }
+    rebuild();
+}
+
+void trigger_save(Config& cfg)
+{
+    for (int i = 1; i <= MAX_TRIGGERS; ++i) cfg.erase("trigger" + std::to_string(i));
+    for (size_t i = 0; i < g_trigger.triggers.size(); ++i) {
+        cfg["trigger" + std::to_string(i + 1)] = g_trigger.triggers[i].spec;
+    }
+}
+
+bool trigger_add(const std::string& spec, std::string& error)
+{
+    if (g_trigger.triggers.size() >= static_cast<size_t>(MAX_TRIGGERS)) {
+        error = "too many triggers";
+        return false;
+    }
+    Trigger t;
+    if (!trigger_parse(spec, t, error)) return false;
+    g_trigger.triggers.push_back(std::move(t));
+    rebuild();
+    return true;
+}
+
+bool trigger_remove(size_t index)
+{
+    if (index >= g_trigger.triggers.size()) return false;
+    g_trigger.triggers.erase(g_trigger.triggers.begin() + static_cast<std::ptrdiff_t>(index));
+    rebuild();
+    return true;
+}
+
+void trigger_clear()
+{
+    g_trigger.triggers.clear();
+    rebuild();
+}
+
+void trigger_print_list()
+{
+    const auto& g = g_trigger;
+    std::printf("\r\nTriggers %s (%zu CAN, %zu serial, history %zu events):\n",
+                g.enabled ? "on" : "off", g.index.can_count, g.index.serial_count, g.history_count);
+    if (g.triggers.empty()) {
+        std::printf("  None. Example: /trig add can 0x100 01 ?? -> preset 2\n");
+    }
+    for (size_t i = 0; i < g.triggers.size(); ++i) {
+        std::printf("  %2zu. %-50s fired %llu\n", i + 1, g.triggers[i].spec.c_str(),
+                    static_cast<unsigned long long>(g.triggers[i].fires));
+    }
+    if (g.capture) {
+        std::printf("  Capturing to %s (%llu events)\n", g.capture_path.c_str(),
+                    static_cast<unsigned long long>(g.capture_events));
+    }
+    std::printf("\n");
+}
+
+} // namespace adamcom
@@ -0,0 +1,252 @@
+/**
+ * @file txqueue.cpp
+ * @brief Transmit queue: serial bytes flushed on POLLOUT, CAN frames parked after ENOBUFS/EAGAIN
+ */
+
+#include "adamcom.hpp"
+
+#include <linux/can.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace adamcom {
+
+// Define the global transmit queue
+TxQueueState g_txq{};
+
+using Clock = std::chrono::steady_clock;
+
+/// Watermarks: serial bytes as above; CAN at three quarters and one quarter of the ring
+static void update_backpressure()
+{
+    auto& q = g_txq;
+    size_t depth = txq_depth();
+    if (depth > q.max_depth) q.max_depth = depth;
+    if (q.can_count > q.can_max_depth) q.can_max_depth = q.can_count;
+    bool high = depth >= TXQ_HIGH_WATER || q.can_count * 4 >= q.can_limit * 3;
+    bool low = depth < TXQ_LOW_WATER && q.can_count * 4 < q.can_limit;
+    if (!q.backpressure && high) {
+        q.backpressure = true;
+    } else if (q.backpressure && low) {
+        q.backpressure = false;
+    }
+}
+
+void txq_configure(const Config& cfg)
+{
+    auto it = cfg.find("tx_queue_kb");
+    if (it != cfg.end()) {
+        try { g_txq.limit = std::max<size_t>(1, std::stoul(it->second)) * 1024; } catch (...) {}
+    }
+    it = cfg.find("tx_queue_frames");
+    if (it != cfg.end() && g_txq.can_count == 0) {
+        try { g_txq.can_limit = std::max<size_t>(4, std::stoul(it->second)); } catch (...) {}
+        g_txq.can.clear();
+        g_txq.can_head = 0;
+    }
+}
+
+bool txq_push(const uint8_t* data, size_t len)
+{
+    auto& q = g_txq;
+    if (txq_depth() + len > q.limit) {
+        ++q.overflows;
+        return false;
+    }
+    // Reclaim the consumed prefix once it outgrows what is pending
+    if (q.head > 0 && q.head >= txq_depth()) {
+        q.buf.erase(q.buf.begin(), q.buf.begin() + static_cast<std::ptrdiff_t>(q.head));
+        q.head = 0;
+    }
+    q.buf.insert(q.buf.end(), data, data + len);
+    q.queued_bytes += len;
+    update_backpressure();
+    return true;
+}
+
+bool txq_flush(int fd)
+{
+    auto& q = g_txq;
+    while (txq_depth() > 0) {
+        ssize_t n;
+        {
+            ADAMCOM_PERF(DEVICE_WRITE);
+            TraceScope tx_trace(TraceKind::TX, static_cast<uint32_t>(txq_depth()));
+            n = write(fd, q.buf.data() + q.head, txq_depth());
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                ++q.stalls;
+                break;
+            }
+            metric_add(Metric::TX_ERRORS);
+            reconnect_note_error(errno);
+            txq_reset();
+            return false;
+        }
+        serial_tx_written(q.buf.data() + q.head, static_cast<size_t>(n));
+        q.head += static_cast<size_t>(n);
+        if (static_cast<size_t>(n) == 0) break;
+    }
+    if (txq_depth() == 0) {
+        q.buf.clear();
+        q.head = 0;
+    }
+    update_backpressure();
+    return true;
+}
+
+void txq_drain(int fd, int timeout_ms)
+{
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (txq_depth() > 0 || g_txq.can_count > 0) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0) break;
+        if (g_txq.can_count > 0 && g_txq.can_nobufs) {
+            // Writable either way; only time frees the driver queue
+            poll(nullptr, 0, static_cast<int>(std::min<int64_t>(left, TXQ_CAN_RETRY.count())));
+        } else {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            if (poll(&pfd, 1, static_cast<int>(left)) <= 0) break;
+        }
+        if (!txq_flush(fd) || !txq_flush_can(fd)) break;
+    }
+}
+
+void txq_reset()
+{
+    auto& q = g_txq;
+    q.buf.clear();
+    q.head = 0;
+    q.can_dropped += q.can_count;
+    q.can_head = 0;
+    q.can_count = 0;
+    q.can_nobufs = false;
+    q.backpressure = false;
+}
+
+// ============================================================================
+// CAN Frames
+// ============================================================================
+
+void txq_can_refused(int err)
+{
+    auto& q = g_txq;
+    q.can_nobufs = (err == ENOBUFS);
+    if (q.can_nobufs) {
+        ++q.can_enobufs;
+    } else {
+        ++q.can_eagain;
+    }
+    q.can_retry_at = Clock::now() + TXQ_CAN_RETRY;
+}
+
+bool txq_can_push(uint32_t can_id, const uint8_t* data, uint8_t dlc)
+{
+    auto& q = g_txq;
+    if (q.can_count >= q.can_limit) {
+        ++q.can_dropped;
+        return false;
+    }
+    if (q.can.empty()) q.can.resize(q.can_limit);
+    CanTxFrame& f = q.can[(q.can_head + q.can_count) % q.can_limit];
+    f.can_id = can_id;
+    f.dlc = dlc;
+    std::memcpy(f.data, data, dlc);
+    f.queued = Clock::now();
+    ++q.can_count;
+    ++q.can_queued;
+    update_backpressure();
+    return true;
+}
+
+bool txq_flush_can(int fd)
+{
+    auto& q = g_txq;
+    while (q.can_count > 0) {
+        const CanTxFrame& f = q.can[q.can_head];
+        struct can_frame frame{};
+        frame.can_id = f.can_id;
+        frame.can_dlc = f.dlc;
+        std::memcpy(frame.data, f.data, f.dlc);
+        ssize_t n;
+        {
+            ADAMCOM_PERF(DEVICE_WRITE);
+            TraceScope tx_trace(TraceKind::TX, f.dlc);
+            n = write(fd, &frame, sizeof(frame));
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK) {
+                txq_can_refused(errno);
+                break;
+            }
+            metric_add(Metric::TX_ERRORS);
+            reconnect_note_error(errno);
+            txq_reset();
+            return false;
+        }
+        auto wait_us = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - f.queued).count());
+        metric_observe(MetricHist::CAN_TX_WAIT, wait_us);
+        q.can_wait_sum_us += wait_us;
+        q.can_wait_max_us = std::max(q.can_wait_max_us, wait_us);
+        ++q.can_sent;
+        can_tx_written(frame.can_id, frame.data, frame.can_dlc);
+        q.can_head = (q.can_head + 1) % q.can_limit;
+        --q.can_count;
+    }
+    if (q.can_count == 0) {
+        q.can_head = 0;
+        q.can_nobufs = false;
+    }
+    update_backpressure();
+    return true;
+}
+
+Clock::time_point txq_can_next_retry()
+{
+    return g_txq.can_count > 0 ? g_txq.can_retry_at : Clock::time_point::max();
+}
+
+void txq_print_status(const std::string& can_iface)
+{
+    const auto& q = g_txq;
+    if (can_iface.empty()) {
+        std::printf("\r\nTX queue: %zu bytes pending (max %zu, limit %zu KB), %llu bytes waited, %llu stalls, "
+                    "%llu refused, %llu repeat slots skipped%s\n\n", txq_depth(), q.max_depth, q.limit / 1024,
+                    static_cast<unsigned long long>(q.queued_bytes), static_cast<unsigned long long>(q.stalls),
+                    static_cast<unsigned long long>(q.overflows), static_cast<unsigned long long>(q.skipped_repeats),
+                    q.backpressure ? " [BACKPRESSURE]" : "");
+        return;
+    }
+    std::printf("\r\nTX queue: %zu frames parked (max %zu of %zu)%s\n", q.can_count, q.can_max_depth, q.can_limit,
+                q.backpressure ? " [BACKPRESSURE]" : "");
+    std::printf("  Parked:   %llu frames, %llu sent later, %llu dropped, %llu repeat slots skipped\n",
+                static_cast<unsigned long long>(q.can_queued), static_cast<unsigned long long>(q.can_sent),
+                static_cast<unsigned long long>(q.can_dropped), static_cast<unsigned long long>(q.skipped_repeats));
+    std::printf("  Refused:  ENOBUFS %llu, EAGAIN %llu\n", static_cast<unsigned long long>(q.can_enobufs),
+                static_cast<unsigned long long>(q.can_eagain));
+    if (q.can_sent > 0) {
+        std::printf("  Retry:    %.0f us average, %llu us max from refusal to write\n",
+                    static_cast<double>(q.can_wait_sum_us) / q.can_sent,
+                    static_cast<unsigned long long>(q.can_wait_max_us));
+    }
+
+    // ENOBUFS means the qdisc/driver queue is full; CAN defaults to 10 frames there
+    CanLinkInfo link;
+    if (canlink_query(can_iface, link) == 0) {
+        std::printf("  %s txqueuelen %u", can_iface.c_str(), link.txqueuelen);
+        if (q.can_enobufs > 0 && link.txqueuelen < 100) {
+            std::printf(": short for bursts, try: sudo ip link set %s txqueuelen 1000", can_iface.c_str());
+        }
+        std::printf("\n");
+    }
+    std::printf("\n");
+}
+
+} // namespace adamcom